@@ -31,6 +31,7 @@
 #include "Listen.hxx"
 #include "client/Client.hxx"
 #include "client/ClientList.hxx"
+#include "client/ClientThreads.hxx"
 #include "command/AllCommands.hxx"
 #include "Partition.hxx"
 #include "tag/TagConfig.hxx"
@@ -47,6 +48,8 @@
 #include "playlist/PlaylistRegistry.hxx"
 #include "zeroconf/ZeroconfGlue.hxx"
 #include "decoder/DecoderList.hxx"
+#include "decoder/DecoderCache.hxx"
+#include "decoder/DecoderConvertThread.hxx"
 #include "AudioConfig.hxx"
 #include "pcm/PcmConvert.hxx"
 #include "unix/SignalHandlers.hxx"
@@ -331,7 +334,22 @@ initialize_decoder_and_player(void)
 
 	buffer_size *= 1024;
 
-	const unsigned buffered_chunks = buffer_size / CHUNK_SIZE;
+	const size_t chunk_size =
+		config_get_positive(CONF_AUDIO_CHUNK_SIZE,
+				    DEFAULT_CHUNK_SIZE);
+	if (chunk_size < MIN_CHUNK_SIZE || chunk_size > MAX_CHUNK_SIZE)
+		FormatFatalError("chunk size \"%lu\" is out of range "
+				 "(%lu..%lu)",
+				 (unsigned long)chunk_size,
+				 (unsigned long)MIN_CHUNK_SIZE,
+				 (unsigned long)MAX_CHUNK_SIZE);
+
+	const unsigned buffered_chunks = buffer_size / chunk_size;
+
+	if (buffered_chunks == 0)
+		FormatFatalError("buffer size \"%lu\" is smaller than "
+				 "the chunk size",
+				 (unsigned long)buffer_size);
 
 	if (buffered_chunks >= 1 << 15)
 		FormatFatalError("buffer size \"%lu\" is too big",
@@ -355,6 +373,14 @@ initialize_decoder_and_player(void)
 	if (buffered_before_play > buffered_chunks)
 		buffered_before_play = buffered_chunks;
 
+	const unsigned decoder_cache_size =
+		config_get_unsigned(CONF_DECODER_CACHE_SIZE, 0);
+	if (decoder_cache_size > 0)
+		decoder_cache =
+			new DecoderCache(uint64_t(decoder_cache_size) * 1024);
+
+	decoder_convert_thread = config_get_bool(CONF_CONVERT_THREAD, false);
+
 	const unsigned max_length =
 		config_get_positive(CONF_MAX_PLAYLIST_LENGTH,
 				    DEFAULT_PLAYLIST_MAX_LENGTH);
@@ -362,7 +388,10 @@ initialize_decoder_and_player(void)
 	instance->partition = new Partition(*instance,
 					    max_length,
 					    buffered_chunks,
-					    buffered_before_play);
+					    chunk_size,
+					    buffered_before_play,
+					    config_get_unsigned(CONF_PREFETCH_SONGS,
+								0));
 }
 
 /**
@@ -549,6 +578,7 @@ int mpd_main(int argc, char *argv[])
 	instance->partition->outputs.Configure(*instance->event_loop,
 					       instance->partition->pc);
 	client_manager_init();
+	client_threads_init();
 	replay_gain_global_init();
 
 	if (!input_stream_global_init(error)) {
@@ -567,6 +597,7 @@ int mpd_main(int argc, char *argv[])
 #endif
 
 	io_thread_start();
+	client_threads_start();
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance->neighbors != nullptr &&
@@ -635,6 +666,10 @@ int mpd_main(int argc, char *argv[])
 
 	/* cleanup */
 
+	/* the client threads may be waiting for the main loop, which
+	   is not running anymore */
+	client_threads_stop();
+
 #if defined(ENABLE_DATABASE) && defined(ENABLE_INOTIFY)
 	mpd_inotify_finish();
 
@@ -651,6 +686,7 @@ int mpd_main(int argc, char *argv[])
 	ZeroconfDeinit();
 	listen_global_finish();
 	delete instance->client_list;
+	client_threads_deinit();
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance->neighbors != nullptr) {
@@ -684,6 +720,7 @@ int mpd_main(int argc, char *argv[])
 #endif
 
 	delete instance->partition;
+	delete decoder_cache;
 	command_finish();
 	decoder_plugin_deinit_all();
 #ifdef ENABLE_ARCHIVE
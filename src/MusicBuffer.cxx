@@ -24,8 +24,9 @@
 
 #include <assert.h>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
+MusicBuffer::MusicBuffer(unsigned num_chunks, size_t _chunk_size)
+	:chunk_size(_chunk_size),
+	 buffer(num_chunks, sizeof(MusicChunk) + _chunk_size) {
 	if (buffer.IsOOM())
 		FatalError("Failed to allocate buffer");
 }
@@ -33,8 +34,7 @@ MusicBuffer::MusicBuffer(unsigned num_chunks)
 MusicChunk *
 MusicBuffer::Allocate()
 {
-	const ScopeLock protect(mutex);
-	return buffer.Allocate();
+	return buffer.Allocate(chunk_size);
 }
 
 void
@@ -42,8 +42,6 @@ MusicBuffer::Return(MusicChunk *chunk)
 {
 	assert(chunk != nullptr);
 
-	const ScopeLock protect(mutex);
-
 	if (chunk->other != nullptr) {
 		assert(chunk->other->other == nullptr);
 		buffer.Free(chunk->other);
@@ -20,19 +20,19 @@
 #ifndef MPD_MUSIC_BUFFER_HXX
 #define MPD_MUSIC_BUFFER_HXX
 
-#include "util/SliceBuffer.hxx"
-#include "thread/Mutex.hxx"
+#include "util/AtomicSliceBuffer.hxx"
 
 struct MusicChunk;
 
 /**
- * An allocator for #MusicChunk objects.
+ * An allocator for #MusicChunk objects.  It may be used by several
+ * threads concurrently without locking.
  */
 class MusicBuffer {
-	/** a mutex which protects #buffer */
-	Mutex mutex;
+	/** the payload size of each #MusicChunk */
+	const size_t chunk_size;
 
-	SliceBuffer<MusicChunk> buffer;
+	AtomicSliceBuffer<MusicChunk> buffer;
 
 public:
 	/**
@@ -40,14 +40,15 @@ public:
 	 *
 	 * @param num_chunks the number of #MusicChunk reserved in
 	 * this buffer
+	 * @param chunk_size the payload size of each #MusicChunk
 	 */
-	MusicBuffer(unsigned num_chunks);
+	MusicBuffer(unsigned num_chunks, size_t chunk_size);
 
 #ifndef NDEBUG
 	/**
-	 * Check whether the buffer is empty.  This call is not
-	 * protected with the mutex, and may only be used while this
-	 * object is inaccessible to other threads.
+	 * Check whether the buffer is empty.  The result is only
+	 * reliable while this object is inaccessible to other
+	 * threads.
 	 */
 	bool IsEmptyUnsafe() const {
 		return buffer.IsEmpty();
@@ -64,6 +65,14 @@ public:
 		return buffer.GetCapacity();
 	}
 
+	/**
+	 * Returns the payload size of each chunk in bytes.
+	 */
+	gcc_pure
+	size_t GetChunkSize() const {
+		return chunk_size;
+	}
+
 	/**
 	 * Allocates a chunk from the buffer.  When it is not used anymore,
 	 * call Return().
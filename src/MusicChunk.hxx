@@ -28,10 +28,22 @@
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <stdint.h>
 #include <stddef.h>
 
-static constexpr size_t CHUNK_SIZE = 4096;
+/**
+ * The default value of the "audio_chunk_size" setting.
+ */
+static constexpr size_t DEFAULT_CHUNK_SIZE = 4096;
+
+/**
+ * The limits of the "audio_chunk_size" setting.  The minimum must
+ * fit at least one frame of every supported audio format.
+ */
+static constexpr size_t MIN_CHUNK_SIZE = 256;
+static constexpr size_t MAX_CHUNK_SIZE = 1024 * 1024;
 
 struct AudioFormat;
 struct Tag;
@@ -39,10 +51,18 @@ struct Tag;
 /**
  * A chunk of music data.  Its format is defined by the
  * MusicPipe::Push() caller.
+ *
+ * The payload is stored right after this object; its size is
+ * chosen at runtime, and the #MusicBuffer reserves that much space
+ * for each chunk.
  */
 struct MusicChunk {
-	/** the next chunk in a linked list */
-	MusicChunk *next;
+	/**
+	 * The next chunk in a linked list.  This is atomic because
+	 * the #MusicPipe producer links new chunks while consumers
+	 * walk the list without holding a lock.
+	 */
+	std::atomic<MusicChunk *> next;
 
 	/**
 	 * An optional chunk which should be mixed into this chunk.
@@ -57,7 +77,10 @@ struct MusicChunk {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length;
+	uint32_t length;
+
+	/** the size of the #data buffer */
+	const uint32_t capacity;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -87,17 +110,25 @@ struct MusicChunk {
 	unsigned replay_gain_serial;
 
 	/** the data (probably PCM) */
-	uint8_t data[CHUNK_SIZE];
+	uint8_t *const data;
 
 #ifndef NDEBUG
 	AudioFormat audio_format;
 #endif
 
-	MusicChunk()
-		:other(nullptr),
-		 length(0),
+	/**
+	 * @param _capacity the size of the payload which follows
+	 * this object in memory
+	 */
+	explicit MusicChunk(size_t _capacity)
+		:next(nullptr), other(nullptr),
+		 length(0), capacity(_capacity),
 		 tag(nullptr),
-		 replay_gain_serial(0) {}
+		 replay_gain_serial(0),
+		 data(reinterpret_cast<uint8_t *>(this + 1)) {}
+
+	MusicChunk(const MusicChunk &) = delete;
+	MusicChunk &operator=(const MusicChunk &) = delete;
 
 	~MusicChunk();
 
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MusicHistory.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+
+/**
+ * Can this chunk be played again?
+ */
+gcc_pure
+static bool
+IsReplayable(const MusicChunk &chunk)
+{
+	return chunk.length > 0 && !chunk.time.IsNegative() &&
+		chunk.other == nullptr;
+}
+
+/**
+ * Does this chunk contain the specified time stamp?
+ */
+gcc_pure
+static bool
+Contains(const MusicChunk &chunk, double t, double time_to_size)
+{
+	if (!IsReplayable(chunk))
+		return false;
+
+	const double start = chunk.time.ToDoubleS();
+	return t >= start && t < start + chunk.length / time_to_size;
+}
+
+void
+MusicHistory::SetLimit(unsigned limit, MusicBuffer &buffer)
+{
+	max_played = limit;
+	Trim(buffer);
+}
+
+MusicChunk *
+MusicHistory::Shift()
+{
+	if (replay.empty())
+		return nullptr;
+
+	MusicChunk *chunk = replay.front();
+	replay.pop_front();
+	return chunk;
+}
+
+void
+MusicHistory::Push(MusicChunk *chunk, MusicBuffer &buffer)
+{
+	if (n_previous > 0) {
+		/* the tail of the previous song */
+		--n_previous;
+		buffer.Return(chunk);
+		return;
+	}
+
+	if (max_played == 0 || !IsReplayable(*chunk)) {
+		buffer.Return(chunk);
+		return;
+	}
+
+	played.push_back(chunk);
+	Trim(buffer);
+}
+
+void
+MusicHistory::Clear(MusicBuffer &buffer)
+{
+	for (auto chunk : played)
+		buffer.Return(chunk);
+	played.clear();
+
+	for (auto chunk : replay)
+		buffer.Return(chunk);
+	replay.clear();
+}
+
+void
+MusicHistory::Trim(MusicBuffer &buffer)
+{
+	while (played.size() > max_played) {
+		buffer.Return(played.front());
+		played.pop_front();
+	}
+}
+
+bool
+MusicHistory::Seek(SongTime _t, MusicPipe &pipe, MusicBuffer &buffer,
+		   const AudioFormat audio_format)
+{
+	const double t = _t.ToDoubleS();
+	const double time_to_size = audio_format.GetTimeToSize();
+
+	/* seeking backwards: play the tail of the window again */
+
+	for (auto i = played.begin(), end = played.end(); i != end; ++i) {
+		if (Contains(**i, t, time_to_size)) {
+			replay.insert(replay.begin(), i, end);
+			played.erase(i, end);
+			return true;
+		}
+	}
+
+	/* seeking forward, but the new position has been played
+	   already before */
+
+	for (auto i = replay.begin(), end = replay.end(); i != end; ++i) {
+		if (Contains(**i, t, time_to_size)) {
+			played.insert(played.end(), replay.begin(), i);
+			replay.erase(replay.begin(), i);
+			Trim(buffer);
+			return true;
+		}
+	}
+
+	/* seeking forward into the decoder's pipe; only the chunks
+	   which are already counted may be inspected while the
+	   decoder is running */
+
+	const unsigned n = pipe.GetSize();
+	const MusicChunk *chunk = pipe.Peek();
+	for (unsigned i = 0; i < n; ++i, chunk = chunk->next.load()) {
+		if (Contains(*chunk, t, time_to_size)) {
+			/* skip the preceding chunks */
+			played.insert(played.end(),
+				      replay.begin(), replay.end());
+			replay.clear();
+
+			while (i-- > 0)
+				Push(pipe.Shift(), buffer);
+
+			Trim(buffer);
+			return true;
+		}
+	}
+
+	return false;
+}
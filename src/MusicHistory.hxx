@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_MUSIC_HISTORY_HXX
+#define MPD_MUSIC_HISTORY_HXX
+
+#include "Chrono.hxx"
+#include "Compiler.h"
+
+#include <deque>
+
+#include <assert.h>
+
+struct AudioFormat;
+struct MusicChunk;
+class MusicBuffer;
+class MusicPipe;
+
+/**
+ * A window of recently played #MusicChunk objects of the current
+ * song.  It allows the player to seek within audio data which has
+ * already been decoded, without asking the decoder to seek and
+ * without waiting for the buffer to be refilled.
+ *
+ * The chunks are borrowed from the #MusicBuffer; the window is
+ * limited, so the decoder always has enough free chunks.
+ *
+ * This class is not thread-safe; it is used only by the player
+ * thread.
+ */
+class MusicHistory {
+	/**
+	 * Chunks which have been played (or cancelled by the audio
+	 * outputs), oldest first.
+	 */
+	std::deque<MusicChunk *> played;
+
+	/**
+	 * Chunks which shall be played again after seeking
+	 * backwards.  They precede the chunks in the decoder's
+	 * #MusicPipe.
+	 */
+	std::deque<MusicChunk *> replay;
+
+	/**
+	 * The maximum size of #played.  0 disables the history.
+	 */
+	unsigned max_played;
+
+	/**
+	 * The number of chunks of the previous song which are still
+	 * in the audio outputs' #MusicPipe.  Push() returns them to
+	 * the buffer; their time stamps would be confused with the
+	 * current song's.
+	 */
+	unsigned n_previous;
+
+public:
+	MusicHistory():max_played(0), n_previous(0) {}
+
+	~MusicHistory() {
+		/* Clear() must have been called */
+		assert(played.empty());
+		assert(replay.empty());
+	}
+
+	MusicHistory(const MusicHistory &) = delete;
+	MusicHistory &operator=(const MusicHistory &) = delete;
+
+	/**
+	 * Change the maximum number of chunks in the window.  0
+	 * disables the history.  Chunks exceeding the new limit are
+	 * returned to the buffer.
+	 */
+	void SetLimit(unsigned limit, MusicBuffer &buffer);
+
+	unsigned GetLimit() const {
+		return max_played;
+	}
+
+	/**
+	 * A new song begins.  The next chunks passed to Push() still
+	 * belong to the previous song and will not be recorded.
+	 *
+	 * @param n the number of chunks of the previous song which
+	 * have not been returned yet
+	 */
+	void SongBorder(unsigned n) {
+		assert(replay.empty());
+
+		n_previous = n;
+	}
+
+	/**
+	 * Are there chunks to be played before the decoder's
+	 * #MusicPipe?
+	 */
+	bool HasReplay() const {
+		return !replay.empty();
+	}
+
+	/**
+	 * Removes the next chunk to be played again, or returns
+	 * nullptr if there is none.
+	 */
+	MusicChunk *Shift();
+
+	/**
+	 * Add a chunk which has been played, or return it to the
+	 * buffer if it cannot be played again (e.g. silence or
+	 * cross-faded chunks).
+	 */
+	void Push(MusicChunk *chunk, MusicBuffer &buffer);
+
+	/**
+	 * Return all chunks to the buffer.
+	 */
+	void Clear(MusicBuffer &buffer);
+
+	/**
+	 * Attempt to seek within the window and the chunks in the
+	 * decoder's pipe.  On success, Shift() and the pipe return
+	 * the chunk containing the specified time next.
+	 *
+	 * @param pipe the #MusicPipe which is filled by the decoder;
+	 * chunks preceding the new position are removed from it
+	 * @param audio_format the audio format of all chunks
+	 * @return false if the time is not within the window; nothing
+	 * has been modified then
+	 */
+	bool Seek(SongTime t, MusicPipe &pipe, MusicBuffer &buffer,
+		  AudioFormat audio_format);
+
+private:
+	void Trim(MusicBuffer &buffer);
+};
+
+#endif
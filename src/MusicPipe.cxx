@@ -27,8 +27,6 @@
 bool
 MusicPipe::Contains(const MusicChunk *chunk) const
 {
-	const ScopeLock protect(mutex);
-
 	for (const MusicChunk *i = head; i != nullptr; i = i->next)
 		if (i == chunk)
 			return true;
@@ -41,34 +39,51 @@ MusicPipe::Contains(const MusicChunk *chunk) const
 MusicChunk *
 MusicPipe::Shift()
 {
-	const ScopeLock protect(mutex);
-
-	MusicChunk *chunk = head;
-	if (chunk != nullptr) {
-		assert(!chunk->IsEmpty());
-
-		head = chunk->next;
-		--size;
-
-		if (head == nullptr) {
-			assert(size == 0);
-			assert(tail_r == &chunk->next);
+	/* only chunks which have been counted by Push() are visible
+	   to the consumer; this keeps #size consistent with the
+	   list */
+	if (size.load(std::memory_order_acquire) == 0)
+		return nullptr;
+
+	MusicChunk *chunk = head.load(std::memory_order_acquire);
+	assert(chunk != nullptr);
+	assert(!chunk->IsEmpty());
 
-			tail_r = &head;
-		} else {
-			assert(size > 0);
-			assert(tail_r != &chunk->next);
+	MusicChunk *next = chunk->next.load(std::memory_order_acquire);
+	if (next == nullptr) {
+		/* this appears to be the last chunk; unlink it, unless
+		   Push() has just appended another one */
+		head.store(nullptr, std::memory_order_relaxed);
+
+		MusicChunk *expected = chunk;
+		if (!tail.compare_exchange_strong(expected, nullptr,
+						  std::memory_order_acq_rel)) {
+			/* Push() has already claimed the tail, but
+			   has not yet linked the new chunk; wait for
+			   it */
+			while ((next = chunk->next.load(std::memory_order_acquire)) == nullptr) {}
+
+			head.store(next, std::memory_order_release);
 		}
+	} else
+		head.store(next, std::memory_order_release);
 
 #ifndef NDEBUG
-		/* poison the "next" reference */
-		chunk->next = (MusicChunk *)(void *)0x01010101;
+	/* poison the "next" reference */
+	chunk->next.store((MusicChunk *)(void *)0x01010101,
+			  std::memory_order_relaxed);
+#endif
 
-		if (size == 0)
+#ifndef NDEBUG
+	{
+		const ScopeLock protect(mutex);
+		assert(debug_size > 0);
+		if (--debug_size == 0)
 			audio_format.Clear();
-#endif
 	}
+#endif
 
+	size.fetch_sub(1, std::memory_order_release);
 	return chunk;
 }
 
@@ -87,20 +102,28 @@ MusicPipe::Push(MusicChunk *chunk)
 	assert(!chunk->IsEmpty());
 	assert(chunk->length == 0 || chunk->audio_format.IsValid());
 
-	const ScopeLock protect(mutex);
+#ifndef NDEBUG
+	{
+		const ScopeLock protect(mutex);
 
-	assert(size > 0 || !audio_format.IsDefined());
-	assert(!audio_format.IsDefined() ||
-	       chunk->CheckFormat(audio_format));
+		assert(debug_size > 0 || !audio_format.IsDefined());
+		assert(!audio_format.IsDefined() ||
+		       chunk->CheckFormat(audio_format));
 
-#ifndef NDEBUG
-	if (!audio_format.IsDefined() && chunk->length > 0)
-		audio_format = chunk->audio_format;
+		if (!audio_format.IsDefined() && chunk->length > 0)
+			audio_format = chunk->audio_format;
+
+		++debug_size;
+	}
 #endif
 
-	chunk->next = nullptr;
-	*tail_r = chunk;
-	tail_r = &chunk->next;
+	chunk->next.store(nullptr, std::memory_order_relaxed);
+
+	MusicChunk *prev = tail.exchange(chunk, std::memory_order_acq_rel);
+	if (prev == nullptr)
+		head.store(chunk, std::memory_order_release);
+	else
+		prev->next.store(chunk, std::memory_order_release);
 
-	++size;
+	size.fetch_add(1, std::memory_order_release);
 }
@@ -20,13 +20,15 @@
 #ifndef MPD_PIPE_H
 #define MPD_PIPE_H
 
-#include "thread/Mutex.hxx"
 #include "Compiler.h"
 
 #ifndef NDEBUG
+#include "thread/Mutex.hxx"
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <assert.h>
 
 struct MusicChunk;
@@ -35,22 +37,37 @@ class MusicBuffer;
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * The queue is lock-free: Push() may be called by the producer while
+ * the consumer calls Peek(), Shift() or GetSize().  Other threads may
+ * walk the list via Peek() and MusicChunk::next, as long as the
+ * consumer does not shift the chunks they are looking at.
  */
 class MusicPipe {
 	/** the first chunk */
-	MusicChunk *head;
+	std::atomic<MusicChunk *> head;
 
-	/** a pointer to the tail of the chunk */
-	MusicChunk **tail_r;
+	/** the last chunk, or nullptr if the pipe is empty */
+	std::atomic<MusicChunk *> tail;
 
-	/** the current number of chunks */
-	unsigned size;
+	/**
+	 * The current number of chunks.  It is incremented after the
+	 * chunk has been linked, so a non-zero value guarantees that
+	 * Shift() will succeed.
+	 */
+	std::atomic<unsigned> size;
 
-	/** a mutex which protects #head and #tail_r */
+#ifndef NDEBUG
+	/** a mutex which protects #audio_format and #debug_size */
 	mutable Mutex mutex;
 
-#ifndef NDEBUG
 	AudioFormat audio_format;
+
+	/**
+	 * The number of chunks which have been accounted for in
+	 * #audio_format.
+	 */
+	unsigned debug_size;
 #endif
 
 public:
@@ -58,9 +75,10 @@ public:
 	 * Creates a new #MusicPipe object.  It is empty.
 	 */
 	MusicPipe()
-		:head(nullptr), tail_r(&head), size(0) {
+		:head(nullptr), tail(nullptr), size(0) {
 #ifndef NDEBUG
 		audio_format.Clear();
+		debug_size = 0;
 #endif
 	}
 
@@ -68,8 +86,8 @@ public:
 	 * Frees the object.  It must be empty now.
 	 */
 	~MusicPipe() {
-		assert(head == nullptr);
-		assert(tail_r == &head);
+		assert(head.load() == nullptr);
+		assert(tail.load() == nullptr);
 	}
 
 #ifndef NDEBUG
@@ -79,12 +97,14 @@ public:
 	 */
 	gcc_pure
 	bool CheckFormat(AudioFormat other) const {
+		const ScopeLock protect(mutex);
 		return !audio_format.IsDefined() ||
 			audio_format == other;
 	}
 
 	/**
 	 * Checks if the specified chunk is enqueued in the music pipe.
+	 * May only be called by the consumer.
 	 */
 	gcc_pure
 	bool Contains(const MusicChunk *chunk) const;
@@ -96,11 +116,12 @@ public:
 	 */
 	gcc_pure
 	const MusicChunk *Peek() const {
-		return head;
+		return head.load(std::memory_order_acquire);
 	}
 
 	/**
 	 * Removes the first chunk from the head, and returns it.
+	 * Only one thread at a time may call this method.
 	 */
 	MusicChunk *Shift();
 
@@ -112,7 +133,8 @@ public:
 	void Clear(MusicBuffer &buffer);
 
 	/**
-	 * Pushes a chunk to the tail of the pipe.
+	 * Pushes a chunk to the tail of the pipe.  Only one thread at
+	 * a time may call this method.
 	 */
 	void Push(MusicChunk *chunk);
 
@@ -121,7 +143,7 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const {
-		return size;
+		return size.load(std::memory_order_acquire);
 	}
 
 	gcc_pure
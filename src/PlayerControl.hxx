@@ -28,6 +28,9 @@
 #include "CrossFade.hxx"
 #include "Chrono.hxx"
 
+#include <string>
+#include <vector>
+
 #include <stdint.h>
 
 class PlayerListener;
@@ -100,8 +103,19 @@ struct PlayerControl {
 
 	const unsigned buffer_chunks;
 
+	/**
+	 * The payload size of each #MusicChunk in bytes.
+	 */
+	const size_t chunk_size;
+
 	const unsigned buffered_before_play;
 
+	/**
+	 * The number of upcoming songs whose input streams are opened
+	 * in advance.  0 disables this.
+	 */
+	const unsigned prefetch_songs;
+
 	/**
 	 * The handle of the player thread.
 	 */
@@ -162,6 +176,13 @@ struct PlayerControl {
 	 */
 	DetachedSong *next_song;
 
+	/**
+	 * The URIs to be opened in advance, beginning with the next
+	 * queued song.  This is passed to the decoder's
+	 * #InputPrefetch when the song is queued.
+	 */
+	std::vector<std::string> prefetch_uris;
+
 	SongTime seek_time;
 
 	CrossFadeSettings cross_fade;
@@ -180,7 +201,9 @@ struct PlayerControl {
 	PlayerControl(PlayerListener &_listener,
 		      MultipleOutputs &_outputs,
 		      unsigned buffer_chunks,
-		      unsigned buffered_before_play);
+		      size_t chunk_size,
+		      unsigned buffered_before_play,
+		      unsigned prefetch_songs);
 	~PlayerControl();
 
 	/**
@@ -427,6 +450,16 @@ public:
 	 */
 	void EnqueueSong(DetachedSong *song);
 
+	/**
+	 * Set the URIs to be prefetched.  It takes effect when the
+	 * next song is queued with EnqueueSong().
+	 */
+	void SetPrefetch(std::vector<std::string> &&uris) {
+		Lock();
+		prefetch_uris = std::move(uris);
+		Unlock();
+	}
+
 	/**
 	 * Makes the player thread seek the specified song to a position.
 	 *
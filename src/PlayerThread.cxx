@@ -25,6 +25,7 @@
 #include "MusicPipe.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
+#include "MusicHistory.hxx"
 #include "DetachedSong.hxx"
 #include "system/FatalError.hxx"
 #include "CrossFade.hxx"
@@ -55,6 +56,12 @@ class Player {
 
 	MusicPipe *pipe;
 
+	/**
+	 * Recently played chunks of the current song, which allow
+	 * seeking without restarting the decoder.
+	 */
+	MusicHistory history;
+
 	/**
 	 * are we waiting for buffered_before_play?
 	 */
@@ -164,6 +171,16 @@ private:
 		pipe = _pipe;
 	}
 
+	/**
+	 * The maximum number of chunks kept in the #MusicHistory;
+	 * the other half of the buffer remains available to the
+	 * decoder.
+	 */
+	gcc_pure
+	unsigned GetHistoryLimit() const {
+		return buffer.GetSize() / 2;
+	}
+
 	/**
 	 * Start the decoder.
 	 *
@@ -217,6 +234,33 @@ private:
 	 */
 	bool SeekDecoder();
 
+	/**
+	 * Attempt to satisfy the #PlayerCommand::SEEK command with
+	 * chunks from the #MusicHistory or the #MusicPipe, without
+	 * seeking the decoder.
+	 *
+	 * The player lock is not held.
+	 *
+	 * @return true if the command has been finished
+	 */
+	bool SeekWithinHistory(SongTime where);
+
+	/**
+	 * Returns the #PlayerControl::seek_time, clipped to the
+	 * duration of the song.
+	 */
+	gcc_pure
+	SongTime GetSeekTime() const {
+		SongTime where = pc.seek_time;
+		if (!pc.total_time.IsNegative()) {
+			const SongTime total_time(pc.total_time);
+			if (where > total_time)
+				where = total_time;
+		}
+
+		return where;
+	}
+
 	/**
 	 * After the decoder has been started asynchronously, wait for
 	 * the "START" command to finish.  The decoder may not be
@@ -497,7 +541,7 @@ Player::SendSilence()
 	const size_t frame_size = play_audio_format.GetFrameSize();
 	/* this formula ensures that we don't send
 	   partial frames */
-	unsigned num_frames = sizeof(chunk->data) / frame_size;
+	unsigned num_frames = chunk->capacity / frame_size;
 
 	chunk->time = SignedSongTime::Negative(); /* undefined time stamp */
 	chunk->length = num_frames * frame_size;
@@ -520,6 +564,13 @@ Player::SeekDecoder()
 
 	const SongTime start_time = pc.next_song->GetStartTime();
 
+	if (IsDecoderAtCurrentSong() && !decoder_starting &&
+	    song->IsSame(*pc.next_song) &&
+	    SeekWithinHistory(GetSeekTime()))
+		/* no need to bother the decoder (which may have
+		   finished this song already) */
+		return true;
+
 	if (!dc.LockIsCurrentSong(*pc.next_song)) {
 		/* the decoder is already decoding the "next" song -
 		   stop it and start the previous song again */
@@ -561,13 +612,7 @@ Player::SeekDecoder()
 
 	/* send the SEEK command */
 
-	SongTime where = pc.seek_time;
-	if (!pc.total_time.IsNegative()) {
-		const SongTime total_time(pc.total_time);
-		if (where > total_time)
-			where = total_time;
-	}
-
+	const SongTime where = GetSeekTime();
 	if (!dc.Seek(where + start_time)) {
 		/* decoder failure */
 		player_command_finished(pc);
@@ -585,6 +630,35 @@ Player::SeekDecoder()
 
 	pc.outputs.Cancel();
 
+	/* these chunks are from the old position */
+	history.Clear(buffer);
+	history.SetLimit(GetHistoryLimit(), buffer);
+
+	return true;
+}
+
+inline bool
+Player::SeekWithinHistory(SongTime where)
+{
+	/* stop the audio outputs first; they pass their unplayed
+	   chunks to the history */
+	pc.outputs.Cancel();
+
+	if (!history.Seek(where, *pipe, buffer, play_audio_format))
+		return false;
+
+	FormatDebug(player_domain, "seeking within the buffer");
+
+	delete pc.next_song;
+	pc.next_song = nullptr;
+	queued = false;
+
+	elapsed_time = where;
+
+	player_command_finished(pc);
+
+	xfade_state = CrossFadeState::UNKNOWN;
+
 	return true;
 }
 
@@ -611,6 +685,11 @@ Player::ProcessCommand()
 		assert(!IsDecoderAtNextSong());
 
 		queued = true;
+
+		/* start opening the input streams of the next
+		   songs */
+		dc.prefetch.Set(std::move(pc.prefetch_uris));
+
 		pc.CommandFinished();
 		break;
 
@@ -753,6 +832,7 @@ Player::PlayNextChunk()
 	unsigned cross_fade_position;
 	MusicChunk *chunk = nullptr;
 	if (xfade_state == CrossFadeState::ENABLED && IsDecoderAtNextSong() &&
+	    !history.HasReplay() &&
 	    (cross_fade_position = pipe->GetSize()) <= cross_fade_chunks) {
 		/* perform cross fade */
 		MusicChunk *other_chunk = dc.pipe->Shift();
@@ -821,6 +901,11 @@ Player::PlayNextChunk()
 		}
 	}
 
+	if (chunk == nullptr)
+		/* chunks which are played again after seeking
+		   backwards come first */
+		chunk = history.Shift();
+
 	if (chunk == nullptr)
 		chunk = pipe->Shift();
 
@@ -863,7 +948,7 @@ Player::PlayNextChunk()
 	pc.Lock();
 	if (!dc.IsIdle() &&
 	    dc.pipe->GetSize() <= (pc.buffered_before_play +
-				   buffer.GetSize() * 3) / 4) {
+				   (buffer.GetSize() - history.GetLimit()) * 3) / 4) {
 		if (!decoder_woken) {
 			decoder_woken = true;
 			dc.Signal();
@@ -882,8 +967,13 @@ Player::SongBorder()
 
 	FormatDefault(player_domain, "played \"%s\"", song->GetURI());
 
+	assert(!history.HasReplay());
+
 	ReplacePipe(dc.pipe);
 
+	/* record the new song */
+	history.SetLimit(GetHistoryLimit(), buffer);
+
 	pc.outputs.SongBorder();
 
 	if (!WaitForDecoder())
@@ -920,6 +1010,9 @@ Player::Run()
 		return;
 	}
 
+	pc.outputs.SetHistory(&history);
+	history.SetLimit(GetHistoryLimit(), buffer);
+
 	pc.Lock();
 	pc.state = PlayerState::PLAY;
 
@@ -988,6 +1081,11 @@ Player::Run()
 
 			assert(dc.pipe == nullptr || dc.pipe == pipe);
 
+			/* stop recording chunks of the current song,
+			   the decoder needs the space for the next
+			   one */
+			history.SetLimit(0, buffer);
+
 			StartDecoder(*new MusicPipe());
 		}
 
@@ -1008,6 +1106,7 @@ Player::Run()
 							dc.GetMixRampPreviousEnd(),
 							dc.out_audio_format,
 							play_audio_format,
+							buffer.GetChunkSize(),
 							buffer.GetSize() -
 							pc.buffered_before_play);
 			if (cross_fade_chunks > 0) {
@@ -1025,7 +1124,7 @@ Player::Run()
 			if (pc.command == PlayerCommand::NONE)
 				pc.Wait();
 			continue;
-		} else if (!pipe->IsEmpty()) {
+		} else if (!pipe->IsEmpty() || history.HasReplay()) {
 			/* at least one music chunk is ready - send it
 			   to the audio output */
 
@@ -1073,6 +1172,9 @@ Player::Run()
 
 	ClearAndDeletePipe();
 
+	pc.outputs.SetHistory(nullptr);
+	history.Clear(buffer);
+
 	delete cross_fade_tag;
 
 	if (song != nullptr) {
@@ -1113,7 +1215,7 @@ player_task(void *arg)
 	DecoderControl dc(pc.mutex, pc.cond);
 	decoder_thread_start(dc);
 
-	MusicBuffer buffer(pc.buffer_chunks);
+	MusicBuffer buffer(pc.buffer_chunks, pc.chunk_size);
 
 	pc.Lock();
 
@@ -1134,6 +1236,10 @@ player_task(void *arg)
 			pc.outputs.Cancel();
 			pc.Lock();
 
+			/* close the prefetched input streams */
+			pc.prefetch_uris.clear();
+			dc.prefetch.Set(std::vector<std::string>());
+
 			/* fall through */
 
 		case PlayerCommand::PAUSE:
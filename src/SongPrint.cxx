@@ -51,15 +51,18 @@ song_print_uri(Client &client, const char *uri, bool base)
 			uri = allocated.c_str();
 	}
 
-	client_printf(client, "%s%s\n", SONG_FILE, uri);
+	client_write_pair(client, "file", uri);
 }
 
 void
 song_print_uri(Client &client, const LightSong &song, bool base)
 {
 	if (!base && song.directory != nullptr) {
-		client_printf(client, "%s%s/%s\n", SONG_FILE,
-			      song.directory, song.uri);
+		client_puts(client, SONG_FILE);
+		client_puts(client, song.directory);
+		client_puts(client, "/");
+		client_puts(client, song.uri);
+		client_puts(client, "\n");
 	} else
 		song_print_uri(client, song.uri, base);
 }
@@ -121,5 +124,5 @@ song_print_info(Client &client, const DetachedSong &song, bool base)
 
 	const auto duration = song.GetDuration();
 	if (!duration.IsNegative())
-		client_printf(client, "Time: %u\n", duration.RoundS());
+		client_write_pair(client, "Time", unsigned(duration.RoundS()));
 }
@@ -26,6 +26,8 @@
 #include "db/Selection.hxx"
 #include "db/Interface.hxx"
 #include "db/Stats.hxx"
+#include "tag/TagPool.hxx"
+#include "decoder/DecoderCache.hxx"
 #include "util/Error.hxx"
 #include "system/Clock.hxx"
 #include "Log.hxx"
@@ -121,6 +123,37 @@ db_stats_print(Client &client, const Database &db)
 
 #endif
 
+static void
+tag_pool_stats_print(Client &client)
+{
+	TagPoolStats tps;
+	tag_pool_get_stats(tps);
+
+	client_printf(client,
+		      "tag_pool_items: %u\n"
+		      "tag_pool_buckets: %u\n"
+		      "tag_pool_used_buckets: %u\n"
+		      "tag_pool_collisions: %u\n"
+		      "tag_pool_max_chain: %u\n",
+		      tps.n_items, tps.n_buckets, tps.n_used_buckets,
+		      tps.GetCollisions(), tps.max_chain);
+}
+
+static void
+decoder_cache_stats_print(Client &client, const DecoderCache &cache)
+{
+	DecoderCacheStats dcs;
+	cache.GetStats(dcs);
+
+	client_printf(client,
+		      "decoder_cache_songs: %u\n"
+		      "decoder_cache_size: %llu\n"
+		      "decoder_cache_hits: %u\n"
+		      "decoder_cache_misses: %u\n",
+		      dcs.n_items, (unsigned long long)dcs.size,
+		      dcs.hits, dcs.misses);
+}
+
 void
 stats_print(Client &client)
 {
@@ -139,4 +172,9 @@ stats_print(Client &client)
 	if (db != nullptr)
 		db_stats_print(client, *db);
 #endif
+
+	tag_pool_stats_print(client);
+
+	if (decoder_cache != nullptr)
+		decoder_cache_stats_print(client, *decoder_cache);
 }
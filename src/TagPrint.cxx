@@ -23,37 +23,35 @@
 #include "tag/TagSettings.h"
 #include "client/Client.hxx"
 
-#define SONG_TIME "Time: "
-
 void tag_print_types(Client &client)
 {
 	int i;
 
 	for (i = 0; i < TAG_NUM_OF_ITEM_TYPES; i++) {
 		if (!ignore_tag_items[i])
-			client_printf(client, "tagtype: %s\n",
-				      tag_item_names[i]);
+			client_write_pair(client, "tagtype",
+					  tag_item_names[i]);
 	}
 }
 
 void
 tag_print(Client &client, TagType type, const char *value)
 {
-	client_printf(client, "%s: %s\n", tag_item_names[type], value);
+	client_write_pair(client, tag_item_names[type], value);
 }
 
 void
 tag_print_values(Client &client, const Tag &tag)
 {
 	for (const auto &i : tag)
-		client_printf(client, "%s: %s\n",
-			      tag_item_names[i.type], i.value);
+		client_write_pair(client, tag_item_names[i.type], i.value);
 }
 
 void tag_print(Client &client, const Tag &tag)
 {
 	if (!tag.duration.IsNegative())
-		client_printf(client, SONG_TIME "%i\n", tag.duration.RoundS());
+		client_write_pair(client, "Time",
+				  unsigned(tag.duration.RoundS()));
 
 	tag_print_values(client, tag);
 }
@@ -25,6 +25,12 @@
 
 const Domain client_domain("client");
 
+bool
+Client::IsThreaded() const
+{
+	return &TimeoutMonitor::GetEventLoop() != partition.instance.event_loop;
+}
+
 #ifdef ENABLE_DATABASE
 
 const Database *
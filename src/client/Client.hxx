@@ -22,9 +22,13 @@
 
 #include "check.h"
 #include "ClientMessage.hxx"
+#include "ClientStream.hxx"
 #include "command/CommandListBuilder.hxx"
+#include "command/CommandResult.hxx"
 #include "event/FullyBufferedSocket.hxx"
 #include "event/TimeoutMonitor.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Mutex.hxx"
 #include "Compiler.h"
 
 #include <boost/intrusive/list.hpp>
@@ -44,7 +48,7 @@ class Database;
 class Storage;
 
 class Client final
-	: FullyBufferedSocket, TimeoutMonitor,
+	: FullyBufferedSocket, TimeoutMonitor, DeferredMonitor,
 	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
 public:
 	Partition &partition;
@@ -76,6 +80,17 @@ public:
 	/** idle flags that the client wants to receive */
 	unsigned idle_subscriptions;
 
+	/**
+	 * Protects #pending_idle_flags.
+	 */
+	Mutex idle_mutex;
+
+	/**
+	 * Idle flags which were added by another thread, to be
+	 * merged into #idle_flags by this client's #EventLoop.
+	 */
+	unsigned pending_idle_flags;
+
 	/**
 	 * A list of channel names this client is subscribed to.
 	 */
@@ -92,10 +107,34 @@ public:
 	 */
 	std::list<ClientMessage> messages;
 
+private:
+	/**
+	 * If this client lives in a client thread and a command is
+	 * being run in the main thread on its behalf, then its
+	 * response is collected here, because the socket must only
+	 * be used by the client thread.
+	 */
+	std::string *deferred_output;
+
+	/**
+	 * Was #deferred_output truncated because it exceeded
+	 * #client_max_output_buffer_size?
+	 */
+	bool deferred_output_full;
+
+	/**
+	 * The response which is being produced in portions, see
+	 * StartStream().  nullptr if there is none.
+	 */
+	ClientStream *stream;
+
+public:
 	Client(EventLoop &loop, Partition &partition,
 	       int fd, int uid, int num);
 
 	~Client() {
+		delete stream;
+
 		if (FullyBufferedSocket::IsDefined())
 			FullyBufferedSocket::Close();
 	}
@@ -112,7 +151,40 @@ public:
 	void Close();
 	void SetExpired();
 
-	using FullyBufferedSocket::Write;
+	/**
+	 * Does this client live in a client thread (and not in the
+	 * main thread)?
+	 */
+	gcc_pure
+	bool IsThreaded() const;
+
+	/**
+	 * @return false if the socket has been closed
+	 */
+	bool Write(const void *data, size_t length);
+
+	/**
+	 * May the current command respond with StartStream()?  This
+	 * is only possible in a client thread, and not in a command
+	 * list.
+	 */
+	gcc_pure
+	bool CanStream() const;
+
+	/**
+	 * Produce the response of the current command with the
+	 * given #ClientStream.  Whenever the output buffer is full,
+	 * it is suspended until the socket has accepted the pending
+	 * data, and the client does not process more commands until
+	 * the response is complete.  Meanwhile, the client thread
+	 * serves its other clients.
+	 *
+	 * @param _stream the stream; the #Client takes ownership
+	 * @return the result to be returned by the command handler:
+	 * CommandResult::BACKGROUND if the response is continued
+	 * later
+	 */
+	CommandResult StartStream(ClientStream *_stream);
 
 	/**
 	 * returns the uid of the client process, or a negative value
@@ -191,13 +263,34 @@ public:
 	const Storage *GetStorage() const;
 
 private:
+	/**
+	 * Process one line received from the client, in the main
+	 * thread unless client_line_is_concurrent() allows
+	 * processing it in this client's thread.
+	 */
+	CommandResult ProcessLine(char *line);
+
+	void CancelStream();
+
+	/**
+	 * Produce portions of #stream until the output buffer is
+	 * full or the response is complete.
+	 */
+	CommandResult RunStream();
+
 	/* virtual methods from class BufferedSocket */
 	virtual InputResult OnSocketInput(void *data, size_t length) override;
 	virtual void OnSocketError(Error &&error) override;
 	virtual void OnSocketClosed() override;
 
+	/* virtual methods from class FullyBufferedSocket */
+	virtual bool OnSocketFlushed() override;
+
 	/* virtual methods from class TimeoutMonitor */
 	virtual void OnTimeout() override;
+
+	/* virtual methods from class DeferredMonitor */
+	virtual void RunDeferred() override;
 };
 
 void client_manager_init(void);
@@ -223,4 +316,14 @@ gcc_printf(2,3)
 void
 client_printf(Client &client, const char *fmt, ...);
 
+/**
+ * Write a "name: value" line to the client.  This is cheaper than
+ * client_printf().
+ */
+void
+client_write_pair(Client &client, const char *name, const char *value);
+
+void
+client_write_pair(Client &client, const char *name, unsigned value);
+
 #endif
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "ClientInternal.hxx"
 #include "Idle.hxx"
+#include "event/Loop.hxx"
 
 #include <assert.h>
 
@@ -41,19 +42,42 @@ Client::IdleNotify()
 	}
 
 	client_puts(*this, "OK\n");
-
-	TimeoutMonitor::ScheduleSeconds(client_timeout);
 }
 
 void
 Client::IdleAdd(unsigned flags)
 {
+	if (!TimeoutMonitor::GetEventLoop().IsInside()) {
+		/* this client lives in a client thread; let that
+		   thread handle the flags */
+		idle_mutex.lock();
+		pending_idle_flags |= flags;
+		idle_mutex.unlock();
+
+		DeferredMonitor::Schedule();
+		return;
+	}
+
 	if (IsExpired())
 		return;
 
 	idle_flags |= flags;
-	if (idle_waiting && (idle_flags & idle_subscriptions))
+	if (idle_waiting && (idle_flags & idle_subscriptions)) {
 		IdleNotify();
+		TimeoutMonitor::ScheduleSeconds(client_timeout);
+	}
+}
+
+void
+Client::RunDeferred()
+{
+	idle_mutex.lock();
+	const unsigned flags = pending_idle_flags;
+	pending_idle_flags = 0;
+	idle_mutex.unlock();
+
+	if (flags != 0)
+		IdleAdd(flags);
 }
 
 bool
@@ -67,9 +91,8 @@ Client::IdleWait(unsigned flags)
 	if (idle_flags & idle_subscriptions) {
 		IdleNotify();
 		return true;
-	} else {
-		/* disable timeouts while in "idle" */
-		TimeoutMonitor::Cancel();
+	} else
+		/* the caller disables the timeout while in "idle",
+		   see Client::OnSocketInput() */
 		return false;
-	}
 }
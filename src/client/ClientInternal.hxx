@@ -33,6 +33,24 @@ extern int client_timeout;
 extern size_t client_max_command_list_size;
 extern size_t client_max_output_buffer_size;
 
+/**
+ * Create a #Client for a connection which has been accepted (and
+ * checked) by client_new().  Must be called in the thread of the
+ * specified #EventLoop.
+ */
+void
+client_create(EventLoop &loop, Partition &partition,
+	      int fd, const char *remote, int uid, unsigned num);
+
+/**
+ * May the specified line be processed in a client thread, i.e. does
+ * it only touch the client itself and the database?  Otherwise, it
+ * must be processed in the main thread.
+ */
+gcc_pure
+bool
+client_line_is_concurrent(const Client &client, const char *line);
+
 CommandResult
 client_process_line(Client &client, char *line);
 
@@ -28,6 +28,8 @@
 void
 ClientList::Remove(Client &client)
 {
+	const ScopeLock protect(mutex);
+
 	assert(!list.empty());
 
 	list.erase(list.iterator_to(client));
@@ -36,6 +38,7 @@ ClientList::Remove(Client &client)
 void
 ClientList::CloseAll()
 {
+	const ScopeLock protect(mutex);
 	list.clear_and_dispose(Client::Disposer());
 }
 
@@ -44,6 +47,7 @@ ClientList::IdleAdd(unsigned flags)
 {
 	assert(flags != 0);
 
+	const ScopeLock protect(mutex);
 	for (auto &client : list)
 		client.IdleAdd(flags);
 }
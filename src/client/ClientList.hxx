@@ -21,6 +21,7 @@
 #define MPD_CLIENT_LIST_HXX
 
 #include "Client.hxx"
+#include "thread/Mutex.hxx"
 
 class Client;
 
@@ -33,6 +34,12 @@ class ClientList {
 	List list;
 
 public:
+	/**
+	 * Protects the list, because clients living in a client
+	 * thread remove themselves.  Lock it while iterating.
+	 */
+	Mutex mutex;
+
 	ClientList(unsigned _max_size)
 		:max_size(_max_size) {}
 	~ClientList() {
@@ -47,11 +54,13 @@ public:
 		return list.end();
 	}
 
-	bool IsFull() const {
+	bool IsFull() {
+		const ScopeLock protect(mutex);
 		return list.size() >= max_size;
 	}
 
 	void Add(Client &client) {
+		const ScopeLock protect(mutex);
 		list.push_front(client);
 	}
 
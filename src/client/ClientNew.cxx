@@ -20,6 +20,7 @@
 #include "config.h"
 #include "ClientInternal.hxx"
 #include "ClientList.hxx"
+#include "ClientThreads.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "system/fd_util.h"
@@ -45,13 +46,16 @@ Client::Client(EventLoop &_loop, Partition &_partition,
 	       int _fd, int _uid, int _num)
 	:FullyBufferedSocket(_fd, _loop, 16384, client_max_output_buffer_size),
 	 TimeoutMonitor(_loop),
+	 DeferredMonitor(_loop),
 	 partition(_partition),
 	 playlist(partition.playlist), player_control(partition.pc),
 	 permission(getDefaultPermissions()),
 	 uid(_uid),
 	 num(_num),
-	 idle_waiting(false), idle_flags(0),
-	 num_subscriptions(0)
+	 idle_waiting(false), idle_flags(0), pending_idle_flags(0),
+	 num_subscriptions(0),
+	 deferred_output(nullptr), deferred_output_full(false),
+	 stream(nullptr)
 {
 	TimeoutMonitor::ScheduleSeconds(client_timeout);
 }
@@ -94,15 +98,26 @@ client_new(EventLoop &loop, Partition &partition,
 		return;
 	}
 
-	Client *client = new Client(loop, partition, fd, uid,
-				    next_client_num++);
+	if (client_threads_enabled())
+		client_threads_add(partition, fd, std::string(remote), uid,
+				   next_client_num++);
+	else
+		client_create(loop, partition, fd, remote.c_str(), uid,
+			      next_client_num++);
+}
+
+void
+client_create(EventLoop &loop, Partition &partition,
+	      int fd, const char *remote, int uid, unsigned num)
+{
+	Client *client = new Client(loop, partition, fd, uid, num);
 
 	(void)send(fd, GREETING, sizeof(GREETING) - 1, 0);
 
-	client_list.Add(*client);
+	partition.instance.client_list->Add(*client);
 
 	FormatInfo(client_domain, "[%u] opened from %s",
-		   client->num, remote.c_str());
+		   client->num, remote);
 }
 
 void
@@ -51,6 +51,30 @@ client_process_command_list(Client &client, bool list_ok,
 	return ret;
 }
 
+bool
+client_line_is_concurrent(const Client &client, const char *line)
+{
+	if (client.idle_waiting)
+		/* "noidle" only touches the client */
+		return true;
+
+	if (client.cmd_list.IsActive()) {
+		if (strcmp(line, CLIENT_LIST_MODE_END) != 0)
+			/* just adding to the list */
+			return true;
+
+		for (const auto &i : client.cmd_list.GetList())
+			if (!command_is_concurrent(client, i.c_str()))
+				return false;
+
+		return true;
+	}
+
+	return strcmp(line, CLIENT_LIST_MODE_BEGIN) == 0 ||
+		strcmp(line, CLIENT_LIST_OK_MODE_BEGIN) == 0 ||
+		command_is_concurrent(client, line);
+}
+
 CommandResult
 client_process_line(Client &client, char *line)
 {
@@ -19,16 +19,64 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientThreads.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "event/Loop.hxx"
 #include "util/StringUtil.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
 
 #include <string.h>
 
+CommandResult
+Client::ProcessLine(char *line)
+{
+	if (!IsThreaded() || client_line_is_concurrent(*this, line))
+		return client_process_line(*this, line);
+
+	EventLoop &main_loop = *partition.instance.event_loop;
+
+	/* this command may touch the player or the queue: run it
+	   in the main thread, while this thread waits, and send the
+	   response when it is finished */
+
+	std::string response;
+	deferred_output = &response;
+	deferred_output_full = false;
+
+	CommandResult result = CommandResult::CLOSE;
+	const bool called = client_call_main(main_loop, [this, line, &result](){
+			result = client_process_line(*this, line);
+		});
+
+	deferred_output = nullptr;
+
+	if (!called)
+		/* shutting down */
+		return CommandResult::CLOSE;
+
+	if (deferred_output_full) {
+		Error error;
+		error.Set(client_domain, "Output buffer is full");
+		OnSocketError(std::move(error));
+		return CommandResult::CLOSE;
+	}
+
+	if (!response.empty() && !IsExpired())
+		Write(response.data(), response.size());
+
+	return result;
+}
+
 BufferedSocket::InputResult
 Client::OnSocketInput(void *data, size_t length)
 {
+	if (stream != nullptr)
+		/* the response to the previous command is not yet
+		   complete; see OnSocketFlushed() */
+		return InputResult::PAUSE;
+
 	char *p = (char *)data;
 	char *newline = (char *)memchr(p, '\n', length);
 	if (newline == nullptr)
@@ -44,17 +92,22 @@ Client::OnSocketInput(void *data, size_t length)
 	/* terminate the string at the end of the line */
 	*end = 0;
 
-	CommandResult result = client_process_line(*this, p);
+	CommandResult result = ProcessLine(p);
 	switch (result) {
 	case CommandResult::OK:
 	case CommandResult::IDLE:
 	case CommandResult::ERROR:
+	case CommandResult::BACKGROUND:
 		break;
 
-	case CommandResult::KILL:
+	case CommandResult::KILL: {
+		EventLoop &main_loop = *partition.instance.event_loop;
 		Close();
-		partition.instance.event_loop->Break();
+		client_call_main(main_loop, [&main_loop](){
+				main_loop.Break();
+			});
 		return InputResult::CLOSED;
+	}
 
 	case CommandResult::FINISH:
 		if (Flush())
@@ -71,5 +124,12 @@ Client::OnSocketInput(void *data, size_t length)
 		return InputResult::CLOSED;
 	}
 
+	if (result == CommandResult::BACKGROUND)
+		return InputResult::PAUSE;
+
+	if (idle_waiting)
+		/* disable timeouts while in "idle" */
+		TimeoutMonitor::Cancel();
+
 	return InputResult::AGAIN;
 }
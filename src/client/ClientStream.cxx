@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ClientInternal.hxx"
+#include "ClientStream.hxx"
+#include "command/CommandError.hxx"
+#include "protocol/Result.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+
+bool
+Client::CanStream() const
+{
+	return IsThreaded() && !cmd_list.IsActive() && stream == nullptr;
+}
+
+CommandResult
+Client::StartStream(ClientStream *_stream)
+{
+	assert(CanStream());
+	assert(_stream != nullptr);
+
+	stream = _stream;
+	return RunStream();
+}
+
+void
+Client::CancelStream()
+{
+	delete stream;
+	stream = nullptr;
+}
+
+CommandResult
+Client::RunStream()
+{
+	assert(stream != nullptr);
+
+	while (!stream->IsDone()) {
+		if (IsExpired()) {
+			CancelStream();
+			return CommandResult::CLOSE;
+		}
+
+		if (FullyBufferedSocket::IsOutputFull())
+			/* continue in OnSocketFlushed() */
+			return CommandResult::BACKGROUND;
+
+		Error error;
+		if (!stream->Next(*this, error)) {
+			CancelStream();
+			return print_error(*this, error);
+		}
+	}
+
+	CancelStream();
+	return CommandResult::OK;
+}
+
+bool
+Client::OnSocketFlushed()
+{
+	if (stream == nullptr)
+		return true;
+
+	/* the client is still reading */
+	TimeoutMonitor::ScheduleSeconds(client_timeout);
+
+	switch (RunStream()) {
+	case CommandResult::BACKGROUND:
+		return true;
+
+	case CommandResult::OK:
+		command_success(*this);
+		break;
+
+	default:
+		/* an error has been reported already, or the client
+		   has expired */
+		break;
+	}
+
+	if (IsExpired()) {
+		Close();
+		return false;
+	}
+
+	/* the response is complete; process the commands which
+	   have been received meanwhile */
+	return ResumeInput();
+}
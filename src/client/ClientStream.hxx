@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_STREAM_HXX
+#define MPD_CLIENT_STREAM_HXX
+
+#include "check.h"
+
+class Client;
+class Error;
+
+/**
+ * A large response which is produced in portions.  While the
+ * client's output buffer is full, no more portions are produced,
+ * and the client thread serves its other clients.  See
+ * Client::StartStream().
+ */
+class ClientStream {
+public:
+	virtual ~ClientStream() {}
+
+	/**
+	 * Has the whole response been produced?
+	 */
+	virtual bool IsDone() const = 0;
+
+	/**
+	 * Write the next portion of the response to the client.
+	 *
+	 * @return false on error
+	 */
+	virtual bool Next(Client &client, Error &error) = 0;
+};
+
+#endif
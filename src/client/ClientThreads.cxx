@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ClientThreads.hxx"
+#include "ClientInternal.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "event/Loop.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "system/fd_util.h"
+#include "system/FatalError.hxx"
+#include "util/Error.hxx"
+
+#include <list>
+#include <vector>
+
+#include <assert.h>
+
+/**
+ * A thread with its own #EventLoop, which serves a subset of the
+ * clients.
+ */
+class ClientThread final : DeferredMonitor {
+	struct NewClient {
+		Partition &partition;
+		int fd;
+		std::string remote;
+		int uid;
+		unsigned num;
+
+		NewClient(Partition &_partition, int _fd,
+			  std::string &&_remote, int _uid, unsigned _num)
+			:partition(_partition), fd(_fd),
+			 remote(std::move(_remote)), uid(_uid), num(_num) {}
+	};
+
+	const unsigned index;
+
+	Thread thread;
+
+	/**
+	 * Protects #new_clients.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Connections which were accepted by the main thread, waiting
+	 * to be picked up by this thread.
+	 */
+	std::list<NewClient> new_clients;
+
+public:
+	ClientThread(EventLoop &_loop, unsigned _index)
+		:DeferredMonitor(_loop), index(_index) {}
+
+	~ClientThread() {
+		assert(!thread.IsDefined());
+
+		for (const auto &i : new_clients)
+			close_socket(i.fd);
+	}
+
+	EventLoop &GetEventLoop() {
+		return DeferredMonitor::GetEventLoop();
+	}
+
+	void Start() {
+		Error error;
+		if (!thread.Start(Run, this, error))
+			FatalError(error);
+	}
+
+	void Stop() {
+		if (thread.IsDefined()) {
+			GetEventLoop().Break();
+			thread.Join();
+		}
+	}
+
+	void Add(Partition &partition, int fd, std::string &&remote,
+		 int uid, unsigned num) {
+		mutex.lock();
+		new_clients.emplace_back(partition, fd, std::move(remote),
+					 uid, num);
+		mutex.unlock();
+
+		DeferredMonitor::Schedule();
+	}
+
+private:
+	static void Run(void *ctx);
+
+	/* virtual methods from class DeferredMonitor */
+	virtual void RunDeferred() override;
+};
+
+void
+ClientThread::Run(void *ctx)
+{
+	ClientThread &ct = *(ClientThread *)ctx;
+	FormatThreadName("client:%u", ct.index);
+
+	ct.GetEventLoop().Run();
+}
+
+void
+ClientThread::RunDeferred()
+{
+	mutex.lock();
+	std::list<NewClient> list = std::move(new_clients);
+	new_clients.clear();
+	mutex.unlock();
+
+	for (const auto &i : list)
+		client_create(GetEventLoop(), i.partition, i.fd,
+			      i.remote.c_str(), i.uid, i.num);
+}
+
+static std::vector<ClientThread *> client_threads;
+static unsigned next_client_thread;
+
+/**
+ * Protects #client_threads_quit and the "done" flags of all
+ * #MainCall instances.
+ */
+static Mutex client_call_mutex;
+static Cond client_call_cond;
+static bool client_threads_quit;
+
+void
+client_threads_init()
+{
+	assert(client_threads.empty());
+
+	const unsigned n = config_get_unsigned(CONF_CLIENT_THREADS, 0);
+	for (unsigned i = 0; i < n; ++i)
+		client_threads.push_back(new ClientThread(*new EventLoop(),
+							  i));
+}
+
+void
+client_threads_start()
+{
+	for (auto *ct : client_threads)
+		ct->Start();
+}
+
+void
+client_threads_stop()
+{
+	client_call_mutex.lock();
+	client_threads_quit = true;
+	client_call_cond.broadcast();
+	client_call_mutex.unlock();
+
+	for (auto *ct : client_threads)
+		ct->Stop();
+}
+
+void
+client_threads_deinit()
+{
+	for (auto *ct : client_threads) {
+		EventLoop &loop = ct->GetEventLoop();
+		delete ct;
+		delete &loop;
+	}
+
+	client_threads.clear();
+}
+
+bool
+client_threads_enabled()
+{
+	return !client_threads.empty();
+}
+
+void
+client_threads_add(Partition &partition, int fd, std::string &&remote,
+		   int uid, unsigned num)
+{
+	assert(client_threads_enabled());
+
+	ClientThread &ct = *client_threads[next_client_thread];
+	next_client_thread = (next_client_thread + 1) % client_threads.size();
+
+	ct.Add(partition, fd, std::move(remote), uid, num);
+}
+
+class MainCall final : DeferredMonitor {
+	const std::function<void()> f;
+
+	bool done;
+
+public:
+	MainCall(EventLoop &_loop, std::function<void()> &&_f)
+		:DeferredMonitor(_loop), f(std::move(_f)), done(false) {}
+
+	bool Run() {
+		assert(!done);
+
+		Schedule();
+
+		const ScopeLock protect(client_call_mutex);
+		while (!done && !client_threads_quit)
+			client_call_cond.wait(client_call_mutex);
+
+		return done;
+	}
+
+private:
+	virtual void RunDeferred() override {
+		assert(!done);
+
+		f();
+
+		const ScopeLock protect(client_call_mutex);
+		done = true;
+		client_call_cond.broadcast();
+	}
+};
+
+bool
+client_call_main(EventLoop &main_loop, std::function<void()> &&f)
+{
+	if (main_loop.IsInside()) {
+		f();
+		return true;
+	}
+
+	MainCall m(main_loop, std::move(f));
+	return m.Run();
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_THREADS_HXX
+#define MPD_CLIENT_THREADS_HXX
+
+#include "check.h"
+
+#include <functional>
+#include <string>
+
+class EventLoop;
+struct Partition;
+
+/**
+ * Read the "client_threads" setting and create the event loops of
+ * the client threads.
+ */
+void
+client_threads_init();
+
+/**
+ * Start the client threads.
+ */
+void
+client_threads_start();
+
+/**
+ * Stop and join the client threads.  Pending client_call_main()
+ * calls are cancelled, because the main loop will not run them
+ * anymore.  Must be called in the main thread after its #EventLoop
+ * has finished.
+ */
+void
+client_threads_stop();
+
+/**
+ * Free the event loops.  All clients must have been closed.
+ */
+void
+client_threads_deinit();
+
+/**
+ * Are connections served by client threads (instead of the main
+ * thread)?
+ */
+bool
+client_threads_enabled();
+
+/**
+ * Pass a new connection to the next client thread, which creates
+ * the #Client object.
+ */
+void
+client_threads_add(Partition &partition, int fd, std::string &&remote,
+		   int uid, unsigned num);
+
+/**
+ * Call the given function in the main thread, and wait for it to
+ * finish.  Unlike BlockingCall(), this gives up when MPD is shutting
+ * down.
+ *
+ * @return true if the function has been called, false if MPD is
+ * shutting down
+ */
+bool
+client_call_main(EventLoop &main_loop, std::function<void()> &&f);
+
+#endif
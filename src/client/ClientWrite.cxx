@@ -22,6 +22,26 @@
 #include "util/FormatString.hxx"
 
 #include <string.h>
+#include <stdio.h>
+
+bool
+Client::Write(const void *data, size_t length)
+{
+	if (deferred_output != nullptr) {
+		/* called by the main thread on behalf of a client
+		   thread, see Client::ProcessLine() */
+		if (deferred_output->size() + length >
+		    client_max_output_buffer_size) {
+			deferred_output_full = true;
+			return false;
+		}
+
+		deferred_output->append((const char *)data, length);
+		return true;
+	}
+
+	return FullyBufferedSocket::Write(data, length);
+}
 
 /**
  * Write a block of data to the client.
@@ -45,6 +65,21 @@ client_puts(Client &client, const char *s)
 void
 client_vprintf(Client &client, const char *fmt, va_list args)
 {
+#ifndef WIN32
+	/* try a stack buffer first, which is large enough for
+	   nearly all lines */
+	char buffer[1024];
+	va_list tmp;
+	va_copy(tmp, args);
+	const int length = vsnprintf(buffer, sizeof(buffer), fmt, tmp);
+	va_end(tmp);
+
+	if (length >= 0 && size_t(length) < sizeof(buffer)) {
+		client_write(client, buffer, length);
+		return;
+	}
+#endif
+
 	char *p = FormatNewV(fmt, args);
 	client_write(client, p, strlen(p));
 	delete[] p;
@@ -59,3 +94,46 @@ client_printf(Client &client, const char *fmt, ...)
 	client_vprintf(client, fmt, args);
 	va_end(args);
 }
+
+void
+client_write_pair(Client &client, const char *name, const char *value)
+{
+	const size_t name_length = strlen(name);
+	const size_t value_length = strlen(value);
+
+	char buffer[512];
+	const size_t length = name_length + 2 + value_length + 1;
+	if (length > sizeof(buffer)) {
+		client_write(client, name, name_length);
+		client_write(client, ": ", 2);
+		client_write(client, value, value_length);
+		client_write(client, "\n", 1);
+		return;
+	}
+
+	char *p = buffer;
+	memcpy(p, name, name_length);
+	p += name_length;
+	*p++ = ':';
+	*p++ = ' ';
+	memcpy(p, value, value_length);
+	p += value_length;
+	*p = '\n';
+
+	client_write(client, buffer, length);
+}
+
+void
+client_write_pair(Client &client, const char *name, unsigned value)
+{
+	char buffer[16];
+	char *p = buffer + sizeof(buffer);
+	*--p = 0;
+
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+
+	client_write_pair(client, name, p);
+}
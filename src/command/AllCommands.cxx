@@ -34,6 +34,7 @@
 #include "tag/TagType.h"
 #include "protocol/Result.hxx"
 #include "Partition.hxx"
+#include "Instance.hxx"
 #include "client/Client.hxx"
 #include "util/Tokenizer.hxx"
 #include "util/Error.hxx"
@@ -43,6 +44,11 @@
 #include "sticker/StickerDatabase.hxx"
 #endif
 
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#endif
+
 #include <assert.h>
 #include <string.h>
 
@@ -318,6 +324,59 @@ command_check_request(const struct command *cmd, Client &client,
 		return true;
 }
 
+struct concurrent_command {
+	const char *cmd;
+
+	/** does this command use the database? */
+	bool database;
+};
+
+/**
+ * Commands which may be run in a client thread, see
+ * command_is_concurrent().  They must not touch the player, the
+ * queue or other clients.
+ */
+static constexpr struct concurrent_command concurrent_commands[] = {
+	{ "count", true },
+	{ "find", true },
+	{ "idle", false },
+	{ "list", true },
+	{ "listall", true },
+	{ "listallinfo", true },
+	{ "listfiles", true },
+	{ "lsinfo", true },
+	{ "ping", false },
+	{ "search", true },
+};
+
+bool
+command_is_concurrent(gcc_unused const Client &client, const char *line)
+{
+	const size_t length = strcspn(line, " \t");
+
+	const struct concurrent_command *cmd = nullptr;
+	for (const auto &i : concurrent_commands) {
+		if (strlen(i.cmd) == length &&
+		    memcmp(i.cmd, line, length) == 0) {
+			cmd = &i;
+			break;
+		}
+	}
+
+	if (cmd == nullptr)
+		return false;
+
+	if (!cmd->database)
+		return true;
+
+#ifdef ENABLE_DATABASE
+	const Database *db = client.partition.instance.database;
+	return db == nullptr || db->GetPlugin().IsThreadSafe();
+#else
+	return true;
+#endif
+}
+
 static const struct command *
 command_checked_lookup(Client &client, unsigned permission,
 		       unsigned argc, char *argv[])
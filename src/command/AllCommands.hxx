@@ -21,6 +21,7 @@
 #define MPD_ALL_COMMANDS_HXX
 
 #include "CommandResult.hxx"
+#include "Compiler.h"
 
 class Client;
 
@@ -28,6 +29,16 @@ void command_init(void);
 
 void command_finish(void);
 
+/**
+ * May the command on this line be run in a client thread,
+ * concurrently with the main thread?  This is true for commands
+ * which only read the database (if the database plugin allows it)
+ * or the state of the client itself.
+ */
+gcc_pure
+bool
+command_is_concurrent(const Client &client, const char *line);
+
 CommandResult
 command_process(Client &client, unsigned num, char *line);
 
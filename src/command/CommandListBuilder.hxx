@@ -96,6 +96,13 @@ public:
 	 */
 	bool Add(const char *cmd);
 
+	/**
+	 * Returns the commands added so far.
+	 */
+	const std::list<std::string> &GetList() const {
+		return list;
+	}
+
 	/**
 	 * Finishes the list and returns it.
 	 */
@@ -47,6 +47,13 @@ enum class CommandResult {
 	 */
 	ERROR,
 
+	/**
+	 * The response is being produced in portions, see
+	 * Client::StartStream().  The "OK" or "ACK" response will be
+	 * sent when it is complete.
+	 */
+	BACKGROUND,
+
 	/**
 	 * The client has asked MPD to close the connection.  MPD will
 	 * flush the remaining output buffer first.
@@ -32,8 +32,11 @@
 #include "util/Error.hxx"
 #include "SongFilter.hxx"
 #include "protocol/Result.hxx"
+#include "protocol/ArgParser.hxx"
 #include "BulkEdit.hxx"
 
+#include <limits>
+
 #include <string.h>
 
 CommandResult
@@ -65,11 +68,62 @@ handle_lsinfo2(Client &client, unsigned argc, char *argv[])
 	return CommandResult::OK;
 }
 
+/**
+ * Parse a "window START:END" pair at the end of the argument list
+ * and remove it.
+ *
+ * @return false on error (already reported to the client)
+ */
+static bool
+ParseWindow(Client &client, ConstBuffer<const char *> &args,
+	    unsigned &start, unsigned &end)
+{
+	if (args.size < 2 || strcmp(args[args.size - 2], "window") != 0)
+		return true;
+
+	if (!check_range(client, &start, &end, args[args.size - 1]))
+		return false;
+
+	args.pop_back();
+	args.pop_back();
+	return true;
+}
+
 static CommandResult
 handle_match(Client &client, unsigned argc, char *argv[], bool fold_case)
 {
 	ConstBuffer<const char *> args(argv + 1, argc - 1);
 
+	TagType sort = TAG_NUM_OF_ITEM_TYPES;
+	bool descending = false;
+	unsigned window_start = 0;
+	unsigned window_end = std::numeric_limits<unsigned>::max();
+
+	while (args.size >= 2) {
+		const char *name = args[args.size - 2];
+		if (strcmp(name, "window") == 0) {
+			if (!ParseWindow(client, args,
+					 window_start, window_end))
+				return CommandResult::ERROR;
+		} else if (strcmp(name, "sort") == 0) {
+			const char *s = args[args.size - 1];
+			descending = *s == '-';
+			if (descending)
+				++s;
+
+			sort = tag_name_parse_i(s);
+			if (sort == TAG_NUM_OF_ITEM_TYPES) {
+				command_error(client, ACK_ERROR_ARG,
+					      "Unknown tag type: %s", s);
+				return CommandResult::ERROR;
+			}
+
+			args.pop_back();
+			args.pop_back();
+		} else
+			break;
+	}
+
 	SongFilter filter;
 	if (!filter.Parse(args, fold_case)) {
 		command_error(client, ACK_ERROR_ARG, "incorrect arguments");
@@ -79,7 +133,14 @@ handle_match(Client &client, unsigned argc, char *argv[], bool fold_case)
 	const DatabaseSelection selection("", true, &filter);
 
 	Error error;
-	return db_selection_print(client, selection, true, false, error)
+	const bool success = sort == TAG_NUM_OF_ITEM_TYPES &&
+		window_start == 0 &&
+		window_end == std::numeric_limits<unsigned>::max()
+		? db_selection_print(client, selection, true, false, error)
+		: db_selection_print(client, selection, true, false,
+				     sort, descending,
+				     window_start, window_end, error);
+	return success
 		? CommandResult::OK
 		: print_error(client, error);
 }
@@ -182,6 +243,32 @@ handle_count(Client &client, unsigned argc, char *argv[])
 		: print_error(client, error);
 }
 
+/**
+ * Print a directory recursively.  In a client thread, the response
+ * is streamed, see Client::StartStream().
+ */
+static CommandResult
+PrintRecursive(Client &client, const char *directory, bool full)
+{
+	Error error;
+
+	if (client.CanStream()) {
+		ClientStream *stream =
+			db_selection_stream(client, directory, full, false,
+					    error);
+		if (stream != nullptr)
+			return client.StartStream(stream);
+
+		if (error.IsDefined())
+			return print_error(client, error);
+	}
+
+	return db_selection_print(client, DatabaseSelection(directory, true),
+				  full, false, error)
+		? CommandResult::OK
+		: print_error(client, error);
+}
+
 CommandResult
 handle_listall(Client &client, gcc_unused unsigned argc, char *argv[])
 {
@@ -190,11 +277,7 @@ handle_listall(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (argc == 2)
 		directory = argv[1];
 
-	Error error;
-	return db_selection_print(client, DatabaseSelection(directory, true),
-				  false, false, error)
-		? CommandResult::OK
-		: print_error(client, error);
+	return PrintRecursive(client, directory, false);
 }
 
 CommandResult
@@ -213,6 +296,11 @@ handle_list(Client &client, unsigned argc, char *argv[])
 
 	SongFilter *filter = nullptr;
 	uint32_t group_mask = 0;
+	unsigned window_start = 0;
+	unsigned window_end = std::numeric_limits<unsigned>::max();
+
+	if (!ParseWindow(client, args, window_start, window_end))
+		return CommandResult::ERROR;
 
 	if (args.size == 1) {
 		/* for compatibility with < 0.12.0 */
@@ -261,7 +349,8 @@ handle_list(Client &client, unsigned argc, char *argv[])
 
 	Error error;
 	CommandResult ret =
-		PrintUniqueTags(client, tagType, group_mask, filter, error)
+		PrintUniqueTags(client, tagType, group_mask, filter,
+				window_start, window_end, error)
 		? CommandResult::OK
 		: print_error(client, error);
 
@@ -278,9 +367,5 @@ handle_listallinfo(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (argc == 2)
 		directory = argv[1];
 
-	Error error;
-	return db_selection_print(client, DatabaseSelection(directory, true),
-				  true, false, error)
-		? CommandResult::OK
-		: print_error(client, error);
+	return PrintRecursive(client, directory, true);
 }
@@ -80,10 +80,14 @@ handle_channels(Client &client,
 {
 	assert(argc == 1);
 
+	ClientList &client_list = *client.partition.instance.client_list;
+
 	std::set<std::string> channels;
-	for (const auto &c : *client.partition.instance.client_list)
+	client_list.mutex.lock();
+	for (const auto &c : client_list)
 		channels.insert(c.subscriptions.begin(),
 				c.subscriptions.end());
+	client_list.mutex.unlock();
 
 	for (const auto &channel : channels)
 		client_printf(client, "channel: %s\n", channel.c_str());
@@ -120,11 +124,15 @@ handle_send_message(Client &client,
 		return CommandResult::ERROR;
 	}
 
+	ClientList &client_list = *client.partition.instance.client_list;
+
 	bool sent = false;
 	const ClientMessage msg(argv[1], argv[2]);
-	for (auto &c : *client.partition.instance.client_list)
+	client_list.mutex.lock();
+	for (auto &c : client_list)
 		if (c.PushMessage(msg))
 			sent = true;
+	client_list.mutex.unlock();
 
 	if (sent)
 		return CommandResult::OK;
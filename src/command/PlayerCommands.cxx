@@ -54,6 +54,8 @@
 #define COMMAND_STATUS_MIXRAMPDELAY	"mixrampdelay"
 #define COMMAND_STATUS_AUDIO		"audio"
 #define COMMAND_STATUS_UPDATING_DB	"updating_db"
+#define COMMAND_STATUS_UPDATING_DB_DIRECTORIES "updating_db_directories"
+#define COMMAND_STATUS_UPDATING_DB_SONGS "updating_db_songs"
 
 CommandResult
 handle_play(Client &client, unsigned argc, char *argv[])
@@ -201,6 +203,13 @@ handle_status(Client &client,
 		client_printf(client,
 			      COMMAND_STATUS_UPDATING_DB ": %i\n",
 			      updateJobId);
+
+		unsigned n_directories, n_songs;
+		if (update_service->GetProgress(n_directories, n_songs))
+			client_printf(client,
+				      COMMAND_STATUS_UPDATING_DB_DIRECTORIES ": %u\n"
+				      COMMAND_STATUS_UPDATING_DB_SONGS ": %u\n",
+				      n_directories, n_songs);
 	}
 #endif
 
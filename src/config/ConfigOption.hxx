@@ -52,8 +52,12 @@ enum ConfigOption {
 	CONF_REPLAYGAIN_LIMIT,
 	CONF_VOLUME_NORMALIZATION,
 	CONF_SAMPLERATE_CONVERTER,
+	CONF_CONVERT_THREAD,
 	CONF_AUDIO_BUFFER_SIZE,
+	CONF_AUDIO_CHUNK_SIZE,
 	CONF_BUFFER_BEFORE_PLAY,
+	CONF_DECODER_CACHE_SIZE,
+	CONF_PREFETCH_SONGS,
 	CONF_HTTP_PROXY_HOST,
 	CONF_HTTP_PROXY_PORT,
 	CONF_HTTP_PROXY_USER,
@@ -63,6 +67,7 @@ enum ConfigOption {
 	CONF_MAX_PLAYLIST_LENGTH,
 	CONF_MAX_COMMAND_LIST_SIZE,
 	CONF_MAX_OUTPUT_BUFFER_SIZE,
+	CONF_CLIENT_THREADS,
 	CONF_FS_CHARSET,
 	CONF_ID3V1_ENCODING,
 	CONF_METADATA_TO_USE,
@@ -73,6 +78,7 @@ enum ConfigOption {
 	CONF_PLAYLIST_PLUGIN,
 	CONF_AUTO_UPDATE,
 	CONF_AUTO_UPDATE_DEPTH,
+	CONF_UPDATE_THREADS,
 	CONF_DESPOTIFY_USER,
 	CONF_DESPOTIFY_PASSWORD,
 	CONF_DESPOTIFY_HIGH_BITRATE,
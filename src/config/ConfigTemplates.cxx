@@ -52,8 +52,12 @@ const ConfigTemplate config_templates[] = {
 	{ "replaygain_limit", false, false },
 	{ "volume_normalization", false, false },
 	{ "samplerate_converter", false, false },
+	{ "convert_thread", false, false },
 	{ "audio_buffer_size", false, false },
+	{ "audio_chunk_size", false, false },
 	{ "buffer_before_play", false, false },
+	{ "decoder_cache_size", false, false },
+	{ "prefetch_songs", false, false },
 	{ "http_proxy_host", false, false },
 	{ "http_proxy_port", false, false },
 	{ "http_proxy_user", false, false },
@@ -63,6 +67,7 @@ const ConfigTemplate config_templates[] = {
 	{ "max_playlist_length", false, false },
 	{ "max_command_list_size", false, false },
 	{ "max_output_buffer_size", false, false },
+	{ "client_threads", false, false },
 	{ "filesystem_charset", false, false },
 	{ "id3v1_encoding", false, false },
 	{ "metadata_to_use", false, false },
@@ -73,6 +78,7 @@ const ConfigTemplate config_templates[] = {
 	{ "playlist_plugin", true, true },
 	{ "auto_update", false, false },
 	{ "auto_update_depth", false, false },
+	{ "update_threads", false, false },
 	{ "despotify_user", false, false },
 	{ "despotify_password", false, false},
 	{ "despotify_high_bitrate", false, false },
@@ -23,6 +23,7 @@
 #include "Interface.hxx"
 #include "client/Client.hxx"
 #include "LightSong.hxx"
+#include "plugins/simple/SimpleDatabasePlugin.hxx"
 #include "tag/Set.hxx"
 
 #include <functional>
@@ -63,6 +64,26 @@ Print(Client &client, TagType group, const TagCountMap &m)
 	}
 }
 
+static bool
+PrintAggregate(Client &client, TagType group,
+	       const Tag &tag, const TagAggregates::Stats &stats)
+{
+	assert(tag.num_items == 1);
+
+	const char *value = tag.items[0]->value;
+	if (*value == 0)
+		/* the songs which don't have this tag */
+		return true;
+
+	client_printf(client, "%s: %s\n", tag_item_names[group], value);
+
+	SearchStats s;
+	s.n_songs = stats.n_songs;
+	s.total_duration = stats.total_duration;
+	PrintSearchStats(client, s);
+	return true;
+}
+
 static bool
 stats_visitor_song(SearchStats &stats, const LightSong &song)
 {
@@ -132,6 +153,17 @@ PrintSongCount(Client &client, const char *name,
 			return false;
 
 		PrintSearchStats(client, stats);
+	} else if (selection.IsEmpty() && db->IsPlugin(simple_db_plugin) &&
+		   !((const SimpleDatabase *)db)->HasMounts()) {
+		/* use the counts maintained by the simple database
+		   plugin */
+
+		const SimpleDatabase &sdb = *(const SimpleDatabase *)db;
+
+		using namespace std::placeholders;
+		const auto f = std::bind(PrintAggregate, std::ref(client),
+					 group, _1, _2);
+		return sdb.VisitTagAggregates(group, 0, f, error);
 	} else {
 		/* group by the specified tag: store counts in a
 		   std::map */
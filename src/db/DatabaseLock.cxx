@@ -20,8 +20,8 @@
 #include "config.h"
 #include "DatabaseLock.hxx"
 
-Mutex db_mutex;
+SharedMutex db_mutex;
 
 #ifndef NDEBUG
-ThreadId db_mutex_holder;
+thread_local DatabaseLockState db_lock_state;
 #endif
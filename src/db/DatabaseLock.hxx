@@ -27,34 +27,54 @@
 #define MPD_DB_LOCK_HXX
 
 #include "check.h"
-#include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
 #include "Compiler.h"
 
 #include <assert.h>
 
-extern Mutex db_mutex;
+/**
+ * The global database lock.  Queries lock it in "shared" mode, so
+ * they may run concurrently; modifications lock it exclusively.
+ */
+extern SharedMutex db_mutex;
 
 #ifndef NDEBUG
 
-#include "thread/Id.hxx"
+enum class DatabaseLockState {
+	NONE, SHARED, EXCLUSIVE,
+};
 
-extern ThreadId db_mutex_holder;
+/**
+ * How does the current thread hold the database lock?
+ */
+extern thread_local DatabaseLockState db_lock_state;
 
 /**
- * Does the current thread hold the database lock?
+ * Does the current thread hold the database lock (shared or
+ * exclusive)?
  */
 gcc_pure
 static inline bool
 holding_db_lock(void)
 {
-	return db_mutex_holder.IsInside();
+	return db_lock_state != DatabaseLockState::NONE;
+}
+
+/**
+ * Does the current thread hold the database lock exclusively?
+ */
+gcc_pure
+static inline bool
+holding_db_lock_exclusive(void)
+{
+	return db_lock_state == DatabaseLockState::EXCLUSIVE;
 }
 
 #endif
 
 /**
- * Obtain the global database lock.  This is needed before
- * dereferencing a #song or #directory.  It is not recursive.
+ * Obtain the global database lock exclusively.  This is needed
+ * before modifying a #song or #directory.  It is not recursive.
  */
 static inline void
 db_lock(void)
@@ -63,26 +83,57 @@ db_lock(void)
 
 	db_mutex.lock();
 
-	assert(db_mutex_holder.IsNull());
 #ifndef NDEBUG
-	db_mutex_holder = ThreadId::GetCurrent();
+	db_lock_state = DatabaseLockState::EXCLUSIVE;
 #endif
 }
 
 /**
- * Release the global database lock.
+ * Release the exclusive database lock.
  */
 static inline void
 db_unlock(void)
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 #ifndef NDEBUG
-	db_mutex_holder = ThreadId::Null();
+	db_lock_state = DatabaseLockState::NONE;
 #endif
 
 	db_mutex.unlock();
 }
 
+/**
+ * Obtain the global database lock in shared mode.  This is needed
+ * before dereferencing a #song or #directory.  Other threads may
+ * hold the shared lock at the same time, but nobody can modify the
+ * database.  It is not recursive.
+ */
+static inline void
+db_lock_shared(void)
+{
+	assert(!holding_db_lock());
+
+	db_mutex.lock_shared();
+
+#ifndef NDEBUG
+	db_lock_state = DatabaseLockState::SHARED;
+#endif
+}
+
+/**
+ * Release the shared database lock.
+ */
+static inline void
+db_unlock_shared(void)
+{
+	assert(db_lock_state == DatabaseLockState::SHARED);
+#ifndef NDEBUG
+	db_lock_state = DatabaseLockState::NONE;
+#endif
+
+	db_mutex.unlock_shared();
+}
+
 class ScopeDatabaseLock {
 public:
 	ScopeDatabaseLock() {
@@ -94,4 +145,15 @@ public:
 	}
 };
 
+class ScopeDatabaseSharedLock {
+public:
+	ScopeDatabaseSharedLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseSharedLock() {
+		db_unlock_shared();
+	}
+};
+
 #endif
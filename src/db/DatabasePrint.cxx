@@ -24,14 +24,26 @@
 #include "SongPrint.hxx"
 #include "TimePrint.hxx"
 #include "client/Client.hxx"
+#include "client/ClientInternal.hxx"
+#include "client/ClientStream.hxx"
+#include "protocol/Ack.hxx"
 #include "tag/Tag.hxx"
 #include "LightSong.hxx"
 #include "LightDirectory.hxx"
 #include "PlaylistInfo.hxx"
 #include "Interface.hxx"
+#include "DatabaseError.hxx"
+#include "plugins/simple/SimpleDatabasePlugin.hxx"
+#include "DetachedSong.hxx"
+#include "util/Error.hxx"
 #include "fs/Traits.hxx"
 
 #include <functional>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+#include <string.h>
 
 static const char *
 ApplyBaseFlag(const char *uri, bool base)
@@ -44,8 +56,8 @@ ApplyBaseFlag(const char *uri, bool base)
 static void
 PrintDirectoryURI(Client &client, bool base, const LightDirectory &directory)
 {
-	client_printf(client, "directory: %s\n",
-		      ApplyBaseFlag(directory.GetPath(), base));
+	client_write_pair(client, "directory",
+			  ApplyBaseFlag(directory.GetPath(), base));
 }
 
 static bool
@@ -89,7 +101,7 @@ print_playlist_in_directory(Client &client, bool base,
 			    const char *name_utf8)
 {
 	if (base || directory == nullptr || directory->IsRoot())
-		client_printf(client, "playlist: %s\n", name_utf8);
+		client_write_pair(client, "playlist", name_utf8);
 	else
 		client_printf(client, "playlist: %s/%s\n",
 			      directory->GetPath(), name_utf8);
@@ -145,6 +157,170 @@ PrintPlaylistFull(Client &client, bool base,
 	return true;
 }
 
+/**
+ * A directory whose contents are printed after the database lock
+ * has been released, see #PrintRecursiveStream.
+ */
+struct PendingDirectory {
+	std::string uri;
+	time_t mtime;
+
+	PendingDirectory(const LightDirectory &directory)
+		:uri(directory.GetPath()), mtime(directory.mtime) {}
+};
+
+/**
+ * Like the recursive Database::Visit() call in db_selection_print(),
+ * but each Next() call visits only one directory, and the database
+ * lock is not held between two calls.
+ */
+class PrintRecursiveStream final : public ClientStream {
+	const std::string uri;
+	const bool full, base;
+
+	bool started;
+
+	/**
+	 * The children of each directory being printed which have
+	 * not been visited yet, outermost first.
+	 */
+	struct Level {
+		std::vector<PendingDirectory> children;
+		size_t next;
+	};
+
+	std::vector<Level> stack;
+
+public:
+	PrintRecursiveStream(const char *_uri, bool _full, bool _base)
+		:uri(_uri), full(_full), base(_base), started(false) {}
+
+	virtual bool IsDone() const override {
+		return started && stack.empty();
+	}
+
+	virtual bool Next(Client &client, Error &error) override;
+
+private:
+	/**
+	 * Print the directory given to the constructor (if it is
+	 * one), which is found in its parent.
+	 */
+	bool PrintStart(Client &client, const Database &db,
+			Error &error) const;
+
+	/**
+	 * Print the songs and playlists of a directory, and push its
+	 * children onto the #stack.
+	 */
+	bool VisitDirectory(Client &client, const Database &db,
+			    const char *directory_uri, Error &error);
+};
+
+bool
+PrintRecursiveStream::PrintStart(Client &client, const Database &db,
+				 Error &error) const
+{
+	if (uri.empty())
+		return true;
+
+	std::string parent = PathTraitsUTF8::GetParent(uri.c_str());
+	if (parent == ".")
+		parent.clear();
+
+	const char *const _uri = uri.c_str();
+	const bool _full = full, _base = base;
+	const auto d = [&client, _uri, _full, _base]
+		(const LightDirectory &directory, Error &){
+		if (strcmp(directory.GetPath(), _uri) == 0)
+			(_full ? PrintDirectoryFull : PrintDirectoryBrief)
+				(client, _base, directory);
+		return true;
+	};
+
+	return db.Visit(DatabaseSelection(parent.c_str(), false),
+			d, VisitSong(), VisitPlaylist(), error);
+}
+
+bool
+PrintRecursiveStream::VisitDirectory(Client &client, const Database &db,
+				     const char *directory_uri, Error &error)
+{
+	Level level;
+	level.next = 0;
+
+	using namespace std::placeholders;
+	const auto d = [&level](const LightDirectory &directory, Error &){
+		level.children.emplace_back(directory);
+		return true;
+	};
+	const auto s = std::bind(full ? PrintSongFull : PrintSongBrief,
+				 std::ref(client), base, _1);
+	const auto p = std::bind(full ? PrintPlaylistFull : PrintPlaylistBrief,
+				 std::ref(client), base, _1, _2);
+
+	if (!db.Visit(DatabaseSelection(directory_uri, false), d, s, p, error))
+		return false;
+
+	if (!level.children.empty())
+		stack.emplace_back(std::move(level));
+	return true;
+}
+
+bool
+PrintRecursiveStream::Next(Client &client, Error &error)
+{
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return false;
+
+	if (!started) {
+		started = true;
+		return PrintStart(client, *db, error) &&
+			VisitDirectory(client, *db, uri.c_str(), error);
+	}
+
+	Level &level = stack.back();
+	if (level.next == level.children.size()) {
+		stack.pop_back();
+		return true;
+	}
+
+	/* copy it, because VisitDirectory() modifies the stack */
+	const PendingDirectory child = std::move(level.children[level.next++]);
+
+	(full ? PrintDirectoryFull : PrintDirectoryBrief)
+		(client, base, LightDirectory(child.uri.c_str(), child.mtime));
+
+	if (!VisitDirectory(client, *db, child.uri.c_str(), error)) {
+		if (!error.IsDomain(db_domain) ||
+		    error.GetCode() != DB_NOT_FOUND)
+			return false;
+
+		/* the directory has been deleted by the update
+		   meanwhile */
+		error.Clear();
+	}
+
+	return true;
+}
+
+ClientStream *
+db_selection_stream(Client &client, const char *uri, bool full, bool base,
+		    Error &error)
+{
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return nullptr;
+
+	if (!db->IsPlugin(simple_db_plugin))
+		/* other plugins may not be able to visit one
+		   directory at a time efficiently */
+		return nullptr;
+
+	return new PrintRecursiveStream(uri, full, base);
+}
+
 bool
 db_selection_print(Client &client, const DatabaseSelection &selection,
 		   bool full, bool base, Error &error)
@@ -168,6 +344,227 @@ db_selection_print(Client &client, const DatabaseSelection &selection,
 	return db->Visit(selection, d, s, p, error);
 }
 
+/**
+ * Copy a #LightSong for printing after the database lock has been
+ * released.  Unlike DatabaseDetachSong(), this does not need a
+ * #Storage, because the real URI is not printed.
+ */
+static DetachedSong *
+NewDetachedSong(const LightSong &song)
+{
+	DetachedSong *detached = new DetachedSong(song.GetURI(),
+						  Tag(*song.tag));
+	detached->SetLastModified(song.mtime);
+	detached->SetStartTime(song.start_time);
+	detached->SetEndTime(song.end_time);
+	return detached;
+}
+
+/**
+ * Collects the first N songs in the order of a tag value.  Songs are
+ * kept in a heap whose top is the last one in the window, so a song
+ * which sorts after it is rejected before it is copied.
+ *
+ * Without a (small) window, all matching songs would be copied;
+ * therefore the estimated size of the copies is limited, see
+ * GetSize().
+ */
+class SortedSongCollector {
+	struct Item {
+		std::string key;
+
+		/**
+		 * The position in database order; keeps the sort
+		 * stable.
+		 */
+		unsigned serial;
+
+		/**
+		 * The estimated size of this item, see GetSize().
+		 */
+		size_t size;
+
+		DetachedSong *song;
+	};
+
+	const TagType sort;
+	const bool descending;
+	const unsigned limit;
+
+	/**
+	 * The maximum total size of all items.
+	 */
+	const size_t max_size;
+
+	unsigned serial = 0;
+
+	/**
+	 * The total size of all items.
+	 */
+	size_t size = 0;
+
+	std::vector<Item> items;
+
+public:
+	SortedSongCollector(TagType _sort, bool _descending, unsigned _limit,
+			    size_t _max_size)
+		:sort(_sort), descending(_descending), limit(_limit),
+		 max_size(_max_size) {}
+
+	~SortedSongCollector() {
+		for (auto &i : items)
+			delete i.song;
+	}
+
+	SortedSongCollector(const SortedSongCollector &) = delete;
+	SortedSongCollector &operator=(const SortedSongCollector &) = delete;
+
+	bool Add(const LightSong &song, Error &error) {
+		const char *key = song.tag->GetValue(sort);
+		if (key == nullptr)
+			key = "";
+
+		const unsigned s = serial++;
+		const size_t item_size = GetSize(key, song);
+
+		if (items.size() >= limit) {
+			if (limit == 0 || !Before(key, s, items.front()))
+				return true;
+
+			std::pop_heap(items.begin(), items.end(), Compare(*this));
+			Item &last = items.back();
+			size -= last.size;
+			delete last.song;
+			last.key = key;
+			last.serial = s;
+			last.size = item_size;
+			last.song = NewDetachedSong(song);
+		} else
+			items.push_back({key, s, item_size,
+					 NewDetachedSong(song)});
+
+		std::push_heap(items.begin(), items.end(), Compare(*this));
+
+		size += item_size;
+		if (size > max_size) {
+			error.Set(ack_domain, ACK_ERROR_ARG,
+				  "Too many songs to sort; use a smaller \"window\"");
+			return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Sort the collected songs and invoke the function for
+	 * each one, starting at the given index.
+	 */
+	template<typename F>
+	void Finish(unsigned start, F &&f) {
+		std::sort_heap(items.begin(), items.end(), Compare(*this));
+
+		for (unsigned i = start; i < items.size(); ++i)
+			f(*items[i].song);
+	}
+
+private:
+	/**
+	 * Estimate the memory occupied by the copy of a song, which is
+	 * roughly the size of its response.
+	 */
+	gcc_pure
+	static size_t GetSize(const char *key, const LightSong &song) {
+		size_t result = sizeof(Item) + sizeof(DetachedSong) +
+			strlen(key) + strlen(song.uri);
+		if (song.directory != nullptr)
+			result += strlen(song.directory) + 1;
+
+		for (const auto &item : *song.tag)
+			result += sizeof(item) + strlen(item.value);
+
+		return result;
+	}
+
+	gcc_pure
+	bool Before(const char *key, unsigned s, const Item &other) const {
+		int cmp = strcmp(key, other.key.c_str());
+		if (descending)
+			cmp = -cmp;
+		return cmp < 0 || (cmp == 0 && s < other.serial);
+	}
+
+	struct Compare {
+		const SortedSongCollector &collector;
+
+		explicit Compare(const SortedSongCollector &_collector)
+			:collector(_collector) {}
+
+		bool operator()(const Item &a, const Item &b) const {
+			return collector.Before(a.key.c_str(), a.serial, b);
+		}
+	};
+};
+
+static void
+PrintDetachedSong(Client &client, bool full, bool base,
+		  const DetachedSong &song)
+{
+	if (full)
+		song_print_info(client, song, base);
+	else
+		song_print_uri(client, song, base);
+
+	if (song.GetTag().has_playlist)
+		/* this song file has an embedded CUE sheet */
+		print_playlist_in_directory(client, base,
+					    (const char *)nullptr,
+					    song.GetURI());
+}
+
+bool
+db_selection_print(Client &client, const DatabaseSelection &selection,
+		   bool full, bool base,
+		   TagType sort, bool descending,
+		   unsigned window_start, unsigned window_end,
+		   Error &error)
+{
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return false;
+
+	if (sort == TAG_NUM_OF_ITEM_TYPES) {
+		unsigned i = 0;
+		const auto s = [&client, full, base, window_start, window_end,
+				&i](const LightSong &song, Error &){
+			if (i >= window_start && i < window_end)
+				(full ? PrintSongFull : PrintSongBrief)(client,
+									base,
+									song);
+			++i;
+			return true;
+		};
+
+		return db->Visit(selection, s, error);
+	}
+
+	/* the songs are copied before they are printed; don't let
+	   this take more memory than the response may take in the
+	   output buffer */
+	SortedSongCollector collector(sort, descending, window_end,
+				      client_max_output_buffer_size);
+
+	using namespace std::placeholders;
+	const auto s = std::bind(&SortedSongCollector::Add,
+				 std::ref(collector), _1, _2);
+	if (!db->Visit(selection, s, error))
+		return false;
+
+	collector.Finish(window_start, [&client, full, base](const DetachedSong &song){
+			PrintDetachedSong(client, full, base, song);
+		});
+	return true;
+}
+
 static bool
 PrintSongURIVisitor(Client &client, const LightSong &song)
 {
@@ -182,12 +579,12 @@ PrintUniqueTag(Client &client, TagType tag_type,
 {
 	const char *value = tag.GetValue(tag_type);
 	assert(value != nullptr);
-	client_printf(client, "%s: %s\n", tag_item_names[tag_type], value);
+	client_write_pair(client, tag_item_names[tag_type], value);
 
 	for (const auto &item : tag)
 		if (item.type != tag_type)
-			client_printf(client, "%s: %s\n",
-				      tag_item_names[item.type], item.value);
+			client_write_pair(client, tag_item_names[item.type],
+					  item.value);
 
 	return true;
 }
@@ -195,6 +592,7 @@ PrintUniqueTag(Client &client, TagType tag_type,
 bool
 PrintUniqueTags(Client &client, unsigned type, uint32_t group_mask,
 		const SongFilter *filter,
+		unsigned window_start, unsigned window_end,
 		Error &error)
 {
 	const Database *db = client.GetDatabase(error);
@@ -203,17 +601,27 @@ PrintUniqueTags(Client &client, unsigned type, uint32_t group_mask,
 
 	const DatabaseSelection selection("", true, filter);
 
+	unsigned i = 0;
+
 	if (type == LOCATE_TAG_FILE_TYPE) {
-		using namespace std::placeholders;
-		const auto f = std::bind(PrintSongURIVisitor,
-					 std::ref(client), _1);
+		const auto f = [&client, window_start, window_end,
+				&i](const LightSong &song, Error &){
+			if (i >= window_start && i < window_end)
+				PrintSongURIVisitor(client, song);
+			++i;
+			return true;
+		};
 		return db->Visit(selection, f, error);
 	} else {
 		assert(type < TAG_NUM_OF_ITEM_TYPES);
 
-		using namespace std::placeholders;
-		const auto f = std::bind(PrintUniqueTag, std::ref(client),
-					 (TagType)type, _1);
+		const auto f = [&client, type, window_start, window_end,
+				&i](const Tag &tag, Error &){
+			if (i >= window_start && i < window_end)
+				PrintUniqueTag(client, (TagType)type, tag);
+			++i;
+			return true;
+		};
 		return db->VisitUniqueTags(selection, (TagType)type,
 					   group_mask,
 					   f, error);
@@ -20,6 +20,7 @@
 #ifndef MPD_DB_PRINT_H
 #define MPD_DB_PRINT_H
 
+#include "tag/TagType.h"
 #include "Compiler.h"
 
 #include <stdint.h>
@@ -27,6 +28,7 @@
 class SongFilter;
 struct DatabaseSelection;
 class Client;
+class ClientStream;
 class Error;
 
 /**
@@ -37,9 +39,48 @@ bool
 db_selection_print(Client &client, const DatabaseSelection &selection,
 		   bool full, bool base, Error &error);
 
+/**
+ * Create a #ClientStream which prints the given directory
+ * recursively, like db_selection_print() with a recursive selection
+ * without a filter, for Client::StartStream().
+ *
+ * @param full print attributes/tags
+ * @param base print only base name of songs/directories?
+ * @return the new stream, or nullptr if the database does not
+ * support this (without setting #error) or on error
+ */
+ClientStream *
+db_selection_stream(Client &client, const char *uri, bool full, bool base,
+		    Error &error);
+
+/**
+ * Print the songs of a selection, optionally sorted by a tag, and
+ * only the ones inside the given window.  Directories and playlists
+ * are not printed.  Sorting keeps up to "window_end" songs in
+ * memory, and fails if they need more than
+ * #client_max_output_buffer_size.
+ *
+ * @param sort the tag to sort by, or #TAG_NUM_OF_ITEM_TYPES to
+ * print in database order
+ * @param descending sort in descending order?
+ * @param window_start the index of the first song to print
+ * @param window_end the index after the last song to print
+ */
+bool
+db_selection_print(Client &client, const DatabaseSelection &selection,
+		   bool full, bool base,
+		   TagType sort, bool descending,
+		   unsigned window_start, unsigned window_end,
+		   Error &error);
+
+/**
+ * @param window_start the index of the first value to print
+ * @param window_end the index after the last value to print
+ */
 bool
 PrintUniqueTags(Client &client, unsigned type, uint32_t group_mask,
 		const SongFilter *filter,
+		unsigned window_start, unsigned window_end,
 		Error &error);
 
 #endif
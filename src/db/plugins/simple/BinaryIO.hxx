@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Primitives shared by the binary database format and the journal.
+ * All integers are stored in little-endian byte order.
+ */
+
+#ifndef MPD_DB_BINARY_IO_HXX
+#define MPD_DB_BINARY_IO_HXX
+
+#include "fs/io/BufferedOutputStream.hxx"
+#include "system/ByteOrder.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <stdint.h>
+#include <string.h>
+
+struct Song;
+struct Directory;
+class TagBuilder;
+
+enum class BinaryRecord : uint8_t {
+	END,
+	DIRECTORY,
+	SONG,
+	PLAYLIST,
+};
+
+static inline void
+WriteUint8(BufferedOutputStream &os, uint8_t value)
+{
+	os.Write(&value, sizeof(value));
+}
+
+static inline void
+WriteUint16(BufferedOutputStream &os, uint16_t value)
+{
+	value = ToLE16(value);
+	os.Write(&value, sizeof(value));
+}
+
+static inline void
+WriteUint32(BufferedOutputStream &os, uint32_t value)
+{
+	value = ToLE32(value);
+	os.Write(&value, sizeof(value));
+}
+
+static inline void
+WriteUint64(BufferedOutputStream &os, uint64_t value)
+{
+	value = ToLE64(value);
+	os.Write(&value, sizeof(value));
+}
+
+/**
+ * Write a length-prefixed string, including the null terminator,
+ * which allows the loader to use it in place.
+ */
+static inline void
+WriteString(BufferedOutputStream &os, const char *value)
+{
+	const size_t length = strlen(value);
+	WriteUint32(os, length);
+	os.Write(value, length + 1);
+}
+
+static inline void
+WriteRecord(BufferedOutputStream &os, BinaryRecord record)
+{
+	WriteUint8(os, uint8_t(record));
+}
+
+/**
+ * Reads values written by the Write*() functions.  All methods
+ * return false when the buffer is exhausted.
+ */
+class BinaryReader {
+	const uint8_t *p;
+	const uint8_t *const end;
+
+public:
+	explicit BinaryReader(ConstBuffer<void> data)
+		:p((const uint8_t *)data.data), end(p + data.size) {}
+
+	bool IsEnd() const {
+		return p == end;
+	}
+
+	bool Skip(size_t n) {
+		if (size_t(end - p) < n)
+			return false;
+
+		p += n;
+		return true;
+	}
+
+	bool ReadUint8(uint8_t &value) {
+		if (p == end)
+			return false;
+
+		value = *p++;
+		return true;
+	}
+
+	bool ReadUint16(uint16_t &value) {
+		if (!Read(&value, sizeof(value)))
+			return false;
+
+		value = FromLE16(value);
+		return true;
+	}
+
+	bool ReadUint32(uint32_t &value) {
+		if (!Read(&value, sizeof(value)))
+			return false;
+
+		value = FromLE32(value);
+		return true;
+	}
+
+	bool ReadUint64(uint64_t &value) {
+		if (!Read(&value, sizeof(value)))
+			return false;
+
+		value = FromLE64(value);
+		return true;
+	}
+
+	/**
+	 * Returns a pointer to a null-terminated string inside the
+	 * buffer, or nullptr on error.
+	 */
+	const char *ReadString(size_t &length) {
+		uint32_t length32;
+		if (!ReadUint32(length32) || size_t(end - p) <= length32 ||
+		    p[length32] != 0)
+			return nullptr;
+
+		const char *value = (const char *)p;
+		p += length32 + 1;
+		length = length32;
+		return value;
+	}
+
+	const char *ReadString() {
+		size_t length;
+		return ReadString(length);
+	}
+
+	/**
+	 * Returns a pointer to the next #size bytes and skips them,
+	 * or nullptr if the buffer is too short.
+	 */
+	const void *ReadBytes(size_t size) {
+		if (size_t(end - p) < size)
+			return nullptr;
+
+		const void *result = p;
+		p += size;
+		return result;
+	}
+
+private:
+	bool Read(void *dest, size_t size) {
+		if (size_t(end - p) < size)
+			return false;
+
+		memcpy(dest, p, size);
+		p += size;
+		return true;
+	}
+};
+
+/**
+ * Write the attributes of a #Song (without the record type).
+ */
+void
+binary_save_song(BufferedOutputStream &os, const Song &song);
+
+/**
+ * Load a #Song written by binary_save_song() and add it to the
+ * given #Directory.
+ *
+ * @param tag a scratch object, to avoid allocating it for each song
+ */
+bool
+binary_load_song(BinaryReader &reader, Directory &parent, TagBuilder &tag);
+
+#endif
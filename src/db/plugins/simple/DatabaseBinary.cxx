@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DatabaseBinary.hxx"
+#include "BinaryIO.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/TagSettings.h"
+#include "fs/Charset.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * The file signature.  It cannot be confused with the text format,
+ * which begins with "info_begin".
+ */
+static constexpr char BINARY_MAGIC[8] = {
+	'M', 'P', 'D', 'B', 'I', 'N', '\r', '\n',
+};
+
+/**
+ * Increment this number whenever the binary layout changes.  There
+ * is no backwards compatibility; an old file is discarded (or
+ * imported from a text file).
+ */
+static constexpr uint32_t BINARY_FORMAT = 1;
+
+static_assert(TAG_NUM_OF_ITEM_TYPES <= 32, "Too many tag types");
+
+void
+binary_save_song(BufferedOutputStream &os, const Song &song)
+{
+	WriteString(os, song.uri);
+	WriteUint32(os, song.start_time.ToMS());
+	WriteUint32(os, song.end_time.ToMS());
+	WriteUint64(os, int64_t(song.mtime));
+
+	const Tag &tag = song.tag;
+	WriteUint32(os, tag.duration.ToMS());
+	WriteUint8(os, tag.has_playlist);
+	WriteUint16(os, tag.num_items);
+	for (const auto &i : tag) {
+		WriteUint8(os, i.type);
+		WriteString(os, i.value);
+	}
+}
+
+static void
+SaveDirectory(BufferedOutputStream &os, const Directory &directory)
+{
+	for (const auto &child : directory.children) {
+		/* mount points are restored at runtime, and their
+		   contents belong to another database */
+		if (child.IsMount())
+			continue;
+
+		WriteRecord(os, BinaryRecord::DIRECTORY);
+		WriteString(os, child.GetName());
+		WriteUint32(os, child.device);
+		WriteUint64(os, int64_t(child.mtime));
+
+		SaveDirectory(os, child);
+
+		if (!os.Check())
+			return;
+	}
+
+	for (const auto &song : directory.songs) {
+		WriteRecord(os, BinaryRecord::SONG);
+		binary_save_song(os, song);
+	}
+
+	for (const auto &pi : directory.playlists) {
+		WriteRecord(os, BinaryRecord::PLAYLIST);
+		WriteString(os, pi.name.c_str());
+		WriteUint64(os, int64_t(pi.mtime));
+	}
+
+	WriteRecord(os, BinaryRecord::END);
+}
+
+bool
+db_is_binary(ConstBuffer<void> data)
+{
+	return data.size >= sizeof(BINARY_MAGIC) &&
+		memcmp(data.data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0;
+}
+
+void
+db_save_binary(BufferedOutputStream &os, const Directory &music_root)
+{
+	os.Write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+	WriteUint32(os, BINARY_FORMAT);
+	WriteString(os, VERSION);
+	WriteString(os, GetFSCharset());
+
+	uint32_t tag_mask = 0;
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (!ignore_tag_items[i])
+			tag_mask |= 1u << i;
+	WriteUint32(os, tag_mask);
+
+	SaveDirectory(os, music_root);
+}
+
+bool
+binary_load_song(BinaryReader &reader, Directory &parent, TagBuilder &tag)
+{
+	const char *uri = reader.ReadString();
+	uint32_t start_ms, end_ms, duration_ms;
+	uint64_t mtime;
+	uint8_t has_playlist;
+	uint16_t num_items;
+	if (uri == nullptr || *uri == 0 ||
+	    !reader.ReadUint32(start_ms) ||
+	    !reader.ReadUint32(end_ms) ||
+	    !reader.ReadUint64(mtime) ||
+	    !reader.ReadUint32(duration_ms) ||
+	    !reader.ReadUint8(has_playlist) ||
+	    !reader.ReadUint16(num_items))
+		return false;
+
+	tag.Clear();
+	tag.Reserve(num_items);
+	tag.SetDuration(SignedSongTime::FromMS(int32_t(duration_ms)));
+	tag.SetHasPlaylist(has_playlist != 0);
+
+	for (unsigned i = 0; i < num_items; ++i) {
+		uint8_t type;
+		size_t length;
+		const char *value;
+		if (!reader.ReadUint8(type) ||
+		    type >= TAG_NUM_OF_ITEM_TYPES ||
+		    (value = reader.ReadString(length)) == nullptr)
+			return false;
+
+		tag.AddItem(TagType(type), value, length);
+	}
+
+	Song *song = Song::NewFile(uri, parent);
+	tag.Commit(song->tag);
+	song->mtime = time_t(int64_t(mtime));
+	song->start_time = SongTime::FromMS(start_ms);
+	song->end_time = SongTime::FromMS(end_ms);
+	parent.AddSong(song);
+	return true;
+}
+
+static bool
+LoadDirectory(BinaryReader &reader, Directory &directory, TagBuilder &tag,
+	      unsigned depth)
+{
+	/* a sanity limit which protects the stack against corrupt
+	   files */
+	if (depth > 256)
+		return false;
+
+	while (true) {
+		uint8_t record;
+		if (!reader.ReadUint8(record))
+			return false;
+
+		switch (BinaryRecord(record)) {
+		case BinaryRecord::END:
+			return true;
+
+		case BinaryRecord::DIRECTORY: {
+			const char *name = reader.ReadString();
+			uint32_t device;
+			uint64_t mtime;
+			if (name == nullptr || *name == 0 ||
+			    !reader.ReadUint32(device) ||
+			    !reader.ReadUint64(mtime))
+				return false;
+
+			Directory *child = directory.CreateChild(name);
+			child->device = device;
+			child->mtime = time_t(int64_t(mtime));
+
+			if (!LoadDirectory(reader, *child, tag, depth + 1))
+				return false;
+			break;
+		}
+
+		case BinaryRecord::SONG:
+			if (!binary_load_song(reader, directory, tag))
+				return false;
+			break;
+
+		case BinaryRecord::PLAYLIST: {
+			const char *name = reader.ReadString();
+			uint64_t mtime;
+			if (name == nullptr || !reader.ReadUint64(mtime))
+				return false;
+
+			directory.playlists.push_back(PlaylistInfo(name,
+								   time_t(int64_t(mtime))));
+			break;
+		}
+
+		default:
+			return false;
+		}
+	}
+}
+
+bool
+db_load_binary(ConstBuffer<void> data, Directory &music_root, Error &error)
+{
+	assert(db_is_binary(data));
+
+	BinaryReader reader(data);
+	reader.Skip(sizeof(BINARY_MAGIC));
+
+	uint32_t format, tag_mask;
+	const char *version, *charset;
+	if (!reader.ReadUint32(format) ||
+	    (version = reader.ReadString()) == nullptr ||
+	    (charset = reader.ReadString()) == nullptr ||
+	    !reader.ReadUint32(tag_mask)) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	if (format != BINARY_FORMAT) {
+		error.Set(db_domain,
+			  "Database format mismatch, "
+			  "discarding database file");
+		return false;
+	}
+
+	const char *const old_charset = GetFSCharset();
+	if (*old_charset != 0 && strcmp(charset, old_charset) != 0) {
+		error.Format(db_domain,
+			     "Existing database has charset "
+			     "\"%s\" instead of \"%s\"; "
+			     "discarding database file",
+			     charset, old_charset);
+		return false;
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		if (!ignore_tag_items[i] && (tag_mask & (1u << i)) == 0) {
+			error.Set(db_domain,
+				  "Tag list mismatch, "
+				  "discarding database file");
+			return false;
+		}
+	}
+
+	LogDebug(db_domain, "reading binary DB");
+
+	TagBuilder tag;
+
+	db_lock();
+	bool success = LoadDirectory(reader, music_root, tag, 0) &&
+		reader.IsEnd();
+	db_unlock();
+
+	if (!success) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_BINARY_HXX
+#define MPD_DATABASE_BINARY_HXX
+
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+struct Directory;
+class BufferedOutputStream;
+class Error;
+
+/**
+ * Does the buffer start with the signature of the binary database
+ * format?
+ */
+gcc_pure
+bool
+db_is_binary(ConstBuffer<void> data);
+
+/**
+ * Write the database in the binary format.  Unlike the text format,
+ * all numbers are stored as fixed-size little-endian integers and
+ * all strings are length-prefixed, so loading does not need to scan
+ * for separators.
+ */
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root);
+
+/**
+ * Load a database which was written by db_save_binary().  The
+ * buffer is usually a #MappedFile.
+ */
+bool
+db_load_binary(ConstBuffer<void> data, Directory &root, Error &error);
+
+#endif
@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DatabaseJournal.hxx"
+#include "BinaryIO.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
+#include "fs/io/StringOutputStream.hxx"
+#include "tag/TagBuilder.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <unordered_set>
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr char JOURNAL_MAGIC[8] = {
+	'M', 'P', 'D', 'J', 'R', 'N', 'L', '\n',
+};
+
+/**
+ * Increment this number whenever the journal layout changes.
+ */
+static constexpr uint32_t JOURNAL_FORMAT = 1;
+
+static constexpr size_t JOURNAL_HEADER_SIZE =
+	sizeof(JOURNAL_MAGIC) + sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+/**
+ * Write the direct contents of a directory.  Sub directories are
+ * represented only by their names; their contents are in separate
+ * entries.
+ */
+static void
+SaveEntry(BufferedOutputStream &os, const Directory &directory)
+{
+	WriteString(os, directory.GetPath());
+	WriteUint32(os, directory.device);
+	WriteUint64(os, int64_t(directory.mtime));
+
+	for (const auto &child : directory.children) {
+		if (child.IsMount())
+			continue;
+
+		WriteRecord(os, BinaryRecord::DIRECTORY);
+		WriteString(os, child.GetName());
+	}
+
+	for (const auto &song : directory.songs) {
+		WriteRecord(os, BinaryRecord::SONG);
+		binary_save_song(os, song);
+	}
+
+	for (const auto &pi : directory.playlists) {
+		WriteRecord(os, BinaryRecord::PLAYLIST);
+		WriteString(os, pi.name.c_str());
+		WriteUint64(os, int64_t(pi.mtime));
+	}
+
+	WriteRecord(os, BinaryRecord::END);
+}
+
+/**
+ * The 64 bit FNV-1a hash.
+ */
+gcc_pure
+static uint64_t
+CalcDigest(const std::string &s)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char ch : s) {
+		hash ^= ch;
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/**
+ * Serializes journal entries into a reusable buffer.
+ */
+class JournalSerializer {
+	StringOutputStream sos;
+	BufferedOutputStream bos;
+
+public:
+	JournalSerializer():bos(sos) {}
+
+	const std::string &Serialize(const Directory &directory) {
+		sos.GetValue().clear();
+		SaveEntry(bos, directory);
+		bos.Flush();
+		return sos.GetValue();
+	}
+};
+
+template<typename F>
+static void
+ForEachDirectory(const Directory &directory, F &&f)
+{
+	f(directory);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			ForEachDirectory(child, f);
+}
+
+void
+DatabaseJournal::Reset(const Directory &root)
+{
+	JournalSerializer serializer;
+
+	digests.clear();
+	ForEachDirectory(root, [this, &serializer](const Directory &directory){
+			digests.emplace(directory.GetPath(),
+					CalcDigest(serializer.Serialize(directory)));
+		});
+}
+
+unsigned
+DatabaseJournal::Collect(const Directory &root, std::string &dest)
+{
+	JournalSerializer serializer;
+	decltype(digests) new_digests;
+	unsigned n = 0;
+
+	ForEachDirectory(root, [this, &serializer, &new_digests, &dest, &n](const Directory &directory){
+			const std::string &entry =
+				serializer.Serialize(directory);
+			const uint64_t digest = CalcDigest(entry);
+			new_digests.emplace(directory.GetPath(), digest);
+
+			const auto i = digests.find(directory.GetPath());
+			if (i != digests.end() && i->second == digest)
+				/* unmodified */
+				return;
+
+			const uint32_t size = ToLE32(entry.size());
+			dest.append((const char *)&size, sizeof(size));
+			dest.append(entry);
+			++n;
+		});
+
+	digests.swap(new_digests);
+	return n;
+}
+
+void
+journal_write_header(std::string &dest,
+		     uint64_t base_size, int64_t base_mtime)
+{
+	const uint32_t format = ToLE32(JOURNAL_FORMAT);
+	const uint64_t size = ToLE64(base_size);
+	const uint64_t mtime = ToLE64(base_mtime);
+
+	dest.append(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+	dest.append((const char *)&format, sizeof(format));
+	dest.append((const char *)&size, sizeof(size));
+	dest.append((const char *)&mtime, sizeof(mtime));
+}
+
+bool
+journal_check_header(ConstBuffer<void> data,
+		     uint64_t base_size, int64_t base_mtime)
+{
+	std::string expected;
+	journal_write_header(expected, base_size, base_mtime);
+	assert(expected.size() == JOURNAL_HEADER_SIZE);
+
+	return data.size >= JOURNAL_HEADER_SIZE &&
+		memcmp(data.data, expected.data(), JOURNAL_HEADER_SIZE) == 0;
+}
+
+/**
+ * Look up a directory, and create all missing path components.
+ */
+static Directory &
+MakeDirectory(Directory &root, const char *path)
+{
+	Directory *directory = &root;
+
+	std::string name;
+	while (*path != 0) {
+		const char *slash = strchr(path, '/');
+		if (slash == nullptr)
+			slash = path + strlen(path);
+
+		name.assign(path, slash);
+		directory = directory->MakeChild(name.c_str());
+
+		path = *slash == '/' ? slash + 1 : slash;
+	}
+
+	return *directory;
+}
+
+static bool
+ApplyEntry(BinaryReader &reader, Directory &root, TagBuilder &tag)
+{
+	const char *path = reader.ReadString();
+	uint32_t device;
+	uint64_t mtime;
+	if (path == nullptr ||
+	    !reader.ReadUint32(device) ||
+	    !reader.ReadUint64(mtime))
+		return false;
+
+	Directory &directory = MakeDirectory(root, path);
+	directory.device = device;
+	directory.mtime = time_t(int64_t(mtime));
+
+	directory.songs.clear_and_dispose(Song::Disposer());
+	directory.playlists.erase(directory.playlists.begin(),
+				  directory.playlists.end());
+
+	std::unordered_set<std::string> names;
+
+	while (true) {
+		uint8_t record;
+		if (!reader.ReadUint8(record))
+			return false;
+
+		switch (BinaryRecord(record)) {
+		case BinaryRecord::END:
+			/* delete all sub directories which are not
+			   listed anymore */
+			for (auto i = directory.children.begin(),
+				     end = directory.children.end();
+			     i != end;) {
+				Directory &child = *i++;
+				if (!child.IsMount() &&
+				    names.find(child.GetName()) == names.end())
+					child.Delete();
+			}
+
+			return true;
+
+		case BinaryRecord::DIRECTORY: {
+			const char *name = reader.ReadString();
+			if (name == nullptr || *name == 0 ||
+			    strchr(name, '/') != nullptr)
+				return false;
+
+			directory.MakeChild(name);
+			names.emplace(name);
+			break;
+		}
+
+		case BinaryRecord::SONG:
+			if (!binary_load_song(reader, directory, tag))
+				return false;
+			break;
+
+		case BinaryRecord::PLAYLIST: {
+			const char *name = reader.ReadString();
+			uint64_t pl_mtime;
+			if (name == nullptr || !reader.ReadUint64(pl_mtime))
+				return false;
+
+			directory.playlists.push_back(PlaylistInfo(name,
+								   time_t(int64_t(pl_mtime))));
+			break;
+		}
+
+		default:
+			return false;
+		}
+	}
+}
+
+bool
+journal_replay(ConstBuffer<void> data, Directory &root,
+	       bool &truncated_r, Error &error)
+{
+	assert(data.size >= JOURNAL_HEADER_SIZE);
+	assert(memcmp(data.data, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0);
+
+	BinaryReader reader(data);
+	reader.Skip(JOURNAL_HEADER_SIZE);
+
+	TagBuilder tag;
+	unsigned n = 0;
+	truncated_r = false;
+
+	const ScopeDatabaseLock protect;
+
+	while (!reader.IsEnd()) {
+		uint32_t size;
+		const void *entry;
+		if (!reader.ReadUint32(size) ||
+		    (entry = reader.ReadBytes(size)) == nullptr) {
+			LogWarning(db_domain,
+				   "Ignoring truncated database journal entry");
+			truncated_r = true;
+			break;
+		}
+
+		BinaryReader entry_reader(ConstBuffer<void>(entry, size));
+		if (!ApplyEntry(entry_reader, root, tag)) {
+			error.Set(db_domain, "Database journal corrupted");
+			return false;
+		}
+
+		++n;
+	}
+
+	FormatDebug(db_domain, "replayed %u journal entries", n);
+	return true;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_JOURNAL_HXX
+#define MPD_DATABASE_JOURNAL_HXX
+
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <unordered_map>
+
+#include <stdint.h>
+
+struct Directory;
+class Error;
+
+/**
+ * Incremental saves for #SimpleDatabase.  The journal is a file next
+ * to the database which contains a snapshot of each directory that
+ * has changed since the database was written.  Each entry describes
+ * the direct contents of one directory (sub directory names, songs
+ * and playlists); replaying it replaces the directory's contents.
+ *
+ * This class does not need hooks in the updater: it remembers a
+ * digest of each directory as it was last written, and Collect()
+ * compares it with the current state.
+ */
+class DatabaseJournal {
+	/**
+	 * Maps the path of each directory to the digest of its
+	 * contents, as they are on disk.
+	 */
+	std::unordered_map<std::string, uint64_t> digests;
+
+public:
+	/**
+	 * Remember the current state of all directories as being on
+	 * disk (after a full save or after loading).
+	 */
+	void Reset(const Directory &root);
+
+	/**
+	 * Generate journal entries for all directories which have
+	 * changed since the last Reset() or Collect() call, and
+	 * remember their new state.
+	 *
+	 * @param dest the entries are appended to this string
+	 * @return the number of entries
+	 */
+	unsigned Collect(const Directory &root, std::string &dest);
+};
+
+/**
+ * Generate the header of a new journal file.
+ *
+ * @param base_size the size of the database file the journal
+ * belongs to
+ * @param base_mtime the modification time of that file
+ */
+void
+journal_write_header(std::string &dest,
+		     uint64_t base_size, int64_t base_mtime);
+
+/**
+ * Does the journal belong to the database file with the given size
+ * and modification time?
+ */
+gcc_pure
+bool
+journal_check_header(ConstBuffer<void> data,
+		     uint64_t base_size, int64_t base_mtime);
+
+/**
+ * Apply all entries of a journal to a database which was just
+ * loaded.  A truncated entry at the end of the file (from an
+ * interrupted append) is ignored.
+ *
+ * Caller must not lock the #db_mutex.
+ *
+ * @param truncated_r set to true if a truncated entry was found; the
+ * journal must then be rewritten before appending to it
+ */
+bool
+journal_replay(ConstBuffer<void> data, Directory &root,
+	       bool &truncated_r, Error &error);
+
+#endif
@@ -57,7 +57,7 @@ Directory::~Directory()
 void
 Directory::Delete()
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 	assert(parent != nullptr);
 
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
@@ -75,7 +75,7 @@ Directory::GetName() const
 Directory *
 Directory::CreateChild(const char *name_utf8)
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 	assert(name_utf8 != nullptr);
 	assert(*name_utf8 != 0);
 
@@ -103,7 +103,7 @@ Directory::FindChild(const char *name) const
 void
 Directory::PruneEmpty()
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
@@ -164,7 +164,7 @@ Directory::LookupDirectory(const char *uri)
 void
 Directory::AddSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
@@ -174,7 +174,7 @@ Directory::AddSong(Song *song)
 void
 Directory::RemoveSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
@@ -207,7 +207,7 @@ directory_cmp(const Directory &a, const Directory &b)
 void
 Directory::Sort()
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 
 	children.sort(directory_cmp);
 	song_list_sort(songs);
@@ -230,13 +230,13 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
-		db_unlock();
+		db_unlock_shared();
 		bool result = WalkMount(GetPath(), *mounted_database,
 					recursive, filter,
 					visit_directory, visit_song,
 					visit_playlist,
 					error);
-		db_lock();
+		db_lock_shared();
 		return result;
 	}
 
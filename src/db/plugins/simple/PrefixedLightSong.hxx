@@ -30,6 +30,12 @@ class PrefixedLightSong : public LightSong {
 	std::string buffer;
 
 public:
+	/**
+	 * Copy a #LightSong without adding a prefix.
+	 */
+	explicit PrefixedLightSong(const LightSong &song)
+		:LightSong(song) {}
+
 	PrefixedLightSong(const LightSong &song, const char *base)
 		:LightSong(song),
 		 buffer(PathTraitsUTF8::Build(base, GetURI().c_str())) {
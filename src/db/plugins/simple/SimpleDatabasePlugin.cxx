@@ -23,54 +23,79 @@
 #include "db/DatabasePlugin.hxx"
 #include "db/Selection.hxx"
 #include "db/Helpers.hxx"
+#include "db/Stats.hxx"
 #include "db/UniqueTags.hxx"
 #include "db/LightDirectory.hxx"
 #include "Directory.hxx"
 #include "Song.hxx"
 #include "SongFilter.hxx"
 #include "DatabaseSave.hxx"
+#include "DatabaseBinary.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "fs/io/FileOutputStream.hxx"
+#include "fs/io/MappedFile.hxx"
+#include "fs/io/StringOutputStream.hxx"
 #include "config/ConfigData.hxx"
 #include "fs/FileSystem.hxx"
 #include "util/CharUtil.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "thread/Name.hxx"
 #include "Log.hxx"
 
 #ifdef HAVE_ZLIB
 #include "fs/io/GzipOutputStream.hxx"
 #endif
 
+#include <algorithm>
+#include <set>
+
 #include <errno.h>
+#include <time.h>
 
 static constexpr Domain simple_db_domain("simple_db");
 
+/**
+ * Rewrite the database when the journal grows larger than this (or
+ * larger than the database itself).
+ */
+static constexpr uint64_t MIN_JOURNAL_COMPACT_SIZE = 1024 * 1024;
+
 inline SimpleDatabase::SimpleDatabase()
 	:Database(simple_db_plugin),
 	 path(AllocatedPath::Null()),
 #ifdef HAVE_ZLIB
 	 compress(true),
 #endif
+	 binary(false),
+	 use_journal(false),
+	 journal_path(AllocatedPath::Null()),
 	 cache_path(AllocatedPath::Null()),
-	 prefixed_light_song(nullptr) {}
+	 n_mounts(0),
+	 save_quit(false), force_full(true),
+	 journal_size(0), base_size(0) {}
 
 inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifndef HAVE_ZLIB
 				      gcc_unused
 #endif
-				      bool _compress)
+				      bool _compress, bool _binary)
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
 #ifdef HAVE_ZLIB
 	 compress(_compress),
 #endif
+	 binary(_binary),
+	 use_journal(false),
+	 journal_path(AllocatedPath::Null()),
 	 cache_path(AllocatedPath::Null()),
-	 prefixed_light_song(nullptr) {
+	 n_mounts(0),
+	 save_quit(false), force_full(true),
+	 journal_size(0), base_size(0) {
 }
 
 Database *
@@ -108,6 +133,19 @@ SimpleDatabase::Configure(const config_param &param, Error &error)
 	compress = param.GetBlockValue("compress", compress);
 #endif
 
+	const char *format = param.GetBlockValue("format", "text");
+	if (strcmp(format, "binary") == 0)
+		binary = true;
+	else if (strcmp(format, "text") != 0) {
+		error.Format(simple_db_domain,
+			     "Unrecognized database format: %s", format);
+		return false;
+	}
+
+	use_journal = param.GetBlockValue("journal", false);
+	journal_path = AllocatedPath::FromFS(std::string(path.c_str()) +
+					     ".journal");
+
 	return true;
 }
 
@@ -180,31 +218,95 @@ SimpleDatabase::Check(Error &error) const
 	return true;
 }
 
+inline bool
+SimpleDatabase::LoadText(Error &error)
+{
+	TextFile file(path, error);
+	if (file.HasFailed())
+		return false;
+
+	return db_load_internal(file, *root, error) && file.Check(error);
+}
+
 bool
 SimpleDatabase::Load(Error &error)
 {
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	TextFile file(path, error);
-	if (file.HasFailed())
-		return false;
+	{
+		/* a binary database is read directly from the mapped
+		   file; anything else (including gzip) goes through
+		   the text parser, which allows importing a text
+		   database after switching to the binary format */
+		const MappedFile file(path, error);
+		if (!file.IsDefined())
+			return false;
 
-	if (!db_load_internal(file, *root, error) || !file.Check(error))
-		return false;
+		if (db_is_binary(file.Get())) {
+			if (!db_load_binary(file.Get(), *root, error))
+				return false;
+		} else if (!LoadText(error))
+			return false;
+	}
 
 	struct stat st;
-	if (StatFile(path, st))
+	if (StatFile(path, st)) {
 		mtime = st.st_mtime;
+		base_size = st.st_size;
+	}
+
+	if (!journal_path.IsNull())
+		LoadJournal();
 
 	return true;
 }
 
+void
+SimpleDatabase::LoadJournal()
+{
+	struct stat st;
+	if (!StatFile(path, st))
+		return;
+
+	if (::FileExists(journal_path)) {
+		Error error;
+		const MappedFile file(journal_path, error);
+		if (!file.IsDefined()) {
+			LogError(error);
+			return;
+		}
+
+		if (!journal_check_header(file.Get(), st.st_size,
+					  st.st_mtime)) {
+			LogDebug(simple_db_domain,
+				 "Ignoring stale database journal");
+		} else {
+			bool truncated;
+			if (!journal_replay(file.Get(), *root, truncated,
+					    error)) {
+				/* the database may be partially
+				   modified now, but that is not worse
+				   than ignoring the journal; the next
+				   update will fix it */
+				LogError(error);
+				return;
+			}
+
+			if (use_journal && !truncated) {
+				force_full = false;
+				journal_size = file.Get().size;
+			}
+		}
+	}
+
+	if (use_journal)
+		journal.Reset(*root);
+}
+
 bool
 SimpleDatabase::Open(Error &error)
 {
-	assert(prefixed_light_song == nullptr);
-
 	root = Directory::NewRoot();
 	mtime = 0;
 
@@ -224,6 +326,7 @@ SimpleDatabase::Open(Error &error)
 		root = Directory::NewRoot();
 	}
 
+	tag_index.Rebuild(*root);
 	return true;
 }
 
@@ -231,9 +334,20 @@ void
 SimpleDatabase::Close()
 {
 	assert(root != nullptr);
-	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
+	if (save_thread.IsDefined()) {
+		/* let the thread write all pending snapshots before
+		   quitting */
+		save_mutex.lock();
+		save_quit = true;
+		save_cond.signal();
+		save_mutex.unlock();
+
+		save_thread.Join();
+	}
+
+	tag_index.Clear();
 	delete root;
 }
 
@@ -241,30 +355,30 @@ const LightSong *
 SimpleDatabase::GetSong(const char *uri, Error &error) const
 {
 	assert(root != nullptr);
-	assert(prefixed_light_song == nullptr);
-	assert(borrowed_song_count == 0);
 
-	db_lock();
+	db_lock_shared();
 
 	auto r = root->LookupDirectory(uri);
 
 	if (r.directory->IsMount()) {
 		/* pass the request to the mounted database */
-		db_unlock();
+		db_unlock_shared();
 
 		const LightSong *song =
 			r.directory->mounted_database->GetSong(r.uri, error);
 		if (song == nullptr)
 			return nullptr;
 
-		prefixed_light_song =
-			new PrefixedLightSong(*song, r.directory->GetPath());
-		return prefixed_light_song;
+#ifndef NDEBUG
+		++borrowed_song_count;
+#endif
+
+		return new PrefixedLightSong(*song, r.directory->GetPath());
 	}
 
 	if (r.uri == nullptr) {
 		/* it's a directory */
-		db_unlock();
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
@@ -272,44 +386,88 @@ SimpleDatabase::GetSong(const char *uri, Error &error) const
 
 	if (strchr(r.uri, '/') != nullptr) {
 		/* refers to a URI "below" the actual song */
-		db_unlock();
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
 	}
 
 	const Song *song = r.directory->FindSong(r.uri);
-	db_unlock();
+	db_unlock_shared();
 	if (song == nullptr) {
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
 	}
 
-	light_song = song->Export();
-
 #ifndef NDEBUG
 	++borrowed_song_count;
 #endif
 
-	return &light_song;
+	/* each caller gets its own copy, because several threads
+	   may be borrowing songs at the same time */
+	return new PrefixedLightSong(song->Export());
 }
 
 void
-SimpleDatabase::ReturnSong(gcc_unused const LightSong *song) const
+SimpleDatabase::ReturnSong(const LightSong *song) const
 {
 	assert(song != nullptr);
-	assert(song == &light_song || song == prefixed_light_song);
-
-	delete prefixed_light_song;
-	prefixed_light_song = nullptr;
 
 #ifndef NDEBUG
-	if (song == &light_song) {
-		assert(borrowed_song_count > 0);
-		--borrowed_song_count;
-	}
+	assert(borrowed_song_count > 0);
+	--borrowed_song_count;
 #endif
+
+	delete (const PrefixedLightSong *)song;
+}
+
+/**
+ * Visit the songs in #candidates which match the filter, in the same
+ * order as Directory::Walk() would.  Only the directories which
+ * contain candidates are entered.
+ */
+static bool
+WalkCandidates(const Directory &directory,
+	       const TagIndex::SongSet &candidates,
+	       const std::set<const Directory *> &directories,
+	       const SongFilter &filter,
+	       VisitSong visit_song, Error &error)
+{
+	for (const auto &song : directory.songs) {
+		if (candidates.find(&song) == candidates.end())
+			continue;
+
+		const LightSong song2 = song.Export();
+		if (filter.Match(song2) && !visit_song(song2, error))
+			return false;
+	}
+
+	for (const auto &child : directory.children)
+		if (directories.find(&child) != directories.end() &&
+		    !WalkCandidates(child, candidates, directories, filter,
+				    visit_song, error))
+			return false;
+
+	return true;
+}
+
+static bool
+WalkIndexed(const Directory &directory,
+	    const TagIndex::SongSet &candidates,
+	    const SongFilter &filter,
+	    VisitSong visit_song, Error &error)
+{
+	/* collect the directories which contain candidates */
+	std::set<const Directory *> directories;
+	for (const Song *song : candidates)
+		for (const Directory *i = song->parent;
+		     i != nullptr && directories.insert(i).second;
+		     i = i->parent) {}
+
+	return directories.find(&directory) == directories.end() ||
+		WalkCandidates(directory, candidates, directories, filter,
+			       visit_song, error);
 }
 
 bool
@@ -319,7 +477,7 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitPlaylist visit_playlist,
 		      Error &error) const
 {
-	ScopeDatabaseLock protect;
+	const ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(selection.uri.c_str());
 	if (r.uri == nullptr) {
@@ -329,6 +487,15 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		    !visit_directory(r.directory->Export(), error))
 			return false;
 
+		TagIndex::SongSet candidates;
+		if (selection.recursive && selection.filter != nullptr &&
+		    visit_song && !visit_directory && !visit_playlist &&
+		    n_mounts == 0 &&
+		    tag_index.Lookup(*selection.filter, candidates))
+			return WalkIndexed(*r.directory, candidates,
+					   *selection.filter,
+					   visit_song, error);
+
 		return r.directory->Walk(selection.recursive, selection.filter,
 					 visit_directory, visit_song,
 					 visit_playlist,
@@ -350,12 +517,43 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 	return false;
 }
 
+bool
+SimpleDatabase::VisitTagAggregates(TagType tag_type, uint32_t group_mask,
+				   VisitAggregate visit,
+				   Error &error) const
+{
+	const ScopeDatabaseSharedLock protect;
+
+	/* only the lookup needs to be serialized; the map does not
+	   change while the shared lock is held, and other threads
+	   may use the aggregates while this one is visiting */
+	aggregates_mutex.lock();
+	const auto map = tag_index.GetAggregate(*root, tag_type,
+						group_mask);
+	aggregates_mutex.unlock();
+
+	for (const auto &i : *map)
+		if (!visit(i.first, i.second, error))
+			return false;
+
+	return true;
+}
+
 bool
 SimpleDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 				TagType tag_type, uint32_t group_mask,
 				VisitTag visit_tag,
 				Error &error) const
 {
+	if (selection.IsEmpty() && !HasMounts())
+		return VisitTagAggregates(tag_type, group_mask,
+					  [&visit_tag](const Tag &tag,
+						       const TagAggregates::Stats &,
+						       Error &error2){
+						  return visit_tag(tag, error2);
+					  },
+					  error);
+
 	return ::VisitUniqueTags(*this, selection, tag_type, group_mask,
 				 visit_tag,
 				 error);
@@ -365,9 +563,163 @@ bool
 SimpleDatabase::GetStats(const DatabaseSelection &selection,
 			 DatabaseStats &stats, Error &error) const
 {
+	if (selection.IsEmpty()) {
+		const ScopeDatabaseSharedLock protect;
+
+		/* check with the lock held, so Mount() cannot
+		   interfere */
+		if (!HasMounts()) {
+			const auto &total = tag_index.GetTotal();
+			stats.song_count = total.n_songs;
+			stats.total_duration = total.total_duration;
+			stats.artist_count = tag_index.GetValueCount(TAG_ARTIST);
+			stats.album_count = tag_index.GetValueCount(TAG_ALBUM);
+			return true;
+		}
+	}
+
 	return ::GetStats(*this, selection, stats, error);
 }
 
+bool
+SimpleDatabase::WriteFull(const std::string &data, Error &error)
+{
+	FileOutputStream fos(path, error);
+	if (!fos.IsDefined())
+		return false;
+
+	/* the binary format is never compressed, because it is
+	   meant to be mapped into memory */
+#ifdef HAVE_ZLIB
+	if (compress && !binary) {
+		GzipOutputStream gzip(fos, error);
+		if (!gzip.IsDefined() ||
+		    !gzip.Write(data.data(), data.size(), error) ||
+		    !gzip.Flush(error))
+			return false;
+	} else
+#endif
+	if (!fos.Write(data.data(), data.size(), error))
+		return false;
+
+	if (!fos.Commit(error))
+		return false;
+
+	if (!use_journal) {
+		/* delete the obsolete journal of a previous run */
+		if (!journal_path.IsNull())
+			RemoveFile(journal_path);
+		return true;
+	}
+
+	struct stat st;
+	if (!StatFile(path, st)) {
+		error.FormatErrno("Failed to stat \"%s\"",
+				  path_utf8.c_str());
+		return false;
+	}
+
+	std::string header;
+	journal_write_header(header, st.st_size, st.st_mtime);
+
+	FileOutputStream journal_fos(journal_path, error);
+	return journal_fos.IsDefined() &&
+		journal_fos.Write(header.data(), header.size(), error) &&
+		journal_fos.Commit(error);
+}
+
+bool
+SimpleDatabase::WriteJournal(const std::string &data, Error &error)
+{
+	FileOutputStream fos(journal_path, error,
+			     FileOutputStream::Mode::APPEND);
+	return fos.IsDefined() &&
+		fos.Write(data.data(), data.size(), error) &&
+		fos.Commit(error);
+}
+
+inline void
+SimpleDatabase::SaveThread()
+{
+	SetThreadName("db_save");
+
+	save_mutex.lock();
+
+	while (true) {
+		if (save_queue.empty()) {
+			if (save_quit)
+				break;
+
+			save_cond.wait(save_mutex);
+			continue;
+		}
+
+		SaveJob job = std::move(save_queue.front());
+		save_queue.pop_front();
+		save_mutex.unlock();
+
+		FormatDebug(simple_db_domain, "writing %s (%zu bytes)",
+			    job.full ? "DB" : "DB journal",
+			    job.data.size());
+
+		Error error;
+		const bool success = job.full
+			? WriteFull(job.data, error)
+			: WriteJournal(job.data, error);
+
+		save_mutex.lock();
+
+		if (!success) {
+			LogError(error, "Failed to save database");
+
+			/* the journal entries queued after this job
+			   depend on it; discard them and rewrite the
+			   whole database next time */
+			save_queue.remove_if([](const SaveJob &j){
+					return !j.full;
+				});
+			force_full = true;
+		}
+	}
+
+	save_mutex.unlock();
+}
+
+void
+SimpleDatabase::SaveThread(void *ctx)
+{
+	SimpleDatabase &db = *(SimpleDatabase *)ctx;
+	db.SaveThread();
+}
+
+bool
+SimpleDatabase::EnqueueSave(bool full, std::string &&data, Error &error)
+{
+	const ScopeLock protect(save_mutex);
+
+	if (full) {
+		/* a full snapshot obsoletes everything which has not
+		   been written yet */
+		save_queue.clear();
+		force_full = false;
+		base_size = data.size();
+		journal_size = 0;
+	} else
+		journal_size += data.size();
+
+	save_queue.emplace_back(full, std::move(data));
+
+	if (!save_thread.IsDefined() &&
+	    !save_thread.Start(SaveThread, this, error)) {
+		save_queue.clear();
+		force_full = true;
+		return false;
+	}
+
+	save_cond.signal();
+	return true;
+}
+
 bool
 SimpleDatabase::Save(Error &error)
 {
@@ -381,55 +733,50 @@ SimpleDatabase::Save(Error &error)
 
 	db_unlock();
 
-	LogDebug(simple_db_domain, "writing DB");
-
-	FileOutputStream fos(path, error);
-	if (!fos.IsDefined())
-		return false;
-
-	OutputStream *os = &fos;
+	/* only the update thread modifies the tree, which is the
+	   thread we are running in, therefore the snapshot can be
+	   generated without holding the db_mutex */
 
-#ifdef HAVE_ZLIB
-	GzipOutputStream *gzip = nullptr;
-	if (compress) {
-		gzip = new GzipOutputStream(*os, error);
-		if (!gzip->IsDefined()) {
-			delete gzip;
-			return false;
-		}
+	mtime = time(nullptr);
 
-		os = gzip;
+	bool full;
+	{
+		const ScopeLock protect(save_mutex);
+		full = !use_journal || force_full ||
+			journal_size >= std::max(base_size,
+						 MIN_JOURNAL_COMPACT_SIZE);
 	}
-#endif
 
-	BufferedOutputStream bos(*os);
+	std::string data;
 
-	db_save_internal(bos, *root);
+	if (!full) {
+		const unsigned n = journal.Collect(*root, data);
+		if (n == 0)
+			return true;
 
-	if (!bos.Flush(error)) {
-#ifdef HAVE_ZLIB
-		delete gzip;
-#endif
-		return false;
+		FormatDebug(simple_db_domain,
+			    "journaling %u modified directories", n);
+		return EnqueueSave(false, std::move(data), error);
 	}
 
-#ifdef HAVE_ZLIB
-	if (gzip != nullptr) {
-		bool success = gzip->Flush(error);
-		delete gzip;
-		if (!success)
-			return false;
-	}
-#endif
+	LogDebug(simple_db_domain, "serializing DB");
 
-	if (!fos.Commit(error))
-		return false;
+	{
+		StringOutputStream sos;
+		BufferedOutputStream bos(sos);
+		if (binary)
+			db_save_binary(bos, *root);
+		else
+			db_save_internal(bos, *root);
+		bos.Flush();
 
-	struct stat st;
-	if (StatFile(path, st))
-		mtime = st.st_mtime;
+		data = std::move(sos.GetValue());
+	}
 
-	return true;
+	if (use_journal)
+		journal.Reset(*root);
+
+	return EnqueueSave(true, std::move(data), error);
 }
 
 bool
@@ -456,6 +803,7 @@ SimpleDatabase::Mount(const char *uri, Database *db, Error &error)
 
 	Directory *mnt = r.directory->CreateChild(r.uri);
 	mnt->mounted_database = db;
+	++n_mounts;
 	return true;
 }
 
@@ -489,7 +837,7 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri,
 #endif
 	auto db = new SimpleDatabase(AllocatedPath::Build(cache_path,
 							  name.c_str()),
-				     compress);
+				     compress, binary);
 	if (!db->Open(error)) {
 		delete db;
 		return false;
@@ -519,6 +867,9 @@ SimpleDatabase::LockUmountSteal(const char *uri)
 	r.directory->mounted_database = nullptr;
 	r.directory->Delete();
 
+	assert(n_mounts > 0);
+	--n_mounts;
+
 	return db;
 }
 
@@ -536,6 +887,7 @@ SimpleDatabase::Unmount(const char *uri)
 
 const DatabasePlugin simple_db_plugin = {
 	"simple",
-	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	DatabasePlugin::FLAG_REQUIRE_STORAGE |
+	DatabasePlugin::FLAG_THREAD_SAFE,
 	SimpleDatabase::Create,
 };
@@ -24,10 +24,20 @@
 #include "db/Interface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "db/LightSong.hxx"
+#include "DatabaseJournal.hxx"
+#include "TagIndex.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 #include "Compiler.h"
 
+#include <atomic>
+#include <list>
+#include <string>
 #include <cassert>
 
+#include <stdint.h>
+
 struct config_param;
 struct Directory;
 struct DatabasePlugin;
@@ -43,6 +53,26 @@ class SimpleDatabase : public Database {
 	bool compress;
 #endif
 
+	/**
+	 * Write the binary database format instead of text?  Both
+	 * formats can be loaded regardless of this setting.
+	 */
+	bool binary;
+
+	/**
+	 * Append modified directories to a journal file instead of
+	 * rewriting the whole database after each update?
+	 */
+	bool use_journal;
+
+	AllocatedPath journal_path;
+
+	/**
+	 * Remembers which directories are already on disk.  Only
+	 * used by the update thread (in Save()) and by Load().
+	 */
+	DatabaseJournal journal;
+
 	/**
 	 * The path where cache files for Mount() are located.
 	 */
@@ -50,26 +80,88 @@ class SimpleDatabase : public Database {
 
 	Directory *root;
 
-	time_t mtime;
+	/**
+	 * Speeds up Visit() with a #SongFilter, and contains the
+	 * aggregates for VisitUniqueTags() and GetStats().  It is
+	 * mutable because aggregates are built on demand.  Protected
+	 * by the #db_mutex.
+	 */
+	mutable TagIndex tag_index;
 
 	/**
-	 * A buffer for GetSong() when prefixing the #LightSong
-	 * instance from a mounted #Database.
+	 * Serializes looking up and building the aggregates in
+	 * #tag_index, because that happens while holding only a
+	 * shared #db_mutex lock.
 	 */
-	mutable PrefixedLightSong *prefixed_light_song;
+	mutable Mutex aggregates_mutex;
 
 	/**
-	 * A buffer for GetSong().
+	 * The number of databases mounted with Mount().  The
+	 * #tag_index does not cover them, therefore it is only used
+	 * when there are none.  Modified only with the exclusive
+	 * #db_mutex lock; it is atomic because HasMounts() reads it
+	 * without the lock.
 	 */
-	mutable LightSong light_song;
+	std::atomic_uint n_mounts;
+
+	time_t mtime;
 
 #ifndef NDEBUG
-	mutable unsigned borrowed_song_count;
+	mutable std::atomic_uint borrowed_song_count;
 #endif
 
+	/**
+	 * A serialized snapshot waiting to be written by the
+	 * #save_thread.
+	 */
+	struct SaveJob {
+		/**
+		 * true: replace the database file with #data; false:
+		 * append #data to the journal.
+		 */
+		bool full;
+
+		std::string data;
+
+		SaveJob(bool _full, std::string &&_data)
+			:full(_full), data(std::move(_data)) {}
+	};
+
+	/**
+	 * Writes the snapshots generated by Save(), so the update
+	 * thread does not have to wait for the disk.  It is started
+	 * on demand.
+	 */
+	Thread save_thread;
+
+	/**
+	 * Protects #save_queue, #save_quit, #force_full and
+	 * #journal_size.
+	 */
+	Mutex save_mutex;
+	Cond save_cond;
+
+	std::list<SaveJob> save_queue;
+
+	bool save_quit;
+
+	/**
+	 * Must the next Save() write the whole database?  This is
+	 * set if the journal file does not match the database file
+	 * or if a write has failed.
+	 */
+	bool force_full;
+
+	/**
+	 * The size of the journal file after all queued jobs are
+	 * written, and the (uncompressed) size of the database it
+	 * belongs to.  Used to decide when to compact the journal.
+	 */
+	uint64_t journal_size, base_size;
+
 	SimpleDatabase();
 
-	SimpleDatabase(AllocatedPath &&_path, bool _compress);
+	SimpleDatabase(AllocatedPath &&_path, bool _compress, bool _binary);
 
 public:
 	static Database *Create(EventLoop &loop, DatabaseListener &listener,
@@ -83,6 +175,38 @@ public:
 		return *root;
 	}
 
+	/**
+	 * The #TagIndex must be updated by the updater whenever it
+	 * modifies the songs in the tree.
+	 */
+	TagIndex &GetTagIndex() {
+		return tag_index;
+	}
+
+	/**
+	 * Are there databases mounted with Mount()?  They are not
+	 * covered by VisitTagAggregates().
+	 */
+	bool HasMounts() const {
+		return n_mounts > 0;
+	}
+
+	typedef std::function<bool(const Tag &tag,
+				   const TagAggregates::Stats &stats,
+				   Error &error)> VisitAggregate;
+
+	/**
+	 * Visit all unique tag values in the whole database (like
+	 * VisitUniqueTags() with an empty selection), together with
+	 * the number and the duration of the songs which have them.
+	 * This uses the materialized #TagAggregates instead of
+	 * visiting all songs.  Should not be called if HasMounts() is
+	 * true; a database mounted after that check is not visited.
+	 */
+	bool VisitTagAggregates(TagType tag_type, uint32_t group_mask,
+				VisitAggregate visit,
+				Error &error) const;
+
 	bool Save(Error &error);
 
 	/**
@@ -141,6 +265,26 @@ private:
 
 	bool Load(Error &error);
 
+	bool LoadText(Error &error);
+
+	/**
+	 * Load the journal file and apply it to the database which
+	 * was just loaded.
+	 */
+	void LoadJournal();
+
+	/**
+	 * Queue a snapshot for the #save_thread, and start it if
+	 * necessary.
+	 */
+	bool EnqueueSave(bool full, std::string &&data, Error &error);
+
+	bool WriteFull(const std::string &data, Error &error);
+	bool WriteJournal(const std::string &data, Error &error);
+
+	void SaveThread();
+	static void SaveThread(void *ctx);
+
 	Database *LockUmountSteal(const char *uri);
 };
 
@@ -20,15 +20,19 @@
 #include "config.h"
 #include "Song.hxx"
 #include "Directory.hxx"
+#include "SongArena.hxx"
 #include "tag/Tag.hxx"
-#include "util/VarSize.hxx"
 #include "DetachedSong.hxx"
 #include "db/LightSong.hxx"
 
+#include <new>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
+static SongArena song_arena;
+
 inline Song::Song(const char *_uri, size_t uri_length, Directory &_parent)
 	:parent(&_parent), mtime(0),
 	 start_time(SongTime::zero()), end_time(SongTime::zero())
@@ -49,9 +53,8 @@ song_alloc(const char *uri, Directory &parent)
 	uri_length = strlen(uri);
 	assert(uri_length);
 
-	return NewVarSize<Song>(sizeof(Song::uri),
-				uri_length + 1,
-				uri, uri_length, parent);
+	const size_t size = sizeof(Song) - sizeof(Song::uri) + uri_length + 1;
+	return new(song_arena.Allocate(size)) Song(uri, uri_length, parent);
 }
 
 Song *
@@ -74,7 +77,8 @@ Song::NewFile(const char *path, Directory &parent)
 void
 Song::Free()
 {
-	DeleteVarSize(this);
+	this->~Song();
+	song_arena.Free(this);
 }
 
 std::string
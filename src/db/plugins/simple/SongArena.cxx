@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SongArena.hxx"
+#include "util/Alloc.hxx"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+struct SongArena::Block {
+	/**
+	 * The number of objects which have not been freed yet.
+	 */
+	size_t n_allocated;
+
+	/**
+	 * The number of bytes used in #data.
+	 */
+	size_t fill;
+
+	union {
+		Header header;
+		uint8_t data[sizeof(Header)];
+	};
+
+	bool CanAllocate(size_t size) const {
+		return offsetof(Block, data) + fill + size <= BLOCK_SIZE;
+	}
+};
+
+SongArena::~SongArena()
+{
+	/* the current block may be empty; all others have been freed
+	   by Free() already (unless objects have leaked) */
+	if (current != nullptr && current->n_allocated == 0)
+		free(current);
+}
+
+static constexpr size_t
+AlignSize(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+void *
+SongArena::Allocate(size_t size)
+{
+	size = AlignSize(sizeof(Header) + size, sizeof(Header));
+
+	if (size > MAX_OBJECT_SIZE) {
+		Header *header = (Header *)xalloc(size);
+		header->block = nullptr;
+		return header + 1;
+	}
+
+	const ScopeLock protect(mutex);
+
+	if (current == nullptr || !current->CanAllocate(size)) {
+		if (current != nullptr && current->n_allocated == 0)
+			/* all objects have been freed already: start
+			   over */
+			current->fill = 0;
+		else {
+			current = (Block *)xalloc(BLOCK_SIZE);
+			current->n_allocated = 0;
+			current->fill = 0;
+			++n_blocks;
+		}
+	}
+
+	Header *header = (Header *)(current->data + current->fill);
+	current->fill += size;
+	++current->n_allocated;
+
+	header->block = current;
+	return header + 1;
+}
+
+void
+SongArena::Free(void *p)
+{
+	Header *header = (Header *)p - 1;
+	Block *block = header->block;
+
+	if (block == nullptr) {
+		free(header);
+		return;
+	}
+
+	const ScopeLock protect(mutex);
+
+	assert(block->n_allocated > 0);
+	if (--block->n_allocated == 0 && block != current) {
+		free(block);
+		--n_blocks;
+	}
+}
+
+unsigned
+SongArena::GetBlockCount()
+{
+	const ScopeLock protect(mutex);
+	return n_blocks;
+}
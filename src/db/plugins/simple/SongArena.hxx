@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SONG_ARENA_HXX
+#define MPD_SONG_ARENA_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * An allocator for #Song objects.  Objects are carved sequentially
+ * out of large blocks, so songs which are created together (e.g.
+ * while loading the database, which happens directory by
+ * directory) are adjacent in memory, and walking a directory's song
+ * list does not jump around the heap.  It also saves the overhead of
+ * one malloc() call per song.
+ *
+ * A block is freed when all of its objects have been freed; the
+ * memory of single objects is not reused before that.
+ *
+ * This class is thread-safe.
+ */
+class SongArena {
+	struct Block;
+
+	/**
+	 * Precedes each object, so Free() can find the block.
+	 */
+	union Header {
+		/**
+		 * The block containing this object, or nullptr if it
+		 * was allocated with malloc().
+		 */
+		Block *block;
+
+		/**
+		 * Ensure that the object following this header is
+		 * aligned properly.
+		 */
+		long double align;
+	};
+
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	/**
+	 * Larger objects are allocated with malloc(), to avoid
+	 * wasting the rest of a block.
+	 */
+	static constexpr size_t MAX_OBJECT_SIZE = BLOCK_SIZE / 16;
+
+	Mutex mutex;
+
+	/**
+	 * The block where new objects are allocated.
+	 */
+	Block *current;
+
+	unsigned n_blocks;
+
+public:
+	SongArena():current(nullptr), n_blocks(0) {}
+
+	SongArena(const SongArena &) = delete;
+	SongArena &operator=(const SongArena &) = delete;
+
+	~SongArena();
+
+	/**
+	 * Allocate memory for one object.  Never fails (aborts when
+	 * out of memory).
+	 */
+	gcc_malloc
+	void *Allocate(size_t size);
+
+	/**
+	 * Free an object allocated by Allocate().
+	 */
+	gcc_nonnull_all
+	void Free(void *p);
+
+	/**
+	 * Returns the number of blocks allocated by this object.
+	 */
+	gcc_pure
+	unsigned GetBlockCount();
+};
+
+#endif
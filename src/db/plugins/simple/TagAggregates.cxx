@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "TagAggregates.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "tag/Tag.hxx"
+
+#include <assert.h>
+
+void
+TagAggregates::Clear()
+{
+	aggregates.clear();
+	total = Stats();
+}
+
+static void
+AddStats(TagAggregates::Stats &stats, const Tag &tag)
+{
+	++stats.n_songs;
+	if (!tag.duration.IsNegative())
+		stats.total_duration += tag.duration;
+}
+
+static void
+RemoveStats(TagAggregates::Stats &stats, const Tag &tag)
+{
+	assert(stats.n_songs > 0);
+
+	--stats.n_songs;
+	if (!tag.duration.IsNegative())
+		stats.total_duration -= tag.duration;
+}
+
+static void
+AddToMap(TagAggregates::Map &map, TagType type, uint32_t group_mask,
+	 const Tag &tag)
+{
+	TagSet set;
+	set.InsertUnique(tag, type, group_mask);
+
+	for (const auto &value : set) {
+		auto i = map.find(value);
+		if (i == map.end())
+			i = map.emplace(value, TagAggregates::Stats()).first;
+
+		AddStats(i->second, tag);
+	}
+}
+
+static void
+AddToMap(TagAggregates::Map &map, TagType type, uint32_t group_mask,
+	 const Directory &directory)
+{
+	for (const auto &song : directory.songs)
+		AddToMap(map, type, group_mask, song.tag);
+
+	for (const auto &child : directory.children)
+		AddToMap(map, type, group_mask, child);
+}
+
+void
+TagAggregates::Add(const Tag &tag)
+{
+	AddStats(total, tag);
+
+	for (auto &i : aggregates)
+		AddToMap(*i.second.map, TagType(i.first.first),
+			 i.first.second, tag);
+}
+
+void
+TagAggregates::Remove(const Tag &tag)
+{
+	RemoveStats(total, tag);
+
+	for (auto &i : aggregates) {
+		Map &map = *i.second.map;
+
+		TagSet set;
+		set.InsertUnique(tag, TagType(i.first.first), i.first.second);
+
+		for (const auto &value : set) {
+			auto j = map.find(value);
+			assert(j != map.end());
+
+			RemoveStats(j->second, tag);
+			if (j->second.n_songs == 0)
+				map.erase(j);
+		}
+	}
+}
+
+std::shared_ptr<const TagAggregates::Map>
+TagAggregates::Get(const Directory &root, TagType type, uint32_t group_mask)
+{
+	const Key key(type, group_mask);
+
+	auto i = aggregates.find(key);
+	if (i == aggregates.end()) {
+		if (aggregates.size() >= MAX_AGGREGATES) {
+			auto oldest = aggregates.begin();
+			for (auto j = aggregates.begin();
+			     j != aggregates.end(); ++j)
+				if (j->second.serial < oldest->second.serial)
+					oldest = j;
+
+			aggregates.erase(oldest);
+		}
+
+		i = aggregates.emplace(key, Aggregate()).first;
+		i->second.map = std::make_shared<Map>();
+		AddToMap(*i->second.map, type, group_mask, root);
+	}
+
+	i->second.serial = next_serial++;
+	return i->second.map;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_AGGREGATES_HXX
+#define MPD_TAG_AGGREGATES_HXX
+
+#include "check.h"
+#include "Chrono.hxx"
+#include "tag/Set.hxx"
+#include "Compiler.h"
+
+#include <map>
+#include <memory>
+#include <utility>
+
+#include <stdint.h>
+
+struct Tag;
+struct Directory;
+
+/**
+ * Materialized results of "list" and "count" over the whole
+ * database.  Each aggregate is built on the first request for a tag
+ * type and group mask, and is then kept up to date by Add() and
+ * Remove().  Part of #TagIndex.
+ */
+class TagAggregates {
+public:
+	struct Stats {
+		unsigned n_songs;
+
+		std::chrono::duration<std::uint64_t,
+				      SongTime::period> total_duration;
+
+		constexpr Stats():n_songs(0), total_duration(0) {}
+	};
+
+	/**
+	 * Maps the unique tag values (as generated by
+	 * TagSet::InsertUnique()) to the songs which have them.
+	 */
+	typedef std::map<Tag, Stats, TagLess> Map;
+
+private:
+	/**
+	 * Limit the memory used by rarely used groupings.  When this
+	 * number is exceeded, the oldest aggregate is discarded.
+	 */
+	static constexpr size_t MAX_AGGREGATES = 16;
+
+	typedef std::pair<unsigned, uint32_t> Key;
+
+	struct Aggregate {
+		/**
+		 * For choosing the oldest aggregate to discard.
+		 */
+		unsigned serial;
+
+		/**
+		 * Shared with callers of Get(), so it survives being
+		 * discarded while they are still using it.
+		 */
+		std::shared_ptr<Map> map;
+	};
+
+	std::map<Key, Aggregate> aggregates;
+
+	unsigned next_serial;
+
+	/**
+	 * The totals of all songs.
+	 */
+	Stats total;
+
+public:
+	TagAggregates():next_serial(0) {}
+
+	void Clear();
+
+	/**
+	 * Add a song with the given tag.
+	 */
+	void Add(const Tag &tag);
+
+	/**
+	 * Remove a song which had the given tag.
+	 */
+	void Remove(const Tag &tag);
+
+	const Stats &GetTotal() const {
+		return total;
+	}
+
+	/**
+	 * Returns the aggregate for the given tag type and group
+	 * mask, and builds it if it does not exist yet.
+	 *
+	 * The returned map is modified only by Add() and Remove(),
+	 * and remains valid even if a later call discards it.
+	 */
+	std::shared_ptr<const Map> Get(const Directory &root,
+				       TagType type, uint32_t group_mask);
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "TagIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongFilter.hxx"
+#include "tag/Tag.hxx"
+#include "lib/icu/Collate.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+void
+TagIndex::Clear()
+{
+	for (auto &map : maps)
+		map.clear();
+
+	aggregates.Clear();
+}
+
+static void
+AddRecursive(TagIndex &index, const Directory &directory)
+{
+	for (const auto &song : directory.songs)
+		index.Add(song);
+
+	for (const auto &child : directory.children)
+		AddRecursive(index, child);
+}
+
+void
+TagIndex::Rebuild(const Directory &root)
+{
+	Clear();
+	AddRecursive(*this, root);
+}
+
+void
+TagIndex::Add(const Song &song)
+{
+	for (const auto &item : song.tag) {
+		Map &map = maps[item.type];
+
+		auto i = map.find(item.value);
+		if (i == map.end())
+			i = map.emplace(item.value,
+					Entry(IcuCaseFold(item.value))).first;
+
+		i->second.songs.insert(&song);
+	}
+
+	aggregates.Add(song.tag);
+}
+
+void
+TagIndex::Remove(const Song &song, const Tag &tag)
+{
+	for (const auto &item : tag) {
+		Map &map = maps[item.type];
+
+		auto i = map.find(item.value);
+		if (i == map.end())
+			/* a duplicate item which was already removed */
+			continue;
+
+		i->second.songs.erase(&song);
+		if (i->second.songs.empty())
+			map.erase(i);
+	}
+
+	aggregates.Remove(tag);
+}
+
+void
+TagIndex::Remove(const Song &song)
+{
+	Remove(song, song.tag);
+}
+
+void
+TagIndex::FindExact(TagType type, const char *value, SongSet &dest) const
+{
+	const Map &map = maps[type];
+	auto i = map.find(value);
+	if (i != map.end())
+		dest.insert(i->second.songs.begin(), i->second.songs.end());
+}
+
+void
+TagIndex::FindPrefix(TagType type, const char *prefix, SongSet &dest) const
+{
+	const size_t length = strlen(prefix);
+
+	const Map &map = maps[type];
+	for (auto i = map.lower_bound(prefix);
+	     i != map.end() && i->first.compare(0, length, prefix) == 0;
+	     ++i)
+		dest.insert(i->second.songs.begin(), i->second.songs.end());
+}
+
+void
+TagIndex::FindFolded(TagType type, const char *folded, SongSet &dest) const
+{
+	for (const auto &i : maps[type])
+		if (i.second.folded.find(folded) != std::string::npos)
+			dest.insert(i.second.songs.begin(),
+				    i.second.songs.end());
+}
+
+/**
+ * Collect the candidates of one filter item.
+ *
+ * @return false if the item cannot use the index
+ */
+static bool
+LookupItem(const TagIndex &index, const SongFilter::Item &item,
+	   TagIndex::SongSet &dest)
+{
+	const unsigned tag = item.GetTag();
+	const char *value = item.GetValue().c_str();
+
+	if (tag != LOCATE_TAG_ANY_TYPE && tag >= TAG_NUM_OF_ITEM_TYPES)
+		return false;
+
+	if (*value == 0)
+		/* an empty value matches songs which don't have this
+		   tag at all */
+		return false;
+
+	const auto find = [&index, &item, value, &dest](TagType type){
+		if (item.GetFoldCase())
+			index.FindFolded(type, value, dest);
+		else
+			index.FindExact(type, value, dest);
+	};
+
+	if (tag == LOCATE_TAG_ANY_TYPE) {
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+			find(TagType(i));
+	} else {
+		find(TagType(tag));
+
+		if (tag == TAG_ALBUM_ARTIST)
+			/* SongFilter falls back to "artist" if there
+			   is no "album artist" */
+			find(TAG_ARTIST);
+	}
+
+	return true;
+}
+
+bool
+TagIndex::Lookup(const SongFilter &filter, SongSet &dest) const
+{
+	assert(dest.empty());
+
+	bool found = false;
+
+	for (const auto &item : filter.GetItems()) {
+		SongSet candidates;
+		if (!LookupItem(*this, item, candidates))
+			continue;
+
+		/* use the most selective item */
+		if (!found || candidates.size() < dest.size())
+			dest.swap(candidates);
+
+		found = true;
+		if (dest.empty())
+			break;
+	}
+
+	return found;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_INDEX_HXX
+#define MPD_TAG_INDEX_HXX
+
+#include "check.h"
+#include "TagAggregates.hxx"
+#include "tag/TagType.h"
+#include "Compiler.h"
+
+#include <map>
+#include <set>
+#include <string>
+
+struct Tag;
+struct Song;
+struct Directory;
+class SongFilter;
+
+/**
+ * Secondary indexes for #SimpleDatabase which map each tag value to
+ * the songs which have it, so "find" and "search" do not need to
+ * match every song in the database.  It also contains the
+ * #TagAggregates for "list" and "count".
+ *
+ * The index is maintained by the updater (#DatabaseEditor) and
+ * rebuilt after the database is loaded.  Caller must lock the
+ * #db_mutex for all methods; a shared lock is enough for the const
+ * ones.
+ */
+class TagIndex {
+public:
+	typedef std::set<const Song *> SongSet;
+
+private:
+	struct Entry {
+		/**
+		 * The case-folded tag value, for "search".
+		 */
+		std::string folded;
+
+		SongSet songs;
+
+		explicit Entry(std::string &&_folded)
+			:folded(std::move(_folded)) {}
+	};
+
+	/**
+	 * An ordered map, which allows prefix lookups.
+	 */
+	typedef std::map<std::string, Entry> Map;
+
+	Map maps[TAG_NUM_OF_ITEM_TYPES];
+
+	TagAggregates aggregates;
+
+public:
+	void Clear();
+
+	/**
+	 * Clear the index and add all songs below the given
+	 * directory.
+	 */
+	void Rebuild(const Directory &root);
+
+	void Add(const Song &song);
+
+	/**
+	 * Remove a song which has the given tag.  This overload is
+	 * used when the song's tag has already been replaced.
+	 */
+	void Remove(const Song &song, const Tag &tag);
+
+	void Remove(const Song &song);
+
+	const TagAggregates::Stats &GetTotal() const {
+		return aggregates.GetTotal();
+	}
+
+	/**
+	 * See TagAggregates::Get().  With only a shared #db_mutex
+	 * lock, calls must be serialized by the caller, but the
+	 * returned map may be used without that until the lock is
+	 * released.
+	 */
+	std::shared_ptr<const TagAggregates::Map>
+	GetAggregate(const Directory &root, TagType type,
+		     uint32_t group_mask) {
+		return aggregates.Get(root, type, group_mask);
+	}
+
+	/**
+	 * The number of distinct values of the given tag type.
+	 */
+	gcc_pure
+	size_t GetValueCount(TagType type) const {
+		return maps[type].size();
+	}
+
+	/**
+	 * Add all songs with the given tag value to #dest.
+	 */
+	void FindExact(TagType type, const char *value, SongSet &dest) const;
+
+	/**
+	 * Add all songs with a tag value which starts with the given
+	 * string to #dest.
+	 */
+	void FindPrefix(TagType type, const char *prefix,
+			SongSet &dest) const;
+
+	/**
+	 * Add all songs with a tag value whose case-folded form
+	 * contains the given (case-folded) string to #dest.
+	 */
+	void FindFolded(TagType type, const char *folded,
+			SongSet &dest) const;
+
+	/**
+	 * Determine a set of songs which contains all songs matching
+	 * the filter (but maybe more).  The caller must still check
+	 * each of them with SongFilter::Match().
+	 *
+	 * @return false if the filter cannot use the index
+	 */
+	bool Lookup(const SongFilter &filter, SongSet &dest) const;
+};
+
+#endif
@@ -67,9 +67,7 @@ UpdateWalk::UpdateArchiveTree(Directory &directory, const char *name)
 		if (song == nullptr) {
 			song = Song::LoadFile(storage, name, directory);
 			if (song != nullptr) {
-				db_lock();
-				directory.AddSong(song);
-				db_unlock();
+				editor.LockAddSong(directory, song);
 
 				modified = true;
 				FormatDefault(update_domain, "added %s/%s",
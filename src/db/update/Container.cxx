@@ -113,9 +113,7 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 
 		tag_builder.Commit(song->tag);
 
-		db_lock();
-		contdir->AddSong(song);
-		db_unlock();
+		editor.LockAddSong(*contdir, song);
 
 		modified = true;
 
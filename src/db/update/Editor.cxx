@@ -24,10 +24,41 @@
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/TagIndex.hxx"
 
 #include <assert.h>
 #include <stddef.h>
 
+void
+DatabaseEditor::AddSong(Directory &parent, Song *song)
+{
+	assert(song->parent == &parent);
+
+	parent.AddSong(song);
+	tag_index.Add(*song);
+}
+
+void
+DatabaseEditor::LockAddSong(Directory &parent, Song *song)
+{
+	db_lock();
+	AddSong(parent, song);
+	db_unlock();
+}
+
+void
+DatabaseEditor::LockUpdateSong(Song &song, Song *update)
+{
+	db_lock();
+	tag_index.Remove(song);
+	song.tag = std::move(update->tag);
+	song.mtime = update->mtime;
+	tag_index.Add(song);
+	db_unlock();
+
+	update->Free();
+}
+
 void
 DatabaseEditor::DeleteSong(Directory &dir, Song *del)
 {
@@ -35,6 +66,7 @@ DatabaseEditor::DeleteSong(Directory &dir, Song *del)
 
 	/* first, prevent traversers in main task from getting this */
 	dir.RemoveSong(del);
+	tag_index.Remove(*del);
 
 	db_unlock(); /* temporary unlock, because update_remove_song() blocks */
 
@@ -27,13 +27,38 @@
 struct Directory;
 struct Song;
 class UpdateRemoveService;
+class TagIndex;
 
 class DatabaseEditor final {
 	UpdateRemoveService remove;
 
+	TagIndex &tag_index;
+
 public:
-	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener)
-		:remove(_loop, _listener) {}
+	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener,
+		       TagIndex &_tag_index)
+		:remove(_loop, _listener), tag_index(_tag_index) {}
+
+	/**
+	 * Add a new song to the directory and to the #TagIndex.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void AddSong(Directory &parent, Song *song);
+
+	/**
+	 * AddSong() with automatic locking.
+	 */
+	void LockAddSong(Directory &parent, Song *song);
+
+	/**
+	 * Replace the tag and the modification time of a song with
+	 * those of a freshly loaded copy, and update the #TagIndex.
+	 *
+	 * @param update a song object which is not in the database;
+	 * it is freed by this method
+	 */
+	void LockUpdateSong(Song &song, Song *update);
 
 	/**
 	 * Caller must lock the #db_mutex.
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h" /* must be first for large file support */
+#include "ScanPool.hxx"
+#include "UpdateDomain.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+/**
+ * The number of outstanding jobs per worker thread at which
+ * IsFull() returns true.
+ */
+static constexpr unsigned JOBS_PER_THREAD = 16;
+
+ScanPool::ScanPool(Storage &_storage, unsigned _n_threads)
+	:storage(_storage), n_threads(_n_threads),
+	 threads(nullptr), n_started(0),
+	 n_running(0), quit(false)
+{
+}
+
+ScanPool::~ScanPool()
+{
+	if (threads != nullptr) {
+		mutex.lock();
+		jobs.clear();
+		quit = true;
+		cond.broadcast();
+		mutex.unlock();
+
+		for (unsigned i = 0; i < n_started; ++i)
+			threads[i].Join();
+
+		delete[] threads;
+	}
+
+	for (auto &job : results)
+		if (job.loaded != nullptr)
+			job.loaded->Free();
+}
+
+bool
+ScanPool::IsFull() const
+{
+	const ScopeLock protect(mutex);
+	return jobs.size() + n_running + results.size() >=
+		n_threads * JOBS_PER_THREAD;
+}
+
+void
+ScanPool::Start()
+{
+	assert(threads == nullptr);
+	assert(IsEnabled());
+
+	threads = new Thread[n_threads];
+
+	Error error;
+	for (; n_started < n_threads; ++n_started) {
+		if (!threads[n_started].Start(Run, this, error)) {
+			LogError(error);
+			break;
+		}
+	}
+}
+
+void
+ScanPool::Push(Job &&job)
+{
+	assert(IsEnabled());
+
+	if (threads == nullptr)
+		Start();
+
+	if (n_started == 0) {
+		/* no worker thread: scan inline */
+		job.loaded = Song::LoadFile(storage, job.name.c_str(),
+					    *job.directory);
+
+		const ScopeLock protect(mutex);
+		results.push_back(std::move(job));
+		return;
+	}
+
+	const ScopeLock protect(mutex);
+	jobs.push_back(std::move(job));
+	cond.signal();
+}
+
+bool
+ScanPool::Pop(Job &job, bool wait)
+{
+	const ScopeLock protect(mutex);
+
+	while (results.empty()) {
+		if (!wait || (jobs.empty() && n_running == 0))
+			return false;
+
+		result_cond.wait(mutex);
+	}
+
+	job = std::move(results.front());
+	results.pop_front();
+	return true;
+}
+
+void
+ScanPool::Clear()
+{
+	const ScopeLock protect(mutex);
+	jobs.clear();
+}
+
+inline void
+ScanPool::Run()
+{
+	SetThreadName("update_scan");
+	SetThreadIdlePriority();
+
+	mutex.lock();
+
+	while (true) {
+		if (jobs.empty()) {
+			if (quit)
+				break;
+
+			cond.wait(mutex);
+			continue;
+		}
+
+		Job job = std::move(jobs.front());
+		jobs.pop_front();
+		++n_running;
+		mutex.unlock();
+
+		FormatDebug(update_domain, "reading %s/%s",
+			    job.directory->GetPath(), job.name.c_str());
+		job.loaded = Song::LoadFile(storage, job.name.c_str(),
+					    *job.directory);
+
+		mutex.lock();
+		--n_running;
+		results.push_back(std::move(job));
+		result_cond.signal();
+	}
+
+	mutex.unlock();
+}
+
+void
+ScanPool::Run(void *ctx)
+{
+	ScanPool &pool = *(ScanPool *)ctx;
+	pool.Run();
+}
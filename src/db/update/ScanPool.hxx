@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_SCAN_POOL_HXX
+#define MPD_UPDATE_SCAN_POOL_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "Compiler.h"
+
+#include <list>
+#include <string>
+
+struct Directory;
+struct Song;
+class Storage;
+
+/**
+ * A pool of threads which read song tags on behalf of #UpdateWalk.
+ * The walker submits jobs with Push() and collects the loaded
+ * #Song objects with Pop(); the database tree is only ever modified
+ * by the walker, the workers just read files.
+ *
+ * The #Directory objects referenced by pending jobs must not be
+ * deleted until their results have been collected.
+ */
+class ScanPool {
+public:
+	struct Job {
+		Directory *directory;
+
+		std::string name;
+
+		/**
+		 * The existing #Song with this name, or nullptr if
+		 * the file is new.
+		 */
+		Song *song;
+
+		/**
+		 * The #Song loaded by the worker, or nullptr if the
+		 * file was not recognized.
+		 */
+		Song *loaded;
+
+		Job() = default;
+		Job(Directory &_directory, const char *_name, Song *_song)
+			:directory(&_directory), name(_name),
+			 song(_song), loaded(nullptr) {}
+	};
+
+private:
+	Storage &storage;
+
+	const unsigned n_threads;
+
+	Thread *threads;
+
+	/**
+	 * The number of threads which were started successfully.
+	 */
+	unsigned n_started;
+
+	/**
+	 * Protects all attributes below.
+	 */
+	mutable Mutex mutex;
+
+	/**
+	 * Signalled when a job is added or #quit is set.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a job has been finished.
+	 */
+	Cond result_cond;
+
+	std::list<Job> jobs, results;
+
+	unsigned n_running;
+
+	bool quit;
+
+public:
+	/**
+	 * @param _n_threads the number of worker threads; with 0 or
+	 * 1, the pool is disabled and the caller shall scan inline
+	 */
+	ScanPool(Storage &_storage, unsigned _n_threads);
+	~ScanPool();
+
+	ScanPool(const ScanPool &) = delete;
+	ScanPool &operator=(const ScanPool &) = delete;
+
+	bool IsEnabled() const {
+		return n_threads > 1;
+	}
+
+	/**
+	 * Are there so many outstanding jobs that the caller should
+	 * collect results before submitting more?
+	 */
+	gcc_pure
+	bool IsFull() const;
+
+	/**
+	 * Submit a job.  The worker threads are started on the first
+	 * call.
+	 */
+	void Push(Job &&job);
+
+	/**
+	 * Obtain a finished job.
+	 *
+	 * @param wait if true, then wait for a running job to finish
+	 * @return false if no result is available (with wait=true:
+	 * no job is outstanding)
+	 */
+	bool Pop(Job &job, bool wait);
+
+	/**
+	 * Discard all jobs which have not been started yet.  Results
+	 * of running jobs can still be collected with Pop().
+	 */
+	void Clear();
+
+private:
+	void Start();
+
+	void Run();
+	static void Run(void *ctx);
+};
+
+#endif
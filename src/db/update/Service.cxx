@@ -80,9 +80,9 @@ UpdateService::CancelMount(const char *uri)
 	/* determine which (mounted) database will be updated and what
 	   storage will be scanned */
 
-	db_lock();
+	db_lock_shared();
 	const auto lr = db.GetRoot().LookupDirectory(uri);
-	db_unlock();
+	db_unlock_shared();
 
 	if (!lr.directory->IsMount())
 		return;
@@ -159,7 +159,8 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 	modified = false;
 
 	next = std::move(i);
-	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage);
+	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage,
+			      next.db->GetTagIndex());
 
 	Error error;
 	if (!update_thread.Start(Task, this, error))
@@ -169,6 +170,19 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 		    "spawned thread for update job id %i", next.id);
 }
 
+bool
+UpdateService::GetProgress(unsigned &n_directories, unsigned &n_songs) const
+{
+	assert(GetEventLoop().IsInsideOrNull());
+
+	if (walk == nullptr)
+		return false;
+
+	n_directories = walk->GetDirectoryCount();
+	n_songs = walk->GetSongCount();
+	return true;
+}
+
 unsigned
 UpdateService::GenerateId()
 {
@@ -188,9 +202,9 @@ UpdateService::Enqueue(const char *path, bool discard)
 	SimpleDatabase *db2;
 	Storage *storage2;
 
-	db_lock();
+	db_lock_shared();
 	const auto lr = db.GetRoot().LookupDirectory(path);
-	db_unlock();
+	db_unlock_shared();
 	if (lr.directory->IsMount()) {
 		/* follow the mountpoint, update the mounted
 		   database */
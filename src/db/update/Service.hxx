@@ -77,6 +77,14 @@ public:
 		return next.id;
 	}
 
+	/**
+	 * Obtain the progress of the current update: the number of
+	 * directories visited and song files read so far.
+	 *
+	 * @return false if no update is running
+	 */
+	bool GetProgress(unsigned &n_directories, unsigned &n_songs) const;
+
 	/**
 	 * Add this path to the database update queue.
 	 *
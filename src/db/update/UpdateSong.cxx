@@ -30,6 +30,58 @@
 
 #include <unistd.h>
 
+void
+UpdateWalk::CommitSongFile(Directory &directory, const char *name,
+			   Song *song, Song *loaded)
+{
+	++n_songs;
+
+	if (song == nullptr) {
+		if (loaded == nullptr) {
+			FormatDebug(update_domain,
+				    "ignoring unrecognized file %s/%s",
+				    directory.GetPath(), name);
+			return;
+		}
+
+		editor.LockAddSong(directory, loaded);
+
+		modified = true;
+		FormatDefault(update_domain, "added %s/%s",
+			      directory.GetPath(), name);
+	} else {
+		FormatDefault(update_domain, "updating %s/%s",
+			      directory.GetPath(), name);
+		if (loaded == nullptr) {
+			FormatDebug(update_domain,
+				    "deleting unrecognized file %s/%s",
+				    directory.GetPath(), name);
+			editor.LockDeleteSong(directory, song);
+		} else
+			editor.LockUpdateSong(*song, loaded);
+
+		modified = true;
+	}
+}
+
+bool
+UpdateWalk::CollectScanResult(bool wait)
+{
+	ScanPool::Job job;
+	if (!scan_pool.Pop(job, wait))
+		return false;
+
+	CommitSongFile(*job.directory, job.name.c_str(),
+		       job.song, job.loaded);
+	return true;
+}
+
+void
+UpdateWalk::CollectScanResults(bool wait)
+{
+	while (CollectScanResult(wait)) {}
+}
+
 inline void
 UpdateWalk::UpdateSongFile2(Directory &directory,
 			    const char *name, const char *suffix,
@@ -58,36 +110,29 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 		return;
 	}
 
-	if (song == nullptr) {
-		FormatDebug(update_domain, "reading %s/%s",
-			    directory.GetPath(), name);
-		song = Song::LoadFile(storage, name, directory);
-		if (song == nullptr) {
-			FormatDebug(update_domain,
-				    "ignoring unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			return;
-		}
-
-		db_lock();
-		directory.AddSong(song);
-		db_unlock();
+	if (song != nullptr && info.mtime == song->mtime && !walk_discard)
+		/* not modified */
+		return;
 
-		modified = true;
-		FormatDefault(update_domain, "added %s/%s",
-			      directory.GetPath(), name);
-	} else if (info.mtime != song->mtime || walk_discard) {
-		FormatDefault(update_domain, "updating %s/%s",
-			      directory.GetPath(), name);
-		if (!song->UpdateFile(storage)) {
-			FormatDebug(update_domain,
-				    "deleting unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			editor.LockDeleteSong(directory, song);
-		}
+	if (scan_pool.IsEnabled()) {
+		/* let a worker thread read the file; the existing
+		   song stays in the database (and is not touched by
+		   the worker) until the result is committed */
+		while (scan_pool.IsFull())
+			CollectScanResult(true);
 
-		modified = true;
+		scan_pool.Push(ScanPool::Job(directory, name, song));
+		CollectScanResults(false);
+		return;
 	}
+
+	/* load the new tag into a separate object, because an
+	   existing song may be read by other threads while the file
+	   is being scanned */
+	FormatDebug(update_domain, "reading %s/%s",
+		    directory.GetPath(), name);
+	Song *loaded = Song::LoadFile(storage, name, directory);
+	CommitSongFile(directory, name, song, loaded);
 }
 
 bool
@@ -50,10 +50,13 @@
 #include <memory>
 
 UpdateWalk::UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		       Storage &_storage)
+		       Storage &_storage, TagIndex &_tag_index)
 	:cancel(false),
 	 storage(_storage),
-	 editor(_loop, _listener)
+	 editor(_loop, _listener, _tag_index),
+	 scan_pool(_storage, config_get_positive(CONF_UPDATE_THREADS,
+						 DEFAULT_UPDATE_THREADS)),
+	 n_directories(0), n_songs(0)
 {
 #ifndef WIN32
 	follow_inside_symlinks =
@@ -332,6 +335,7 @@ UpdateWalk::UpdateDirectory(Directory &directory, const FileInfo &info)
 	assert(info.IsDirectory());
 
 	directory_set_stat(directory, info);
+	++n_directories;
 
 	Error error;
 	const std::auto_ptr<StorageDirectoryReader> reader(storage.OpenDirectory(directory.GetPath(), error));
@@ -487,5 +491,9 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard)
 		UpdateDirectory(root, info);
 	}
 
+	if (cancel)
+		scan_pool.Clear();
+	CollectScanResults(true);
+
 	return modified;
 }
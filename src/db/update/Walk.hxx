@@ -22,8 +22,11 @@
 
 #include "check.h"
 #include "Editor.hxx"
+#include "ScanPool.hxx"
 #include "Compiler.h"
 
+#include <atomic>
+
 #include <sys/stat.h>
 
 struct stat;
@@ -32,6 +35,7 @@ struct Directory;
 struct ArchivePlugin;
 class Storage;
 class ExcludeList;
+class TagIndex;
 
 class UpdateWalk final {
 #ifdef ENABLE_ARCHIVE
@@ -46,6 +50,13 @@ class UpdateWalk final {
 	bool follow_outside_symlinks;
 #endif
 
+	/**
+	 * Several decoder plugins wrap libraries with global state
+	 * which is not thread-safe, therefore tags are read serially
+	 * unless configured otherwise.
+	 */
+	static constexpr unsigned DEFAULT_UPDATE_THREADS = 1;
+
 	bool walk_discard;
 	bool modified;
 
@@ -60,9 +71,20 @@ class UpdateWalk final {
 
 	DatabaseEditor editor;
 
+	/**
+	 * Reads tags of new and modified songs in parallel.
+	 */
+	ScanPool scan_pool;
+
+	/**
+	 * Progress counters for the "status" command; written by the
+	 * update thread, read by the main thread.
+	 */
+	std::atomic<unsigned> n_directories, n_songs;
+
 public:
 	UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		   Storage &_storage);
+		   Storage &_storage, TagIndex &_tag_index);
 
 	/**
 	 * Cancel the current update and quit the Walk() method as
@@ -70,6 +92,21 @@ public:
 	 */
 	void Cancel() {
 		cancel = true;
+		scan_pool.Clear();
+	}
+
+	/**
+	 * Returns the number of directories visited so far.
+	 */
+	unsigned GetDirectoryCount() const {
+		return n_directories.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the number of song files read so far.
+	 */
+	unsigned GetSongCount() const {
+		return n_songs.load(std::memory_order_relaxed);
 	}
 
 	/**
@@ -87,6 +124,31 @@ private:
 
 	void PurgeDeletedFromDirectory(Directory &directory);
 
+	/**
+	 * Apply the result of reading a song file to the database.
+	 *
+	 * @param song the existing #Song, or nullptr if the file is new
+	 * @param loaded the #Song freshly loaded from the file, or
+	 * nullptr if it was not recognized
+	 */
+	void CommitSongFile(Directory &directory, const char *name,
+			    Song *song, Song *loaded);
+
+	/**
+	 * Commit one finished #ScanPool job.
+	 *
+	 * @param wait if true, then wait for a running job
+	 * @return false if there was no job to commit
+	 */
+	bool CollectScanResult(bool wait);
+
+	/**
+	 * Commit finished #ScanPool jobs.
+	 *
+	 * @param wait if true, then wait until all jobs are finished
+	 */
+	void CollectScanResults(bool wait);
+
 	void UpdateSongFile2(Directory &directory,
 			     const char *name, const char *suffix,
 			     const FileInfo &info);
@@ -28,10 +28,13 @@
 #include "MusicPipe.hxx"
 #include "DecoderControl.hxx"
 #include "DecoderInternal.hxx"
+#include "DecoderCache.hxx"
+#include "DecoderConvertThread.hxx"
 #include "DetachedSong.hxx"
 #include "input/InputStream.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "Log.hxx"
 
 #include <assert.h>
@@ -62,6 +65,12 @@ decoder_initialized(Decoder &decoder,
 	dc.seekable = seekable;
 	dc.total_time = duration;
 
+	if (decoder.cache_writer != nullptr &&
+	    !decoder.cache_writer->SetFormat(dc.in_audio_format,
+					     dc.out_audio_format,
+					     seekable, duration))
+		decoder.AbortCache();
+
 	FormatDebug(decoder_domain, "audio_format=%s, seekable=%s",
 		    audio_format_to_string(dc.in_audio_format, &af_string),
 		    seekable ? "true" : "false");
@@ -78,6 +87,18 @@ decoder_initialized(Decoder &decoder,
 					   dc.out_audio_format,
 					   error))
 			decoder.error = std::move(error);
+		else if (decoder_convert_thread &&
+			 !decoder.convert->CanConvertInPlace()) {
+			/* in-place conversions are cheap and are
+			   done by decoder_write_commit() */
+			decoder.convert_thread =
+				new DecoderConvertThread(*decoder.convert);
+			if (!decoder.convert_thread->Start(error)) {
+				LogError(error);
+				delete decoder.convert_thread;
+				decoder.convert_thread = nullptr;
+			}
+		}
 	}
 
 	dc.Lock();
@@ -145,6 +166,9 @@ decoder_get_virtual_command(Decoder &decoder)
 		/* an error has occurred: stop the decoder plugin */
 		return DecoderCommand::STOP;
 
+	if (decoder.convert_command != DecoderCommand::NONE)
+		return decoder.convert_command;
+
 	const DecoderControl &dc = decoder.dc;
 	assert(dc.pipe != nullptr);
 
@@ -160,11 +184,30 @@ decoder_get_command(Decoder &decoder)
 	return decoder_get_virtual_command(decoder);
 }
 
+/**
+ * Discard the block which is pending in the #DecoderConvertThread
+ * (if any), e.g. because the decoder has seeked.
+ */
+static void
+decoder_discard_convert(Decoder &decoder)
+{
+	if (decoder.convert_thread == nullptr ||
+	    !decoder.convert_thread->IsPending())
+		return;
+
+	decoder.convert_thread->Collect(IgnoreError());
+	decoder.convert_timestamp = -1;
+}
+
 void
 decoder_command_finished(Decoder &decoder)
 {
 	DecoderControl &dc = decoder.dc;
 
+	if (decoder.seeking)
+		/* the converted data is from the old song position */
+		decoder_discard_convert(decoder);
+
 	dc.Lock();
 
 	assert(dc.command != DecoderCommand::NONE ||
@@ -219,6 +262,9 @@ decoder_seek_time(Decoder &decoder)
 
 	decoder.seeking = true;
 
+	/* the cache needs the whole song in one piece */
+	decoder.AbortCache();
+
 	return dc.seek_time;
 }
 
@@ -388,7 +434,12 @@ decoder_timestamp(Decoder &decoder, double t)
 {
 	assert(t >= 0);
 
-	decoder.timestamp = t;
+	if (decoder.convert_thread != nullptr &&
+	    decoder.convert_thread->IsPending())
+		/* applies to the data after the pending block */
+		decoder.convert_timestamp = t;
+	else
+		decoder.timestamp = t;
 }
 
 /**
@@ -441,18 +492,24 @@ update_stream_tag(Decoder &decoder, InputStream *is)
 	return true;
 }
 
-DecoderCommand
-decoder_data(Decoder &decoder,
-	     InputStream *is,
-	     const void *data, size_t length,
-	     uint16_t kbit_rate)
+static DecoderCommand
+decoder_send_stream_tag(Decoder &decoder, InputStream *is);
+
+/**
+ * The common part of decoder_data() and decoder_data_converted():
+ * check for pending commands and send stream tags.
+ *
+ * @return the command to be returned to the caller if it is not
+ * #DecoderCommand::NONE or if the length is zero
+ */
+static DecoderCommand
+decoder_data_begin(Decoder &decoder, InputStream *is, size_t length)
 {
 	DecoderControl &dc = decoder.dc;
 	DecoderCommand cmd;
 
 	assert(dc.state == DecoderState::DECODE);
 	assert(dc.pipe != nullptr);
-	assert(length % dc.in_audio_format.GetFrameSize() == 0);
 
 	dc.Lock();
 	cmd = decoder_get_virtual_command(decoder);
@@ -462,12 +519,27 @@ decoder_data(Decoder &decoder,
 	    length == 0)
 		return cmd;
 
+	return decoder_send_stream_tag(decoder, is);
+}
+
+/**
+ * Send a new tag from the #InputStream to the music pipe.
+ */
+static DecoderCommand
+decoder_send_stream_tag(Decoder &decoder, InputStream *is)
+{
+	DecoderCommand cmd = DecoderCommand::NONE;
+
 	assert(!decoder.initial_seek_pending);
 	assert(!decoder.initial_seek_running);
 
-	/* send stream tags */
-
 	if (update_stream_tag(decoder, is)) {
+		/* the tag belongs behind the data submitted
+		   before */
+		cmd = decoder_flush_convert(decoder);
+		if (cmd != DecoderCommand::NONE)
+			return cmd;
+
 		if (decoder.decoder_tag != nullptr) {
 			/* merge with tag from decoder plugin */
 			Tag *tag = Tag::Merge(*decoder.decoder_tag,
@@ -477,36 +549,56 @@ decoder_data(Decoder &decoder,
 		} else
 			/* send only the stream tag */
 			cmd = do_send_tag(decoder, *decoder.stream_tag);
-
-		if (cmd != DecoderCommand::NONE)
-			return cmd;
 	}
 
-	if (decoder.convert != nullptr) {
-		assert(dc.in_audio_format != dc.out_audio_format);
+	return cmd;
+}
 
-		Error error;
-		auto result = decoder.convert->Convert({data, length},
-						       error);
-		if (data == nullptr) {
-			/* the PCM conversion has failed - stop
-			   playback, since we have no better way to
-			   bail out */
-			LogError(error);
-			return DecoderCommand::STOP;
-		}
+/**
+ * Account for PCM data which has just been written to the current
+ * chunk: pass it to the decoder cache, expand the chunk and advance
+ * the decoder's timestamp.
+ *
+ * @return true if the end of the range has been reached
+ */
+static bool
+decoder_expand_chunk(Decoder &decoder, MusicChunk &chunk,
+		     const void *data, size_t nbytes,
+		     uint16_t kbit_rate)
+{
+	DecoderControl &dc = decoder.dc;
 
-		data = result.data;
-		length = result.size;
-	} else {
-		assert(dc.in_audio_format == dc.out_audio_format);
+	if (decoder.cache_writer != nullptr &&
+	    !decoder.cache_writer->Append(data, nbytes, kbit_rate))
+		decoder.AbortCache();
+
+	/* expand the music pipe chunk */
+
+	const bool full = chunk.Expand(dc.out_audio_format, nbytes);
+	if (full) {
+		/* the chunk is full, flush it */
+		decoder.FlushChunk();
 	}
 
-	while (length > 0) {
-		MusicChunk *chunk;
-		bool full;
+	decoder.timestamp += (double)nbytes /
+		dc.out_audio_format.GetTimeToSize();
+
+	return dc.end_time.IsPositive() &&
+		decoder.timestamp >= dc.end_time.ToDoubleS();
+}
+
+/**
+ * Copy PCM data in the output audio format into the music pipe.
+ */
+static DecoderCommand
+decoder_write_chunks(Decoder &decoder,
+		     const void *data, size_t length,
+		     uint16_t kbit_rate)
+{
+	DecoderControl &dc = decoder.dc;
 
-		chunk = decoder.GetChunk();
+	while (length > 0) {
+		MusicChunk *chunk = decoder.GetChunk();
 		if (chunk == nullptr) {
 			assert(dc.command != DecoderCommand::NONE);
 			return dc.command;
@@ -529,22 +621,11 @@ decoder_data(Decoder &decoder,
 
 		memcpy(dest.data, data, nbytes);
 
-		/* expand the music pipe chunk */
-
-		full = chunk->Expand(dc.out_audio_format, nbytes);
-		if (full) {
-			/* the chunk is full, flush it */
-			decoder.FlushChunk();
-		}
-
 		data = (const uint8_t *)data + nbytes;
 		length -= nbytes;
 
-		decoder.timestamp += (double)nbytes /
-			dc.out_audio_format.GetTimeToSize();
-
-		if (dc.end_time.IsPositive() &&
-		    decoder.timestamp >= dc.end_time.ToDoubleS())
+		if (decoder_expand_chunk(decoder, *chunk, dest.data, nbytes,
+					 kbit_rate))
 			/* the end of this range has been reached:
 			   stop decoding */
 			return DecoderCommand::STOP;
@@ -553,6 +634,186 @@ decoder_data(Decoder &decoder,
 	return DecoderCommand::NONE;
 }
 
+DecoderCommand
+decoder_flush_convert(Decoder &decoder)
+{
+	if (decoder.convert_thread == nullptr ||
+	    !decoder.convert_thread->IsPending())
+		return DecoderCommand::NONE;
+
+	Error error;
+	const auto result = decoder.convert_thread->Collect(error);
+	if (result.IsNull()) {
+		/* the PCM conversion has failed - stop playback,
+		   since we have no better way to bail out */
+		LogError(error);
+		return DecoderCommand::STOP;
+	}
+
+	const DecoderCommand cmd =
+		decoder_write_chunks(decoder, result.data, result.size,
+				     decoder.convert_kbit_rate);
+
+	if (decoder.convert_timestamp >= 0) {
+		decoder.timestamp = decoder.convert_timestamp;
+		decoder.convert_timestamp = -1;
+	}
+
+	return cmd;
+}
+
+/**
+ * Like decoder_flush_convert(), but for functions which cannot
+ * return a #DecoderCommand.  A STOP is remembered and returned by
+ * the next decoder_get_command() or decoder_data() call; other
+ * commands remain in DecoderControl::command anyway.
+ */
+static void
+decoder_defer_flush_convert(Decoder &decoder)
+{
+	if (decoder_flush_convert(decoder) == DecoderCommand::STOP)
+		decoder.convert_command = DecoderCommand::STOP;
+}
+
+DecoderCommand
+decoder_data(Decoder &decoder,
+	     InputStream *is,
+	     const void *data, size_t length,
+	     uint16_t kbit_rate)
+{
+	assert(length % decoder.dc.in_audio_format.GetFrameSize() == 0);
+
+	const DecoderCommand cmd = decoder_data_begin(decoder, is, length);
+	if (cmd != DecoderCommand::NONE || length == 0)
+		return cmd;
+
+	if (decoder.convert_thread != nullptr) {
+		assert(decoder.convert != nullptr);
+
+		/* write the block which has been converted in the
+		   meantime, and let the thread convert this one while
+		   the plugin decodes the next one */
+		const DecoderCommand cmd2 = decoder_flush_convert(decoder);
+		if (cmd2 != DecoderCommand::NONE)
+			return cmd2;
+
+		decoder.convert_kbit_rate = kbit_rate;
+		decoder.convert_thread->Submit({data, length});
+		return DecoderCommand::NONE;
+	} else if (decoder.convert != nullptr) {
+		assert(decoder.dc.in_audio_format !=
+		       decoder.dc.out_audio_format);
+
+		Error error;
+		auto result = decoder.convert->Convert({data, length},
+						       error);
+		if (result.IsNull()) {
+			/* the PCM conversion has failed - stop
+			   playback, since we have no better way to
+			   bail out */
+			LogError(error);
+			return DecoderCommand::STOP;
+		}
+
+		data = result.data;
+		length = result.size;
+	} else {
+		assert(decoder.dc.in_audio_format ==
+		       decoder.dc.out_audio_format);
+	}
+
+	return decoder_write_chunks(decoder, data, length, kbit_rate);
+}
+
+DecoderCommand
+decoder_data_converted(Decoder &decoder,
+		       const void *data, size_t length,
+		       uint16_t kbit_rate)
+{
+	assert(length % decoder.dc.out_audio_format.GetFrameSize() == 0);
+
+	const DecoderCommand cmd = decoder_data_begin(decoder, nullptr,
+						      length);
+	if (cmd != DecoderCommand::NONE || length == 0)
+		return cmd;
+
+	return decoder_write_chunks(decoder, data, length, kbit_rate);
+}
+
+WritableBuffer<void>
+decoder_write_begin(Decoder &decoder, uint16_t kbit_rate)
+{
+	DecoderControl &dc = decoder.dc;
+
+	assert(dc.state == DecoderState::DECODE);
+	assert(dc.pipe != nullptr);
+
+	dc.Lock();
+	const DecoderCommand cmd = decoder_get_virtual_command(decoder);
+	dc.Unlock();
+
+	if (cmd != DecoderCommand::NONE ||
+	    (decoder.convert != nullptr &&
+	     !decoder.convert->CanConvertInPlace()))
+		return nullptr;
+
+	while (true) {
+		MusicChunk *chunk = decoder.GetChunk();
+		if (chunk == nullptr)
+			return nullptr;
+
+		const auto dest =
+			chunk->Write(dc.out_audio_format,
+				     SongTime::FromS(decoder.timestamp) -
+				     dc.song->GetStartTime(),
+				     kbit_rate);
+		if (!dest.IsEmpty())
+			return dest;
+
+		/* the chunk is full, flush it */
+		decoder.FlushChunk();
+	}
+}
+
+DecoderCommand
+decoder_write_commit(Decoder &decoder, InputStream *is, size_t length)
+{
+	DecoderControl &dc = decoder.dc;
+
+	assert(dc.state == DecoderState::DECODE);
+	assert(dc.pipe != nullptr);
+	assert(length % dc.in_audio_format.GetFrameSize() == 0);
+
+	dc.Lock();
+	const DecoderCommand cmd = decoder_get_virtual_command(decoder);
+	dc.Unlock();
+
+	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK ||
+	    length == 0)
+		/* discard the data */
+		return cmd;
+
+	/* decoder_write_begin() has left the chunk it returned as the
+	   current one; the data was written right behind its end */
+	assert(decoder.chunk != nullptr);
+	MusicChunk &chunk = *decoder.chunk;
+	void *data = chunk.data + chunk.length;
+	assert(chunk.length + length <= chunk.capacity);
+
+	if (decoder.convert != nullptr)
+		decoder.convert->ConvertInPlace({data, length});
+
+	if (decoder_expand_chunk(decoder, chunk, data, length,
+				 chunk.bit_rate))
+		/* the end of this range has been reached: stop
+		   decoding */
+		return DecoderCommand::STOP;
+
+	/* stream tags are sent after the data, because sending a tag
+	   flushes the chunk we have just written to */
+	return decoder_send_stream_tag(decoder, is);
+}
+
 DecoderCommand
 decoder_tag(Decoder &decoder, InputStream *is,
 	    Tag &&tag)
@@ -563,11 +824,17 @@ decoder_tag(Decoder &decoder, InputStream *is,
 	assert(dc.state == DecoderState::DECODE);
 	assert(dc.pipe != nullptr);
 
+	/* the tag belongs behind the data submitted before */
+	const DecoderCommand flush_cmd = decoder_flush_convert(decoder);
+
 	/* save the tag */
 
 	delete decoder.decoder_tag;
 	decoder.decoder_tag = new Tag(tag);
 
+	if (decoder.cache_writer != nullptr)
+		decoder.cache_writer->AddTag(tag);
+
 	/* check for a new stream tag */
 
 	update_stream_tag(decoder, is);
@@ -580,6 +847,12 @@ decoder_tag(Decoder &decoder, InputStream *is,
 		   function here */
 		return DecoderCommand::SEEK;
 
+	if (flush_cmd != DecoderCommand::NONE)
+		return flush_cmd;
+
+	if (decoder.convert_command != DecoderCommand::NONE)
+		return decoder.convert_command;
+
 	/* send tag to music pipe */
 
 	if (decoder.stream_tag != nullptr) {
@@ -601,6 +874,12 @@ void
 decoder_replay_gain(Decoder &decoder,
 		    const ReplayGainInfo *replay_gain_info)
 {
+	/* the pending data must not get the new replay gain info */
+	decoder_defer_flush_convert(decoder);
+
+	if (decoder.cache_writer != nullptr)
+		decoder.cache_writer->AddReplayGain(replay_gain_info);
+
 	if (replay_gain_info != nullptr) {
 		static unsigned serial;
 		if (++serial == 0)
@@ -637,5 +916,11 @@ decoder_mixramp(Decoder &decoder, MixRampInfo &&mix_ramp)
 {
 	DecoderControl &dc = decoder.dc;
 
+	/* keep the position recorded in the cache accurate */
+	decoder_defer_flush_convert(decoder);
+
+	if (decoder.cache_writer != nullptr)
+		decoder.cache_writer->AddMixRamp(mix_ramp);
+
 	dc.SetMixRamp(std::move(mix_ramp));
 }
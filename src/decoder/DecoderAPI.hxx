@@ -43,6 +43,7 @@
 
 #include <stdint.h>
 
+template<typename T> struct WritableBuffer;
 class Error;
 
 /**
@@ -193,6 +194,45 @@ decoder_data(Decoder &decoder, InputStream &is,
 	return decoder_data(decoder, &is, data, length, kbit_rate);
 }
 
+/**
+ * Obtain a buffer inside the music pipe where the decoder plugin may
+ * decode directly into, in the audio format passed to
+ * decoder_initialized().  This saves the copy done by
+ * decoder_data().  After writing, call decoder_write_commit().
+ *
+ * If the audio format needs a conversion which cannot be done in
+ * place, or if a command is pending, then the returned buffer is
+ * empty, and the plugin must submit its data with decoder_data()
+ * instead.
+ *
+ * @param decoder the decoder object
+ * @param kbit_rate the current bit rate
+ * @return a writable buffer whose size is a multiple of the frame
+ * size
+ */
+WritableBuffer<void>
+decoder_write_begin(Decoder &decoder, uint16_t kbit_rate);
+
+/**
+ * Submit the data which was written to the buffer returned by
+ * decoder_write_begin().
+ *
+ * @param decoder the decoder object
+ * @param is an input stream which is buffering while we are waiting
+ * for the player
+ * @param length the number of bytes which were written
+ * @return the current command, or DecoderCommand::NONE if there is no
+ * command pending
+ */
+DecoderCommand
+decoder_write_commit(Decoder &decoder, InputStream *is, size_t length);
+
+static inline DecoderCommand
+decoder_write_commit(Decoder &decoder, InputStream &is, size_t length)
+{
+	return decoder_write_commit(decoder, &is, length);
+}
+
 /**
  * This function is called by the decoder plugin when it has
  * successfully decoded a tag.
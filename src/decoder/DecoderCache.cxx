@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DecoderCache.hxx"
+#include "tag/Tag.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+
+DecoderCache *decoder_cache;
+
+DecoderCacheItem::DecoderCacheItem(std::string &&_key)
+	:key(std::move(_key)), block_size(BLOCK_SIZE), size(0), refcount(0), last_used(0),
+	 linked(false),
+	 in_audio_format(AudioFormat::Undefined()),
+	 audio_format(AudioFormat::Undefined()),
+	 seekable(false), duration(SignedSongTime::Negative()),
+	 kbit_rate(0) {}
+
+DecoderCacheItem::~DecoderCacheItem()
+{
+	assert(refcount == 0);
+
+	for (auto block : blocks)
+		delete[] block;
+
+	for (auto &event : events) {
+		delete event.tag;
+		delete event.replay_gain;
+	}
+}
+
+ConstBuffer<void>
+DecoderCacheItem::Read(uint64_t offset) const
+{
+	if (offset >= size)
+		return ConstBuffer<void>(nullptr, 0);
+
+	const size_t i = offset / block_size;
+	const size_t position = offset % block_size;
+	const size_t length = std::min<uint64_t>(block_size - position,
+						 size - offset);
+	return ConstBuffer<void>(blocks[i] + position, length);
+}
+
+DecoderCacheWriter::DecoderCacheWriter(DecoderCache &_cache,
+				       std::string &&key)
+	:cache(_cache), item(new DecoderCacheItem(std::move(key))) {}
+
+DecoderCacheWriter::~DecoderCacheWriter()
+{
+	if (item != nullptr)
+		cache.Discard(item);
+}
+
+bool
+DecoderCacheWriter::SetFormat(AudioFormat in_audio_format,
+			      AudioFormat audio_format,
+			      bool seekable, SignedSongTime duration)
+{
+	assert(item->size == 0);
+	assert(audio_format.IsValid());
+
+	item->in_audio_format = in_audio_format;
+	item->audio_format = audio_format;
+	item->seekable = seekable;
+	item->duration = duration;
+
+	const size_t frame_size = audio_format.GetFrameSize();
+	item->block_size = DecoderCacheItem::BLOCK_SIZE -
+		DecoderCacheItem::BLOCK_SIZE % frame_size;
+
+	/* don't evict other songs for one which cannot fit */
+	return !duration.IsPositive() ||
+		duration.ToScale<uint64_t>(audio_format.sample_rate) * frame_size
+		<= cache.max_size;
+}
+
+bool
+DecoderCacheWriter::Append(const void *_data, size_t length,
+			   uint16_t kbit_rate)
+{
+	assert(item != nullptr);
+	assert(item->audio_format.IsValid());
+
+	const uint8_t *data = (const uint8_t *)_data;
+
+	while (length > 0) {
+		if (item->size == item->GetCapacity()) {
+			const ScopeLock protect(cache.mutex);
+			if (!cache.Reserve(item->block_size))
+				return false;
+
+			item->blocks.push_back(new uint8_t[item->block_size]);
+		}
+
+		const size_t position = item->size % item->block_size;
+		const size_t nbytes = std::min(item->block_size - position,
+					       length);
+		memcpy(item->blocks.back() + position, data, nbytes);
+
+		item->size += nbytes;
+		data += nbytes;
+		length -= nbytes;
+	}
+
+	if (kbit_rate > 0)
+		item->kbit_rate = kbit_rate;
+
+	return true;
+}
+
+void
+DecoderCacheWriter::AddTag(const Tag &tag)
+{
+	item->events.emplace_back(item->size,
+				  DecoderCacheItem::Event::Type::TAG);
+	item->events.back().tag = new Tag(tag);
+}
+
+void
+DecoderCacheWriter::AddReplayGain(const ReplayGainInfo *info)
+{
+	item->events.emplace_back(item->size,
+				  DecoderCacheItem::Event::Type::REPLAY_GAIN);
+	if (info != nullptr)
+		item->events.back().replay_gain = new ReplayGainInfo(*info);
+}
+
+void
+DecoderCacheWriter::AddMixRamp(const MixRampInfo &mix_ramp)
+{
+	item->events.emplace_back(item->size,
+				  DecoderCacheItem::Event::Type::MIX_RAMP);
+	item->events.back().mix_ramp = mix_ramp;
+}
+
+void
+DecoderCacheWriter::Commit()
+{
+	assert(item != nullptr);
+	assert(item->audio_format.IsValid());
+
+	cache.Commit(item);
+	item = nullptr;
+}
+
+DecoderCache::DecoderCache(uint64_t _max_size)
+	:max_size(_max_size), size(0), clock(0), hits(0), misses(0) {}
+
+DecoderCache::~DecoderCache()
+{
+	for (auto &i : items)
+		delete i.second;
+}
+
+std::string
+DecoderCache::MakeKey(const char *uri, time_t mtime,
+		      SongTime start_time, SongTime end_time)
+{
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "\n%lu\n%u-%u",
+		 (unsigned long)mtime,
+		 start_time.ToMS(), end_time.ToMS());
+
+	std::string key(uri);
+	key.append(buffer);
+	return key;
+}
+
+const DecoderCacheItem *
+DecoderCache::Get(const std::string &key)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = items.find(key);
+	if (i == items.end()) {
+		++misses;
+		return nullptr;
+	}
+
+	++hits;
+
+	DecoderCacheItem &item = *i->second;
+	++item.refcount;
+	item.last_used = ++clock;
+	return &item;
+}
+
+void
+DecoderCache::Put(const DecoderCacheItem &_item)
+{
+	DecoderCacheItem &item = const_cast<DecoderCacheItem &>(_item);
+
+	const ScopeLock protect(mutex);
+
+	assert(item.refcount > 0);
+
+	if (--item.refcount == 0 && !item.linked)
+		Free(&item);
+}
+
+void
+DecoderCache::GetStats(DecoderCacheStats &stats) const
+{
+	const ScopeLock protect(mutex);
+
+	stats.n_items = items.size();
+	stats.size = size;
+	stats.max_size = max_size;
+	stats.hits = hits;
+	stats.misses = misses;
+}
+
+bool
+DecoderCache::Reserve(uint64_t n)
+{
+	if (size + n > max_size) {
+		uint64_t unused = 0;
+		for (const auto &i : items)
+			if (i.second->refcount == 0)
+				unused += i.second->GetCapacity();
+
+		if (size + n > max_size + unused)
+			/* evicting would not help */
+			return false;
+	}
+
+	while (size + n > max_size) {
+		DecoderCacheItem *victim = nullptr;
+		for (const auto &i : items) {
+			DecoderCacheItem &item = *i.second;
+			if (item.refcount == 0 &&
+			    (victim == nullptr ||
+			     item.last_used < victim->last_used))
+				victim = &item;
+		}
+
+		if (victim == nullptr)
+			return false;
+
+		Evict(*victim);
+	}
+
+	size += n;
+	return true;
+}
+
+void
+DecoderCache::Evict(DecoderCacheItem &item)
+{
+	assert(item.linked);
+
+	items.erase(item.key);
+	item.linked = false;
+
+	if (item.refcount == 0)
+		Free(&item);
+}
+
+void
+DecoderCache::Free(DecoderCacheItem *item)
+{
+	assert(!item->linked);
+	assert(size >= item->GetCapacity());
+
+	size -= item->GetCapacity();
+	delete item;
+}
+
+void
+DecoderCache::Commit(DecoderCacheItem *item)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = items.find(item->key);
+	if (i != items.end())
+		/* replace the old item; this happens when a song was
+		   being decoded twice at the same time */
+		Evict(*i->second);
+
+	item->linked = true;
+	item->last_used = ++clock;
+	items.emplace(item->key, item);
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_CACHE_HXX
+#define MPD_DECODER_CACHE_HXX
+
+#include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
+#include "Chrono.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <time.h>
+
+struct Tag;
+class DecoderCache;
+
+/**
+ * A song which has been decoded completely, in the output audio
+ * format, together with the meta data the decoder plugin has
+ * submitted.  Obtain it with DecoderCache::Get() and release it with
+ * DecoderCache::Put().
+ */
+class DecoderCacheItem {
+	friend class DecoderCache;
+	friend class DecoderCacheWriter;
+
+	/**
+	 * The PCM data is stored in blocks of (approximately) this
+	 * size, so it can grow without copying.
+	 */
+	static constexpr size_t BLOCK_SIZE = 256 * 1024;
+
+public:
+	/**
+	 * A call to decoder_tag(), decoder_replay_gain() or
+	 * decoder_mixramp() which has to be repeated during
+	 * playback.
+	 */
+	struct Event {
+		enum class Type : uint8_t {
+			TAG, REPLAY_GAIN, MIX_RAMP,
+		};
+
+		/** the PCM position (in bytes) of this event */
+		uint64_t offset;
+
+		Type type;
+
+		/** the tag (for #Type::TAG) */
+		Tag *tag;
+
+		/**
+		 * Replay gain information (for #Type::REPLAY_GAIN);
+		 * nullptr clears it.
+		 */
+		ReplayGainInfo *replay_gain;
+
+		/** mixramp information (for #Type::MIX_RAMP) */
+		MixRampInfo mix_ramp;
+
+		Event(uint64_t _offset, Type _type)
+			:offset(_offset), type(_type),
+			 tag(nullptr), replay_gain(nullptr) {}
+	};
+
+private:
+	const std::string key;
+
+	/**
+	 * The size of each block, a multiple of the frame size, so
+	 * no frame crosses a block boundary.
+	 */
+	size_t block_size;
+
+	std::vector<uint8_t *> blocks;
+
+	/** the number of PCM bytes */
+	uint64_t size;
+
+	/** the number of #DecoderCache::Get() references */
+	unsigned refcount;
+
+	/** for the LRU eviction, see DecoderCache::clock */
+	unsigned last_used;
+
+	/** is this item still in the #DecoderCache map? */
+	bool linked;
+
+public:
+	AudioFormat in_audio_format, audio_format;
+
+	bool seekable;
+
+	SignedSongTime duration;
+
+	/** the last bit rate reported by the decoder plugin */
+	uint16_t kbit_rate;
+
+	std::vector<Event> events;
+
+	explicit DecoderCacheItem(std::string &&_key);
+	~DecoderCacheItem();
+
+	DecoderCacheItem(const DecoderCacheItem &) = delete;
+	DecoderCacheItem &operator=(const DecoderCacheItem &) = delete;
+
+	uint64_t GetSize() const {
+		return size;
+	}
+
+	/**
+	 * Returns a contiguous portion of the PCM data beginning at
+	 * the specified offset, which must be a multiple of the frame
+	 * size.  Returns an empty buffer at the end.
+	 */
+	gcc_pure
+	ConstBuffer<void> Read(uint64_t offset) const;
+
+private:
+	/**
+	 * Returns the number of bytes allocated for the PCM data.
+	 */
+	uint64_t GetCapacity() const {
+		return uint64_t(blocks.size()) * block_size;
+	}
+};
+
+struct DecoderCacheStats {
+	unsigned n_items;
+
+	/** the number of bytes used (including songs being recorded) */
+	uint64_t size;
+
+	uint64_t max_size;
+
+	unsigned hits, misses;
+};
+
+/**
+ * Records the output of a decoder.  When the song has been decoded
+ * completely, Commit() adds it to the #DecoderCache.  Deleting the
+ * object without committing discards the data.
+ */
+class DecoderCacheWriter {
+	DecoderCache &cache;
+
+	DecoderCacheItem *item;
+
+public:
+	DecoderCacheWriter(DecoderCache &_cache, std::string &&key);
+	~DecoderCacheWriter();
+
+	DecoderCacheWriter(const DecoderCacheWriter &) = delete;
+	DecoderCacheWriter &operator=(const DecoderCacheWriter &) = delete;
+
+	/**
+	 * Set the audio format and the other attributes reported by
+	 * decoder_initialized().  Must be called before Append().
+	 *
+	 * @return false if the song is known to be too large for the
+	 * cache; the caller should delete this object then
+	 */
+	bool SetFormat(AudioFormat in_audio_format, AudioFormat audio_format,
+		       bool seekable, SignedSongTime duration);
+
+	/**
+	 * Append PCM data.
+	 *
+	 * @return false if the cache has no room for the song; the
+	 * caller should delete this object then
+	 */
+	bool Append(const void *data, size_t length, uint16_t kbit_rate);
+
+	void AddTag(const Tag &tag);
+	void AddReplayGain(const ReplayGainInfo *info);
+	void AddMixRamp(const MixRampInfo &mix_ramp);
+
+	/**
+	 * Add the song to the cache.  After that, this object must be
+	 * deleted.
+	 */
+	void Commit();
+};
+
+/**
+ * A bounded, least-recently-used cache of decoded songs, so songs
+ * which are played again do not need to be decoded again.  The keys
+ * are built by MakeKey().  All methods are thread-safe.
+ */
+class DecoderCache {
+	friend class DecoderCacheWriter;
+
+	mutable Mutex mutex;
+
+	const uint64_t max_size;
+
+	/**
+	 * The number of bytes used by all items, including those
+	 * which are still being recorded or which have been evicted
+	 * but are still in use.
+	 */
+	uint64_t size;
+
+	std::map<std::string, DecoderCacheItem *> items;
+
+	/**
+	 * Incremented on each access, to find the least recently
+	 * used item.
+	 */
+	unsigned clock;
+
+	unsigned hits, misses;
+
+public:
+	explicit DecoderCache(uint64_t _max_size);
+	~DecoderCache();
+
+	DecoderCache(const DecoderCache &) = delete;
+	DecoderCache &operator=(const DecoderCache &) = delete;
+
+	/**
+	 * Build a key for a song.  Songs whose file has been
+	 * modified get a new key.
+	 */
+	gcc_pure
+	static std::string MakeKey(const char *uri, time_t mtime,
+				   SongTime start_time, SongTime end_time);
+
+	/**
+	 * Look up a song and count a hit or a miss.  The returned
+	 * item must be released with Put().
+	 */
+	const DecoderCacheItem *Get(const std::string &key);
+
+	void Put(const DecoderCacheItem &item);
+
+	void GetStats(DecoderCacheStats &stats) const;
+
+private:
+	/**
+	 * Make room for the specified number of bytes by evicting
+	 * unused items, and account for them.  Caller must lock the
+	 * mutex.
+	 *
+	 * @return false if there is not enough room
+	 */
+	bool Reserve(uint64_t n);
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void Evict(DecoderCacheItem &item);
+
+	/**
+	 * Delete an item and release its memory.  Caller must lock
+	 * the mutex.
+	 */
+	void Free(DecoderCacheItem *item);
+
+	void Discard(DecoderCacheItem *item) {
+		const ScopeLock protect(mutex);
+		Free(item);
+	}
+
+	void Commit(DecoderCacheItem *item);
+};
+
+/**
+ * The global decoder cache, configured with "decoder_cache_size".
+ * nullptr if disabled.
+ */
+extern DecoderCache *decoder_cache;
+
+#endif
@@ -30,7 +30,8 @@ DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond)
 	 command(DecoderCommand::NONE),
 	 client_is_waiting(false),
 	 song(nullptr),
-	 replay_gain_db(0), replay_gain_prev_db(0) {}
+	 replay_gain_db(0), replay_gain_prev_db(0),
+	 prefetch(_mutex, cond) {}
 
 DecoderControl::~DecoderControl()
 {
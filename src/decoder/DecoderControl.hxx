@@ -23,6 +23,7 @@
 #include "DecoderCommand.hxx"
 #include "AudioFormat.hxx"
 #include "MixRampInfo.hxx"
+#include "input/Prefetch.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
@@ -158,6 +159,12 @@ struct DecoderControl {
 
 	MixRampInfo mix_ramp, previous_mix_ramp;
 
+	/**
+	 * Opens the input streams of upcoming songs in advance.  It
+	 * is protected by #mutex.
+	 */
+	InputPrefetch prefetch;
+
 	/**
 	 * @param _mutex see #mutex
 	 * @param _client_cond see #client_cond
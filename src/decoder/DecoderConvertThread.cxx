@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DecoderConvertThread.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "thread/Name.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+bool decoder_convert_thread;
+
+DecoderConvertThread::DecoderConvertThread(PcmConvert &_convert)
+	:convert(_convert), input(nullptr), output(nullptr),
+	 pending(false), done(false), quit(false)
+{
+}
+
+DecoderConvertThread::~DecoderConvertThread()
+{
+	if (!thread.IsDefined())
+		return;
+
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	thread.Join();
+}
+
+bool
+DecoderConvertThread::Start(Error &_error)
+{
+	assert(!thread.IsDefined());
+
+	return thread.Start(Run, this, _error);
+}
+
+void
+DecoderConvertThread::Submit(ConstBuffer<void> src)
+{
+	assert(thread.IsDefined());
+	assert(!pending);
+	assert(!src.IsEmpty());
+
+	void *copy = input_buffer.Get(src.size);
+	memcpy(copy, src.data, src.size);
+
+	pending = true;
+
+	const ScopeLock protect(mutex);
+	input = {copy, src.size};
+	done = false;
+	cond.broadcast();
+}
+
+ConstBuffer<void>
+DecoderConvertThread::Collect(Error &_error)
+{
+	assert(pending);
+
+	pending = false;
+
+	const ScopeLock protect(mutex);
+	while (!done)
+		cond.wait(mutex);
+
+	input = nullptr;
+
+	if (output.IsNull())
+		_error = std::move(error);
+
+	return output;
+}
+
+void
+DecoderConvertThread::Run()
+{
+	SetThreadName("convert");
+
+	mutex.lock();
+
+	while (!quit) {
+		if (input.IsNull() || done) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		const ConstBuffer<void> src = input;
+		mutex.unlock();
+
+		Error error2;
+		const auto result = convert.Convert(src, error2);
+
+		mutex.lock();
+		output = result;
+		if (result.IsNull())
+			error = std::move(error2);
+		done = true;
+		cond.broadcast();
+	}
+
+	mutex.unlock();
+}
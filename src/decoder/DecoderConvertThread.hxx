@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_CONVERT_THREAD_HXX
+#define MPD_DECODER_CONVERT_THREAD_HXX
+
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+
+class PcmConvert;
+
+/**
+ * Runs a #PcmConvert in a separate thread, so a decoder plugin can
+ * decode the next block while the previous one is being converted
+ * (e.g. resampled).  There is at most one block in flight: the
+ * caller submits a block with Submit(), and picks up the result with
+ * Collect() before submitting the next one.
+ *
+ * The methods must be called from one thread (the decoder thread).
+ */
+class DecoderConvertThread {
+	PcmConvert &convert;
+
+	Mutex mutex;
+	Cond cond;
+
+	Thread thread;
+
+	/**
+	 * A copy of the submitted data, because the decoder plugin
+	 * may reuse its buffer after Submit() returns.
+	 */
+	PcmBuffer input_buffer;
+
+	/** the data to be converted; protected by the mutex */
+	ConstBuffer<void> input;
+
+	/**
+	 * The converted data, owned by the #PcmConvert; nullptr if
+	 * the conversion has failed.  Protected by the mutex.
+	 */
+	ConstBuffer<void> output;
+
+	/** the error which occurred during the conversion */
+	Error error;
+
+	/**
+	 * Is there a block which has been submitted but not
+	 * collected yet?  This is only accessed by the caller's
+	 * thread.
+	 */
+	bool pending;
+
+	/**
+	 * Has the thread finished converting the #input block?
+	 * Protected by the mutex.
+	 */
+	bool done;
+
+	bool quit;
+
+public:
+	explicit DecoderConvertThread(PcmConvert &_convert);
+
+	/**
+	 * Stops the thread.  A pending block is discarded.
+	 */
+	~DecoderConvertThread();
+
+	DecoderConvertThread(const DecoderConvertThread &) = delete;
+	DecoderConvertThread &operator=(const DecoderConvertThread &) = delete;
+
+	bool Start(Error &error);
+
+	bool IsPending() const {
+		return pending;
+	}
+
+	/**
+	 * Submit a block to the thread.  There must not be a pending
+	 * block.
+	 */
+	void Submit(ConstBuffer<void> src);
+
+	/**
+	 * Wait until the pending block has been converted and return
+	 * the result.  The returned buffer is valid until the next
+	 * Submit() call.
+	 *
+	 * @return the converted data or nullptr on error
+	 */
+	ConstBuffer<void> Collect(Error &error);
+
+private:
+	void Run();
+
+	static void Run(void *ctx) {
+		((DecoderConvertThread *)ctx)->Run();
+	}
+};
+
+/**
+ * Shall #PcmConvert run in a #DecoderConvertThread?  Configured with
+ * "convert_thread".
+ */
+extern bool decoder_convert_thread;
+
+#endif
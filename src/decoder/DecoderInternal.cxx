@@ -20,6 +20,8 @@
 #include "config.h"
 #include "DecoderInternal.hxx"
 #include "DecoderControl.hxx"
+#include "DecoderCache.hxx"
+#include "DecoderConvertThread.hxx"
 #include "pcm/PcmConvert.hxx"
 #include "MusicPipe.hxx"
 #include "MusicBuffer.hxx"
@@ -33,6 +35,9 @@ Decoder::~Decoder()
 	/* caller must flush the chunk */
 	assert(chunk == nullptr);
 
+	/* stop the thread before closing the PcmConvert it uses */
+	delete convert_thread;
+
 	if (convert != nullptr) {
 		convert->Close();
 		delete convert;
@@ -41,6 +46,7 @@ Decoder::~Decoder()
 	delete song_tag;
 	delete stream_tag;
 	delete decoder_tag;
+	delete cache_writer;
 }
 
 /**
@@ -102,3 +108,10 @@ Decoder::FlushChunk()
 		dc.client_cond.signal();
 	dc.Unlock();
 }
+
+void
+Decoder::AbortCache()
+{
+	delete cache_writer;
+	cache_writer = nullptr;
+}
@@ -20,10 +20,16 @@
 #ifndef MPD_DECODER_INTERNAL_HXX
 #define MPD_DECODER_INTERNAL_HXX
 
+#include "DecoderCommand.hxx"
 #include "ReplayGainInfo.hxx"
 #include "util/Error.hxx"
 
+#include <stddef.h>
+#include <stdint.h>
+
 class PcmConvert;
+class DecoderConvertThread;
+class DecoderCacheWriter;
 struct MusicChunk;
 struct DecoderControl;
 struct Tag;
@@ -37,6 +43,34 @@ struct Decoder {
 	 */
 	PcmConvert *convert;
 
+	/**
+	 * If not nullptr, then #convert runs in this thread, one
+	 * block behind the decoder plugin.
+	 */
+	DecoderConvertThread *convert_thread;
+
+	/**
+	 * The bit rate of the block pending in #convert_thread.
+	 */
+	uint16_t convert_kbit_rate;
+
+	/**
+	 * A time stamp passed to decoder_timestamp() while a block
+	 * was pending in #convert_thread; it will be applied after
+	 * that block has been written.  Negative if there is none.
+	 */
+	double convert_timestamp;
+
+	/**
+	 * #DecoderCommand::STOP if decoder_flush_convert() has asked
+	 * to stop in a function which cannot pass this on to the
+	 * plugin, e.g. decoder_replay_gain() (because the end of the
+	 * range has been reached, or the conversion has failed).  It
+	 * will be returned by the next decoder_get_command() or
+	 * decoder_data() call.  #DecoderCommand::NONE otherwise.
+	 */
+	DecoderCommand convert_command;
+
 	/**
 	 * The time stamp of the next data chunk, in seconds.
 	 */
@@ -87,6 +121,12 @@ struct Decoder {
 	 */
 	unsigned replay_gain_serial;
 
+	/**
+	 * Records the decoded song for the #DecoderCache.  nullptr if
+	 * the song is not being recorded (anymore).
+	 */
+	DecoderCacheWriter *cache_writer;
+
 	/**
 	 * An error has occurred (in DecoderAPI.cxx), and the plugin
 	 * will be asked to stop.
@@ -95,14 +135,17 @@ struct Decoder {
 
 	Decoder(DecoderControl &_dc, bool _initial_seek_pending, Tag *_tag)
 		:dc(_dc),
-		 convert(nullptr),
+		 convert(nullptr), convert_thread(nullptr),
+		 convert_timestamp(-1),
+		 convert_command(DecoderCommand::NONE),
 		 timestamp(0),
 		 initial_seek_pending(_initial_seek_pending),
 		 initial_seek_running(false),
 		 seeking(false),
 		 song_tag(_tag), stream_tag(nullptr), decoder_tag(nullptr),
 		 chunk(nullptr),
-		 replay_gain_serial(0) {
+		 replay_gain_serial(0),
+		 cache_writer(nullptr) {
 	}
 
 	~Decoder();
@@ -121,6 +164,30 @@ struct Decoder {
 	 * Caller must not lock the #DecoderControl object.
 	 */
 	void FlushChunk();
+
+	/**
+	 * Stop recording the song for the #DecoderCache, e.g. because
+	 * the plugin has been asked to seek.
+	 */
+	void AbortCache();
 };
 
+/**
+ * Write the block which is pending in the #DecoderConvertThread (if
+ * any) to the music pipe.  This must be called before submitting
+ * anything else to the music pipe.
+ */
+DecoderCommand
+decoder_flush_convert(Decoder &decoder);
+
+/**
+ * Like decoder_data(), but the data is already in the output audio
+ * format and bypasses the #PcmConvert.  This is used for songs
+ * played from the #DecoderCache.
+ */
+DecoderCommand
+decoder_data_converted(Decoder &decoder,
+		       const void *data, size_t length,
+		       uint16_t kbit_rate);
+
 #endif
@@ -22,12 +22,14 @@
 #include "DecoderControl.hxx"
 #include "DecoderInternal.hxx"
 #include "DecoderError.hxx"
+#include "DecoderCache.hxx"
 #include "DecoderPlugin.hxx"
 #include "DetachedSong.hxx"
 #include "system/FatalError.hxx"
 #include "MusicPipe.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
 #include "DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "DecoderList.hxx"
@@ -36,6 +38,8 @@
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
 #include "tag/ApeReplayGain.hxx"
+#include "tag/Tag.hxx"
+#include "AudioConfig.hxx"
 #include "Log.hxx"
 
 #include <functional>
@@ -59,10 +63,10 @@ decoder_command_finished_locked(DecoderControl &dc)
 }
 
 /**
- * Opens the input stream with input_stream::Open(), and waits until
- * the stream gets ready.  If a decoder STOP command is received
- * during that, it cancels the operation (but does not close the
- * stream).
+ * Opens the input stream with input_stream::Open() (or adopts the
+ * one opened by #InputPrefetch), and waits until the stream gets
+ * ready.  If a decoder STOP command is received during that, it
+ * cancels the operation (but does not close the stream).
  *
  * Unlock the decoder before calling this function.
  *
@@ -74,7 +78,15 @@ decoder_input_stream_open(DecoderControl &dc, const char *uri)
 {
 	Error error;
 
-	InputStream *is = InputStream::Open(uri, dc.mutex, dc.cond, error);
+	dc.Lock();
+	InputStream *is = dc.prefetch.Take(uri);
+	dc.Unlock();
+
+	if (is != nullptr)
+		FormatDebug(decoder_thread_domain, "using prefetched %s", uri);
+	else
+		is = InputStream::Open(uri, dc.mutex, dc.cond, error);
+
 	if (is == nullptr) {
 		if (error.IsDefined())
 			LogError(error);
@@ -357,6 +369,136 @@ decoder_run_file(Decoder &decoder, const char *uri_utf8, Path path_fs)
 	return false;
 }
 
+/**
+ * Look up the song in the #DecoderCache.  On a miss, start recording
+ * it, unless decoding starts in the middle of the song.
+ *
+ * Unlock the decoder before calling this function.
+ */
+static const DecoderCacheItem *
+decoder_cache_lookup(Decoder &decoder, const DetachedSong &song,
+		     const char *uri, Path path_fs)
+{
+	assert(decoder_cache != nullptr);
+
+	struct stat st;
+	if (!StatFile(path_fs, st))
+		return nullptr;
+
+	std::string key = DecoderCache::MakeKey(uri, st.st_mtime,
+						song.GetStartTime(),
+						song.GetEndTime());
+
+	const DecoderCacheItem *item = decoder_cache->Get(key);
+	if (item != nullptr) {
+		if (item->audio_format ==
+		    getOutputAudioFormat(item->in_audio_format))
+			return item;
+
+		/* the configured output format has changed */
+		decoder_cache->Put(*item);
+	}
+
+	if (decoder.dc.start_time == song.GetStartTime())
+		decoder.cache_writer =
+			new DecoderCacheWriter(*decoder_cache,
+					       std::move(key));
+
+	return nullptr;
+}
+
+static void
+decoder_cache_replay_event(Decoder &decoder,
+			   const DecoderCacheItem::Event &event)
+{
+	switch (event.type) {
+	case DecoderCacheItem::Event::Type::TAG:
+		decoder_tag(decoder, nullptr, Tag(*event.tag));
+		break;
+
+	case DecoderCacheItem::Event::Type::REPLAY_GAIN:
+		decoder_replay_gain(decoder, event.replay_gain);
+		break;
+
+	case DecoderCacheItem::Event::Type::MIX_RAMP:
+		decoder_mixramp(decoder, MixRampInfo(event.mix_ramp));
+		break;
+	}
+}
+
+/**
+ * Play a song from the #DecoderCache, acting like a decoder plugin
+ * whose output needs no conversion.
+ *
+ * Unlock the decoder before calling this function.
+ */
+static void
+decoder_run_cache(Decoder &decoder, const DecoderCacheItem &item)
+{
+	DecoderControl &dc = decoder.dc;
+	struct audio_format_string af_string;
+
+	dc.in_audio_format = item.in_audio_format;
+	dc.out_audio_format = item.audio_format;
+	dc.seekable = item.seekable;
+	dc.total_time = item.duration;
+
+	FormatDebug(decoder_thread_domain, "playing %s from the cache",
+		    audio_format_to_string(item.audio_format, &af_string));
+
+	dc.Lock();
+	dc.state = DecoderState::DECODE;
+	dc.client_cond.signal();
+	dc.Unlock();
+
+	const SongTime start_time = dc.song->GetStartTime();
+	const size_t frame_size = item.audio_format.GetFrameSize();
+
+	uint64_t position = 0;
+	auto event = item.events.begin();
+
+	while (true) {
+		DecoderCommand cmd = decoder_get_command(decoder);
+		if (cmd == DecoderCommand::SEEK) {
+			const SongTime t = decoder_seek_time(decoder);
+			position = t > start_time
+				? (t - start_time).ToScale<uint64_t>(item.audio_format.sample_rate) * frame_size
+				: 0;
+			position = std::min(position, item.GetSize());
+
+			/* like a decoder plugin, don't repeat the
+			   events which have been skipped */
+			event = item.events.begin();
+			while (event != item.events.end() &&
+			       event->offset < position)
+				++event;
+
+			decoder_command_finished(decoder);
+			continue;
+		} else if (cmd == DecoderCommand::STOP)
+			break;
+
+		while (event != item.events.end() &&
+		       event->offset <= position)
+			decoder_cache_replay_event(decoder, *event++);
+
+		auto data = item.Read(position);
+		if (data.IsEmpty())
+			break;
+
+		if (event != item.events.end() &&
+		    position + data.size > event->offset)
+			data.size = event->offset - position;
+
+		cmd = decoder_data_converted(decoder, data.data, data.size,
+					     item.kbit_rate);
+		if (cmd == DecoderCommand::NONE)
+			position += data.size;
+		else if (cmd == DecoderCommand::STOP)
+			break;
+	}
+}
+
 static void
 decoder_run_song(DecoderControl &dc,
 		 const DetachedSong &song, const char *uri, Path path_fs)
@@ -369,12 +511,33 @@ decoder_run_song(DecoderControl &dc,
 
 	decoder_command_finished_locked(dc);
 
-	ret = !path_fs.IsNull()
-		? decoder_run_file(decoder, uri, path_fs)
-		: decoder_run_stream(decoder, uri);
+	const DecoderCacheItem *cached = nullptr;
+	if (decoder_cache != nullptr && !path_fs.IsNull()) {
+		dc.Unlock();
+		cached = decoder_cache_lookup(decoder, song, uri, path_fs);
+		dc.Lock();
+	}
+
+	if (cached != nullptr) {
+		dc.Unlock();
+		decoder_run_cache(decoder, *cached);
+		decoder_cache->Put(*cached);
+		dc.Lock();
+		ret = true;
+	} else
+		ret = !path_fs.IsNull()
+			? decoder_run_file(decoder, uri, path_fs)
+			: decoder_run_stream(decoder, uri);
 
 	dc.Unlock();
 
+	/* write the data which is still being converted; the plugin
+	   has returned already, so the command it may return does
+	   not matter anymore */
+
+	if (!decoder.seeking)
+		decoder_flush_convert(decoder);
+
 	/* flush the last chunk */
 
 	if (decoder.chunk != nullptr)
@@ -382,6 +545,17 @@ decoder_run_song(DecoderControl &dc,
 
 	dc.Lock();
 
+	if (decoder.cache_writer != nullptr) {
+		/* the song has been decoded completely, unless the
+		   plugin was interrupted */
+		if (ret && !decoder.error.IsDefined() &&
+		    dc.command == DecoderCommand::NONE &&
+		    dc.state == DecoderState::DECODE)
+			decoder.cache_writer->Commit();
+
+		decoder.AbortCache();
+	}
+
 	if (decoder.error.IsDefined()) {
 		/* copy the Error from sruct Decoder to
 		   DecoderControl */
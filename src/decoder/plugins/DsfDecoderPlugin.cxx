@@ -32,6 +32,7 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/bit_reverse.h"
 #include "util/Error.hxx"
 #include "system/ByteOrder.hxx"
@@ -39,6 +40,8 @@
 #include "tag/TagHandler.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <string.h>
 
 static constexpr unsigned DSF_BLOCK_SIZE = 4096;
@@ -191,9 +194,9 @@ bit_reverse_buffer(uint8_t *p, uint8_t *end)
 
 static void
 InterleaveDsfBlockMono(uint8_t *gcc_restrict dest,
-		       const uint8_t *gcc_restrict src)
+		       const uint8_t *gcc_restrict src, size_t n)
 {
-	memcpy(dest, src, DSF_BLOCK_SIZE);
+	memcpy(dest, src, n);
 }
 
 /**
@@ -201,12 +204,15 @@ InterleaveDsfBlockMono(uint8_t *gcc_restrict dest,
  * right. Convert the buffer holding 1 block of 4096 DSD left samples and 1
  * block of 4096 DSD right samples to 8k of samples in normal PCM left/right
  * order.
+ *
+ * The parameter "n" specifies how many frames are converted; this
+ * allows converting only a part of the block.
  */
 static void
 InterleaveDsfBlockStereo(uint8_t *gcc_restrict dest,
-			 const uint8_t *gcc_restrict src)
+			 const uint8_t *gcc_restrict src, size_t n)
 {
-	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i) {
+	for (size_t i = 0; i < n; ++i) {
 		dest[2 * i] = src[i];
 		dest[2 * i + 1] = src[DSF_BLOCK_SIZE + i];
 	}
@@ -215,31 +221,72 @@ InterleaveDsfBlockStereo(uint8_t *gcc_restrict dest,
 static void
 InterleaveDsfBlockChannel(uint8_t *gcc_restrict dest,
 			  const uint8_t *gcc_restrict src,
-			  unsigned channels)
+			  unsigned channels, size_t n)
 {
-	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i, dest += channels, ++src)
+	for (size_t i = 0; i < n; ++i, dest += channels, ++src)
 		*dest = *src;
 }
 
 static void
 InterleaveDsfBlockGeneric(uint8_t *gcc_restrict dest,
 			  const uint8_t *gcc_restrict src,
-			  unsigned channels)
+			  unsigned channels, size_t n)
 {
 	for (unsigned c = 0; c < channels; ++c, ++dest, src += DSF_BLOCK_SIZE)
-		InterleaveDsfBlockChannel(dest, src, channels);
+		InterleaveDsfBlockChannel(dest, src, channels, n);
 }
 
+/**
+ * Interleave "n" frames of a DSF block.  The "src" pointer may point
+ * into the middle of the first channel's block.
+ */
 static void
 InterleaveDsfBlock(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
-		   unsigned channels)
+		   unsigned channels, size_t n)
 {
 	if (channels == 1)
-		InterleaveDsfBlockMono(dest, src);
+		InterleaveDsfBlockMono(dest, src, n);
 	else if (channels == 2)
-		InterleaveDsfBlockStereo(dest, src);
+		InterleaveDsfBlockStereo(dest, src, n);
 	else
-		InterleaveDsfBlockGeneric(dest, src, channels);
+		InterleaveDsfBlockGeneric(dest, src, channels, n);
+}
+
+/**
+ * Submit one DSF block to the decoder API.  If possible, the block
+ * is interleaved directly into the music pipe, which saves a copy.
+ */
+static DecoderCommand
+dsf_submit_block(Decoder &decoder, InputStream &is,
+		 const uint8_t *block, unsigned channels,
+		 uint16_t kbit_rate)
+{
+	DecoderCommand cmd = DecoderCommand::NONE;
+
+	for (size_t frame = 0; frame < DSF_BLOCK_SIZE;) {
+		const size_t remaining = DSF_BLOCK_SIZE - frame;
+		const auto dest = decoder_write_begin(decoder, kbit_rate);
+		if (dest.IsEmpty()) {
+			/* fall back to decoder_data() */
+			uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
+			InterleaveDsfBlock(interleaved_buffer, block + frame,
+					   channels, remaining);
+			return decoder_data(decoder, is, interleaved_buffer,
+					    remaining * channels, kbit_rate);
+		}
+
+		const size_t n = std::min(dest.size / channels, remaining);
+		InterleaveDsfBlock((uint8_t *)dest.data, block + frame,
+				   channels, n);
+
+		cmd = decoder_write_commit(decoder, is, n * channels);
+		if (cmd != DecoderCommand::NONE)
+			break;
+
+		frame += n;
+	}
+
+	return cmd;
 }
 
 static offset_type
@@ -287,12 +334,8 @@ dsf_decode_chunk(Decoder &decoder, InputStream &is,
 		if (bitreverse)
 			bit_reverse_buffer(buffer, buffer + block_size);
 
-		uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
-		InterleaveDsfBlock(interleaved_buffer, buffer, channels);
-
-		cmd = decoder_data(decoder, is,
-				   interleaved_buffer, block_size,
-				   sample_rate / 1000);
+		cmd = dsf_submit_block(decoder, is, buffer, channels,
+				       sample_rate / 1000);
 		++i;
 	}
 
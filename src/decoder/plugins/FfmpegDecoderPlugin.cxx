@@ -30,6 +30,7 @@
 #include "CheckAudioFormat.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "util/WritableBuffer.hxx"
 #include "LogV.hxx"
 
 extern "C" {
@@ -45,6 +46,8 @@ extern "C" {
 #endif
 }
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
@@ -251,10 +254,10 @@ start_time_fallback(const AVStream &stream)
 
 static void
 copy_interleave_frame2(uint8_t *dest, uint8_t **src,
-		       unsigned nframes, unsigned nchannels,
+		       unsigned start, unsigned end, unsigned nchannels,
 		       unsigned sample_size)
 {
-	for (unsigned frame = 0; frame < nframes; ++frame) {
+	for (unsigned frame = start; frame < end; ++frame) {
 		for (unsigned channel = 0; channel < nchannels; ++channel) {
 			memcpy(dest, src[channel] + frame * sample_size,
 			       sample_size);
@@ -263,12 +266,21 @@ copy_interleave_frame2(uint8_t *dest, uint8_t **src,
 	}
 }
 
+gcc_pure
+static bool
+IsPlanarMultiChannel(const AVCodecContext &codec_context)
+{
+	return av_sample_fmt_is_planar(codec_context.sample_fmt) &&
+		codec_context.channels > 1;
+}
+
 /**
- * Copy PCM data from a AVFrame to an interleaved buffer.
+ * Copy PCM data from a AVFrame to an interleaved buffer, starting at
+ * the specified frame.
  */
 static int
 copy_interleave_frame(const AVCodecContext *codec_context,
-		      const AVFrame *frame,
+		      const AVFrame *frame, unsigned start,
 		      uint8_t **output_buffer,
 		      uint8_t **global_buffer, int *global_buffer_size)
 {
@@ -276,13 +288,12 @@ copy_interleave_frame(const AVCodecContext *codec_context,
 	const int data_size =
 		av_samples_get_buffer_size(&plane_size,
 					   codec_context->channels,
-					   frame->nb_samples,
+					   frame->nb_samples - start,
 					   codec_context->sample_fmt, 1);
 	if (data_size <= 0)
 		return data_size;
 
-	if (av_sample_fmt_is_planar(codec_context->sample_fmt) &&
-	    codec_context->channels > 1) {
+	if (IsPlanarMultiChannel(*codec_context)) {
 		if(*global_buffer_size < data_size) {
 			av_freep(global_buffer);
 
@@ -295,16 +306,69 @@ copy_interleave_frame(const AVCodecContext *codec_context,
 		}
 		*output_buffer = *global_buffer;
 		copy_interleave_frame2(*output_buffer, frame->extended_data,
-				       frame->nb_samples,
+				       start, frame->nb_samples,
 				       codec_context->channels,
 				       av_get_bytes_per_sample(codec_context->sample_fmt));
 	} else {
+		/* packed data is never written directly, see
+		   ffmpeg_write_direct() */
+		assert(start == 0);
+
 		*output_buffer = frame->extended_data[0];
 	}
 
 	return data_size;
 }
 
+/**
+ * Interleave planar PCM data from a AVFrame straight into the music
+ * pipe.  Packed data is left alone, because decoder_data() can copy
+ * it from the AVFrame without an intermediate buffer.
+ *
+ * @return the number of frames which were submitted; the remaining
+ * ones must be passed to decoder_data()
+ */
+static unsigned
+ffmpeg_write_direct(Decoder &decoder, InputStream &is,
+		    const AVCodecContext &codec_context,
+		    const AVFrame &frame,
+		    DecoderCommand &cmd)
+{
+	if (!IsPlanarMultiChannel(codec_context))
+		return 0;
+
+	const unsigned channels = codec_context.channels;
+	const unsigned sample_size =
+		av_get_bytes_per_sample(codec_context.sample_fmt);
+	const size_t frame_size = channels * sample_size;
+	const unsigned nframes = frame.nb_samples;
+
+	unsigned position = 0;
+	while (position < nframes) {
+		const auto dest =
+			decoder_write_begin(decoder,
+					    codec_context.bit_rate / 1000);
+		if (dest.IsEmpty())
+			break;
+
+		const unsigned end =
+			std::min<size_t>(nframes,
+					 position + dest.size / frame_size);
+		copy_interleave_frame2((uint8_t *)dest.data,
+				       frame.extended_data,
+				       position, end,
+				       channels, sample_size);
+
+		cmd = decoder_write_commit(decoder, is,
+					   (end - position) * frame_size);
+		position = end;
+		if (cmd != DecoderCommand::NONE)
+			break;
+	}
+
+	return position;
+}
+
 static DecoderCommand
 ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 		   const AVPacket *packet,
@@ -330,12 +394,19 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 						frame, &got_frame,
 						&packet2);
 		if (len >= 0 && got_frame) {
-			audio_size = copy_interleave_frame(codec_context,
-							   frame,
-							   &output_buffer,
-							   buffer, buffer_size);
-			if (audio_size < 0)
-				len = audio_size;
+			const unsigned start =
+				ffmpeg_write_direct(decoder, is,
+						    *codec_context, *frame,
+						    cmd);
+			if (cmd == DecoderCommand::NONE &&
+			    start < unsigned(frame->nb_samples)) {
+				audio_size = copy_interleave_frame(codec_context,
+								   frame, start,
+								   &output_buffer,
+								   buffer, buffer_size);
+				if (audio_size < 0)
+					len = audio_size;
+			}
 		}
 
 		if (len < 0) {
@@ -26,9 +26,12 @@
 #include "FlacMetadata.hxx"
 #include "FlacPcm.hxx"
 #include "CheckAudioFormat.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 flac_data::flac_data(Decoder &_decoder,
 		     InputStream &_input_stream)
 	:FlacInput(_input_stream, &_decoder),
@@ -153,29 +156,55 @@ flac_common_write(struct flac_data *data, const FLAC__Frame * frame,
 		  const FLAC__int32 *const buf[],
 		  FLAC__uint64 nbytes)
 {
-	void *buffer;
 	unsigned bit_rate;
 
 	if (!data->initialized && !flac_got_first_frame(data, &frame->header))
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
-	size_t buffer_size = frame->header.blocksize * data->frame_size;
-	buffer = data->buffer.Get(buffer_size);
-
-	flac_convert(buffer, frame->header.channels,
-		     data->audio_format.format, buf,
-		     0, frame->header.blocksize);
-
 	if (nbytes > 0)
 		bit_rate = nbytes * 8 * frame->header.sample_rate /
 			(1000 * frame->header.blocksize);
 	else
 		bit_rate = 0;
 
-	auto cmd = decoder_data(data->decoder, data->input_stream,
-				buffer, buffer_size,
-				bit_rate);
-	data->next_frame += frame->header.blocksize;
+	const unsigned blocksize = frame->header.blocksize;
+	const unsigned channels = frame->header.channels;
+	const SampleFormat format = data->audio_format.format;
+
+	DecoderCommand cmd = DecoderCommand::NONE;
+	for (unsigned position = 0; position < blocksize;) {
+		/* try to decode straight into the music pipe */
+		const auto dest = decoder_write_begin(data->decoder, bit_rate);
+		if (dest.IsEmpty()) {
+			/* fall back to decoder_data() */
+			const size_t buffer_size =
+				(blocksize - position) * data->frame_size;
+			void *buffer = data->buffer.Get(buffer_size);
+
+			flac_convert(buffer, channels, format, buf,
+				     position, blocksize);
+
+			cmd = decoder_data(data->decoder, data->input_stream,
+					   buffer, buffer_size,
+					   bit_rate);
+			break;
+		}
+
+		const unsigned end =
+			std::min<size_t>(blocksize,
+					 position + dest.size / data->frame_size);
+		flac_convert(dest.data, channels, format, buf,
+			     position, end);
+
+		cmd = decoder_write_commit(data->decoder, data->input_stream,
+					   (end - position) * data->frame_size);
+		if (cmd != DecoderCommand::NONE)
+			break;
+
+		position = end;
+	}
+
+	data->next_frame += blocksize;
 	switch (cmd) {
 	case DecoderCommand::NONE:
 	case DecoderCommand::START:
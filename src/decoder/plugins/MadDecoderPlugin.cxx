@@ -30,6 +30,7 @@
 #include "util/ASCII.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "util/WritableBuffer.hxx"
 #include "Log.hxx"
 
 #include <mad.h>
@@ -38,6 +39,8 @@
 #include <id3tag.h>
 #endif
 
+#include <algorithm>
+
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -171,7 +174,8 @@ struct MadDecoder {
 	void UpdateTimerNextFrame();
 
 	/**
-	 * Sends the synthesized current frame via decoder_data().
+	 * Sends the synthesized current frame via
+	 * decoder_write_begin() or decoder_data().
 	 */
 	DecoderCommand SendPCM(unsigned i, unsigned pcm_length);
 
@@ -901,25 +905,41 @@ MadDecoder::UpdateTimerNextFrame()
 DecoderCommand
 MadDecoder::SendPCM(unsigned i, unsigned pcm_length)
 {
-	unsigned max_samples = sizeof(output_buffer) /
-		sizeof(output_buffer[0]) /
-		MAD_NCHANNELS(&frame.header);
+	const unsigned channels = MAD_NCHANNELS(&frame.header);
+	const size_t frame_size = sizeof(output_buffer[0]) * channels;
+	const unsigned max_samples = sizeof(output_buffer) / frame_size;
 
 	while (i < pcm_length) {
 		unsigned int num_samples = pcm_length - i;
-		if (num_samples > max_samples)
-			num_samples = max_samples;
-
-		i += num_samples;
 
-		mad_fixed_to_24_buffer(output_buffer, &synth,
-				       i - num_samples, i,
-				       MAD_NCHANNELS(&frame.header));
-		num_samples *= MAD_NCHANNELS(&frame.header);
+		/* try to synthesize straight into the music pipe */
+		const auto dest = decoder_write_begin(*decoder,
+						      bit_rate / 1000);
+		DecoderCommand cmd;
+		if (!dest.IsEmpty()) {
+			num_samples = std::min<size_t>(num_samples,
+						       dest.size / frame_size);
+
+			mad_fixed_to_24_buffer((int32_t *)dest.data, &synth,
+					       i, i + num_samples, channels);
+			i += num_samples;
+
+			cmd = decoder_write_commit(*decoder, input_stream,
+						   num_samples * frame_size);
+		} else {
+			if (num_samples > max_samples)
+				num_samples = max_samples;
+
+			mad_fixed_to_24_buffer(output_buffer, &synth,
+					       i, i + num_samples, channels);
+			i += num_samples;
+
+			cmd = decoder_data(*decoder, input_stream,
+					   output_buffer,
+					   num_samples * frame_size,
+					   bit_rate / 1000);
+		}
 
-		auto cmd = decoder_data(*decoder, input_stream, output_buffer,
-					sizeof(output_buffer[0]) * num_samples,
-					bit_rate / 1000);
 		if (cmd != DecoderCommand::NONE)
 			return cmd;
 	}
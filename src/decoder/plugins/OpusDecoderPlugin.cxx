@@ -30,6 +30,7 @@
 #include "tag/TagBuilder.hxx"
 #include "input/InputStream.hxx"
 #include "util/Error.hxx"
+#include "util/WritableBuffer.hxx"
 #include "Log.hxx"
 
 #include <opus.h>
@@ -301,10 +302,21 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 {
 	assert(opus_decoder != nullptr);
 
+	/* decode straight into the music pipe if the whole packet
+	   fits into the current chunk */
+	const auto dest = decoder_write_begin(decoder, 0);
+	const int packet_frames =
+		opus_decoder_get_nb_samples(opus_decoder,
+					    (const unsigned char*)packet.packet,
+					    packet.bytes);
+	const bool direct = !dest.IsEmpty() && packet_frames > 0 &&
+		size_t(packet_frames) * frame_size <= dest.size;
+
 	int nframes = opus_decode(opus_decoder,
 				  (const unsigned char*)packet.packet,
 				  packet.bytes,
-				  output_buffer, output_size,
+				  direct ? (opus_int16 *)dest.data : output_buffer,
+				  direct ? dest.size / frame_size : output_size,
 				  0);
 	if (nframes < 0) {
 		LogError(opus_domain, opus_strerror(nframes));
@@ -313,9 +325,11 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 
 	if (nframes > 0) {
 		const size_t nbytes = nframes * frame_size;
-		auto cmd = decoder_data(decoder, input_stream,
-					output_buffer, nbytes,
-					0);
+		auto cmd = direct
+			? decoder_write_commit(decoder, input_stream, nbytes)
+			: decoder_data(decoder, input_stream,
+				       output_buffer, nbytes,
+				       0);
 		if (cmd != DecoderCommand::NONE)
 			return cmd;
 
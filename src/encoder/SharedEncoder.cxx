@@ -0,0 +1,726 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SharedEncoder.hxx"
+#include "EncoderAPI.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "AudioFormat.hxx"
+#include "tag/Tag.hxx"
+#include "util/Domain.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <deque>
+#include <forward_list>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr Domain shared_encoder_domain("shared_encoder");
+
+/**
+ * Discard encoded data when it exceeds this size, even if some
+ * output has not read it yet.  This happens if an output doesn't
+ * need the data (e.g. a httpd output without clients).
+ */
+static constexpr size_t MAX_BUFFERED = 1024 * 1024;
+
+/**
+ * If an output doesn't receive a tag which the leader has received,
+ * it stops waiting for it after this amount of encoded data.
+ */
+static constexpr size_t MAX_TAG_SKEW = 64 * 1024;
+
+struct SharedEncoder;
+
+/**
+ * The real encoder and the encoded data which has not yet been read
+ * by all of its #SharedEncoder instances.
+ */
+struct SharedEncoderCore {
+	/**
+	 * The encoder configuration; see MakeKey().
+	 */
+	const std::string key;
+
+	/**
+	 * The name of the first output, for log messages.
+	 */
+	const std::string name;
+
+	Encoder *const encoder;
+
+	/**
+	 * The number of #SharedEncoder instances.
+	 */
+	unsigned n_instances;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when #in_tag is cleared.
+	 */
+	Cond cond;
+
+	/**
+	 * The instances which have opened the encoder.  The first
+	 * one is the leader.
+	 */
+	std::list<SharedEncoder *> open;
+
+	/**
+	 * The audio format which was negotiated by the first
+	 * instance.
+	 */
+	AudioFormat audio_format;
+
+	/**
+	 * Encoded data which has not been read by all instances.
+	 */
+	std::string buffer;
+
+	/**
+	 * The stream position of the first byte in #buffer.
+	 */
+	uint64_t buffer_position;
+
+	/**
+	 * The current stream header, i.e. the data generated by
+	 * opening the encoder or by the most recent tag.  It is sent
+	 * first to instances which join later.
+	 */
+	std::string header;
+
+	/**
+	 * A header generated by a tag inside #buffer.
+	 */
+	struct TagHeader {
+		unsigned n;
+
+		uint64_t start, end;
+	};
+
+	std::deque<TagHeader> tag_headers;
+
+	/**
+	 * The number of tags sent to the encoder.
+	 */
+	unsigned n_tags;
+
+	/**
+	 * True between encoder_pre_tag() and encoder_tag().
+	 */
+	bool in_tag;
+
+	/**
+	 * The instance which has called encoder_pre_tag() (only valid
+	 * if #in_tag is set).
+	 */
+	SharedEncoder *tagger;
+
+	/**
+	 * Has encoder_end() been called?
+	 */
+	bool ended;
+
+	SharedEncoderCore(std::string &&_key, const char *_name,
+			  Encoder *_encoder)
+		:key(std::move(_key)), name(_name), encoder(_encoder),
+		 n_instances(0) {}
+
+	~SharedEncoderCore() {
+		encoder_finish(encoder);
+	}
+
+	uint64_t GetEnd() const {
+		return buffer_position + buffer.size();
+	}
+
+	/**
+	 * Move all available data from the real encoder to #buffer.
+	 */
+	void Drain() {
+		char data[16384];
+		size_t nbytes;
+		while ((nbytes = encoder_read(encoder, data,
+					      sizeof(data))) > 0)
+			buffer.append(data, nbytes);
+	}
+
+	gcc_pure
+	const TagHeader *FindTagHeader(unsigned n) const {
+		for (const auto &h : tag_headers)
+			if (h.n == n)
+				return &h;
+		return nullptr;
+	}
+
+	bool SendTag(const Tag *tag, Error &error);
+
+	/**
+	 * Discard data which was read by all instances.
+	 */
+	void Trim();
+};
+
+struct SharedEncoder final {
+	Encoder encoder;
+
+	SharedEncoderCore &core;
+
+	/**
+	 * The stream position of the next byte to be read.
+	 */
+	uint64_t position;
+
+	/**
+	 * The number of tags received by this instance.
+	 */
+	unsigned n_tags;
+
+	/**
+	 * The stream header which is being sent to this instance
+	 * after it has joined.
+	 */
+	std::string header;
+	size_t header_position;
+
+	/**
+	 * If not UINT64_MAX, then encoder_read() stops at this stream
+	 * position (the end of a header) and returns 0 once, just
+	 * like the real encoder does after encoder_tag().
+	 */
+	uint64_t stop;
+
+	/**
+	 * Return 0 from the next encoder_read() call, to separate the
+	 * header from the following data.
+	 */
+	bool boundary;
+
+	SharedEncoder(const EncoderPlugin &plugin, SharedEncoderCore &_core)
+		:encoder(plugin), core(_core) {}
+
+	bool IsLeader() const {
+		return !core.open.empty() && core.open.front() == this;
+	}
+
+	size_t Read(void *dest, size_t length);
+};
+
+static std::forward_list<SharedEncoderCore *> shared_encoder_cores;
+
+extern const EncoderPlugin shared_encoder_plugin;
+extern const EncoderPlugin shared_tag_encoder_plugin;
+
+bool
+SharedEncoderCore::SendTag(const Tag *tag, Error &error)
+{
+	if (!in_tag) {
+		if (!encoder_pre_tag(encoder, error))
+			return false;
+
+		Drain();
+	}
+
+	in_tag = false;
+	cond.broadcast();
+
+	const uint64_t start = GetEnd();
+	if (!encoder_tag(encoder, tag, error))
+		return false;
+
+	Drain();
+
+	tagger = nullptr;
+	tag_headers.push_back({++n_tags, start, GetEnd()});
+	header.assign(buffer, start - buffer_position, std::string::npos);
+	return true;
+}
+
+void
+SharedEncoderCore::Trim()
+{
+	uint64_t min = GetEnd();
+	for (const auto *e : open)
+		min = std::min(min, e->position);
+
+	if (GetEnd() - min > MAX_BUFFERED)
+		/* drop data which some slow instance has not read
+		   yet */
+		min = GetEnd() - MAX_BUFFERED;
+
+	/* avoid moving the buffer contents for small amounts */
+	if (min - buffer_position < 16384 && min < GetEnd())
+		return;
+
+	buffer.erase(0, min - buffer_position);
+	buffer_position = min;
+
+	while (!tag_headers.empty() &&
+	       tag_headers.front().end <= buffer_position)
+		tag_headers.pop_front();
+}
+
+/**
+ * Build a string from all settings which affect the encoded stream.
+ */
+static std::string
+MakeKey(const EncoderPlugin &plugin, const config_param &param,
+	const char *const*ignore)
+{
+	static constexpr const char *generic_ignore[] = {
+		"name", "type", "enabled", "always_on", nullptr,
+	};
+
+	std::vector<const block_param *> params;
+	for (const auto &bp : param.block_params) {
+		bool ignored = false;
+		for (const char *const*i = generic_ignore; *i != nullptr; ++i)
+			if (bp.name == *i)
+				ignored = true;
+		for (const char *const*i = ignore; *i != nullptr; ++i)
+			if (bp.name == *i)
+				ignored = true;
+
+		if (!ignored)
+			params.push_back(&bp);
+	}
+
+	std::sort(params.begin(), params.end(),
+		  [](const block_param *a, const block_param *b){
+			  return a->name < b->name;
+		  });
+
+	std::string key(plugin.name);
+	for (const auto *bp : params) {
+		key.push_back('\n');
+		key.append(bp->name);
+		key.push_back('=');
+		key.append(bp->value);
+	}
+
+	return key;
+}
+
+gcc_pure
+static bool
+HasSoftwareMixer(const config_param &param)
+{
+	const char *mixer_type = param.GetBlockValue("mixer_type");
+	if (mixer_type == nullptr)
+		mixer_type = config_get_string(CONF_MIXER_TYPE, nullptr);
+
+	return mixer_type != nullptr && strcmp(mixer_type, "software") == 0;
+}
+
+Encoder *
+shared_encoder_init(const EncoderPlugin &plugin, const config_param &param,
+		    const char *const*ignore, Error &error)
+{
+	if (HasSoftwareMixer(param))
+		return encoder_init(plugin, param, error);
+
+	std::string key = MakeKey(plugin, param, ignore);
+	const char *name = param.GetBlockValue("name", "");
+
+	SharedEncoderCore *core = nullptr;
+	for (auto *i : shared_encoder_cores) {
+		if (i->key == key) {
+			core = i;
+			FormatInfo(shared_encoder_domain,
+				   "output \"%s\" shares the encoder of \"%s\"",
+				   name, core->name.c_str());
+			break;
+		}
+	}
+
+	if (core == nullptr) {
+		Encoder *encoder = encoder_init(plugin, param, error);
+		if (encoder == nullptr)
+			return nullptr;
+
+		core = new SharedEncoderCore(std::move(key), name, encoder);
+		shared_encoder_cores.push_front(core);
+	}
+
+	++core->n_instances;
+
+	SharedEncoder *e =
+		new SharedEncoder(plugin.tag != nullptr
+				  ? shared_tag_encoder_plugin
+				  : shared_encoder_plugin,
+				  *core);
+	return &e->encoder;
+}
+
+bool
+shared_encoder_has_peers(const Encoder *_encoder)
+{
+	if (&_encoder->plugin != &shared_encoder_plugin &&
+	    &_encoder->plugin != &shared_tag_encoder_plugin)
+		return false;
+
+	const SharedEncoder *e = (const SharedEncoder *)_encoder;
+	SharedEncoderCore &core = e->core;
+
+	const ScopeLock protect(core.mutex);
+	return core.open.size() > 1;
+}
+
+static void
+shared_encoder_finish(Encoder *_encoder)
+{
+	SharedEncoder *e = (SharedEncoder *)_encoder;
+	SharedEncoderCore &core = e->core;
+	delete e;
+
+	assert(core.n_instances > 0);
+	if (--core.n_instances == 0) {
+		shared_encoder_cores.remove(&core);
+		delete &core;
+	}
+}
+
+static bool
+shared_encoder_open(Encoder *_encoder, AudioFormat &audio_format,
+		    Error &error)
+{
+	SharedEncoder *e = (SharedEncoder *)_encoder;
+	SharedEncoderCore &core = e->core;
+
+	const ScopeLock protect(core.mutex);
+
+	if (core.open.empty()) {
+		if (!encoder_open(core.encoder, audio_format, error))
+			return false;
+
+		core.audio_format = audio_format;
+		core.buffer.clear();
+		core.buffer_position = 0;
+		core.tag_headers.clear();
+		core.n_tags = 0;
+		core.in_tag = false;
+		core.ended = false;
+
+		core.Drain();
+		core.header = core.buffer;
+
+		/* the leader reads the header from the buffer */
+		e->header.clear();
+		e->position = 0;
+	} else {
+		/* join the running stream; the encoder ignores our
+		   PCM data while another output is the leader, but
+		   it has to be in the same format in case we become
+		   the leader */
+		audio_format = core.audio_format;
+
+		e->header = core.header;
+		e->position = core.GetEnd();
+	}
+
+	e->header_position = 0;
+	e->n_tags = core.n_tags;
+	e->stop = e->position < core.GetEnd()
+		? core.GetEnd()
+		: UINT64_MAX;
+	e->boundary = false;
+
+	core.open.push_back(e);
+	return true;
+}
+
+static void
+shared_encoder_close(Encoder *_encoder)
+{
+	SharedEncoder *e = (SharedEncoder *)_encoder;
+	SharedEncoderCore &core = e->core;
+
+	const ScopeLock protect(core.mutex);
+
+	core.open.remove(e);
+
+	if (core.open.empty()) {
+		encoder_close(core.encoder);
+		core.buffer.clear();
+		core.header.clear();
+		core.tag_headers.clear();
+	} else {
+		if (core.in_tag && core.tagger == e) {
+			/* complete the encoder_pre_tag() call, or
+			   else the leader would wait forever; the
+			   other outputs will adopt this empty tag */
+			const Tag empty;
+			core.SendTag(&empty, IgnoreError());
+		}
+
+		core.Trim();
+	}
+}
+
+static bool
+shared_encoder_end(Encoder *_encoder, Error &error)
+{
+	SharedEncoder *e = (SharedEncoder *)_encoder;
+	SharedEncoderCore &core = e->core;
+
+	const ScopeLock protect(core.mutex);
+
+	if (core.open.size() > 1 || core.in_tag || core.ended)
+		/* the stream goes on for the other outputs */
+		return true;
+
+	if (!encoder_end(core.encoder, error))
+		return false;
+
+	core.ended = true;
+	core.Drain();
+	return true;
+}
+
+static bool
+shared_encoder_flush(Encoder *_encoder, Error &error)
+{
+	SharedEncoder *e = (SharedEncoder *)_encoder;
+	SharedEncoderCore &core = e->core;
+
+	const ScopeLock protect(core.mutex);
+
+	if (!e->IsLeader() || core.in_tag || core.ended)
+		return true;
+
+	if (!encoder_flush(core.encoder, error))
+		return false;
+
+	core.Drain();
+	return true;
+}
+
+static bool
+shared_encoder_pre_tag(Encoder *_encoder, Error &error)
+{
+	SharedEncoder *e = (SharedEncoder *)_encoder;
+	SharedEncoderCore &core = e->core;
+
+	const ScopeLock protect(core.mutex);
+
+	if (core.in_tag || core.ended ||
+	    core.FindTagHeader(e->n_tags + 1) != nullptr)
+		/* another output has already done it */
+		return true;
+
+	if (!encoder_pre_tag(core.encoder, error))
+		return false;
+
+	core.Drain();
+	core.in_tag = true;
+	core.tagger = e;
+	return true;
+}
+
+static bool
+shared_encoder_tag(Encoder *_encoder, const Tag *tag, Error &error)
+{
+	SharedEncoder *e = (SharedEncoder *)_encoder;
+	SharedEncoderCore &core = e->core;
+
+	const ScopeLock protect(core.mutex);
+
+	if (core.ended)
+		return true;
+
+	const auto *h = core.FindTagHeader(e->n_tags + 1);
+	if (h == nullptr) {
+		/* we're the first output to receive this tag */
+		if (!core.SendTag(tag, error))
+			return false;
+
+		h = &core.tag_headers.back();
+	}
+
+	/* the next encoder_read() calls return the new header; if
+	   this output still lags behind, it skips the rest of the old
+	   stream */
+	e->n_tags = h->n;
+	if (e->position < h->start)
+		e->position = h->start;
+	if (e->position < h->end)
+		e->stop = h->end;
+
+	return true;
+}
+
+static bool
+shared_encoder_write(Encoder *_encoder, const void *data, size_t length,
+		     Error &error)
+{
+	SharedEncoder *e = (SharedEncoder *)_encoder;
+	SharedEncoderCore &core = e->core;
+
+	const ScopeLock protect(core.mutex);
+
+	if (!e->IsLeader())
+		/* the leader encodes the same data */
+		return true;
+
+	/* wait until the other output which has begun sending a tag
+	   is finished */
+	while (core.in_tag && core.tagger != e && e->IsLeader())
+		core.cond.wait(core.mutex);
+
+	if (core.ended)
+		return true;
+
+	if (!encoder_write(core.encoder, data, length, error))
+		return false;
+
+	core.Drain();
+	return true;
+}
+
+inline size_t
+SharedEncoder::Read(void *dest, size_t length)
+{
+	if (header_position < header.length()) {
+		/* send the stream header first */
+		size_t nbytes = std::min(length,
+					 header.length() - header_position);
+		memcpy(dest, header.data() + header_position, nbytes);
+		header_position += nbytes;
+
+		if (header_position == header.length()) {
+			header.clear();
+			header_position = 0;
+			boundary = true;
+		}
+
+		return nbytes;
+	}
+
+	if (boundary) {
+		boundary = false;
+		return 0;
+	}
+
+	if (position < core.buffer_position) {
+		/* too slow, some data has been discarded */
+		position = core.buffer_position;
+		if (position >= stop)
+			stop = UINT64_MAX;
+	}
+
+	uint64_t limit = std::min(core.GetEnd(), stop);
+
+	/* don't read past a header generated by a tag which this
+	   output hasn't received yet */
+	for (const auto &h : core.tag_headers) {
+		if (h.n <= n_tags)
+			continue;
+
+		if (h.end <= position ||
+		    core.GetEnd() - h.start > MAX_TAG_SKEW) {
+			/* we have missed this tag; don't wait for
+			   it */
+			n_tags = h.n;
+			continue;
+		}
+
+		limit = std::min(limit, h.start);
+		break;
+	}
+
+	if (position >= limit)
+		return 0;
+
+	size_t nbytes = std::min(uint64_t(length), limit - position);
+	memcpy(dest, core.buffer.data() + (position - core.buffer_position),
+	       nbytes);
+	position += nbytes;
+
+	if (position == stop) {
+		stop = UINT64_MAX;
+		boundary = true;
+	}
+
+	core.Trim();
+	return nbytes;
+}
+
+static size_t
+shared_encoder_read(Encoder *_encoder, void *dest, size_t length)
+{
+	SharedEncoder *e = (SharedEncoder *)_encoder;
+	SharedEncoderCore &core = e->core;
+
+	const ScopeLock protect(core.mutex);
+	return e->Read(dest, length);
+}
+
+static const char *
+shared_encoder_get_mime_type(Encoder *_encoder)
+{
+	SharedEncoder *e = (SharedEncoder *)_encoder;
+
+	return encoder_get_mime_type(e->core.encoder);
+}
+
+const EncoderPlugin shared_encoder_plugin = {
+	"shared",
+	nullptr,
+	shared_encoder_finish,
+	shared_encoder_open,
+	shared_encoder_close,
+	shared_encoder_end,
+	shared_encoder_flush,
+	shared_encoder_pre_tag,
+	nullptr,
+	shared_encoder_write,
+	shared_encoder_read,
+	shared_encoder_get_mime_type,
+};
+
+/**
+ * The same as #shared_encoder_plugin, for encoders which support
+ * tags.
+ */
+const EncoderPlugin shared_tag_encoder_plugin = {
+	"shared",
+	nullptr,
+	shared_encoder_finish,
+	shared_encoder_open,
+	shared_encoder_close,
+	shared_encoder_end,
+	shared_encoder_flush,
+	shared_encoder_pre_tag,
+	shared_encoder_tag,
+	shared_encoder_write,
+	shared_encoder_read,
+	shared_encoder_get_mime_type,
+};
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SHARED_ENCODER_HXX
+#define MPD_SHARED_ENCODER_HXX
+
+#include "Compiler.h"
+
+struct Encoder;
+struct EncoderPlugin;
+struct config_param;
+class Error;
+
+/**
+ * Creates a new encoder object, like encoder_init().  All outputs
+ * whose encoder configuration is equal share one instance of the
+ * real encoder: the PCM data is encoded only once, by the first open
+ * output (the "leader"), and all others read the same encoded stream.
+ *
+ * The configuration is compared by all block settings except the
+ * ones listed in #ignore and a few generic ones ("name", "type",
+ * "enabled", "always_on").  Outputs with a software mixer are never
+ * shared, because each of them has its own volume.
+ *
+ * @param ignore a nullptr terminated list of block settings which
+ * do not affect the encoded stream, e.g. the port or the mount point
+ */
+Encoder *
+shared_encoder_init(const EncoderPlugin &plugin, const config_param &param,
+		    const char *const*ignore, Error &error);
+
+/**
+ * Is this encoder (returned by shared_encoder_init()) currently
+ * opened by at least one other output?  Such an output should feed
+ * PCM data into the encoder even if it doesn't need the encoded data
+ * itself, because the others rely on it.
+ */
+gcc_pure
+bool
+shared_encoder_has_peers(const Encoder *encoder);
+
+#endif
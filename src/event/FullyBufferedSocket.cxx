@@ -113,6 +113,9 @@ FullyBufferedSocket::OnSocketReady(unsigned flags)
 
 		if (!Flush())
 			return false;
+
+		if (output.IsEmpty() && !OnSocketFlushed())
+			return false;
 	}
 
 	if (!BufferedSocket::OnSocketReady(flags))
@@ -124,6 +127,11 @@ FullyBufferedSocket::OnSocketReady(unsigned flags)
 void
 FullyBufferedSocket::OnIdle()
 {
-	if (Flush() && !output.IsEmpty())
+	if (!Flush())
+		return;
+
+	if (!output.IsEmpty())
 		ScheduleWrite();
+	else
+		OnSocketFlushed();
 }
@@ -61,6 +61,25 @@ protected:
 	 */
 	bool Write(const void *data, size_t length);
 
+	/**
+	 * Has the output buffer overflowed into its "peak" area?  The
+	 * producer of a large response should pause then, until
+	 * OnSocketFlushed() gets called.
+	 */
+	gcc_pure
+	bool IsOutputFull() const {
+		return output.IsPeak();
+	}
+
+	/**
+	 * The output buffer has been sent to the socket completely.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	virtual bool OnSocketFlushed() {
+		return true;
+	}
+
 	virtual bool OnSocketReady(unsigned flags) override;
 	virtual void OnIdle() override;
 };
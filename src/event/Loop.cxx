@@ -178,10 +178,17 @@ EventLoop::Run()
 		   overhead */
 		mutex.lock();
 		HandleDeferred();
+		if (quit) {
+			/* a DeferredMonitor has called Break() */
+			mutex.unlock();
+			break;
+		}
+
 		busy = false;
+		const bool _again = again;
 		mutex.unlock();
 
-		if (again)
+		if (_again)
 			/* re-evaluate timers because one of the
 			   IdleMonitors may have added a new
 			   timeout */
@@ -21,14 +21,18 @@
 #include "SocketMonitor.hxx"
 #include "Loop.hxx"
 #include "system/fd_util.h"
+#include "util/ConstBuffer.hxx"
+#include "util/Macros.hxx"
 #include "Compiler.h"
 
 #include <assert.h>
+#include <string.h>
 
 #ifdef WIN32
 #include <winsock2.h>
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 void
@@ -130,3 +134,38 @@ SocketMonitor::Write(const void *data, size_t length)
 
 	return send(Get(), (const char *)data, length, flags);
 }
+
+ssize_t
+SocketMonitor::WriteV(const ConstBuffer<void> *buffers, size_t n)
+{
+	assert(IsDefined());
+	assert(n > 0);
+
+#ifdef WIN32
+	return Write(buffers[0].data, buffers[0].size);
+#else
+	struct iovec iov[64];
+	if (n > ARRAY_SIZE(iov))
+		n = ARRAY_SIZE(iov);
+
+	for (size_t i = 0; i < n; ++i) {
+		iov[i].iov_base = const_cast<void *>(buffers[i].data);
+		iov[i].iov_len = buffers[i].size;
+	}
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = n;
+
+	int flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_DONTWAIT
+	flags |= MSG_DONTWAIT;
+#endif
+
+	return sendmsg(Get(), &msg, flags);
+#endif
+}
@@ -37,6 +37,7 @@
 #endif
 
 class EventLoop;
+template<typename T> struct ConstBuffer;
 
 /**
  * Monitor events on a socket.  Call Schedule() to announce events
@@ -136,6 +137,14 @@ public:
 	ssize_t Read(void *data, size_t length);
 	ssize_t Write(const void *data, size_t length);
 
+	/**
+	 * Send several buffers with one system call (gathering
+	 * write).  Like Write(), this may send less than the total
+	 * size.  On systems without sendmsg(), only the first buffer
+	 * is sent.
+	 */
+	ssize_t WriteV(const ConstBuffer<void> *buffers, size_t n);
+
 protected:
 	/**
 	 * @return false if the socket has been closed
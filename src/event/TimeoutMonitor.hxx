@@ -48,7 +48,7 @@ public:
 		Cancel();
 	}
 
-	EventLoop &GetEventLoop() {
+	EventLoop &GetEventLoop() const {
 		return loop;
 	}
 
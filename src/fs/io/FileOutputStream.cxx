@@ -25,10 +25,14 @@
 
 #ifdef WIN32
 
-FileOutputStream::FileOutputStream(Path _path, Error &error)
-	:path(_path),
-	 handle(CreateFile(path.c_str(), GENERIC_WRITE, 0, nullptr,
-			   TRUNCATE_EXISTING,
+FileOutputStream::FileOutputStream(Path _path, Error &error, Mode _mode)
+	:path(_path), mode(_mode),
+	 handle(CreateFile(path.c_str(),
+			   mode == Mode::APPEND
+			   ? FILE_APPEND_DATA : GENERIC_WRITE,
+			   0, nullptr,
+			   mode == Mode::APPEND
+			   ? OPEN_ALWAYS : TRUNCATE_EXISTING,
 			   FILE_ATTRIBUTE_NORMAL|FILE_FLAG_WRITE_THROUGH,
 			   nullptr))
 {
@@ -71,7 +75,9 @@ FileOutputStream::Cancel()
 	assert(IsDefined());
 
 	CloseHandle(handle);
-	RemoveFile(path);
+
+	if (mode == Mode::CREATE)
+		RemoveFile(path);
 }
 
 #else
@@ -80,10 +86,12 @@ FileOutputStream::Cancel()
 #include <unistd.h>
 #include <errno.h>
 
-FileOutputStream::FileOutputStream(Path _path, Error &error)
-	:path(_path),
+FileOutputStream::FileOutputStream(Path _path, Error &error, Mode _mode)
+	:path(_path), mode(_mode),
 	 fd(open_cloexec(path.c_str(),
-			 O_WRONLY|O_CREAT|O_TRUNC,
+			 mode == Mode::APPEND
+			 ? O_WRONLY|O_CREAT|O_APPEND
+			 : O_WRONLY|O_CREAT|O_TRUNC,
 			 0666))
 {
 	if (fd < 0)
@@ -129,7 +137,8 @@ FileOutputStream::Cancel()
 	close(fd);
 	fd = -1;
 
-	RemoveFile(path);
+	if (mode == Mode::CREATE)
+		RemoveFile(path);
 }
 
 #endif
@@ -26,6 +26,7 @@
 #include "Compiler.h"
 
 #include <assert.h>
+#include <stdint.h>
 
 #ifdef WIN32
 #include <windows.h>
@@ -34,8 +35,25 @@
 class Path;
 
 class FileOutputStream final : public OutputStream {
+public:
+	enum class Mode : uint8_t {
+		/**
+		 * Create a new file, or truncate an existing one.
+		 */
+		CREATE,
+
+		/**
+		 * Append to an existing file, or create a new one.
+		 * Cancel() does not delete the file in this mode.
+		 */
+		APPEND,
+	};
+
+private:
 	AllocatedPath path;
 
+	const Mode mode;
+
 #ifdef WIN32
 	HANDLE handle;
 #else
@@ -43,7 +61,7 @@ class FileOutputStream final : public OutputStream {
 #endif
 
 public:
-	FileOutputStream(Path _path, Error &error);
+	FileOutputStream(Path _path, Error &error, Mode _mode=Mode::CREATE);
 
 	~FileOutputStream() {
 		if (IsDefined())
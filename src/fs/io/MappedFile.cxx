@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MappedFile.hxx"
+#include "FileReader.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <stdint.h>
+
+#ifndef WIN32
+#include "system/fd_util.h"
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static constexpr Domain mapped_file_domain("mapped_file");
+
+#ifdef WIN32
+
+MappedFile::MappedFile(Path path, Error &error)
+	:data(nullptr), size(0)
+{
+	struct stat st;
+	if (!StatFile(path, st)) {
+		error.FormatErrno("Failed to stat %s", path.c_str());
+		return;
+	}
+
+	FileReader reader(path, error);
+	if (!reader.IsDefined())
+		return;
+
+	uint8_t *buffer = new uint8_t[st.st_size];
+	size_t position = 0;
+	while (position < size_t(st.st_size)) {
+		size_t nbytes = reader.Read(buffer + position,
+					    st.st_size - position, error);
+		if (nbytes == 0) {
+			if (!error.IsDefined())
+				error.Format(mapped_file_domain,
+					     "Unexpected end of file %s",
+					     path.c_str());
+			delete[] buffer;
+			return;
+		}
+
+		position += nbytes;
+	}
+
+	data = buffer;
+	size = position;
+}
+
+MappedFile::~MappedFile()
+{
+	delete[] (uint8_t *)data;
+}
+
+#else
+
+MappedFile::MappedFile(Path path, Error &error)
+	:data(nullptr), size(0)
+{
+	int fd = open_cloexec(path.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		error.FormatErrno("Failed to open %s", path.c_str());
+		return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		error.FormatErrno("Failed to stat %s", path.c_str());
+		close(fd);
+		return;
+	}
+
+	if (st.st_size == 0) {
+		error.Format(mapped_file_domain, "File %s is empty",
+			     path.c_str());
+		close(fd);
+		return;
+	}
+
+	void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		error.FormatErrno("Failed to map %s", path.c_str());
+		return;
+	}
+
+#ifdef POSIX_MADV_SEQUENTIAL
+	posix_madvise(p, st.st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+
+	data = p;
+	size = st.st_size;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr)
+		munmap(data, size);
+}
+
+#endif
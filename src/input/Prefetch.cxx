@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Prefetch.hxx"
+#include "InputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Name.hxx"
+#include "system/FatalError.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+static constexpr Domain input_prefetch_domain("input_prefetch");
+
+InputPrefetch::InputPrefetch(Mutex &_mutex, Cond &_cond)
+	:mutex(_mutex), cond(_cond),
+	 opening_cancelled(false), quit(false) {}
+
+InputPrefetch::~InputPrefetch()
+{
+	if (thread.IsDefined()) {
+		mutex.lock();
+		quit = true;
+		thread_cond.signal();
+		mutex.unlock();
+
+		thread.Join();
+	}
+
+	assert(opening.empty());
+
+	for (auto &i : ready)
+		delete i.second;
+
+	for (auto is : garbage)
+		delete is;
+}
+
+void
+InputPrefetch::Set(std::vector<std::string> &&uris)
+{
+	const auto is_wanted = [&uris](const std::string &uri){
+		return std::find(uris.begin(), uris.end(), uri) != uris.end();
+	};
+
+	for (auto i = ready.begin(); i != ready.end();) {
+		if (is_wanted(i->first)) {
+			++i;
+		} else {
+			garbage.push_back(i->second);
+			i = ready.erase(i);
+		}
+	}
+
+	if (!opening.empty() && !is_wanted(opening))
+		opening_cancelled = true;
+
+	pending.clear();
+	for (auto &uri : uris) {
+		if (uri == opening && !opening_cancelled)
+			continue;
+
+		if (std::any_of(ready.begin(), ready.end(),
+				[&uri](const std::pair<std::string,
+					InputStream *> &i){
+					return i.first == uri;
+				}))
+			continue;
+
+		pending.emplace_back(std::move(uri));
+	}
+
+	if (pending.empty() && garbage.empty())
+		return;
+
+	if (!thread.IsDefined()) {
+		Error error;
+		if (!thread.Start(Run, this, error))
+			FatalError(error);
+	}
+
+	thread_cond.signal();
+}
+
+InputStream *
+InputPrefetch::Take(const char *uri)
+{
+	for (auto i = ready.begin(); i != ready.end(); ++i) {
+		if (i->first == uri) {
+			InputStream *is = i->second;
+			ready.erase(i);
+			return is;
+		}
+	}
+
+	/* the caller is going to open it; don't open it twice */
+	pending.remove(uri);
+	if (opening == uri)
+		opening_cancelled = true;
+
+	return nullptr;
+}
+
+inline void
+InputPrefetch::Run()
+{
+	SetThreadName("prefetch");
+
+	mutex.lock();
+
+	while (true) {
+		if (!garbage.empty()) {
+			std::vector<InputStream *> tmp;
+			tmp.swap(garbage);
+
+			mutex.unlock();
+			for (auto is : tmp)
+				delete is;
+			mutex.lock();
+			continue;
+		}
+
+		if (quit)
+			break;
+
+		if (pending.empty()) {
+			thread_cond.wait(mutex);
+			continue;
+		}
+
+		opening = std::move(pending.front());
+		pending.pop_front();
+		opening_cancelled = false;
+
+		mutex.unlock();
+
+		FormatDebug(input_prefetch_domain, "opening %s",
+			    opening.c_str());
+
+		Error error;
+		InputStream *is = InputStream::Open(opening.c_str(),
+						    mutex, cond, error);
+		if (is == nullptr && error.IsDefined())
+			FormatDebug(input_prefetch_domain,
+				    "failed to open %s: %s",
+				    opening.c_str(), error.GetMessage());
+
+		mutex.lock();
+
+		if (is != nullptr) {
+			if (opening_cancelled || quit)
+				garbage.push_back(is);
+			else
+				ready.emplace_back(std::move(opening), is);
+		}
+
+		opening.clear();
+	}
+
+	mutex.unlock();
+}
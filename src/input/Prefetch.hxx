@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_PREFETCH_HXX
+#define MPD_INPUT_PREFETCH_HXX
+
+#include "thread/Thread.hxx"
+#include "thread/Cond.hxx"
+#include "Compiler.h"
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Mutex;
+class InputStream;
+
+/**
+ * Opens the #InputStream objects of upcoming songs in a background
+ * thread, so they can connect and fill their buffers before the
+ * decoder needs them.  This helps with remote streams, where opening
+ * and buffering at the song border would cause a gap.
+ *
+ * The streams are opened with the specified #Mutex and #Cond, which
+ * are the ones of the decoder, so the decoder can adopt them as if
+ * it had opened them itself.
+ *
+ * Unless noted otherwise, the methods must be called with the mutex
+ * locked.
+ */
+class InputPrefetch {
+	Mutex &mutex;
+	Cond &cond;
+
+	/** wakes up the prefetch thread */
+	Cond thread_cond;
+
+	Thread thread;
+
+	/** the URIs which have not been opened yet */
+	std::list<std::string> pending;
+
+	/** the URI currently being opened by the thread */
+	std::string opening;
+
+	/** is the #opening stream not wanted anymore? */
+	bool opening_cancelled;
+
+	/** streams which have been opened */
+	std::list<std::pair<std::string, InputStream *>> ready;
+
+	/**
+	 * Streams which are not wanted anymore, to be deleted by the
+	 * thread (with the mutex unlocked).
+	 */
+	std::vector<InputStream *> garbage;
+
+	bool quit;
+
+public:
+	InputPrefetch(Mutex &_mutex, Cond &_cond);
+
+	/**
+	 * Stops the thread and closes all streams.  Caller must not
+	 * lock the mutex.
+	 */
+	~InputPrefetch();
+
+	InputPrefetch(const InputPrefetch &) = delete;
+	InputPrefetch &operator=(const InputPrefetch &) = delete;
+
+	/**
+	 * Replace the list of URIs to be prefetched.  Streams whose
+	 * URI is not in the new list are closed.
+	 */
+	void Set(std::vector<std::string> &&uris);
+
+	/**
+	 * Remove a stream which has been opened for the specified
+	 * URI and transfer ownership to the caller.  Its state is
+	 * unknown; the caller must wait for it to become ready.
+	 *
+	 * @return the stream or nullptr if the URI has not been
+	 * opened (yet)
+	 */
+	InputStream *Take(const char *uri);
+
+private:
+	void Run();
+
+	static void Run(void *ctx) {
+		((InputPrefetch *)ctx)->Run();
+	}
+};
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "FilterStage.hxx"
+#include "Domain.hxx"
+#include "MusicChunk.hxx"
+#include "pcm/PcmMix.hxx"
+#include "filter/FilterInternal.hxx"
+#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+OutputFilterStage::OutputFilterStage(Filter *_filter, const char *_filters)
+	:filters(_filters),
+	 replay_gain_filter(nullptr), replay_gain_serial(0),
+	 other_replay_gain_filter(nullptr), other_replay_gain_serial(0),
+	 filter(_filter),
+	 n_outputs(1), open_count(0), is_open(false),
+	 replay_gain_mixer(false),
+	 in_audio_format(AudioFormat::Undefined()),
+	 out_audio_format(AudioFormat::Undefined())
+{
+	assert(filter != nullptr);
+}
+
+OutputFilterStage::~OutputFilterStage()
+{
+	assert(open_count == 0);
+	assert(!is_open);
+
+	delete replay_gain_filter;
+	delete other_replay_gain_filter;
+	delete filter;
+}
+
+void
+OutputFilterStage::SetReplayGainMixer(Mixer *mixer)
+{
+	assert(replay_gain_filter != nullptr);
+	assert(!IsShared());
+
+	replay_gain_filter_set_mixer(replay_gain_filter, mixer, 100);
+	replay_gain_mixer = true;
+}
+
+void
+OutputFilterStage::SetReplayGainMode(ReplayGainMode mode)
+{
+	const ScopeLock protect(mutex);
+
+	if (replay_gain_filter != nullptr)
+		replay_gain_filter_set_mode(replay_gain_filter, mode);
+	if (other_replay_gain_filter != nullptr)
+		replay_gain_filter_set_mode(other_replay_gain_filter, mode);
+}
+
+bool
+OutputFilterStage::IsEquivalent(const OutputFilterStage &other) const
+{
+	return !replay_gain_mixer && !other.replay_gain_mixer &&
+		HasReplayGain() == other.HasReplayGain() &&
+		filters == other.filters;
+}
+
+inline AudioFormat
+OutputFilterStage::OpenFilters(AudioFormat format, Error &error)
+{
+	assert(format.IsValid());
+
+	/* the replay_gain filter cannot fail here */
+	if (replay_gain_filter != nullptr &&
+	    !replay_gain_filter->Open(format, error).IsDefined())
+		return AudioFormat::Undefined();
+
+	if (other_replay_gain_filter != nullptr &&
+	    !other_replay_gain_filter->Open(format, error).IsDefined()) {
+		if (replay_gain_filter != nullptr)
+			replay_gain_filter->Close();
+		return AudioFormat::Undefined();
+	}
+
+	const AudioFormat af = filter->Open(format, error);
+	if (!af.IsDefined()) {
+		if (replay_gain_filter != nullptr)
+			replay_gain_filter->Close();
+		if (other_replay_gain_filter != nullptr)
+			other_replay_gain_filter->Close();
+	}
+
+	return af;
+}
+
+inline void
+OutputFilterStage::CloseFilters()
+{
+	if (replay_gain_filter != nullptr)
+		replay_gain_filter->Close();
+	if (other_replay_gain_filter != nullptr)
+		other_replay_gain_filter->Close();
+
+	filter->Close();
+}
+
+AudioFormat
+OutputFilterStage::Open(AudioFormat af, Error &error)
+{
+	const ScopeLock protect(mutex);
+
+	if (!is_open || af != in_audio_format) {
+		/* this is the first output, or the input format has
+		   changed (which happens only after the pipe has been
+		   drained, so no cached chunk is affected) */
+
+		if (is_open) {
+			CloseFilters();
+			is_open = false;
+		}
+
+		const AudioFormat result = OpenFilters(af, error);
+		if (!result.IsDefined())
+			return result;
+
+		in_audio_format = af;
+		out_audio_format = result;
+		is_open = true;
+	}
+
+	++open_count;
+	return out_audio_format;
+}
+
+void
+OutputFilterStage::Close()
+{
+	const ScopeLock protect(mutex);
+
+	assert(open_count > 0);
+
+	if (--open_count == 0 && is_open) {
+		CloseFilters();
+		is_open = false;
+	}
+}
+
+inline ConstBuffer<void>
+OutputFilterStage::ChunkData(const MusicChunk &chunk,
+			     Filter *_replay_gain_filter,
+			     unsigned &_replay_gain_serial,
+			     Error &error)
+{
+	assert(!chunk.IsEmpty());
+	assert(chunk.CheckFormat(in_audio_format));
+
+	ConstBuffer<void> data(chunk.data, chunk.length);
+
+	assert(data.size % in_audio_format.GetFrameSize() == 0);
+
+	if (!data.IsEmpty() && _replay_gain_filter != nullptr) {
+		if (chunk.replay_gain_serial != _replay_gain_serial) {
+			replay_gain_filter_set_info(_replay_gain_filter,
+						    chunk.replay_gain_serial != 0
+						    ? &chunk.replay_gain_info
+						    : nullptr);
+			_replay_gain_serial = chunk.replay_gain_serial;
+		}
+
+		data = _replay_gain_filter->FilterPCM(data, error);
+	}
+
+	return data;
+}
+
+inline ConstBuffer<void>
+OutputFilterStage::Run(const MusicChunk &chunk, Error &error)
+{
+	ConstBuffer<void> data =
+		ChunkData(chunk, replay_gain_filter, replay_gain_serial,
+			  error);
+	if (data.IsEmpty())
+		return data;
+
+	/* cross-fade */
+
+	if (chunk.other != nullptr) {
+		ConstBuffer<void> other_data =
+			ChunkData(*chunk.other, other_replay_gain_filter,
+				  other_replay_gain_serial, error);
+		if (other_data.IsNull())
+			return nullptr;
+
+		if (other_data.IsEmpty())
+			return data;
+
+		/* if the "other" chunk is longer, then that trailer
+		   is used as-is, without mixing; it is part of the
+		   "next" song being faded in, and if there's a rest,
+		   it means cross-fading ends here */
+
+		if (data.size > other_data.size)
+			data.size = other_data.size;
+
+		void *dest = cross_fade_buffer.Get(other_data.size);
+		memcpy(dest, other_data.data, other_data.size);
+		if (!pcm_mix(cross_fade_dither, dest, data.data, data.size,
+			     in_audio_format.format,
+			     1.0 - chunk.mix_ratio)) {
+			error.Format(output_domain,
+				     "Cannot cross-fade format %s",
+				     sample_format_to_string(in_audio_format.format));
+			return nullptr;
+		}
+
+		data.data = dest;
+		data.size = other_data.size;
+	}
+
+	/* apply filter chain */
+
+	return filter->FilterPCM(data, error);
+}
+
+ConstBuffer<void>
+OutputFilterStage::FilterChunk(const MusicChunk &chunk, Error &error)
+{
+	const ScopeLock protect(mutex);
+
+	if (!is_open) {
+		/* reopening has failed in another output thread */
+		error.Set(output_domain, "Filter is not open");
+		return nullptr;
+	}
+
+	if (!IsShared())
+		return Run(chunk, error);
+
+	auto i = entries.find(&chunk);
+	if (i == entries.end()) {
+		/* this is the first output to reach this chunk */
+		const auto data = Run(chunk, error);
+
+		Entry entry;
+		entry.size = data.size;
+		if (!data.IsNull()) {
+			entry.data.reset(new char[data.size]);
+			memcpy(entry.data.get(), data.data, data.size);
+		}
+
+		i = entries.emplace(&chunk, std::move(entry)).first;
+		if (data.IsNull())
+			return nullptr;
+	} else if (i->second.data == nullptr) {
+		error.Set(output_domain, "Filter has failed");
+		return nullptr;
+	}
+
+	return { i->second.data.get(), i->second.size };
+}
+
+void
+OutputFilterStage::Forget(const MusicChunk &chunk)
+{
+	const ScopeLock protect(mutex);
+	entries.erase(&chunk);
+}
+
+void
+OutputFilterStage::ForgetAll()
+{
+	const ScopeLock protect(mutex);
+	entries.clear();
+}
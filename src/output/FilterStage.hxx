@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_FILTER_STAGE_HXX
+#define MPD_OUTPUT_FILTER_STAGE_HXX
+
+#include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmDither.hxx"
+#include "thread/Mutex.hxx"
+#include "util/RefCount.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class Error;
+class Filter;
+class Mixer;
+struct MusicChunk;
+
+/**
+ * The part of an audio output's processing which does not depend on
+ * the device: replay gain, cross-fading and the configured filter
+ * chain ("filters" and volume normalization).  Its result is then
+ * passed to the output's own filters (software volume and format
+ * conversion).
+ *
+ * Outputs with equivalent configuration share one instance (see
+ * MultipleOutputs::Configure()).  Whichever output thread reaches a
+ * chunk first runs the filters; the result is kept until the chunk
+ * is returned to the #MusicBuffer, and the other outputs use it
+ * without running the filters again.  Since every output consumes
+ * the pipe in order, stateful filters still see each chunk once, in
+ * order.
+ */
+class OutputFilterStage {
+	RefCount ref;
+
+	/**
+	 * Protects all attributes below.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The "filters" setting; outputs with different values
+	 * cannot share this object.
+	 */
+	const std::string filters;
+
+	/**
+	 * The replay_gain_filter_plugin instance, or nullptr if
+	 * replay gain is disabled for this output.
+	 */
+	Filter *replay_gain_filter;
+
+	/**
+	 * The serial number of the last replay gain info.  0 means no
+	 * replay gain info was available.
+	 */
+	unsigned replay_gain_serial;
+
+	/**
+	 * The replay_gain_filter_plugin instance to be applied to the
+	 * second chunk during cross-fading.
+	 */
+	Filter *other_replay_gain_filter;
+
+	/**
+	 * The serial number of the last replay gain info by the
+	 * "other" chunk during cross-fading.
+	 */
+	unsigned other_replay_gain_serial;
+
+	/**
+	 * The chain of configured filters.
+	 */
+	Filter *filter;
+
+	/**
+	 * The buffer used to allocate the cross-fading result.
+	 */
+	PcmBuffer cross_fade_buffer;
+
+	/**
+	 * The dithering state for cross-fading two streams.
+	 */
+	PcmDither cross_fade_dither;
+
+	/**
+	 * The number of outputs using this object.
+	 */
+	unsigned n_outputs;
+
+	/**
+	 * The number of outputs which have opened this object.
+	 */
+	unsigned open_count;
+
+	/**
+	 * Are the filters open?  This may be false even if
+	 * #open_count is positive, after reopening has failed.
+	 */
+	bool is_open;
+
+	/**
+	 * Does a hardware mixer apply the replay gain?  Then the
+	 * replay gain filter is bound to one output, and this object
+	 * cannot be shared.
+	 */
+	bool replay_gain_mixer;
+
+	AudioFormat in_audio_format, out_audio_format;
+
+	/**
+	 * A filtered chunk, kept for the other outputs.
+	 */
+	struct Entry {
+		std::unique_ptr<char[]> data;
+		size_t size;
+	};
+
+	/**
+	 * Filtered chunks which are still in the pipe.  Only used if
+	 * this object is shared.  A nullptr data pointer means that
+	 * filtering has failed.
+	 */
+	std::unordered_map<const MusicChunk *, Entry> entries;
+
+public:
+	OutputFilterStage(Filter *_filter, const char *_filters);
+
+	OutputFilterStage(const OutputFilterStage &) = delete;
+	OutputFilterStage &operator=(const OutputFilterStage &) = delete;
+
+	void Ref() {
+		ref.Increment();
+	}
+
+	void Unref() {
+		if (ref.Decrement())
+			delete this;
+	}
+
+	/**
+	 * Enable replay gain.  Call this before the object is shared.
+	 */
+	void SetReplayGainFilters(Filter *_replay_gain_filter,
+				  Filter *_other_replay_gain_filter) {
+		replay_gain_filter = _replay_gain_filter;
+		other_replay_gain_filter = _other_replay_gain_filter;
+	}
+
+	/**
+	 * Apply replay gain with this hardware mixer.
+	 */
+	void SetReplayGainMixer(Mixer *mixer);
+
+	void SetReplayGainMode(ReplayGainMode mode);
+
+	bool HasReplayGain() const {
+		return replay_gain_filter != nullptr;
+	}
+
+	/**
+	 * Can this object be shared with the output which owns the
+	 * other one, i.e. would both produce the same data?
+	 */
+	gcc_pure
+	bool IsEquivalent(const OutputFilterStage &other) const;
+
+	/**
+	 * Let another output use this object.
+	 */
+	void Share() {
+		Ref();
+
+		const ScopeLock protect(mutex);
+		++n_outputs;
+	}
+
+	bool IsShared() const {
+		return n_outputs > 1;
+	}
+
+	/**
+	 * Open the filters (unless another output has already done
+	 * that with the same input format).  Each successful call
+	 * must be followed by Close().
+	 *
+	 * @return the output format of the filters, or an undefined
+	 * format on error
+	 */
+	AudioFormat Open(AudioFormat af, Error &error);
+
+	void Close();
+
+	/**
+	 * Run the filters on a chunk, or look up the result another
+	 * output has already obtained.
+	 *
+	 * @return the filtered data (valid until the chunk is
+	 * returned to the buffer), or nullptr on error
+	 */
+	ConstBuffer<void> FilterChunk(const MusicChunk &chunk, Error &error);
+
+	/**
+	 * The specified chunk has been returned to the buffer; forget
+	 * its filtered data.
+	 */
+	void Forget(const MusicChunk &chunk);
+
+	/**
+	 * All chunks have been returned to the buffer.
+	 */
+	void ForgetAll();
+
+private:
+	~OutputFilterStage();
+
+	AudioFormat OpenFilters(AudioFormat af, Error &error);
+	void CloseFilters();
+
+	ConstBuffer<void> ChunkData(const MusicChunk &chunk,
+				    Filter *replay_gain_filter,
+				    unsigned &replay_gain_serial,
+				    Error &error);
+
+	ConstBuffer<void> Run(const MusicChunk &chunk, Error &error);
+};
+
+#endif
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "Internal.hxx"
+#include "FilterStage.hxx"
 #include "OutputPlugin.hxx"
 #include "mixer/MixerControl.hxx"
 #include "filter/FilterInternal.hxx"
@@ -34,8 +35,8 @@ AudioOutput::~AudioOutput()
 	if (mixer != nullptr)
 		mixer_free(mixer);
 
-	delete replay_gain_filter;
-	delete other_replay_gain_filter;
+	if (filter_stage != nullptr)
+		filter_stage->Unref();
 	delete filter;
 }
 
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "Internal.hxx"
+#include "FilterStage.hxx"
 #include "Registry.hxx"
 #include "Domain.hxx"
 #include "OutputAPI.hxx"
@@ -54,9 +55,8 @@ AudioOutput::AudioOutput(const AudioOutputPlugin &_plugin)
 	 allow_play(true),
 	 in_playback_loop(false),
 	 woken_for_play(false),
+	 filter_stage(nullptr),
 	 filter(nullptr),
-	 replay_gain_filter(nullptr),
-	 other_replay_gain_filter(nullptr),
 	 command(AO_COMMAND_NONE)
 {
 	assert(plugin.finish != nullptr);
@@ -181,8 +181,8 @@ AudioOutput::Configure(const config_param &param, Error &error)
 
 	/* set up the filter chain */
 
-	filter = filter_chain_new();
-	assert(filter != nullptr);
+	Filter *prepared_filter = filter_chain_new();
+	assert(prepared_filter != nullptr);
 
 	/* create the normalization filter (if configured) */
 
@@ -192,14 +192,14 @@ AudioOutput::Configure(const config_param &param, Error &error)
 				   IgnoreError());
 		assert(normalize_filter != nullptr);
 
-		filter_chain_append(*filter, "normalize",
+		filter_chain_append(*prepared_filter, "normalize",
 				    autoconvert_filter_new(normalize_filter));
 	}
 
+	const char *filters = param.GetBlockValue(AUDIO_FILTERS, "");
+
 	Error filter_error;
-	filter_chain_parse(*filter,
-			   param.GetBlockValue(AUDIO_FILTERS, ""),
-			   filter_error);
+	filter_chain_parse(*prepared_filter, filters, filter_error);
 
 	// It's not really fatal - Part of the filter chain has been set up already
 	// and even an empty one will work (if only with unexpected behaviour)
@@ -208,6 +208,14 @@ AudioOutput::Configure(const config_param &param, Error &error)
 			    "Failed to initialize filter chain for '%s'",
 			    name);
 
+	filter_stage = new OutputFilterStage(prepared_filter, filters);
+
+	/* the output specific filters (software volume, conversion)
+	   follow in another chain */
+
+	filter = filter_chain_new();
+	assert(filter != nullptr);
+
 	/* done */
 
 	return true;
@@ -226,21 +234,18 @@ audio_output_setup(EventLoop &event_loop, AudioOutput &ao,
 		param.GetBlockValue("replay_gain_handler", "software");
 
 	if (strcmp(replay_gain_handler, "none") != 0) {
-		ao.replay_gain_filter = filter_new(&replay_gain_filter_plugin,
-						   param, IgnoreError());
-		assert(ao.replay_gain_filter != nullptr);
-
-		ao.replay_gain_serial = 0;
-
-		ao.other_replay_gain_filter = filter_new(&replay_gain_filter_plugin,
-							 param,
-							 IgnoreError());
-		assert(ao.other_replay_gain_filter != nullptr);
-
-		ao.other_replay_gain_serial = 0;
-	} else {
-		ao.replay_gain_filter = nullptr;
-		ao.other_replay_gain_filter = nullptr;
+		Filter *replay_gain_filter =
+			filter_new(&replay_gain_filter_plugin,
+				   param, IgnoreError());
+		assert(replay_gain_filter != nullptr);
+
+		Filter *other_replay_gain_filter =
+			filter_new(&replay_gain_filter_plugin,
+				   param, IgnoreError());
+		assert(other_replay_gain_filter != nullptr);
+
+		ao.filter_stage->SetReplayGainFilters(replay_gain_filter,
+						      other_replay_gain_filter);
 	}
 
 	/* set up the mixer */
@@ -260,13 +265,12 @@ audio_output_setup(EventLoop &event_loop, AudioOutput &ao,
 
 	if (strcmp(replay_gain_handler, "mixer") == 0) {
 		if (ao.mixer != nullptr)
-			replay_gain_filter_set_mixer(ao.replay_gain_filter,
-						     ao.mixer, 100);
+			ao.filter_stage->SetReplayGainMixer(ao.mixer);
 		else
 			FormatError(output_domain,
 				    "No such mixer for output '%s'", ao.name);
 	} else if (strcmp(replay_gain_handler, "software") != 0 &&
-		   ao.replay_gain_filter != nullptr) {
+		   ao.filter_stage->HasReplayGain()) {
 		error.Set(config_domain,
 			  "Invalid \"replay_gain_handler\" value");
 		return false;
@@ -21,8 +21,6 @@
 #define MPD_OUTPUT_INTERNAL_HXX
 
 #include "AudioFormat.hxx"
-#include "pcm/PcmBuffer.hxx"
-#include "pcm/PcmDither.hxx"
 #include "ReplayGainInfo.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
@@ -31,6 +29,7 @@
 
 class Error;
 class Filter;
+class OutputFilterStage;
 class MusicPipe;
 class EventLoop;
 class Mixer;
@@ -174,46 +173,19 @@ struct AudioOutput {
 	AudioFormat out_audio_format;
 
 	/**
-	 * The buffer used to allocate the cross-fading result.
+	 * Replay gain, cross-fading and the configured filters.  This
+	 * object may be shared with other outputs.
 	 */
-	PcmBuffer cross_fade_buffer;
+	OutputFilterStage *filter_stage;
 
 	/**
-	 * The dithering state for cross-fading two streams.
-	 */
-	PcmDither cross_fade_dither;
-
-	/**
-	 * The filter object of this audio output.  This is an
-	 * instance of chain_filter_plugin.
+	 * The filters which are specific to this audio output
+	 * (software volume and format conversion), applied after
+	 * #filter_stage.  This is an instance of
+	 * chain_filter_plugin.
 	 */
 	Filter *filter;
 
-	/**
-	 * The replay_gain_filter_plugin instance of this audio
-	 * output.
-	 */
-	Filter *replay_gain_filter;
-
-	/**
-	 * The serial number of the last replay gain info.  0 means no
-	 * replay gain info was available.
-	 */
-	unsigned replay_gain_serial;
-
-	/**
-	 * The replay_gain_filter_plugin instance of this audio
-	 * output, to be applied to the second chunk during
-	 * cross-fading.
-	 */
-	Filter *other_replay_gain_filter;
-
-	/**
-	 * The serial number of the last replay gain info by the
-	 * "other" chunk during cross-fading.
-	 */
-	unsigned other_replay_gain_serial;
-
 	/**
 	 * The convert_filter_plugin instance of this audio output.
 	 * It is the last item in the filter chain, and is responsible
@@ -342,6 +314,13 @@ struct AudioOutput {
 
 	void SetReplayGainMode(ReplayGainMode mode);
 
+	/**
+	 * Use the specified (equivalent) filter stage instead of this
+	 * output's own one.  Must be called before the output is
+	 * opened.
+	 */
+	void ShareFilterStage(OutputFilterStage &stage);
+
 	/**
 	 * Caller must lock the mutex.
 	 */
@@ -21,16 +21,19 @@
 #include "MultipleOutputs.hxx"
 #include "PlayerControl.hxx"
 #include "Internal.hxx"
+#include "FilterStage.hxx"
 #include "Domain.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
+#include "MusicHistory.hxx"
 #include "system/FatalError.hxx"
 #include "util/Error.hxx"
 #include "config/ConfigData.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
 #include "notify.hxx"
+#include "Log.hxx"
 
 #include <assert.h>
 #include <string.h>
@@ -38,7 +41,7 @@
 MultipleOutputs::MultipleOutputs(MixerListener &_mixer_listener)
 	:mixer_listener(_mixer_listener),
 	 input_audio_format(AudioFormat::Undefined()),
-	 buffer(nullptr), pipe(nullptr),
+	 buffer(nullptr), history(nullptr), pipe(nullptr),
 	 elapsed_time(SignedSongTime::Negative())
 {
 }
@@ -92,6 +95,32 @@ MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc)
 					 pc, empty);
 		outputs.push_back(output);
 	}
+
+	ShareFilterStages();
+}
+
+void
+MultipleOutputs::ShareFilterStages()
+{
+	for (size_t i = 1, n = outputs.size(); i != n; ++i) {
+		AudioOutput &ao = *outputs[i];
+
+		for (size_t j = 0; j != i; ++j) {
+			AudioOutput &other = *outputs[j];
+			if (!other.filter_stage->IsEquivalent(*ao.filter_stage))
+				continue;
+
+			if (!other.filter_stage->IsShared())
+				shared_filter_stages.push_back(other.filter_stage);
+
+			ao.ShareFilterStage(*other.filter_stage);
+
+			FormatDebug(output_domain,
+				    "output \"%s\" shares the filters of \"%s\"",
+				    ao.name, other.name);
+			break;
+		}
+	}
 }
 
 AudioOutput *
@@ -322,6 +351,29 @@ MultipleOutputs::ClearTailChunk(gcc_unused const MusicChunk *chunk,
 	}
 }
 
+void
+MultipleOutputs::ClearPipe()
+{
+	assert(pipe != nullptr);
+	assert(buffer != nullptr);
+
+	MusicChunk *chunk;
+	while ((chunk = pipe->Shift()) != nullptr)
+		ReturnChunk(chunk);
+
+	for (auto stage : shared_filter_stages)
+		stage->ForgetAll();
+}
+
+void
+MultipleOutputs::ReturnChunk(MusicChunk *chunk)
+{
+	if (history != nullptr)
+		history->Push(chunk, *buffer);
+	else
+		buffer->Return(chunk);
+}
+
 unsigned
 MultipleOutputs::Check()
 {
@@ -364,7 +416,9 @@ MultipleOutputs::Check()
 					outputs[i]->mutex.unlock();
 
 		/* return the chunk to the buffer */
-		buffer->Return(shifted);
+		for (auto stage : shared_filter_stages)
+			stage->Forget(*shifted);
+		ReturnChunk(shifted);
 	}
 
 	return 0;
@@ -419,7 +473,7 @@ MultipleOutputs::Cancel()
 	/* clear the music pipe and return all chunks to the buffer */
 
 	if (pipe != nullptr)
-		pipe->Clear(*buffer);
+		ClearPipe();
 
 	/* the audio outputs are now waiting for a signal, to
 	   synchronize the cleared music pipe */
@@ -440,7 +494,7 @@ MultipleOutputs::Close()
 	if (pipe != nullptr) {
 		assert(buffer != nullptr);
 
-		pipe->Clear(*buffer);
+		ClearPipe();
 		delete pipe;
 		pipe = nullptr;
 	}
@@ -461,7 +515,7 @@ MultipleOutputs::Release()
 	if (pipe != nullptr) {
 		assert(buffer != nullptr);
 
-		pipe->Clear(*buffer);
+		ClearPipe();
 		delete pipe;
 		pipe = nullptr;
 	}
@@ -479,4 +533,10 @@ MultipleOutputs::SongBorder()
 	/* clear the elapsed_time pointer at the beginning of a new
 	   song */
 	elapsed_time = SignedSongTime::zero();
+
+	/* the chunks still in the pipe belong to the previous
+	   song; they must not be played again when seeking in the
+	   new one */
+	if (history != nullptr)
+		history->SongBorder(pipe != nullptr ? pipe->GetSize() : 0);
 }
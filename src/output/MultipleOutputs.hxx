@@ -38,11 +38,13 @@
 struct AudioFormat;
 class MusicBuffer;
 class MusicPipe;
+class MusicHistory;
 class EventLoop;
 class MixerListener;
 struct MusicChunk;
 struct PlayerControl;
 struct AudioOutput;
+class OutputFilterStage;
 class Error;
 
 class MultipleOutputs {
@@ -50,6 +52,13 @@ class MultipleOutputs {
 
 	std::vector<AudioOutput *> outputs;
 
+	/**
+	 * Filter stages used by more than one output.  They cache
+	 * filtered chunks, which must be released when the chunk is
+	 * returned to the #MusicBuffer.
+	 */
+	std::vector<OutputFilterStage *> shared_filter_stages;
+
 	AudioFormat input_audio_format;
 
 	/**
@@ -57,6 +66,13 @@ class MultipleOutputs {
 	 */
 	MusicBuffer *buffer;
 
+	/**
+	 * If not nullptr, then consumed chunks are passed to this
+	 * object instead of returning them to the #MusicBuffer
+	 * directly, so the player may play them again.
+	 */
+	MusicHistory *history;
+
 	/**
 	 * The #MusicPipe object which feeds all audio outputs.  It is
 	 * filled by audio_output_all_play().
@@ -140,6 +156,15 @@ public:
 
 	void SetReplayGainMode(ReplayGainMode mode);
 
+	/**
+	 * Pass consumed (and cancelled) chunks to the specified
+	 * #MusicHistory.  Pass nullptr to return them to the
+	 * #MusicBuffer again.
+	 */
+	void SetHistory(MusicHistory *_history) {
+		history = _history;
+	}
+
 	/**
 	 * Enqueue a #MusicChunk object for playing, i.e. pushes it to a
 	 * #MusicPipe.
@@ -231,6 +256,23 @@ public:
 	void SetSoftwareVolume(unsigned volume);
 
 private:
+	/**
+	 * Let outputs with equivalent filter configuration share
+	 * one #OutputFilterStage.
+	 */
+	void ShareFilterStages();
+
+	/**
+	 * Return a chunk which is not needed by the audio outputs
+	 * anymore to the #MusicHistory or to the #MusicBuffer.
+	 */
+	void ReturnChunk(MusicChunk *chunk);
+
+	/**
+	 * Clear the pipe and return all chunks to the buffer.
+	 */
+	void ClearPipe();
+
 	/**
 	 * Determine if all (active) outputs have finished the current
 	 * command.
@@ -19,11 +19,11 @@
 
 #include "config.h"
 #include "Internal.hxx"
+#include "FilterStage.hxx"
 #include "OutputPlugin.hxx"
 #include "Domain.hxx"
 #include "mixer/MixerControl.hxx"
 #include "notify.hxx"
-#include "filter/plugins/ReplayGainFilterPlugin.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 
@@ -71,10 +71,18 @@ AudioOutput::LockCommandWait(audio_output_command cmd)
 void
 AudioOutput::SetReplayGainMode(ReplayGainMode mode)
 {
-	if (replay_gain_filter != nullptr)
-		replay_gain_filter_set_mode(replay_gain_filter, mode);
-	if (other_replay_gain_filter != nullptr)
-		replay_gain_filter_set_mode(other_replay_gain_filter, mode);
+	filter_stage->SetReplayGainMode(mode);
+}
+
+void
+AudioOutput::ShareFilterStage(OutputFilterStage &stage)
+{
+	assert(!open);
+	assert(&stage != filter_stage);
+
+	stage.Share();
+	filter_stage->Unref();
+	filter_stage = &stage;
 }
 
 void
@@ -19,13 +19,12 @@
 
 #include "config.h"
 #include "Internal.hxx"
+#include "FilterStage.hxx"
 #include "OutputAPI.hxx"
 #include "Domain.hxx"
-#include "pcm/PcmMix.hxx"
 #include "notify.hxx"
 #include "filter/FilterInternal.hxx"
 #include "filter/plugins/ConvertFilterPlugin.hxx"
-#include "filter/plugins/ReplayGainFilterPlugin.hxx"
 #include "PlayerControl.hxx"
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
@@ -93,25 +92,13 @@ AudioOutput::OpenFilter(AudioFormat &format, Error &error_r)
 {
 	assert(format.IsValid());
 
-	/* the replay_gain filter cannot fail here */
-	if (replay_gain_filter != nullptr &&
-	    !replay_gain_filter->Open(format, error_r).IsDefined())
-		return AudioFormat::Undefined();
+	AudioFormat prepared_format = filter_stage->Open(format, error_r);
+	if (!prepared_format.IsDefined())
+		return prepared_format;
 
-	if (other_replay_gain_filter != nullptr &&
-	    !other_replay_gain_filter->Open(format, error_r).IsDefined()) {
-		if (replay_gain_filter != nullptr)
-			replay_gain_filter->Close();
-		return AudioFormat::Undefined();
-	}
-
-	const AudioFormat af = filter->Open(format, error_r);
-	if (!af.IsDefined()) {
-		if (replay_gain_filter != nullptr)
-			replay_gain_filter->Close();
-		if (other_replay_gain_filter != nullptr)
-			other_replay_gain_filter->Close();
-	}
+	const AudioFormat af = filter->Open(prepared_format, error_r);
+	if (!af.IsDefined())
+		filter_stage->Close();
 
 	return af;
 }
@@ -119,11 +106,7 @@ AudioOutput::OpenFilter(AudioFormat &format, Error &error_r)
 void
 AudioOutput::CloseFilter()
 {
-	if (replay_gain_filter != nullptr)
-		replay_gain_filter->Close();
-	if (other_replay_gain_filter != nullptr)
-		other_replay_gain_filter->Close();
-
+	filter_stage->Close();
 	filter->Close();
 }
 
@@ -308,93 +291,27 @@ AudioOutput::WaitForDelay()
 }
 
 static ConstBuffer<void>
-ao_chunk_data(AudioOutput *ao, const MusicChunk *chunk,
-	      Filter *replay_gain_filter,
-	      unsigned *replay_gain_serial_p)
+ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
 {
 	assert(chunk != nullptr);
 	assert(!chunk->IsEmpty());
 	assert(chunk->CheckFormat(ao->in_audio_format));
 
-	ConstBuffer<void> data(chunk->data, chunk->length);
-
-	(void)ao;
+	/* replay gain, cross-fade and the configured filters (maybe
+	   shared with other outputs) */
 
-	assert(data.size % ao->in_audio_format.GetFrameSize() == 0);
-
-	if (!data.IsEmpty() && replay_gain_filter != nullptr) {
-		if (chunk->replay_gain_serial != *replay_gain_serial_p) {
-			replay_gain_filter_set_info(replay_gain_filter,
-						    chunk->replay_gain_serial != 0
-						    ? &chunk->replay_gain_info
-						    : nullptr);
-			*replay_gain_serial_p = chunk->replay_gain_serial;
-		}
-
-		Error error;
-		data = replay_gain_filter->FilterPCM(data, error);
-		if (data.IsNull())
-			FormatError(error, "\"%s\" [%s] failed to filter",
-				    ao->name, ao->plugin.name);
-	}
-
-	return data;
-}
-
-static ConstBuffer<void>
-ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
-{
+	Error error;
 	ConstBuffer<void> data =
-		ao_chunk_data(ao, chunk, ao->replay_gain_filter,
-			      &ao->replay_gain_serial);
-	if (data.IsEmpty())
-		return data;
-
-	/* cross-fade */
-
-	if (chunk->other != nullptr) {
-		ConstBuffer<void> other_data =
-			ao_chunk_data(ao, chunk->other,
-				      ao->other_replay_gain_filter,
-				      &ao->other_replay_gain_serial);
-		if (other_data.IsNull())
-			return nullptr;
-
-		if (other_data.IsEmpty())
-			return data;
-
-		/* if the "other" chunk is longer, then that trailer
-		   is used as-is, without mixing; it is part of the
-		   "next" song being faded in, and if there's a rest,
-		   it means cross-fading ends here */
-
-		if (data.size > other_data.size)
-			data.size = other_data.size;
-
-		void *dest = ao->cross_fade_buffer.Get(other_data.size);
-		memcpy(dest, other_data.data, other_data.size);
-		if (!pcm_mix(ao->cross_fade_dither, dest, data.data, data.size,
-			     ao->in_audio_format.format,
-			     1.0 - chunk->mix_ratio)) {
-			FormatError(output_domain,
-				    "Cannot cross-fade format %s",
-				    sample_format_to_string(ao->in_audio_format.format));
-			return nullptr;
-		}
+		ao->filter_stage->FilterChunk(*chunk, error);
 
-		data.data = dest;
-		data.size = other_data.size;
-	}
+	/* volume and format conversion */
 
-	/* apply filter chain */
+	if (!data.IsEmpty())
+		data = ao->filter->FilterPCM(data, error);
 
-	Error error;
-	data = ao->filter->FilterPCM(data, error);
-	if (data.IsNull()) {
+	if (data.IsNull())
 		FormatError(error, "\"%s\" [%s] failed to filter",
 			    ao->name, ao->plugin.name);
-		return nullptr;
-	}
 
 	return data;
 }
@@ -22,6 +22,7 @@
 #include "../OutputAPI.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
 #include "config/ConfigError.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -173,7 +174,14 @@ ShoutOutput::Configure(const config_param &param, Error &error)
 		return false;
 	}
 
-	encoder = encoder_init(*encoder_plugin, param, error);
+	/* outputs with the same encoder settings share one encoder */
+	static constexpr const char *ignore[] = {
+		"host", "port", "mount", "user", "password", "public",
+		"description", "genre", "url", "protocol", "timeout",
+		"encoding", nullptr,
+	};
+
+	encoder = shared_encoder_init(*encoder_plugin, param, ignore, error);
 	if (encoder == nullptr)
 		return false;
 
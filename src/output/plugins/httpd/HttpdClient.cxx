@@ -22,22 +22,24 @@
 #include "HttpdInternal.hxx"
 #include "util/ASCII.hxx"
 #include "Page.hxx"
+#include "PageRing.hxx"
 #include "IcyMetaDataServer.hxx"
 #include "system/SocketError.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Macros.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 
 HttpdClient::~HttpdClient()
 {
-	if (state == RESPONSE) {
-		if (current_page != nullptr)
-			current_page->Unref();
-
-		ClearQueue();
-	}
+	if (state == RESPONSE && current_page != nullptr)
+		current_page->Unref();
 
 	if (metadata)
 		metadata->Unref();
@@ -67,6 +69,9 @@ HttpdClient::BeginResponse()
 	state = RESPONSE;
 	current_page = nullptr;
 
+	/* start with the next page from the encoder */
+	next_page = httpd.GetPageRing().GetTail();
+
 	if (!head_method)
 		httpd.SendHeader(*this);
 }
@@ -198,7 +203,6 @@ HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop,
 	:BufferedSocket(_fd, _loop),
 	 httpd(_httpd),
 	 state(REQUEST),
-	 queue_size(0),
 	 head_method(false),
 	 dlna_streaming_requested(false),
 	 metadata_supported(_metadata_supported),
@@ -209,33 +213,13 @@ HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop,
 {
 }
 
-void
-HttpdClient::ClearQueue()
-{
-	assert(state == RESPONSE);
-
-	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
-
-#ifndef NDEBUG
-		assert(queue_size >= page->size);
-		queue_size -= page->size;
-#endif
-
-		page->Unref();
-	}
-
-	assert(queue_size == 0);
-}
-
 void
 HttpdClient::CancelQueue()
 {
 	if (state != RESPONSE)
 		return;
 
-	ClearQueue();
+	next_page = httpd.GetPageRing().GetTail();
 
 	if (current_page == nullptr)
 		CancelWrite();
@@ -250,18 +234,68 @@ HttpdClient::TryWritePage(const Page &page, size_t position)
 }
 
 ssize_t
-HttpdClient::TryWritePageN(const Page &page, size_t position, ssize_t n)
+HttpdClient::TryWritePages(size_t limit)
 {
-	return n >= 0
-		? Write(page.data + position, n)
-		: TryWritePage(page, position);
+	assert(current_page != nullptr);
+	assert(current_position < current_page->size);
+	assert(limit > 0);
+
+	const PageRing &ring = httpd.GetPageRing();
+
+	ConstBuffer<void> buffers[64];
+	size_t n = 0;
+
+	size_t size = std::min(current_page->size - current_position, limit);
+	buffers[n++] = { current_page->data + current_position, size };
+	limit -= size;
+
+	for (uint64_t i = next_page;
+	     limit > 0 && i < ring.GetTail() && n < ARRAY_SIZE(buffers);
+	     ++i) {
+		const Page &page = ring.Get(i);
+		size = std::min(page.size, limit);
+		buffers[n++] = { page.data, size };
+		limit -= size;
+	}
+
+	return WriteV(buffers, n);
+}
+
+void
+HttpdClient::ConsumePages(size_t nbytes)
+{
+	assert(current_page != nullptr);
+
+	const size_t rest = current_page->size - current_position;
+	if (nbytes < rest) {
+		current_position += nbytes;
+		return;
+	}
+
+	nbytes -= rest;
+	current_page->Unref();
+	current_page = nullptr;
+
+	const PageRing &ring = httpd.GetPageRing();
+	while (nbytes > 0) {
+		Page &page = ring.Get(next_page++);
+		if (nbytes < page.size) {
+			/* partially sent: keep a reference, because the
+			   ring may drop it before we're finished */
+			page.Ref();
+			current_page = &page;
+			current_position = nbytes;
+			return;
+		}
+
+		nbytes -= page.size;
+	}
 }
 
 ssize_t
 HttpdClient::GetBytesTillMetaData() const
 {
-	if (metadata_requested &&
-	    current_page->size - current_position > metaint - metadata_fill)
+	if (metadata_requested)
 		return metaint - metadata_fill;
 
 	return -1;
@@ -274,8 +308,16 @@ HttpdClient::TryWrite()
 
 	assert(state == RESPONSE);
 
+	const PageRing &ring = httpd.GetPageRing();
+	if (next_page < ring.GetHead()) {
+		FormatDebug(httpd_output_domain,
+			    "client is too slow, skipping %u pages",
+			    unsigned(ring.GetHead() - next_page));
+		next_page = ring.GetHead();
+	}
+
 	if (current_page == nullptr) {
-		if (pages.empty()) {
+		if (next_page == ring.GetTail()) {
 			/* another thread has removed the event source
 			   while this thread was waiting for
 			   httpd.mutex */
@@ -283,12 +325,9 @@ HttpdClient::TryWrite()
 			return true;
 		}
 
-		current_page = pages.front();
-		pages.pop();
+		current_page = &ring.Get(next_page++);
+		current_page->Ref();
 		current_position = 0;
-
-		assert(queue_size >= current_page->size);
-		queue_size -= current_page->size;
 	}
 
 	const ssize_t bytes_to_write = GetBytesTillMetaData();
@@ -344,8 +383,9 @@ HttpdClient::TryWrite()
 		}
 	} else {
 		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
+			TryWritePages(bytes_to_write >= 0
+				      ? size_t(bytes_to_write)
+				      : SIZE_MAX);
 		if (nbytes < 0) {
 			auto e = GetSocketError();
 			if (IsSocketErrorAgain(e))
@@ -362,43 +402,40 @@ HttpdClient::TryWrite()
 			return false;
 		}
 
-		current_position += nbytes;
-		assert(current_position <= current_page->size);
-
 		if (metadata_requested)
 			metadata_fill += nbytes;
 
-		if (current_position >= current_page->size) {
-			current_page->Unref();
-			current_page = nullptr;
+		ConsumePages(nbytes);
 
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				CancelWrite();
-		}
+		if (current_page == nullptr && next_page == ring.GetTail())
+			/* all pages are sent: remove the event
+			   source */
+			CancelWrite();
 	}
 
 	return true;
 }
 
 void
-HttpdClient::PushPage(Page *page)
+HttpdClient::PushHeader(Page *page)
+{
+	assert(state == RESPONSE);
+	assert(current_page == nullptr);
+
+	page->Ref();
+	current_page = page;
+	current_position = 0;
+
+	ScheduleWrite();
+}
+
+void
+HttpdClient::NotifyPages()
 {
 	if (state != RESPONSE)
 		/* the client is still writing the HTTP request */
 		return;
 
-	if (queue_size > 256 * 1024) {
-		FormatDebug(httpd_output_domain,
-			    "client is too slow, flushing its queue");
-		ClearQueue();
-	}
-
-	page->Ref();
-	pages.push(page);
-	queue_size += page->size;
-
 	ScheduleWrite();
 }
 
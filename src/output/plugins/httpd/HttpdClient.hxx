@@ -23,10 +23,8 @@
 #include "event/BufferedSocket.hxx"
 #include "Compiler.h"
 
-#include <queue>
-#include <list>
-
 #include <stddef.h>
+#include <stdint.h>
 
 class HttpdOutput;
 class Page;
@@ -52,17 +50,16 @@ class HttpdClient final : BufferedSocket {
 	} state;
 
 	/**
-	 * A queue of #Page objects to be sent to the client.
-	 */
-	std::queue<Page *, std::list<Page *>> pages;
-
-	/**
-	 * The sum of all page sizes in #pages.
+	 * The sequence number of the next page in the output's
+	 * #PageRing to be sent to the client.
 	 */
-	size_t queue_size;
+	uint64_t next_page;
 
 	/**
 	 * The #page which is currently being sent to the client.
+	 * This is either the header or a page from the #PageRing;
+	 * the client holds its own reference, so the ring may drop
+	 * it meanwhile.
 	 */
 	Page *current_page;
 
@@ -143,7 +140,7 @@ public:
 	void LockClose();
 
 	/**
-	 * Clears the page queue.
+	 * Skips all pages which have not been sent yet.
 	 */
 	void CancelQueue();
 
@@ -166,14 +163,27 @@ public:
 	ssize_t GetBytesTillMetaData() const;
 
 	ssize_t TryWritePage(const Page &page, size_t position);
-	ssize_t TryWritePageN(const Page &page, size_t position, ssize_t n);
+
+	/**
+	 * Sends the rest of #current_page and the following pages of
+	 * the #PageRing with one system call.
+	 *
+	 * @param limit the maximum number of bytes
+	 */
+	ssize_t TryWritePages(size_t limit);
 
 	bool TryWrite();
 
 	/**
-	 * Appends a page to the client's queue.
+	 * Sends the specified page before the pages of the
+	 * #PageRing.  This is used for the encoder header.
+	 */
+	void PushHeader(Page *page);
+
+	/**
+	 * New pages have been added to the #PageRing.
 	 */
-	void PushPage(Page *page);
+	void NotifyPages();
 
 	/**
 	 * Sends the passed metadata.
@@ -181,7 +191,11 @@ public:
 	void PushMetaData(Page *page);
 
 private:
-	void ClearQueue();
+	/**
+	 * Mark the specified number of bytes (starting at
+	 * #current_page) as sent.
+	 */
+	void ConsumePages(size_t nbytes);
 
 protected:
 	virtual bool OnSocketReady(unsigned flags) override;
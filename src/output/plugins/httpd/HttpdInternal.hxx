@@ -25,6 +25,7 @@
 #ifndef MPD_OUTPUT_HTTPD_INTERNAL_H
 #define MPD_OUTPUT_HTTPD_INTERNAL_H
 
+#include "PageRing.hxx"
 #include "output/Internal.hxx"
 #include "output/Timer.hxx"
 #include "thread/Mutex.hxx"
@@ -116,6 +117,13 @@ private:
 	 */
 	std::queue<Page *, std::list<Page *>> pages;
 
+	/**
+	 * The pages which were broadcasted recently.  All clients
+	 * send from this ring, each at its own position.  It is only
+	 * accessed in the IOThread, while #mutex is locked.
+	 */
+	PageRing ring;
+
  public:
 	/**
 	 * The configured name.
@@ -214,6 +222,13 @@ public:
 		return HasClients();
 	}
 
+	/**
+	 * Shall PCM data be fed into the encoder?  That is the case
+	 * if there are clients, or if other outputs share the encoder.
+	 */
+	gcc_pure
+	bool LockWantsEncoder() const;
+
 	void AddClient(int fd);
 
 	/**
@@ -227,6 +242,10 @@ public:
 	 */
 	void SendHeader(HttpdClient &client) const;
 
+	const PageRing &GetPageRing() const {
+		return ring;
+	}
+
 	gcc_pure
 	unsigned Delay() const;
 
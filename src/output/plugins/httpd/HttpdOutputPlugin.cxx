@@ -24,6 +24,7 @@
 #include "output/OutputAPI.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
 #include "system/Resolver.hxx"
 #include "Page.hxx"
 #include "IcyMetaDataServer.hxx"
@@ -120,9 +121,15 @@ HttpdOutput::Configure(const config_param &param, Error &error)
 	if (!success)
 		return false;
 
-	/* initialize encoder */
+	/* initialize encoder; outputs with the same encoder settings
+	   share one encoder */
 
-	encoder = encoder_init(*encoder_plugin, param, error);
+	static constexpr const char *ignore[] = {
+		"genre", "website", "port", "bind_to_address",
+		"max_clients", "encoder", nullptr,
+	};
+
+	encoder = shared_encoder_init(*encoder_plugin, param, ignore, error);
 	if (encoder == nullptr)
 		return false;
 
@@ -179,19 +186,20 @@ HttpdOutput::AddClient(int fd)
 void
 HttpdOutput::RunDeferred()
 {
-	/* this method runs in the IOThread; it broadcasts pages from
-	   our own queue to all clients */
+	/* this method runs in the IOThread; it moves pages from our
+	   own queue to the ring which is shared by all clients */
 
 	const ScopeLock protect(mutex);
 
-	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
+	if (!pages.empty()) {
+		do {
+			/* the ring takes over the reference */
+			ring.Push(pages.front());
+			pages.pop();
+		} while (!pages.empty());
 
 		for (auto &client : clients)
-			client.PushPage(page);
-
-		page->Unref();
+			client.NotifyPages();
 	}
 
 	/* wake up the client that may be waiting for the queue to be
@@ -349,6 +357,7 @@ HttpdOutput::Close()
 
 	BlockingCall(GetEventLoop(), [this](){
 			clients.clear();
+			ring.Clear();
 		});
 
 	if (header != nullptr)
@@ -386,13 +395,19 @@ void
 HttpdOutput::SendHeader(HttpdClient &client) const
 {
 	if (header != nullptr)
-		client.PushPage(header);
+		client.PushHeader(header);
+}
+
+bool
+HttpdOutput::LockWantsEncoder() const
+{
+	return LockHasClients() || shared_encoder_has_peers(encoder);
 }
 
 inline unsigned
 HttpdOutput::Delay() const
 {
-	if (!LockHasClients() && base.pause) {
+	if (!LockWantsEncoder() && base.pause) {
 		/* if there's no client and this output is paused,
 		   then httpd_output_pause() will not do anything, it
 		   will not fill the buffer and it will not update the
@@ -463,7 +478,7 @@ HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, Error &error)
 inline size_t
 HttpdOutput::Play(const void *chunk, size_t size, Error &error)
 {
-	if (LockHasClients()) {
+	if (LockWantsEncoder()) {
 		if (!EncodeAndPlay(chunk, size, error))
 			return 0;
 	}
@@ -489,7 +504,7 @@ httpd_output_pause(AudioOutput *ao)
 {
 	HttpdOutput *httpd = HttpdOutput::Cast(ao);
 
-	if (httpd->LockHasClients()) {
+	if (httpd->LockWantsEncoder()) {
 		static const char silence[1020] = { 0 };
 		return httpd_output_play(ao, silence, sizeof(silence),
 					 IgnoreError()) > 0;
@@ -566,6 +581,8 @@ HttpdOutput::CancelAllClients()
 		page->Unref();
 	}
 
+	ring.Clear();
+
 	for (auto &client : clients)
 		client.CancelQueue();
 
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_HTTPD_PAGE_RING_HXX
+#define MPD_OUTPUT_HTTPD_PAGE_RING_HXX
+
+#include "Page.hxx"
+#include "Compiler.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A bounded ring of #Page objects which is shared by all clients of
+ * one httpd output.  Every page gets a sequence number; each client
+ * remembers the sequence number of the next page it is going to
+ * send, instead of keeping its own page queue.
+ *
+ * When the ring is full, the oldest pages are dropped.  Clients
+ * whose position has been dropped are too slow, and have to skip
+ * ahead to GetHead().
+ *
+ * This class is not thread-safe.
+ */
+class PageRing {
+	static constexpr size_t CAPACITY = 1024;
+
+	/**
+	 * The maximum sum of all page sizes.
+	 */
+	static constexpr size_t MAX_SIZE = 256 * 1024;
+
+	Page *slots[CAPACITY];
+
+	/**
+	 * The sequence number of the oldest page in the ring.
+	 */
+	uint64_t head;
+
+	/**
+	 * The sequence number which will be assigned to the next
+	 * page.
+	 */
+	uint64_t tail;
+
+	/**
+	 * The sum of all page sizes.
+	 */
+	size_t size;
+
+public:
+	PageRing():head(0), tail(0), size(0) {}
+
+	~PageRing() {
+		Clear();
+	}
+
+	PageRing(const PageRing &) = delete;
+	PageRing &operator=(const PageRing &) = delete;
+
+	uint64_t GetHead() const {
+		return head;
+	}
+
+	uint64_t GetTail() const {
+		return tail;
+	}
+
+	/**
+	 * Does the ring still contain the page with the specified
+	 * sequence number?
+	 */
+	bool Contains(uint64_t sequence) const {
+		return sequence >= head && sequence < tail;
+	}
+
+	gcc_pure
+	Page &Get(uint64_t sequence) const {
+		assert(Contains(sequence));
+
+		return *slots[sequence % CAPACITY];
+	}
+
+	/**
+	 * Append a page, dropping old pages if the ring is full.  The
+	 * ring takes over the caller's reference.
+	 */
+	void Push(Page *page) {
+		assert(page != nullptr);
+
+		while (tail > head &&
+		       (tail - head >= CAPACITY ||
+			size + page->size > MAX_SIZE))
+			PopFront();
+
+		slots[tail % CAPACITY] = page;
+		++tail;
+		size += page->size;
+	}
+
+	/**
+	 * Drop all pages.  The sequence numbers of new pages continue
+	 * to grow.
+	 */
+	void Clear() {
+		while (tail > head)
+			PopFront();
+	}
+
+private:
+	void PopFront() {
+		assert(tail > head);
+
+		Page *page = slots[head % CAPACITY];
+		++head;
+
+		assert(size >= page->size);
+		size -= page->size;
+		page->Unref();
+	}
+};
+
+#endif
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_AVX2_HXX
+#define MPD_PCM_AVX2_HXX
+
+#include <immintrin.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * PCM kernels using x86 AVX2.  This header is only included by
+ * Simd.cxx, which selects them at runtime.  They operate on unaligned
+ * buffers and return the number of samples processed.
+ */
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+static AVX2_TARGET size_t
+avx2_volume_float(float *dest, const float *src, size_t n, float volume)
+{
+	const __m256 v = _mm256_set1_ps(volume);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_loadu_ps(src + i), v));
+
+	return i;
+}
+
+static AVX2_TARGET size_t
+avx2_add_vol_float(float *a, const float *b, size_t n,
+		   float volume1, float volume2)
+{
+	const __m256 v1 = _mm256_set1_ps(volume1);
+	const __m256 v2 = _mm256_set1_ps(volume2);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		/* no FMA here: the result must be rounded just like
+		   the portable code does */
+		__m256 x = _mm256_mul_ps(_mm256_loadu_ps(a + i), v1);
+		__m256 y = _mm256_mul_ps(_mm256_loadu_ps(b + i), v2);
+		_mm256_storeu_ps(a + i, _mm256_add_ps(x, y));
+	}
+
+	return i;
+}
+
+static AVX2_TARGET size_t
+avx2_add_float(float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(a + i,
+				 _mm256_add_ps(_mm256_loadu_ps(a + i),
+					       _mm256_loadu_ps(b + i)));
+
+	return i;
+}
+
+static AVX2_TARGET inline __m256i
+avx2_load(const void *p)
+{
+	return _mm256_loadu_si256((const __m256i *)p);
+}
+
+static AVX2_TARGET inline void
+avx2_store(void *p, __m256i x)
+{
+	_mm256_storeu_si256((__m256i *)p, x);
+}
+
+static AVX2_TARGET size_t
+avx2_add_8(int8_t *a, const int8_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32)
+		avx2_store(a + i, _mm256_adds_epi8(avx2_load(a + i),
+						   avx2_load(b + i)));
+
+	return i;
+}
+
+static AVX2_TARGET size_t
+avx2_add_16(int16_t *a, const int16_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+		avx2_store(a + i, _mm256_adds_epi16(avx2_load(a + i),
+						    avx2_load(b + i)));
+
+	return i;
+}
+
+/**
+ * Add 32 bit integers and clamp the result to [min, max].  The sum
+ * must not overflow 32 bit.
+ */
+static AVX2_TARGET size_t
+avx2_add_clamp_32(int32_t *a, const int32_t *b, size_t n,
+		  int32_t min, int32_t max)
+{
+	const __m256i vmin = _mm256_set1_epi32(min);
+	const __m256i vmax = _mm256_set1_epi32(max);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_add_epi32(avx2_load(a + i),
+					     avx2_load(b + i));
+		x = _mm256_max_epi32(_mm256_min_epi32(x, vmax), vmin);
+		avx2_store(a + i, x);
+	}
+
+	return i;
+}
+
+static AVX2_TARGET size_t
+avx2_add_32(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m256i max = _mm256_set1_epi32(0x7fffffff);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = avx2_load(a + i), y = avx2_load(b + i);
+		const __m256i sum = _mm256_add_epi32(x, y);
+
+		/* the addition has overflowed if both operands have
+		   the same sign, and the sum has a different one */
+		const __m256i overflow =
+			_mm256_andnot_si256(_mm256_xor_si256(x, y),
+					    _mm256_xor_si256(x, sum));
+
+		/* INT32_MAX if x is positive, INT32_MIN otherwise */
+		const __m256i saturated =
+			_mm256_xor_si256(_mm256_srai_epi32(x, 31), max);
+
+		/* blendv looks only at the most significant bit of
+		   each byte, so the overflow flag is spread with a
+		   shift first */
+		avx2_store(a + i,
+			   _mm256_blendv_epi8(sum, saturated,
+					      _mm256_srai_epi32(overflow, 31)));
+	}
+
+	return i;
+}
+
+/**
+ * Sign-extend 16 bit samples to 32 bit and shift them to the left.
+ */
+static AVX2_TARGET size_t
+avx2_convert_16_to_32(int32_t *dest, const int16_t *src, size_t n,
+		      unsigned shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		avx2_store(dest + i,
+			   _mm256_sll_epi32(_mm256_cvtepi16_epi32(x), count));
+	}
+
+	return i;
+}
+
+static AVX2_TARGET size_t
+avx2_shift_left_32(int32_t *dest, const int32_t *src, size_t n,
+		   unsigned shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		avx2_store(dest + i,
+			   _mm256_sll_epi32(avx2_load(src + i), count));
+
+	return i;
+}
+
+static AVX2_TARGET size_t
+avx2_shift_right_32(int32_t *dest, const int32_t *src, size_t n,
+		    unsigned shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		avx2_store(dest + i,
+			   _mm256_sra_epi32(avx2_load(src + i), count));
+
+	return i;
+}
+
+static AVX2_TARGET size_t
+avx2_convert_16_to_float(float *dest, const int16_t *src, size_t n,
+			 float factor)
+{
+	const __m256 f = _mm256_set1_ps(factor);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		const __m256i y = _mm256_cvtepi16_epi32(x);
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(y), f));
+	}
+
+	return i;
+}
+
+static AVX2_TARGET size_t
+avx2_convert_32_to_float(float *dest, const int32_t *src, size_t n,
+			 float factor)
+{
+	const __m256 f = _mm256_set1_ps(factor);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(avx2_load(src + i)),
+					       f));
+
+	return i;
+}
+
+/**
+ * Scale a float vector and convert it to 32 bit integers with
+ * truncation, clamping to [min, max].  The parameters "fmin" and
+ * "fmax" are min-1 and max+1 as float: values reaching them would
+ * truncate to an integer outside of the range.
+ */
+static AVX2_TARGET inline __m256i
+avx2_float_to_int(const float *src, __m256 factor,
+		  __m256 fmin, __m256 fmax, __m256i min, __m256i max)
+{
+	const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src), factor);
+	__m256i r = _mm256_cvttps_epi32(x);
+	r = _mm256_blendv_epi8(r, max,
+			       _mm256_castps_si256(_mm256_cmp_ps(x, fmax,
+								 _CMP_GE_OQ)));
+	r = _mm256_blendv_epi8(r, min,
+			       _mm256_castps_si256(_mm256_cmp_ps(x, fmin,
+								 _CMP_LE_OQ)));
+	return r;
+}
+
+static AVX2_TARGET size_t
+avx2_convert_float_to_16(int16_t *dest, const float *src, size_t n,
+			 float factor)
+{
+	const __m256 f = _mm256_set1_ps(factor);
+	const __m256 fmin = _mm256_set1_ps(INT16_MIN - 1);
+	const __m256 fmax = _mm256_set1_ps(INT16_MAX + 1);
+	const __m256i min = _mm256_set1_epi32(INT16_MIN);
+	const __m256i max = _mm256_set1_epi32(INT16_MAX);
+
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256i lo = avx2_float_to_int(src + i, f,
+						     fmin, fmax, min, max);
+		const __m256i hi = avx2_float_to_int(src + i + 8, f,
+						     fmin, fmax, min, max);
+
+		/* the pack instruction works on each 128 bit lane
+		   separately; restore the order of the 64 bit
+		   quarters */
+		const __m256i packed = _mm256_packs_epi32(lo, hi);
+		avx2_store(dest + i, _mm256_permute4x64_epi64(packed, 0xd8));
+	}
+
+	return i;
+}
+
+static AVX2_TARGET size_t
+avx2_convert_float_to_32(int32_t *dest, const float *src, size_t n,
+			 float factor, int32_t min, int32_t max)
+{
+	const __m256 f = _mm256_set1_ps(factor);
+	const __m256 fmin = _mm256_set1_ps(double(min) - 1);
+	const __m256 fmax = _mm256_set1_ps(double(max) + 1);
+	const __m256i vmin = _mm256_set1_epi32(min);
+	const __m256i vmax = _mm256_set1_epi32(max);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		avx2_store(dest + i,
+			   avx2_float_to_int(src + i, f,
+					     fmin, fmax, vmin, vmax));
+
+	return i;
+}
+
+#undef AVX2_TARGET
+
+#endif
@@ -21,6 +21,9 @@
 #define MPD_PCM_FLOAT_CONVERT_HXX
 
 #include "Traits.hxx"
+#include "Compiler.h"
+
+#include <stdint.h>
 
 /**
  * Convert from float to an integer sample format.
@@ -31,14 +34,24 @@ struct FloatToIntegerSampleConvert {
 	typedef Traits DstTraits;
 
 	typedef typename SrcTraits::value_type SV;
-	typedef typename SrcTraits::long_type SL;
 	typedef typename DstTraits::value_type DV;
 
-	static constexpr SV factor = 1 << (DstTraits::BITS - 1);
+	static constexpr SV factor = uintmax_t(1) << (DstTraits::BITS - 1);
 
 	gcc_const
 	static DV Convert(SV src) {
-		return PcmClamp<F, Traits>(SL(src * factor));
+		const SV x = src * factor;
+
+		/* clamp before converting to an integer, because the
+		   conversion of an out-of-range value is undefined;
+		   these are the same limits as in the SIMD kernels */
+		if (gcc_unlikely(x >= SV(double(DstTraits::MAX) + 1)))
+			return DstTraits::MAX;
+
+		if (gcc_unlikely(x <= SV(double(DstTraits::MIN) - 1)))
+			return DstTraits::MIN;
+
+		return DV(x);
 	}
 };
 
@@ -21,11 +21,12 @@
 #include "PcmConvert.hxx"
 #include "Domain.hxx"
 #include "ConfiguredResampler.hxx"
+#include "PcmFormat.hxx"
 #include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
-#include "util/ConstBuffer.hxx"
 
 #include <assert.h>
 #include <math.h>
@@ -96,6 +97,11 @@ PcmConvert::Open(AudioFormat _src_format, AudioFormat _dest_format,
 		return false;
 	}
 
+	in_place = !enable_resampler && !enable_channels &&
+		src_format.format != SampleFormat::DSD &&
+		pcm_can_convert_in_place(src_format.format,
+					 dest_format.format);
+
 	return true;
 }
 
@@ -162,3 +168,13 @@ PcmConvert::Convert(ConstBuffer<void> buffer, Error &error)
 
 	return buffer;
 }
+
+void
+PcmConvert::ConvertInPlace(WritableBuffer<void> buffer)
+{
+	assert(in_place);
+
+	if (enable_format)
+		pcm_convert_in_place(src_format.format, dest_format.format,
+				     buffer);
+}
@@ -30,6 +30,7 @@
 #include <stddef.h>
 
 template<typename T> struct ConstBuffer;
+template<typename T> struct WritableBuffer;
 class Error;
 class Domain;
 
@@ -49,6 +50,12 @@ class PcmConvert {
 
 	bool enable_resampler, enable_format, enable_channels;
 
+	/**
+	 * Do the two formats differ only in a sample format of the
+	 * same size?  See CanConvertInPlace().
+	 */
+	bool in_place;
+
 public:
 	PcmConvert();
 	~PcmConvert();
@@ -76,6 +83,21 @@ public:
 	 * @return the destination buffer, or nullptr on error
 	 */
 	ConstBuffer<void> Convert(ConstBuffer<void> src, Error &error);
+
+	/**
+	 * Can the conversion be done with ConvertInPlace()?  This is
+	 * the case if only the sample format differs, and both
+	 * sample formats have the same size.
+	 */
+	bool CanConvertInPlace() const {
+		return in_place;
+	}
+
+	/**
+	 * Converts PCM data, overwriting the source buffer.  This is
+	 * only allowed if CanConvertInPlace() returns true.
+	 */
+	void ConvertInPlace(WritableBuffer<void> buffer);
 };
 
 bool
@@ -24,7 +24,12 @@
 #include "Traits.hxx"
 #include "FloatConvert.hxx"
 #include "ShiftConvert.hxx"
+#include "Simd.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <assert.h>
+#include <string.h>
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
 
@@ -106,6 +111,27 @@ public:
 	}
 };
 
+/**
+ * A template class which lets a runtime-selected kernel from
+ * Simd.hxx convert as much of the buffer as it can, and calls the
+ * "portable" algorithm for the rest.
+ */
+template<typename Portable,
+	 size_t (*simd)(typename Portable::DstTraits::pointer_type,
+			typename Portable::SrcTraits::const_pointer_type,
+			size_t)>
+struct GlueSimdConvert : Portable {
+	typedef typename Portable::SrcTraits SrcTraits;
+	typedef typename Portable::DstTraits DstTraits;
+
+	void Convert(typename DstTraits::pointer_type out,
+		     typename SrcTraits::const_pointer_type in,
+		     size_t n) const {
+		const size_t done = simd(out, in, n);
+		Portable::Convert(out + done, in + done, n - done);
+	}
+};
+
 #ifdef __ARM_NEON__
 #include "Neon.hxx"
 
@@ -114,8 +140,26 @@ struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
 	: GlueOptimizedConvert<NeonFloatTo16,
 			       PortableFloatToInteger<SampleFormat::S16>> {};
 
+#else
+
+template<>
+struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
+	: GlueSimdConvert<PortableFloatToInteger<SampleFormat::S16>,
+			  pcm_simd_convert_float_to_16> {};
+
 #endif
 
+template<>
+struct FloatToInteger<SampleFormat::S24_P32,
+		      SampleTraits<SampleFormat::S24_P32>>
+	: GlueSimdConvert<PortableFloatToInteger<SampleFormat::S24_P32>,
+			  pcm_simd_convert_float_to_24> {};
+
+template<>
+struct FloatToInteger<SampleFormat::S32, SampleTraits<SampleFormat::S32>>
+	: GlueSimdConvert<PortableFloatToInteger<SampleFormat::S32>,
+			  pcm_simd_convert_float_to_32> {};
+
 template<class C>
 static ConstBuffer<typename C::DstTraits::value_type>
 AllocateConvert(PcmBuffer &buffer, C convert,
@@ -196,8 +240,9 @@ struct Convert8To24
 						  SampleFormat::S24_P32>> {};
 
 struct Convert16To24
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S24_P32>> {};
+	: GlueSimdConvert<PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
+								  SampleFormat::S24_P32>>,
+			  pcm_simd_convert_16_to_24> {};
 
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_24(PcmBuffer &buffer, ConstBuffer<int8_t> src)
@@ -212,8 +257,9 @@ pcm_allocate_16_to_24(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 }
 
 struct Convert32To24
-	: PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
-						   SampleFormat::S24_P32>> {};
+	: GlueSimdConvert<PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
+								   SampleFormat::S24_P32>>,
+			  pcm_simd_convert_32_to_24> {};
 
 static ConstBuffer<int32_t>
 pcm_allocate_32_to_24(PcmBuffer &buffer, ConstBuffer<int32_t> src)
@@ -264,12 +310,14 @@ struct Convert8To32
 						  SampleFormat::S32>> {};
 
 struct Convert16To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S32>> {};
+	: GlueSimdConvert<PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
+								  SampleFormat::S32>>,
+			  pcm_simd_convert_16_to_32> {};
 
 struct Convert24To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
-						  SampleFormat::S32>> {};
+	: GlueSimdConvert<PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
+								  SampleFormat::S32>>,
+			  pcm_simd_convert_24_to_32> {};
 
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_32(PcmBuffer &buffer, ConstBuffer<int8_t> src)
@@ -331,13 +379,16 @@ struct Convert8ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S8>> {};
 
 struct Convert16ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>> {};
+	: GlueSimdConvert<PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>>,
+			  pcm_simd_convert_16_to_float> {};
 
 struct Convert24ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>> {};
+	: GlueSimdConvert<PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>>,
+			  pcm_simd_convert_24_to_float> {};
 
 struct Convert32ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>> {};
+	: GlueSimdConvert<PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>>,
+			  pcm_simd_convert_32_to_float> {};
 
 static ConstBuffer<float>
 pcm_allocate_8_to_float(PcmBuffer &buffer, ConstBuffer<int8_t> src)
@@ -394,3 +445,76 @@ pcm_convert_to_float(PcmBuffer &buffer,
 
 	return nullptr;
 }
+
+static constexpr bool
+IsInPlaceFormat(SampleFormat format)
+{
+	return format == SampleFormat::S24_P32 ||
+		format == SampleFormat::S32 ||
+		format == SampleFormat::FLOAT;
+}
+
+bool
+pcm_can_convert_in_place(SampleFormat src_format, SampleFormat dest_format)
+{
+	return IsInPlaceFormat(src_format) && IsInPlaceFormat(dest_format);
+}
+
+/**
+ * Convert one sample at a time, reading each sample before it gets
+ * overwritten.  The samples are copied with memcpy(), because the
+ * buffer is accessed with two different types.
+ */
+template<typename C>
+static void
+ConvertInPlace(WritableBuffer<void> buffer)
+{
+	typedef typename C::SrcTraits::value_type SV;
+	typedef typename C::DstTraits::value_type DV;
+	static_assert(sizeof(SV) == sizeof(DV), "Sample sizes differ");
+
+	uint8_t *p = (uint8_t *)buffer.data;
+	for (size_t n = buffer.size / sizeof(SV); n > 0;
+	     --n, p += sizeof(SV)) {
+		SV src;
+		memcpy(&src, p, sizeof(src));
+		const DV dest = C::Convert(src);
+		memcpy(p, &dest, sizeof(dest));
+	}
+}
+
+void
+pcm_convert_in_place(SampleFormat src_format, SampleFormat dest_format,
+		     WritableBuffer<void> buffer)
+{
+	assert(pcm_can_convert_in_place(src_format, dest_format));
+
+	switch (dest_format) {
+	case SampleFormat::S24_P32:
+		if (src_format == SampleFormat::S32)
+			ConvertInPlace<RightShiftSampleConvert<SampleFormat::S32,
+							       SampleFormat::S24_P32>>(buffer);
+		else if (src_format == SampleFormat::FLOAT)
+			ConvertInPlace<FloatToIntegerSampleConvert<SampleFormat::S24_P32>>(buffer);
+		break;
+
+	case SampleFormat::S32:
+		if (src_format == SampleFormat::S24_P32)
+			ConvertInPlace<LeftShiftSampleConvert<SampleFormat::S24_P32,
+							      SampleFormat::S32>>(buffer);
+		else if (src_format == SampleFormat::FLOAT)
+			ConvertInPlace<FloatToIntegerSampleConvert<SampleFormat::S32>>(buffer);
+		break;
+
+	case SampleFormat::FLOAT:
+		if (src_format == SampleFormat::S24_P32)
+			ConvertInPlace<IntegerToFloatSampleConvert<SampleFormat::S24_P32>>(buffer);
+		else if (src_format == SampleFormat::S32)
+			ConvertInPlace<IntegerToFloatSampleConvert<SampleFormat::S32>>(buffer);
+		break;
+
+	default:
+		assert(false);
+		gcc_unreachable();
+	}
+}
@@ -26,6 +26,7 @@
 #include <stddef.h>
 
 template<typename T> struct ConstBuffer;
+template<typename T> struct WritableBuffer;
 class PcmBuffer;
 class PcmDither;
 
@@ -85,4 +86,22 @@ ConstBuffer<float>
 pcm_convert_to_float(PcmBuffer &buffer,
 		     SampleFormat src_format, ConstBuffer<void> src);
 
+/**
+ * Can pcm_convert_in_place() convert between these two sample
+ * formats?  This is true for the formats which have the same sample
+ * size (24 bit with 32 bit alignment, 32 bit and floating point).
+ */
+gcc_const
+bool
+pcm_can_convert_in_place(SampleFormat src_format, SampleFormat dest_format);
+
+/**
+ * Converts PCM samples to another sample format of the same size,
+ * overwriting the source buffer.  This is only allowed if
+ * pcm_can_convert_in_place() returns true.
+ */
+void
+pcm_convert_in_place(SampleFormat src_format, SampleFormat dest_format,
+		     WritableBuffer<void> buffer);
+
 #endif
@@ -21,6 +21,7 @@
 #include "PcmMix.hxx"
 #include "Volume.hxx"
 #include "PcmUtils.hxx"
+#include "Simd.hxx"
 #include "AudioFormat.hxx"
 #include "Traits.hxx"
 #include "util/Clamp.hxx"
@@ -75,6 +76,13 @@ static void
 pcm_add_vol_float(float *buffer1, const float *buffer2,
 		  unsigned num_samples, float volume1, float volume2)
 {
+	const size_t done = pcm_simd_add_vol_float(buffer1, buffer2,
+						   num_samples,
+						   volume1, volume2);
+	buffer1 += done;
+	buffer2 += done;
+	num_samples -= done;
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -151,21 +159,36 @@ PcmAdd(typename Traits::pointer_type a,
 		a[i] = PcmAdd<F, Traits>(a[i], b[i]);
 }
 
+/**
+ * @param simd an optimized kernel from Simd.hxx which processes the
+ * first part of the buffer
+ */
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static void
-PcmAddVoid(void *a, const void *b, size_t size)
+PcmAddVoid(void *_a, const void *_b, size_t size,
+	   size_t (*simd)(typename Traits::pointer_type,
+			  typename Traits::const_pointer_type,
+			  size_t))
 {
 	constexpr size_t sample_size = Traits::SAMPLE_SIZE;
 	assert(size % sample_size == 0);
 
-	PcmAdd<F, Traits>(typename Traits::pointer_type(a),
-			  typename Traits::const_pointer_type(b),
-			  size / sample_size);
+	const auto a = typename Traits::pointer_type(_a);
+	const auto b = typename Traits::const_pointer_type(_b);
+	const size_t n = size / sample_size;
+
+	const size_t done = simd(a, b, n);
+	PcmAdd<F, Traits>(a + done, b + done, n - done);
 }
 
 static void
 pcm_add_float(float *buffer1, const float *buffer2, unsigned num_samples)
 {
+	const size_t done = pcm_simd_add_float(buffer1, buffer2, num_samples);
+	buffer1 += done;
+	buffer2 += done;
+	num_samples -= done;
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -185,19 +208,23 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return false;
 
 	case SampleFormat::S8:
-		PcmAddVoid<SampleFormat::S8>(buffer1, buffer2, size);
+		PcmAddVoid<SampleFormat::S8>(buffer1, buffer2, size,
+					     pcm_simd_add_8);
 		return true;
 
 	case SampleFormat::S16:
-		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size);
+		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size,
+					      pcm_simd_add_16);
 		return true;
 
 	case SampleFormat::S24_P32:
-		PcmAddVoid<SampleFormat::S24_P32>(buffer1, buffer2, size);
+		PcmAddVoid<SampleFormat::S24_P32>(buffer1, buffer2, size,
+						  pcm_simd_add_24);
 		return true;
 
 	case SampleFormat::S32:
-		PcmAddVoid<SampleFormat::S32>(buffer1, buffer2, size);
+		PcmAddVoid<SampleFormat::S32>(buffer1, buffer2, size,
+					      pcm_simd_add_32);
 		return true;
 
 	case SampleFormat::FLOAT:
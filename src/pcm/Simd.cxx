@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Simd.hxx"
+#include "Traits.hxx"
+#include "PcmUtils.hxx"
+#include "FloatConvert.hxx"
+
+#include <atomic>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(GCC_CHECK_VERSION(4,9) || \
+	 (defined(__clang__) && CLANG_VERSION >= 30800))
+/* these compilers allow using intrinsics in functions with a
+   "target" attribute, without enabling them for the whole file */
+#define ENABLE_X86_SIMD
+#include "Sse2.hxx"
+#include "Avx2.hxx"
+#endif
+
+SimdLevel
+pcm_simd_detect()
+{
+#ifdef ENABLE_X86_SIMD
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return SimdLevel::AVX2;
+
+	if (__builtin_cpu_supports("sse2"))
+		return SimdLevel::SSE2;
+#endif
+
+	return SimdLevel::NONE;
+}
+
+/**
+ * The level used by the kernels.  It may be changed while other
+ * threads run the kernels; each dispatch picks one consistent
+ * value, and no other memory depends on it, so relaxed ordering is
+ * enough.
+ */
+static std::atomic<SimdLevel> simd_level(pcm_simd_detect());
+
+SimdLevel
+pcm_simd_get_level()
+{
+	return simd_level.load(std::memory_order_relaxed);
+}
+
+SimdLevel
+pcm_simd_set_level(SimdLevel level)
+{
+	const SimdLevel max = pcm_simd_detect();
+	if (level > max)
+		level = max;
+
+	simd_level.store(level, std::memory_order_relaxed);
+	return level;
+}
+
+#ifdef ENABLE_X86_SIMD
+
+/**
+ * Call the best kernel implementation for #simd_level, and return
+ * its result from the calling function.
+ */
+#define SIMD_DISPATCH(name, ...) do { \
+	switch (simd_level.load(std::memory_order_relaxed)) { \
+	case SimdLevel::NONE: \
+		break; \
+	case SimdLevel::SSE2: \
+		return sse2_ ## name(__VA_ARGS__); \
+	case SimdLevel::AVX2: \
+		return avx2_ ## name(__VA_ARGS__); \
+	} \
+} while (0)
+
+#else
+
+template<typename... Args>
+static inline void
+IgnoreArguments(Args...)
+{
+}
+
+#define SIMD_DISPATCH(name, ...) IgnoreArguments(__VA_ARGS__)
+
+#endif
+
+size_t
+pcm_simd_volume_float(float *dest, const float *src, size_t n, float volume)
+{
+	SIMD_DISPATCH(volume_float, dest, src, n, volume);
+	return 0;
+}
+
+size_t
+pcm_simd_add_vol_float(float *a, const float *b, size_t n,
+		       float volume1, float volume2)
+{
+	SIMD_DISPATCH(add_vol_float, a, b, n, volume1, volume2);
+	return 0;
+}
+
+size_t
+pcm_simd_add_float(float *a, const float *b, size_t n)
+{
+	SIMD_DISPATCH(add_float, a, b, n);
+	return 0;
+}
+
+size_t
+pcm_simd_add_8(int8_t *a, const int8_t *b, size_t n)
+{
+	SIMD_DISPATCH(add_8, a, b, n);
+	return 0;
+}
+
+size_t
+pcm_simd_add_16(int16_t *a, const int16_t *b, size_t n)
+{
+	SIMD_DISPATCH(add_16, a, b, n);
+	return 0;
+}
+
+size_t
+pcm_simd_add_24(int32_t *a, const int32_t *b, size_t n)
+{
+	typedef SampleTraits<SampleFormat::S24_P32> Traits;
+
+	SIMD_DISPATCH(add_clamp_32, a, b, n, Traits::MIN, Traits::MAX);
+	return 0;
+}
+
+size_t
+pcm_simd_add_32(int32_t *a, const int32_t *b, size_t n)
+{
+	SIMD_DISPATCH(add_32, a, b, n);
+	return 0;
+}
+
+size_t
+pcm_simd_convert_16_to_24(int32_t *dest, const int16_t *src, size_t n)
+{
+	SIMD_DISPATCH(convert_16_to_32, dest, src, n, 8u);
+	return 0;
+}
+
+size_t
+pcm_simd_convert_16_to_32(int32_t *dest, const int16_t *src, size_t n)
+{
+	SIMD_DISPATCH(convert_16_to_32, dest, src, n, 16u);
+	return 0;
+}
+
+size_t
+pcm_simd_convert_24_to_32(int32_t *dest, const int32_t *src, size_t n)
+{
+	SIMD_DISPATCH(shift_left_32, dest, src, n, 8u);
+	return 0;
+}
+
+size_t
+pcm_simd_convert_32_to_24(int32_t *dest, const int32_t *src, size_t n)
+{
+	SIMD_DISPATCH(shift_right_32, dest, src, n, 8u);
+	return 0;
+}
+
+size_t
+pcm_simd_convert_16_to_float(float *dest, const int16_t *src, size_t n)
+{
+	typedef IntegerToFloatSampleConvert<SampleFormat::S16> C;
+
+	SIMD_DISPATCH(convert_16_to_float, dest, src, n, C::factor);
+	return 0;
+}
+
+size_t
+pcm_simd_convert_24_to_float(float *dest, const int32_t *src, size_t n)
+{
+	typedef IntegerToFloatSampleConvert<SampleFormat::S24_P32> C;
+
+	SIMD_DISPATCH(convert_32_to_float, dest, src, n, C::factor);
+	return 0;
+}
+
+size_t
+pcm_simd_convert_32_to_float(float *dest, const int32_t *src, size_t n)
+{
+	typedef IntegerToFloatSampleConvert<SampleFormat::S32> C;
+
+	SIMD_DISPATCH(convert_32_to_float, dest, src, n, C::factor);
+	return 0;
+}
+
+size_t
+pcm_simd_convert_float_to_16(int16_t *dest, const float *src, size_t n)
+{
+	typedef FloatToIntegerSampleConvert<SampleFormat::S16> C;
+
+	SIMD_DISPATCH(convert_float_to_16, dest, src, n, C::factor);
+	return 0;
+}
+
+size_t
+pcm_simd_convert_float_to_24(int32_t *dest, const float *src, size_t n)
+{
+	typedef FloatToIntegerSampleConvert<SampleFormat::S24_P32> C;
+	typedef C::DstTraits Traits;
+
+	SIMD_DISPATCH(convert_float_to_32, dest, src, n, C::factor,
+		      Traits::MIN, Traits::MAX);
+	return 0;
+}
+
+size_t
+pcm_simd_convert_float_to_32(int32_t *dest, const float *src, size_t n)
+{
+	typedef FloatToIntegerSampleConvert<SampleFormat::S32> C;
+	typedef C::DstTraits Traits;
+
+	SIMD_DISPATCH(convert_float_to_32, dest, src, n, C::factor,
+		      Traits::MIN, Traits::MAX);
+	return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_SIMD_HXX
+#define MPD_PCM_SIMD_HXX
+
+#include "Compiler.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Instruction set extensions which may be used by the optimized PCM
+ * kernels.  Each level implies all lower levels.
+ */
+enum class SimdLevel : uint8_t {
+	NONE,
+	SSE2,
+	AVX2,
+};
+
+/**
+ * Determine the best #SimdLevel supported by this CPU (and by this
+ * build).
+ */
+SimdLevel
+pcm_simd_detect();
+
+/**
+ * Returns the #SimdLevel currently used by the kernels.
+ */
+gcc_pure
+SimdLevel
+pcm_simd_get_level();
+
+/**
+ * Limit the kernels to the given #SimdLevel.  Levels not supported
+ * by this CPU are lowered to what pcm_simd_detect() returns.  This
+ * is useful for debugging and for comparing the optimized kernels
+ * with the portable code.
+ *
+ * @return the level which is now in effect
+ */
+SimdLevel
+pcm_simd_set_level(SimdLevel level);
+
+/*
+ * The kernels below are selected at runtime according to the CPU's
+ * capabilities.  Each one processes a prefix of the buffer (a
+ * multiple of its vector size) and returns the number of samples it
+ * has processed; the caller is responsible for the remaining
+ * samples.  If no optimized implementation is available, they return
+ * 0.  The results are bit-exact with the portable code.
+ */
+
+/**
+ * dest[i] = src[i] * volume
+ */
+size_t
+pcm_simd_volume_float(float *dest, const float *src, size_t n,
+		      float volume);
+
+/**
+ * a[i] = a[i] * volume1 + b[i] * volume2
+ */
+size_t
+pcm_simd_add_vol_float(float *a, const float *b, size_t n,
+		       float volume1, float volume2);
+
+/**
+ * a[i] = a[i] + b[i]
+ */
+size_t
+pcm_simd_add_float(float *a, const float *b, size_t n);
+
+/**
+ * a[i] = a[i] + b[i], with saturation.
+ */
+size_t
+pcm_simd_add_8(int8_t *a, const int8_t *b, size_t n);
+
+/**
+ * a[i] = a[i] + b[i], with saturation.
+ */
+size_t
+pcm_simd_add_16(int16_t *a, const int16_t *b, size_t n);
+
+/**
+ * a[i] = a[i] + b[i], with saturation to 24 bit.
+ */
+size_t
+pcm_simd_add_24(int32_t *a, const int32_t *b, size_t n);
+
+/**
+ * a[i] = a[i] + b[i], with saturation.
+ */
+size_t
+pcm_simd_add_32(int32_t *a, const int32_t *b, size_t n);
+
+size_t
+pcm_simd_convert_16_to_24(int32_t *dest, const int16_t *src, size_t n);
+
+size_t
+pcm_simd_convert_16_to_32(int32_t *dest, const int16_t *src, size_t n);
+
+size_t
+pcm_simd_convert_24_to_32(int32_t *dest, const int32_t *src, size_t n);
+
+size_t
+pcm_simd_convert_32_to_24(int32_t *dest, const int32_t *src, size_t n);
+
+size_t
+pcm_simd_convert_16_to_float(float *dest, const int16_t *src, size_t n);
+
+size_t
+pcm_simd_convert_24_to_float(float *dest, const int32_t *src, size_t n);
+
+size_t
+pcm_simd_convert_32_to_float(float *dest, const int32_t *src, size_t n);
+
+size_t
+pcm_simd_convert_float_to_16(int16_t *dest, const float *src, size_t n);
+
+size_t
+pcm_simd_convert_float_to_24(int32_t *dest, const float *src, size_t n);
+
+size_t
+pcm_simd_convert_float_to_32(int32_t *dest, const float *src, size_t n);
+
+#endif
@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_SSE2_HXX
+#define MPD_PCM_SSE2_HXX
+
+#include <emmintrin.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * PCM kernels using x86 SSE2.  This header is only included by
+ * Simd.cxx, which selects them at runtime.  They operate on unaligned
+ * buffers and return the number of samples processed.
+ */
+
+#define SSE2_TARGET __attribute__((target("sse2")))
+
+static SSE2_TARGET size_t
+sse2_volume_float(float *dest, const float *src, size_t n, float volume)
+{
+	const __m128 v = _mm_set1_ps(volume);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_loadu_ps(src + i), v));
+
+	return i;
+}
+
+static SSE2_TARGET size_t
+sse2_add_vol_float(float *a, const float *b, size_t n,
+		   float volume1, float volume2)
+{
+	const __m128 v1 = _mm_set1_ps(volume1), v2 = _mm_set1_ps(volume2);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(a + i), v1);
+		__m128 y = _mm_mul_ps(_mm_loadu_ps(b + i), v2);
+		_mm_storeu_ps(a + i, _mm_add_ps(x, y));
+	}
+
+	return i;
+}
+
+static SSE2_TARGET size_t
+sse2_add_float(float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(a + i, _mm_add_ps(_mm_loadu_ps(a + i),
+						_mm_loadu_ps(b + i)));
+
+	return i;
+}
+
+static SSE2_TARGET inline __m128i
+sse2_load(const void *p)
+{
+	return _mm_loadu_si128((const __m128i *)p);
+}
+
+static SSE2_TARGET inline void
+sse2_store(void *p, __m128i x)
+{
+	_mm_storeu_si128((__m128i *)p, x);
+}
+
+/**
+ * Returns x where mask is set, and y elsewhere.
+ */
+static SSE2_TARGET inline __m128i
+sse2_select(__m128i mask, __m128i x, __m128i y)
+{
+	return _mm_or_si128(_mm_and_si128(mask, x),
+			    _mm_andnot_si128(mask, y));
+}
+
+static SSE2_TARGET size_t
+sse2_add_8(int8_t *a, const int8_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+		sse2_store(a + i, _mm_adds_epi8(sse2_load(a + i),
+						sse2_load(b + i)));
+
+	return i;
+}
+
+static SSE2_TARGET size_t
+sse2_add_16(int16_t *a, const int16_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		sse2_store(a + i, _mm_adds_epi16(sse2_load(a + i),
+						 sse2_load(b + i)));
+
+	return i;
+}
+
+/**
+ * Add 32 bit integers and clamp the result to [min, max].  The sum
+ * must not overflow 32 bit.
+ */
+static SSE2_TARGET size_t
+sse2_add_clamp_32(int32_t *a, const int32_t *b, size_t n,
+		  int32_t min, int32_t max)
+{
+	const __m128i vmin = _mm_set1_epi32(min), vmax = _mm_set1_epi32(max);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_add_epi32(sse2_load(a + i), sse2_load(b + i));
+		x = sse2_select(_mm_cmpgt_epi32(x, vmax), vmax, x);
+		x = sse2_select(_mm_cmplt_epi32(x, vmin), vmin, x);
+		sse2_store(a + i, x);
+	}
+
+	return i;
+}
+
+static SSE2_TARGET size_t
+sse2_add_32(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m128i max = _mm_set1_epi32(0x7fffffff);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = sse2_load(a + i), y = sse2_load(b + i);
+		const __m128i sum = _mm_add_epi32(x, y);
+
+		/* the addition has overflowed if both operands have
+		   the same sign, and the sum has a different one */
+		const __m128i overflow =
+			_mm_srai_epi32(_mm_andnot_si128(_mm_xor_si128(x, y),
+							_mm_xor_si128(x, sum)),
+				       31);
+
+		/* INT32_MAX if x is positive, INT32_MIN otherwise */
+		const __m128i saturated =
+			_mm_xor_si128(_mm_srai_epi32(x, 31), max);
+
+		sse2_store(a + i, sse2_select(overflow, saturated, sum));
+	}
+
+	return i;
+}
+
+/**
+ * Sign-extend 16 bit samples to 32 bit and shift them to the left.
+ */
+static SSE2_TARGET size_t
+sse2_convert_16_to_32(int32_t *dest, const int16_t *src, size_t n,
+		      unsigned shift)
+{
+	/* unpacking into the upper half of each 32 bit word shifts
+	   by 16, the arithmetic right shift adjusts that */
+	const __m128i count = _mm_cvtsi32_si128(16 - shift);
+	const __m128i zero = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = sse2_load(src + i);
+		sse2_store(dest + i,
+			   _mm_sra_epi32(_mm_unpacklo_epi16(zero, x), count));
+		sse2_store(dest + i + 4,
+			   _mm_sra_epi32(_mm_unpackhi_epi16(zero, x), count));
+	}
+
+	return i;
+}
+
+static SSE2_TARGET size_t
+sse2_shift_left_32(int32_t *dest, const int32_t *src, size_t n,
+		   unsigned shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		sse2_store(dest + i, _mm_sll_epi32(sse2_load(src + i), count));
+
+	return i;
+}
+
+static SSE2_TARGET size_t
+sse2_shift_right_32(int32_t *dest, const int32_t *src, size_t n,
+		    unsigned shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		sse2_store(dest + i, _mm_sra_epi32(sse2_load(src + i), count));
+
+	return i;
+}
+
+static SSE2_TARGET size_t
+sse2_convert_16_to_float(float *dest, const int16_t *src, size_t n,
+			 float factor)
+{
+	const __m128 f = _mm_set1_ps(factor);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = sse2_load(src + i);
+		const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), f));
+		_mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), f));
+	}
+
+	return i;
+}
+
+static SSE2_TARGET size_t
+sse2_convert_32_to_float(float *dest, const int32_t *src, size_t n,
+			 float factor)
+{
+	const __m128 f = _mm_set1_ps(factor);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dest + i,
+			      _mm_mul_ps(_mm_cvtepi32_ps(sse2_load(src + i)),
+					 f));
+
+	return i;
+}
+
+/**
+ * Scale a float vector and convert it to 32 bit integers with
+ * truncation, clamping to [min, max].  The parameters "fmin" and
+ * "fmax" are min-1 and max+1 as float: values reaching them would
+ * truncate to an integer outside of the range.
+ */
+static SSE2_TARGET inline __m128i
+sse2_float_to_int(const float *src, __m128 factor,
+		  __m128 fmin, __m128 fmax, __m128i min, __m128i max)
+{
+	const __m128 x = _mm_mul_ps(_mm_loadu_ps(src), factor);
+	__m128i r = _mm_cvttps_epi32(x);
+	r = sse2_select(_mm_castps_si128(_mm_cmpge_ps(x, fmax)), max, r);
+	r = sse2_select(_mm_castps_si128(_mm_cmple_ps(x, fmin)), min, r);
+	return r;
+}
+
+static SSE2_TARGET size_t
+sse2_convert_float_to_16(int16_t *dest, const float *src, size_t n,
+			 float factor)
+{
+	const __m128 f = _mm_set1_ps(factor);
+	const __m128 fmin = _mm_set1_ps(INT16_MIN - 1);
+	const __m128 fmax = _mm_set1_ps(INT16_MAX + 1);
+	const __m128i min = _mm_set1_epi32(INT16_MIN);
+	const __m128i max = _mm_set1_epi32(INT16_MAX);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i lo = sse2_float_to_int(src + i, f,
+						     fmin, fmax, min, max);
+		const __m128i hi = sse2_float_to_int(src + i + 4, f,
+						     fmin, fmax, min, max);
+		sse2_store(dest + i, _mm_packs_epi32(lo, hi));
+	}
+
+	return i;
+}
+
+static SSE2_TARGET size_t
+sse2_convert_float_to_32(int32_t *dest, const float *src, size_t n,
+			 float factor, int32_t min, int32_t max)
+{
+	const __m128 f = _mm_set1_ps(factor);
+	const __m128 fmin = _mm_set1_ps(double(min) - 1);
+	const __m128 fmax = _mm_set1_ps(double(max) + 1);
+	const __m128i vmin = _mm_set1_epi32(min), vmax = _mm_set1_epi32(max);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		sse2_store(dest + i,
+			   sse2_float_to_int(src + i, f,
+					     fmin, fmax, vmin, vmax));
+
+	return i;
+}
+
+#undef SSE2_TARGET
+
+#endif
@@ -21,6 +21,7 @@
 #include "Volume.hxx"
 #include "Domain.hxx"
 #include "PcmUtils.hxx"
+#include "Simd.hxx"
 #include "Traits.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
@@ -92,7 +93,8 @@ static void
 pcm_volume_change_float(float *dest, const float *src, size_t n,
 			float volume)
 {
-	for (size_t i = 0; i != n; ++i)
+	for (size_t i = pcm_simd_volume_float(dest, src, n, volume);
+	     i != n; ++i)
 		dest[i] = src[i] * volume;
 }
 
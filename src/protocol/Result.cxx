@@ -23,8 +23,8 @@
 
 #include <assert.h>
 
-const char *current_command;
-int command_list_num;
+thread_local const char *current_command;
+thread_local int command_list_num;
 
 void
 command_success(Client &client)
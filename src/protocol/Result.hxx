@@ -28,8 +28,10 @@
 
 class Client;
 
-extern const char *current_command;
-extern int command_list_num;
+/* thread-local, because commands may be processed in several client
+   threads */
+extern thread_local const char *current_command;
+extern thread_local int command_list_num;
 
 void
 command_success(Client &client);
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ChangeLog.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+void
+QueueChangeLog::AddRange(uint32_t version, unsigned start, unsigned end)
+{
+	assert(start <= end);
+	assert(entries.empty() || entries.back().version <= version);
+
+	if (start == end)
+		return;
+
+	if (!entries.empty()) {
+		Entry &last = entries.back();
+		if (last.version == version &&
+		    start <= last.end && end >= last.start) {
+			last.start = std::min(last.start, start);
+			last.end = std::max(last.end, end);
+			return;
+		}
+	}
+
+	if (entries.size() >= MAX_ENTRIES) {
+		/* drop the oldest version completely, so no partial
+		   version remains */
+		const uint32_t dropped = entries.front().version;
+		do {
+			entries.pop_front();
+		} while (!entries.empty() &&
+			 entries.front().version == dropped);
+
+		if (complete_since <= dropped)
+			complete_since = dropped + 1;
+	}
+
+	entries.push_back({version, start, end});
+}
+
+bool
+QueueChangeLog::Collect(uint32_t version, unsigned length,
+			std::vector<Range> &ranges) const
+{
+	if (version < complete_since)
+		return false;
+
+	/* entries are sorted by version; find the first relevant one */
+	auto i = std::lower_bound(entries.begin(), entries.end(), version,
+				  [](const Entry &e, uint32_t v){
+					  return e.version < v;
+				  });
+
+	const size_t first = ranges.size();
+	for (; i != entries.end(); ++i) {
+		const unsigned end = std::min(i->end, length);
+		if (i->start < end)
+			ranges.push_back({i->start, end});
+	}
+
+	std::sort(ranges.begin() + first, ranges.end(),
+		  [](const Range &a, const Range &b){
+			  return a.start < b.start;
+		  });
+
+	/* merge overlapping and adjacent ranges */
+	const auto begin = ranges.begin() + first;
+	auto dest = begin;
+	for (auto j = begin; j != ranges.end(); ++j) {
+		if (dest != begin && j->start <= std::prev(dest)->end)
+			std::prev(dest)->end = std::max(std::prev(dest)->end,
+							j->end);
+		else
+			*dest++ = *j;
+	}
+
+	ranges.erase(dest, ranges.end());
+	return true;
+}
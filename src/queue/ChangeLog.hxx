@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_CHANGE_LOG_HXX
+#define MPD_QUEUE_CHANGE_LOG_HXX
+
+#include "Compiler.h"
+
+#include <deque>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A bounded journal of the queue positions which were modified in
+ * each version.  It allows "plchanges" to visit only the positions
+ * which may have changed instead of scanning the whole queue.
+ *
+ * Adjacent positions modified in the same version are coalesced into
+ * one range, so shifting a large part of the queue costs only one
+ * entry.  When the journal is full, the oldest entries are dropped,
+ * and queries for versions before them fail; the caller must then
+ * fall back to a full scan.
+ */
+class QueueChangeLog {
+	static constexpr size_t MAX_ENTRIES = 1024;
+
+	struct Entry {
+		uint32_t version;
+
+		/** the modified position range, end excluded */
+		unsigned start, end;
+	};
+
+	std::deque<Entry> entries;
+
+	/**
+	 * All modifications with this version or newer are recorded.
+	 * Zero after construction; UINT32_MAX if nothing is reliable.
+	 */
+	uint32_t complete_since;
+
+public:
+	struct Range {
+		unsigned start, end;
+	};
+
+	QueueChangeLog():complete_since(0) {}
+
+	/**
+	 * Record that the specified position was modified in the
+	 * specified version.  Versions must be passed in
+	 * non-decreasing order.
+	 */
+	void Add(uint32_t version, unsigned position) {
+		if (!entries.empty()) {
+			Entry &last = entries.back();
+			if (last.version == version) {
+				if (position >= last.start &&
+				    position < last.end)
+					return;
+
+				if (position == last.end) {
+					++last.end;
+					return;
+				}
+
+				if (position + 1 == last.start) {
+					--last.start;
+					return;
+				}
+			}
+		}
+
+		AddRange(version, position, position + 1);
+	}
+
+	/**
+	 * Record that the specified position range (end excluded)
+	 * was modified in the specified version.
+	 */
+	void AddRange(uint32_t version, unsigned start, unsigned end);
+
+	/**
+	 * Forget everything; queries fail until Reset() is called.
+	 * Used when the version numbers wrap around.
+	 */
+	void Invalidate() {
+		entries.clear();
+		complete_since = UINT32_MAX;
+	}
+
+	/**
+	 * Forget everything and accept queries for versions since the
+	 * specified one.
+	 */
+	void Reset(uint32_t version) {
+		entries.clear();
+		complete_since = version;
+	}
+
+	/**
+	 * Determine the positions which may have been modified in the
+	 * specified version or later.
+	 *
+	 * @param length the current length of the queue; ranges are
+	 * clipped to it
+	 * @param ranges receives sorted, non-overlapping ranges
+	 * @return false if the journal does not reach back to the
+	 * specified version
+	 */
+	bool Collect(uint32_t version, unsigned length,
+		     std::vector<Range> &ranges) const;
+};
+
+#endif
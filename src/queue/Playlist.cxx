@@ -23,8 +23,11 @@
 #include "PlayerControl.hxx"
 #include "DetachedSong.hxx"
 #include "Idle.hxx"
+#include "util/UriUtil.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 
 void
@@ -44,6 +47,35 @@ playlist::TagModified(DetachedSong &&song)
 	idle_add(IDLE_PLAYLIST);
 }
 
+/**
+ * Tell the player which remote songs follow, beginning with the
+ * specified one, so it can open their input streams in advance.
+ */
+static void
+playlist_update_prefetch(const playlist &playlist, PlayerControl &pc,
+			 unsigned order)
+{
+	if (pc.prefetch_songs == 0)
+		return;
+
+	const Queue &queue = playlist.queue;
+
+	std::vector<std::string> uris;
+	int i = order;
+	for (unsigned n = 0; n < pc.prefetch_songs; ++n) {
+		const char *uri = queue.GetOrder(i).GetRealURI();
+		if (uri_has_scheme(uri) &&
+		    std::find(uris.begin(), uris.end(), uri) == uris.end())
+			uris.emplace_back(uri);
+
+		i = queue.GetNextOrder(i);
+		if (i < 0 || unsigned(i) == order)
+			break;
+	}
+
+	pc.SetPrefetch(std::move(uris));
+}
+
 /**
  * Queue a song, addressed by its order number.
  */
@@ -60,6 +92,7 @@ playlist_queue_song_order(playlist &playlist, PlayerControl &pc,
 	FormatDebug(playlist_domain, "queue song %i:\"%s\"",
 		    playlist.queued, song.GetURI());
 
+	playlist_update_prefetch(playlist, pc, order);
 	pc.EnqueueSong(new DetachedSong(song));
 }
 
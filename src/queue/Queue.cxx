@@ -21,12 +21,14 @@
 #include "Queue.hxx"
 #include "DetachedSong.hxx"
 
+#include <algorithm>
+
+#include <limits.h>
+
 Queue::Queue(unsigned _max_length)
 	:max_length(_max_length), length(0),
 	 version(1),
-	 items(new Item[max_length]),
-	 order(new unsigned[max_length]),
-	 id_table(max_length * HASH_MULT),
+	 next_id(1),
 	 repeat(false),
 	 single(false),
 	 consume(false),
@@ -37,9 +39,6 @@ Queue::Queue(unsigned _max_length)
 Queue::~Queue()
 {
 	Clear();
-
-	delete[] items;
-	delete[] order;
 }
 
 int
@@ -67,10 +66,11 @@ Queue::IncrementVersion()
 	version++;
 
 	if (version >= max) {
-		for (unsigned i = 0; i < length; i++)
-			items[i].version = 0;
-
 		version = 1;
+
+		/* all items are "new" now; the log cannot express
+		   that */
+		change_log.Invalidate();
 	}
 }
 
@@ -79,139 +79,108 @@ Queue::ModifyAtOrder(unsigned _order)
 {
 	assert(_order < length);
 
-	unsigned position = order[_order];
+	unsigned position = OrderToPosition(_order);
 	ModifyAtPosition(position);
 }
 
 unsigned
-Queue::Append(DetachedSong &&song, uint8_t priority)
+Queue::GenerateId()
 {
-	assert(!IsFull());
+	/* reserve max_length * HASH_MULT elements in the id number
+	   space, but stay within the range of "int" */
+	const unsigned long long n =
+		(unsigned long long)max_length * HASH_MULT;
+	const unsigned limit = n < INT_MAX ? unsigned(n) : INT_MAX;
 
-	const unsigned position = length++;
-	const unsigned id = id_table.Insert(position);
+	assert(next_id > 0);
+	assert(next_id < limit);
 
-	auto &item = items[position];
-	item.song = new DetachedSong(std::move(song));
-	item.id = id;
-	item.version = version;
-	item.priority = priority;
+	while (true) {
+		unsigned id = next_id;
 
-	order[position] = position;
+		++next_id;
+		if (next_id >= limit)
+			next_id = 1;
 
-	return id;
+		if (id_map.find(id) == id_map.end())
+			return id;
+	}
 }
 
-void
-Queue::SwapPositions(unsigned position1, unsigned position2)
+unsigned
+Queue::Append(DetachedSong &&song, uint8_t priority)
 {
-	unsigned id1 = items[position1].id;
-	unsigned id2 = items[position2].id;
+	assert(!IsFull());
 
-	std::swap(items[position1], items[position2]);
+	Item *item = new Item();
+	item->song = new DetachedSong(std::move(song));
+	item->id = GenerateId();
+	item->priority = priority;
+	id_map.emplace(item->id, item);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	const unsigned position = length++;
+	items.push_back(item);
+	order.push_back(item);
+	ModifyAtPosition(position);
 
-	id_table.Move(id1, position2);
-	id_table.Move(id2, position1);
+	return item->id;
 }
 
 void
-Queue::MovePostion(unsigned from, unsigned to)
+Queue::SwapPositions(unsigned position1, unsigned position2)
 {
-	const Item tmp = items[from];
-
-	/* move songs to one less in from->to */
-
-	for (unsigned i = from; i < to; i++)
-		MoveItemTo(i + 1, i);
-
-	/* move songs to one more in to->from */
+	Item *item1 = items.At(position1);
+	Item *item2 = items.At(position2);
 
-	for (unsigned i = from; i > to; i--)
-		MoveItemTo(i - 1, i);
+	items.Swap(item1, item2);
 
-	/* put song at _to_ */
+	/* the order list refers to positions, not to songs */
+	order.Swap(item1, item2);
 
-	id_table.Move(tmp.id, to);
-	items[to] = tmp;
-	items[to].version = version;
-
-	/* now deal with order */
+	ModifyAtPosition(position1);
+	ModifyAtPosition(position2);
+}
 
-	if (random) {
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] > from && order[i] <= to)
-				order[i]--;
-			else if (order[i] < from &&
-				 order[i] >= to)
-				order[i]++;
-			else if (from == order[i])
-				order[i] = to;
-		}
+void
+Queue::MovePostion(unsigned from, unsigned to)
+{
+	Item *item = items.At(from);
+	items.Erase(item);
+	items.Insert(to, item);
+
+	if (!random) {
+		/* the order is the identity in non-random mode; in
+		   random mode, the song keeps its order number */
+		order.Erase(item);
+		order.Insert(to, item);
 	}
+
+	ModifyRange(std::min(from, to), std::max(from, to) + 1);
 }
 
 void
 Queue::MoveRange(unsigned start, unsigned end, unsigned to)
 {
-	Item tmp[end - start];
-	// Copy the original block [start,end-1]
-	for (unsigned i = start; i < end; i++)
-		tmp[i - start] = items[i];
-
-	// If to > start, we need to move to-start items to start, starting from end
-	for (unsigned i = end; i < end + to - start; i++)
-		MoveItemTo(i, start + i - end);
-
-	// If to < start, we need to move start-to items to newend (= end + to - start), starting from to
-	// This is the same as moving items from start-1 to to (decreasing), with start-1 going to end-1
-	// We have to iterate in this order to avoid writing over something we haven't yet moved
-	for (int i = start - 1; i >= int(to); i--)
-		MoveItemTo(i, i + end - start);
-
-	// Copy the original block back in, starting at to.
-	for (unsigned i = start; i< end; i++)
-	{
-		id_table.Move(tmp[i - start].id, to + i - start);
-		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
-	}
+	assert(start <= end);
+	assert(to + end - start <= length);
 
-	if (random) {
-		// Update the positions in the queue.
-		// Note that the ranges for these cases are the same as the ranges of
-		// the loops above.
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] >= end && order[i] < to + end - start)
-				order[i] -= end - start;
-			else if (order[i] < start &&
-				 order[i] >= to)
-				order[i] += end - start;
-			else if (start <= order[i] && order[i] < end)
-				order[i] += to - start;
-		}
-	}
+	items.InsertTree(to, items.Extract(start, end));
+
+	if (!random)
+		order.InsertTree(to, order.Extract(start, end));
+
+	ModifyRange(std::min(start, to), std::max(end, to + end - start));
 }
 
 void
 Queue::MoveOrder(unsigned from_order, unsigned to_order)
 {
 	assert(from_order < length);
-	assert(to_order <= length);
+	assert(to_order < length);
 
-	const unsigned from_position = OrderToPosition(from_order);
-
-	if (from_order < to_order) {
-		for (unsigned i = from_order; i < to_order; ++i)
-			order[i] = order[i + 1];
-	} else {
-		for (unsigned i = from_order; i > to_order; --i)
-			order[i] = order[i - 1];
-	}
-
-	order[to_order] = from_position;
+	Item *item = order.At(from_order);
+	order.Erase(item);
+	order.Insert(to_order, item);
 }
 
 void
@@ -219,64 +188,61 @@ Queue::DeletePosition(unsigned position)
 {
 	assert(position < length);
 
-	delete items[position].song;
-
-	const unsigned id = PositionToId(position);
-	const unsigned _order = PositionToOrder(position);
-
-	--length;
-
-	/* release the song id */
+	Item *item = items.At(position);
 
-	id_table.Erase(id);
+	items.Erase(item);
+	order.Erase(item);
+	id_map.erase(item->id);
 
-	/* delete song from songs array */
+	delete item->song;
+	delete item;
 
-	for (unsigned i = position; i < length; i++)
-		MoveItemTo(i + 1, i);
-
-	/* delete the entry from the order array */
-
-	for (unsigned i = _order; i < length; i++)
-		order[i] = order[i + 1];
-
-	/* readjust values in the order array */
+	--length;
 
-	for (unsigned i = 0; i < length; i++)
-		if (order[i] > position)
-			--order[i];
+	/* all following songs have been shifted */
+	ModifyRange(position, length);
 }
 
 void
 Queue::Clear()
 {
-	for (unsigned i = 0; i < length; i++) {
-		Item *item = &items[i];
+	std::vector<Item *> v;
+	items.CopyTo(v);
 
+	for (Item *item : v) {
 		delete item->song;
-
-		id_table.Erase(item->id);
+		delete item;
 	}
 
+	items.clear();
+	order.clear();
+	id_map.clear();
 	length = 0;
 }
 
-static void
-queue_sort_order_by_priority(Queue *queue, unsigned start, unsigned end)
+void
+Queue::RestoreOrder()
+{
+	std::vector<Item *> v;
+	items.CopyTo(v);
+	order.Assign(v);
+}
+
+void
+Queue::SortOrderByPriority(unsigned start, unsigned end)
 {
-	assert(queue != nullptr);
-	assert(queue->random);
+	assert(random);
 	assert(start <= end);
-	assert(end <= queue->length);
+	assert(end <= length);
 
-	auto cmp = [queue](unsigned a_pos, unsigned b_pos){
-		const Queue::Item &a = queue->items[a_pos];
-		const Queue::Item &b = queue->items[b_pos];
+	std::vector<Item *> v;
+	OrderTree::Flatten(order.Extract(start, end), v);
 
-		return a.priority > b.priority;
-	};
+	std::stable_sort(v.begin(), v.end(), [](const Item *a, const Item *b){
+			return a->priority > b->priority;
+		});
 
-	std::stable_sort(queue->order + start, queue->order + end, cmp);
+	order.InsertTree(start, order.Build(v));
 }
 
 void
@@ -287,7 +253,11 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end)
 	assert(end <= length);
 
 	rand.AutoCreate();
-	std::shuffle(order + start, order + end, rand);
+
+	std::vector<Item *> v;
+	OrderTree::Flatten(order.Extract(start, end), v);
+	std::shuffle(v.begin(), v.end(), rand);
+	order.InsertTree(start, order.Build(v));
 }
 
 /**
@@ -305,7 +275,7 @@ Queue::ShuffleOrderRangeWithPriority(unsigned start, unsigned end)
 		return;
 
 	/* first group the range by priority */
-	queue_sort_order_by_priority(this, start, end);
+	SortOrderByPriority(start, end);
 
 	/* now shuffle each priority group */
 	unsigned group_start = start;
@@ -376,8 +346,7 @@ Queue::FindPriorityOrder(unsigned start_order, uint8_t priority,
 	assert(start_order <= length);
 
 	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
+		const Item *item = &GetOrderItem(i);
 		if (item->priority <= priority && i != exclude_order)
 			return i;
 	}
@@ -392,8 +361,7 @@ Queue::CountSamePriority(unsigned start_order, uint8_t priority) const
 	assert(start_order <= length);
 
 	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
+		const Item *item = &GetOrderItem(i);
 		if (item->priority != priority)
 			return i - start_order;
 	}
@@ -406,13 +374,13 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order)
 {
 	assert(position < length);
 
-	Item *item = &items[position];
+	Item *item = items.At(position);
 	uint8_t old_priority = item->priority;
 	if (old_priority == priority)
 		return false;
 
-	item->version = version;
 	item->priority = priority;
+	ModifyAtPosition(position);
 
 	if (!random)
 		/* don't reorder if not in random mode */
@@ -429,10 +397,7 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order)
 			   - enqueue it only if its priority has just
 			   become bigger than the current one's */
 
-			const unsigned after_position =
-				OrderToPosition(after_order);
-			const Item *after_item =
-				&items[after_position];
+			const Item *after_item = &GetOrderItem(after_order);
 			if (old_priority > after_item->priority ||
 			    priority <= after_item->priority)
 				/* priority hasn't become bigger */
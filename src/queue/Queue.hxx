@@ -21,10 +21,12 @@
 #define MPD_QUEUE_HXX
 
 #include "Compiler.h"
-#include "IdTable.hxx"
+#include "ChangeLog.hxx"
+#include "RankTree.hxx"
 #include "util/LazyRandomEngine.hxx"
 
-#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 #include <assert.h>
 #include <stdint.h>
@@ -40,6 +42,11 @@ class DetachedSong;
  * - the position in the queue
  * - the unique id (which stays the same, regardless of moves)
  * - the order number (which only differs from "position" in random mode)
+ *
+ * The items are linked into two #RankTree instances, one sorted by
+ * position and one by order number, so looking up, inserting,
+ * moving and removing songs take O(log n) time.  Memory is allocated
+ * per item; #max_length only limits the number of songs.
  */
 struct Queue {
 	/**
@@ -58,17 +65,19 @@ struct Queue {
 		/** the unique id of this item in the queue */
 		unsigned id;
 
-		/** when was this item last changed? */
-		uint32_t version;
-
 		/**
 		 * The priority of this item, between 0 and 255.  High
 		 * priority value means that this song gets played first in
 		 * "random" mode.
 		 */
 		uint8_t priority;
+
+		RankTreeHook<Item> position_hook, order_hook;
 	};
 
+	typedef RankTree<Item, &Item::position_hook> PositionTree;
+	typedef RankTree<Item, &Item::order_hook> OrderTree;
+
 	/** configured maximum length of the queue */
 	unsigned max_length;
 
@@ -79,13 +88,19 @@ struct Queue {
 	uint32_t version;
 
 	/** all songs in "position" order */
-	Item *items;
+	PositionTree items;
 
-	/** map order numbers to positions */
-	unsigned *order;
+	/** all songs in "order" order */
+	OrderTree order;
 
-	/** map song ids to positions */
-	IdTable id_table;
+	/** map song ids to items */
+	std::unordered_map<unsigned, Item *> id_map;
+
+	/** the next song id to try, see GenerateId() */
+	unsigned next_id;
+
+	/** which positions were modified in which version? */
+	QueueChangeLog change_log;
 
 	/** repeat playback when the end of the queue has been
 	    reached? */
@@ -150,47 +165,51 @@ struct Queue {
 		return _order < length;
 	}
 
+	gcc_pure
 	int IdToPosition(unsigned id) const {
-		return id_table.IdToPosition(id);
+		auto i = id_map.find(id);
+		return i != id_map.end()
+			? (int)items.Rank(i->second)
+			: -1;
 	}
 
+	gcc_pure
 	int PositionToId(unsigned position) const
 	{
-		assert(position < length);
-
-		return items[position].id;
+		return GetItem(position).id;
 	}
 
 	gcc_pure
 	unsigned OrderToPosition(unsigned _order) const {
 		assert(_order < length);
 
-		return order[_order];
+		return items.Rank(order.At(_order));
 	}
 
 	gcc_pure
 	unsigned PositionToOrder(unsigned position) const {
 		assert(position < length);
 
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
-
-			if (order[i] == position)
-				return i;
-		}
+		return order.Rank(items.At(position));
 	}
 
 	gcc_pure
 	uint8_t GetPriorityAtPosition(unsigned position) const {
+		return GetItem(position).priority;
+	}
+
+	gcc_pure
+	const Item &GetItem(unsigned position) const {
 		assert(position < length);
 
-		return items[position].priority;
+		return *items.At(position);
 	}
 
+	gcc_pure
 	const Item &GetOrderItem(unsigned i) const {
 		assert(IsValidOrder(i));
 
-		return items[OrderToPosition(i)];
+		return *order.At(i);
 	}
 
 	uint8_t GetOrderPriority(unsigned i) const {
@@ -201,28 +220,35 @@ struct Queue {
 	 * Returns the song at the specified position.
 	 */
 	DetachedSong &Get(unsigned position) const {
-		assert(position < length);
-
-		return *items[position].song;
+		return *GetItem(position).song;
 	}
 
 	/**
 	 * Returns the song at the specified order number.
 	 */
 	DetachedSong &GetOrder(unsigned _order) const {
-		return Get(OrderToPosition(_order));
+		return *GetOrderItem(_order).song;
 	}
 
 	/**
-	 * Is the song at the specified position newer than the specified
-	 * version?
+	 * Invoke a function for each position (in ascending order)
+	 * which was modified in the specified version or later.  If
+	 * the change log does not reach back that far (or if the
+	 * version is from the future), all positions are reported.
 	 */
-	bool IsNewerAtPosition(unsigned position, uint32_t _version) const {
-		assert(position < length);
+	template<typename F>
+	void VisitChanges(uint32_t _version, F &&f) const {
+		std::vector<QueueChangeLog::Range> ranges;
+		if (_version > version ||
+		    !change_log.Collect(_version, length, ranges)) {
+			for (unsigned i = 0; i < length; ++i)
+				f(i);
+			return;
+		}
 
-		return _version > version ||
-			items[position].version >= _version ||
-			items[position].version == 0;
+		for (const auto &r : ranges)
+			for (unsigned i = r.start; i < r.end; ++i)
+				f(i);
 	}
 
 	/**
@@ -248,7 +274,7 @@ struct Queue {
 	void ModifyAtPosition(unsigned position) {
 		assert(position < length);
 
-		items[position].version = version;
+		change_log.Add(version, position);
 	}
 
 	/**
@@ -279,7 +305,7 @@ struct Queue {
 	 * Swaps two songs, addressed by their order number.
 	 */
 	void SwapOrders(unsigned order1, unsigned order2) {
-		std::swap(order[order1], order[order2]);
+		order.Swap(order.At(order1), order.At(order2));
 	}
 
 	/**
@@ -305,10 +331,7 @@ struct Queue {
 	/**
 	 * Initializes the "order" array, and restores "normal" order.
 	 */
-	void RestoreOrder() {
-		for (unsigned i = 0; i < length; ++i)
-			order[i] = i;
-	}
+	void RestoreOrder();
 
 	/**
 	 * Shuffle the order of items in the specified range, ignoring
@@ -354,14 +377,25 @@ private:
 	 */
 	void MoveOrder(unsigned from_order, unsigned to_order);
 
-	void MoveItemTo(unsigned from, unsigned to) {
-		unsigned from_id = items[from].id;
+	/**
+	 * Marks a range of positions as "modified", e.g. after songs
+	 * have been shifted.
+	 */
+	void ModifyRange(unsigned start, unsigned end) {
+		assert(start <= end);
+		assert(end <= length);
 
-		items[to] = items[from];
-		items[to].version = version;
-		id_table.Move(from_id, to);
+		change_log.AddRange(version, start, end);
 	}
 
+	unsigned GenerateId();
+
+	/**
+	 * Sort the specified order range by priority (descending),
+	 * keeping the relative order of items with the same priority.
+	 */
+	void SortOrderByPriority(unsigned start, unsigned end);
+
 	/**
 	 * Find the first item that has this specified priority or
 	 * higher.
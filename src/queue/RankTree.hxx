@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_RANK_TREE_HXX
+#define MPD_QUEUE_RANK_TREE_HXX
+
+#include "Compiler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * The links of one #RankTree inside an object.  An object may be
+ * linked into several trees with separate hooks.
+ */
+template<typename T>
+struct RankTreeHook {
+	T *left, *right, *parent;
+
+	/** the number of nodes in this subtree */
+	unsigned size;
+
+	/** the random heap priority of the treap */
+	uint32_t priority;
+};
+
+/**
+ * An intrusive sequence container which supports access by index,
+ * looking up the index of a node, insertion, removal and moving
+ * ranges in O(log n) expected time.  It is a treap with implicit
+ * keys; every node knows the size of its subtree and its parent.
+ *
+ * The tree does not own its nodes.
+ */
+template<typename T, RankTreeHook<T> T::*hook>
+class RankTree {
+	T *root;
+
+	/** state of the xorshift generator for node priorities */
+	uint32_t seed;
+
+public:
+	RankTree():root(nullptr), seed(0x9e3779b9) {}
+
+	RankTree(const RankTree &) = delete;
+	RankTree &operator=(const RankTree &) = delete;
+
+	unsigned size() const {
+		return Size(root);
+	}
+
+	bool empty() const {
+		return root == nullptr;
+	}
+
+	/**
+	 * Forget all nodes (without freeing them).
+	 */
+	void clear() {
+		root = nullptr;
+	}
+
+	/**
+	 * Returns the node at the specified index.
+	 */
+	gcc_pure
+	T *At(unsigned i) const {
+		assert(i < size());
+
+		T *t = root;
+		while (true) {
+			const unsigned left_size = Size(H(t).left);
+			if (i < left_size)
+				t = H(t).left;
+			else if (i == left_size)
+				return t;
+			else {
+				i -= left_size + 1;
+				t = H(t).right;
+			}
+		}
+	}
+
+	/**
+	 * Returns the index of the specified node, which must be
+	 * linked into this tree.
+	 */
+	gcc_pure
+	unsigned Rank(const T *n) const {
+		unsigned i = Size(H(n).left);
+		for (const T *p = H(n).parent; p != nullptr;
+		     n = p, p = H(p).parent)
+			if (n == H(p).right)
+				i += Size(H(p).left) + 1;
+
+		return i;
+	}
+
+	/**
+	 * Insert a node so it gets the specified index.
+	 */
+	void Insert(unsigned i, T *n) {
+		assert(i <= size());
+
+		auto &h = H(n);
+		h.left = h.right = h.parent = nullptr;
+		h.size = 1;
+		h.priority = NextPriority();
+
+		InsertTree(i, n);
+	}
+
+	void push_back(T *n) {
+		Insert(size(), n);
+	}
+
+	/**
+	 * Unlink the specified node.
+	 */
+	void Erase(T *n) {
+		const unsigned i = Rank(n);
+		gcc_unused T *e = Extract(i, i + 1);
+		assert(e == n);
+	}
+
+	/**
+	 * Unlink the nodes in the specified index range and return
+	 * them as a detached subtree, to be passed to InsertTree().
+	 */
+	T *Extract(unsigned start, unsigned end) {
+		assert(start <= end);
+		assert(end <= size());
+
+		T *left, *middle, *right;
+		Split(root, start, left, middle);
+		Split(middle, end - start, middle, right);
+		SetRoot(Merge(left, right));
+
+		if (middle != nullptr)
+			H(middle).parent = nullptr;
+		return middle;
+	}
+
+	/**
+	 * Insert a subtree returned by Extract() or Build(), so its
+	 * first node gets the specified index.
+	 */
+	void InsertTree(unsigned i, T *subtree) {
+		assert(i <= size());
+
+		T *left, *right;
+		Split(root, i, left, right);
+		SetRoot(Merge(Merge(left, subtree), right));
+	}
+
+	/**
+	 * Swap the positions of two nodes.
+	 */
+	void Swap(T *a, T *b) {
+		unsigned ia = Rank(a), ib = Rank(b);
+		if (ia == ib)
+			return;
+
+		if (ia > ib) {
+			std::swap(ia, ib);
+			std::swap(a, b);
+		}
+
+		/* remove the later one first, so the index of the
+		   earlier one stays valid */
+		Erase(b);
+		Erase(a);
+		Insert(ia, b);
+		Insert(ib, a);
+	}
+
+	/**
+	 * Append all nodes (in order) to a vector.
+	 */
+	void CopyTo(std::vector<T *> &v) const {
+		v.reserve(v.size() + size());
+		Flatten(root, v);
+	}
+
+	/**
+	 * Append the nodes of a subtree (in order) to a vector.
+	 */
+	static void Flatten(T *t, std::vector<T *> &v) {
+		while (t != nullptr) {
+			Flatten(H(t).left, v);
+			v.push_back(t);
+			t = H(t).right;
+		}
+	}
+
+	/**
+	 * Build a subtree from a sequence of nodes (which are not
+	 * linked into this tree), in linear time.
+	 */
+	T *Build(const std::vector<T *> &v) {
+		std::vector<T *> stack;
+		for (T *n : v) {
+			auto &h = H(n);
+			h.left = h.right = h.parent = nullptr;
+			h.priority = NextPriority();
+
+			T *last = nullptr;
+			while (!stack.empty() &&
+			       H(stack.back()).priority < h.priority) {
+				last = stack.back();
+				stack.pop_back();
+			}
+
+			h.left = last;
+			if (!stack.empty())
+				H(stack.back()).right = n;
+			stack.push_back(n);
+		}
+
+		if (stack.empty())
+			return nullptr;
+
+		T *top = stack.front();
+		FixSizes(top);
+		H(top).parent = nullptr;
+		return top;
+	}
+
+	/**
+	 * Replace the contents with the specified sequence of nodes.
+	 */
+	void Assign(const std::vector<T *> &v) {
+		root = Build(v);
+	}
+
+private:
+	static RankTreeHook<T> &H(T *n) {
+		return n->*hook;
+	}
+
+	static const RankTreeHook<T> &H(const T *n) {
+		return n->*hook;
+	}
+
+	static unsigned Size(const T *n) {
+		return n != nullptr ? H(n).size : 0;
+	}
+
+	uint32_t NextPriority() {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return seed;
+	}
+
+	/**
+	 * Recalculate the size of a node and adopt its children.
+	 */
+	static T *Pull(T *n) {
+		auto &h = H(n);
+		h.size = 1 + Size(h.left) + Size(h.right);
+		if (h.left != nullptr)
+			H(h.left).parent = n;
+		if (h.right != nullptr)
+			H(h.right).parent = n;
+		return n;
+	}
+
+	static void FixSizes(T *n) {
+		auto &h = H(n);
+		if (h.left != nullptr)
+			FixSizes(h.left);
+		if (h.right != nullptr)
+			FixSizes(h.right);
+		Pull(n);
+	}
+
+	void SetRoot(T *n) {
+		root = n;
+		if (n != nullptr)
+			H(n).parent = nullptr;
+	}
+
+	static T *Merge(T *a, T *b) {
+		if (a == nullptr)
+			return b;
+		if (b == nullptr)
+			return a;
+
+		if (H(a).priority > H(b).priority) {
+			H(a).right = Merge(H(a).right, b);
+			return Pull(a);
+		} else {
+			H(b).left = Merge(a, H(b).left);
+			return Pull(b);
+		}
+	}
+
+	/**
+	 * Split a subtree into its first k nodes and the rest.
+	 */
+	static void Split(T *t, unsigned k, T *&l, T *&r) {
+		if (t == nullptr) {
+			l = r = nullptr;
+			return;
+		}
+
+		if (Size(H(t).left) >= k) {
+			Split(H(t).left, k, l, H(t).left);
+			r = Pull(t);
+		} else {
+			Split(H(t).right, k - Size(H(t).left) - 1,
+			      H(t).right, r);
+			l = Pull(t);
+		}
+	}
+};
+
+#endif
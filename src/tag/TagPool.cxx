@@ -20,71 +20,197 @@
 #include "config.h"
 #include "TagPool.hxx"
 #include "TagItem.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Cast.hxx"
 #include "util/VarSize.hxx"
 
+#include <atomic>
+
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
-Mutex tag_pool_lock;
+/**
+ * The pool is split into this many independent hash tables, each
+ * with its own lock, so threads interning different strings rarely
+ * contend.  Must be a power of two.
+ */
+static constexpr unsigned NUM_SHARDS = 16;
+
+/**
+ * The initial number of buckets in each shard.  Must be a power of
+ * two.
+ */
+static constexpr unsigned INITIAL_BUCKETS = 256;
 
-static constexpr size_t NUM_SLOTS = 4096;
+/**
+ * A shard doubles its bucket array when it holds more items than
+ * this factor times the number of buckets.
+ */
+static constexpr unsigned MAX_LOAD = 2;
 
 struct TagPoolSlot {
 	TagPoolSlot *next;
-	unsigned char ref;
+
+	/**
+	 * The hash of this item; used to find its shard, to skip
+	 * string comparisons and to rehash without reading the value.
+	 */
+	const uint32_t hash;
+
+	/**
+	 * The reference counter.  Incremented without a lock by
+	 * tag_pool_dup_item() (the caller already owns a reference,
+	 * so it cannot drop to zero concurrently); all other
+	 * modifications happen while the shard is locked.
+	 */
+	std::atomic<unsigned> ref;
+
 	TagItem item;
 
-	TagPoolSlot(TagPoolSlot *_next, TagType type,
+	TagPoolSlot(TagPoolSlot *_next, uint32_t _hash, TagType type,
 		    const char *value, size_t length)
-		:next(_next), ref(1) {
+		:next(_next), hash(_hash), ref(1) {
 		item.type = type;
 		memcpy(item.value, value, length);
 		item.value[length] = 0;
 	}
 
-	static TagPoolSlot *Create(TagPoolSlot *_next, TagType type,
+	static TagPoolSlot *Create(TagPoolSlot *_next, uint32_t _hash,
+				   TagType type,
 				   const char *value, size_t length);
-} gcc_packed;
+
+	gcc_pure
+	bool Equals(uint32_t _hash, TagType type,
+		    const char *value, size_t length) const {
+		return hash == _hash && item.type == type &&
+			strncmp(item.value, value, length) == 0 &&
+			item.value[length] == 0;
+	}
+};
 
 TagPoolSlot *
-TagPoolSlot::Create(TagPoolSlot *_next, TagType type,
+TagPoolSlot::Create(TagPoolSlot *_next, uint32_t _hash, TagType type,
 		    const char *value, size_t length)
 {
 	TagPoolSlot *dummy;
 	return NewVarSize<TagPoolSlot>(sizeof(dummy->item.value),
 				       length + 1,
-				       _next, type,
+				       _next, _hash, type,
 				       value, length);
 }
 
-static TagPoolSlot *slots[NUM_SLOTS];
+struct TagPoolShard {
+	Mutex mutex;
+
+	/**
+	 * The bucket array; allocated on the first insertion.
+	 */
+	TagPoolSlot **buckets = nullptr;
+
+	unsigned n_buckets = 0;
+
+	unsigned n_items = 0;
+
+	TagPoolSlot **GetBucket(uint32_t hash) {
+		return &buckets[hash & (n_buckets - 1)];
+	}
+
+	void Insert(TagPoolSlot *slot) {
+		if (n_items >= n_buckets * MAX_LOAD)
+			Grow();
+
+		auto bucket = GetBucket(slot->hash);
+		slot->next = *bucket;
+		*bucket = slot;
+		++n_items;
+	}
+
+	void Remove(TagPoolSlot *slot) {
+		auto slot_p = GetBucket(slot->hash);
+		while (*slot_p != slot) {
+			assert(*slot_p != nullptr);
+			slot_p = &(*slot_p)->next;
+		}
+
+		*slot_p = slot->next;
+		--n_items;
+	}
+
+	void Grow();
+};
 
-static inline unsigned
-calc_hash_n(TagType type, const char *p, size_t length)
+void
+TagPoolShard::Grow()
 {
-	unsigned hash = 5381;
+	const unsigned old_size = n_buckets;
+	TagPoolSlot **const old_buckets = buckets;
 
-	assert(p != nullptr);
+	n_buckets = old_size > 0 ? old_size * 2 : INITIAL_BUCKETS;
+	buckets = new TagPoolSlot *[n_buckets]();
 
-	while (length-- > 0)
-		hash = (hash << 5) + hash + *p++;
+	for (unsigned i = 0; i < old_size; ++i) {
+		for (auto slot = old_buckets[i]; slot != nullptr;) {
+			auto next = slot->next;
+			auto bucket = GetBucket(slot->hash);
+			slot->next = *bucket;
+			*bucket = slot;
+			slot = next;
+		}
+	}
 
-	return hash ^ type;
+	delete[] old_buckets;
 }
 
-static inline unsigned
-calc_hash(TagType type, const char *p)
+static TagPoolShard shards[NUM_SHARDS];
+
+static inline uint64_t
+hash_mix(uint64_t h)
 {
-	unsigned hash = 5381;
+	h ^= h >> 31;
+	h *= 0x7fb5d329728ea185ULL;
+	h ^= h >> 27;
+	h *= 0x81dadef4bc2dd44dULL;
+	h ^= h >> 33;
+	return h;
+}
 
+/**
+ * Hash a tag value eight bytes at a time.  The shard is selected
+ * from the upper bits of the result, the bucket from the lower bits.
+ */
+gcc_pure
+static uint32_t
+calc_hash(TagType type, const char *p, size_t length)
+{
 	assert(p != nullptr);
 
-	while (*p != 0)
-		hash = (hash << 5) + hash + *p++;
+	uint64_t h = (uint64_t(type) << 32) ^ length;
+
+	for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t),
+		     p += sizeof(uint64_t)) {
+		uint64_t k;
+		memcpy(&k, p, sizeof(k));
+		h = (h ^ k) * 0x9e3779b97f4a7c15ULL;
+		h ^= h >> 29;
+	}
+
+	if (length > 0) {
+		uint64_t k = 0;
+		memcpy(&k, p, length);
+		h = (h ^ k) * 0x9e3779b97f4a7c15ULL;
+	}
 
-	return hash ^ type;
+	return uint32_t(hash_mix(h));
+}
+
+static inline TagPoolShard &
+hash_to_shard(uint32_t hash)
+{
+	static_assert(NUM_SHARDS == 1 << 4, "Shard selector mismatch");
+
+	return shards[hash >> (32 - 4)];
 }
 
 #if defined(__clang__) || GCC_CHECK_VERSION(4,7)
@@ -96,35 +222,27 @@ tag_item_to_slot(TagItem *item)
 	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value, size_t length)
-{
-	return &slots[calc_hash_n(type, value, length) % NUM_SLOTS];
-}
-
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value)
-{
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
-}
-
 TagItem *
 tag_pool_get_item(TagType type, const char *value, size_t length)
 {
-	auto slot_p = tag_value_slot_p(type, value, length);
-	for (auto slot = *slot_p; slot != nullptr; slot = slot->next) {
-		if (slot->item.type == type &&
-		    length == strlen(slot->item.value) &&
-		    memcmp(value, slot->item.value, length) == 0 &&
-		    slot->ref < 0xff) {
-			assert(slot->ref > 0);
-			++slot->ref;
-			return &slot->item;
+	const uint32_t hash = calc_hash(type, value, length);
+	TagPoolShard &shard = hash_to_shard(hash);
+
+	const ScopeLock protect(shard.mutex);
+
+	if (shard.n_buckets > 0) {
+		for (auto slot = *shard.GetBucket(hash); slot != nullptr;
+		     slot = slot->next) {
+			if (slot->Equals(hash, type, value, length)) {
+				assert(slot->ref > 0);
+				slot->ref.fetch_add(1, std::memory_order_relaxed);
+				return &slot->item;
+			}
 		}
 	}
 
-	auto slot = TagPoolSlot::Create(*slot_p, type, value, length);
-	*slot_p = slot;
+	auto slot = TagPoolSlot::Create(nullptr, hash, type, value, length);
+	shard.Insert(slot);
 	return &slot->item;
 }
 
@@ -135,40 +253,50 @@ tag_pool_dup_item(TagItem *item)
 
 	assert(slot->ref > 0);
 
-	if (slot->ref < 0xff) {
-		++slot->ref;
-		return item;
-	} else {
-		/* the reference counter overflows above 0xff;
-		   duplicate the item, and start with 1 */
-		size_t length = strlen(item->value);
-		auto slot_p = tag_value_slot_p(item->type,
-					       item->value, length);
-		slot = TagPoolSlot::Create(*slot_p, item->type,
-					   item->value, strlen(item->value));
-		*slot_p = slot;
-		return &slot->item;
-	}
+	slot->ref.fetch_add(1, std::memory_order_relaxed);
+	return item;
 }
 
 void
 tag_pool_put_item(TagItem *item)
 {
-	TagPoolSlot **slot_p, *slot;
+	TagPoolSlot *slot = tag_item_to_slot(item);
+	TagPoolShard &shard = hash_to_shard(slot->hash);
 
-	slot = tag_item_to_slot(item);
-	assert(slot->ref > 0);
-	--slot->ref;
+	{
+		const ScopeLock protect(shard.mutex);
 
-	if (slot->ref > 0)
-		return;
+		assert(slot->ref > 0);
+		if (slot->ref.fetch_sub(1, std::memory_order_acq_rel) > 1)
+			return;
 
-	for (slot_p = tag_value_slot_p(item->type, item->value);
-	     *slot_p != slot;
-	     slot_p = &(*slot_p)->next) {
-		assert(*slot_p != nullptr);
+		shard.Remove(slot);
 	}
 
-	*slot_p = slot->next;
 	DeleteVarSize(slot);
 }
+
+void
+tag_pool_get_stats(TagPoolStats &stats)
+{
+	stats = TagPoolStats();
+
+	for (auto &shard : shards) {
+		const ScopeLock protect(shard.mutex);
+
+		stats.n_items += shard.n_items;
+		stats.n_buckets += shard.n_buckets;
+
+		for (unsigned i = 0; i < shard.n_buckets; ++i) {
+			unsigned chain = 0;
+			for (auto slot = shard.buckets[i]; slot != nullptr;
+			     slot = slot->next)
+				++chain;
+
+			if (chain > 0)
+				++stats.n_used_buckets;
+			if (chain > stats.max_chain)
+				stats.max_chain = chain;
+		}
+	}
+}
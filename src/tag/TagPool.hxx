@@ -21,12 +21,43 @@
 #define MPD_TAG_POOL_HXX
 
 #include "TagType.h"
-#include "thread/Mutex.hxx"
+#include "Compiler.h"
 
-extern Mutex tag_pool_lock;
+#include <stddef.h>
 
 struct TagItem;
 
+/**
+ * Occupancy and collision statistics of the tag pool, see
+ * tag_pool_get_stats().
+ */
+struct TagPoolStats {
+	/** the number of distinct values in the pool */
+	unsigned n_items = 0;
+
+	/** the number of hash buckets over all shards */
+	unsigned n_buckets = 0;
+
+	/** the number of buckets holding at least one value */
+	unsigned n_used_buckets = 0;
+
+	/** the length of the longest bucket chain */
+	unsigned max_chain = 0;
+
+	/**
+	 * The number of values which share their bucket with an
+	 * earlier one.
+	 */
+	constexpr unsigned GetCollisions() const {
+		return n_items - n_used_buckets;
+	}
+};
+
+/*
+ * All functions in this header are thread-safe; the pool is
+ * internally split into independently locked shards.
+ */
+
 TagItem *
 tag_pool_get_item(TagType type, const char *value, size_t length);
 
@@ -36,4 +67,7 @@ tag_pool_dup_item(TagItem *item);
 void
 tag_pool_put_item(TagItem *item);
 
+void
+tag_pool_get_stats(TagPoolStats &stats);
+
 #endif
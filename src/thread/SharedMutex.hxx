@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2009-2014 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef THREAD_SHARED_MUTEX_HXX
+#define THREAD_SHARED_MUTEX_HXX
+
+#ifdef WIN32
+
+#include <windows.h>
+
+/**
+ * Wrapper for a SRWLOCK, a mutex which may be locked by several
+ * readers at a time.
+ */
+class SharedMutex {
+	SRWLOCK lock_;
+
+public:
+	SharedMutex() {
+		::InitializeSRWLock(&lock_);
+	}
+
+	SharedMutex(const SharedMutex &other) = delete;
+	SharedMutex &operator=(const SharedMutex &other) = delete;
+
+	void lock() {
+		::AcquireSRWLockExclusive(&lock_);
+	}
+
+	void unlock() {
+		::ReleaseSRWLockExclusive(&lock_);
+	}
+
+	void lock_shared() {
+		::AcquireSRWLockShared(&lock_);
+	}
+
+	void unlock_shared() {
+		::ReleaseSRWLockShared(&lock_);
+	}
+};
+
+#else
+
+#include <pthread.h>
+
+/**
+ * Low-level wrapper for a pthread_rwlock_t, a mutex which may be
+ * locked by several readers at a time.  On glibc, waiting writers
+ * are preferred over new readers, so a steady stream of readers
+ * cannot starve a writer; therefore, the shared lock must not be
+ * obtained recursively.
+ */
+class SharedMutex {
+	pthread_rwlock_t rwlock;
+
+public:
+#ifndef __BIONIC__
+	constexpr
+#endif
+	SharedMutex()
+#ifdef PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP
+		:rwlock(PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP) {}
+#else
+		:rwlock(PTHREAD_RWLOCK_INITIALIZER) {}
+#endif
+
+	SharedMutex(const SharedMutex &other) = delete;
+	SharedMutex &operator=(const SharedMutex &other) = delete;
+
+	void lock() {
+		pthread_rwlock_wrlock(&rwlock);
+	}
+
+	void unlock() {
+		pthread_rwlock_unlock(&rwlock);
+	}
+
+	void lock_shared() {
+		pthread_rwlock_rdlock(&rwlock);
+	}
+
+	void unlock_shared() {
+		pthread_rwlock_unlock(&rwlock);
+	}
+};
+
+#endif
+
+#endif
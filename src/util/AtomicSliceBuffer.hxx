@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_ATOMIC_SLICE_BUFFER_HXX
+#define MPD_ATOMIC_SLICE_BUFFER_HXX
+
+#include "HugeAllocator.hxx"
+#include "Compiler.h"
+
+#include <atomic>
+#include <utility>
+#include <new>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A variant of #SliceBuffer which may be used by several threads
+ * without a lock.  The free list is a lock-free stack of slice
+ * indices; each head update carries a generation tag, which rules
+ * out the ABA problem.
+ *
+ * Like #SliceBuffer, the memory is given back to the kernel when
+ * the last slice is freed.  During that (short) period, Allocate()
+ * waits for the thread which is discarding the memory.
+ */
+template<typename T>
+class AtomicSliceBuffer {
+	/**
+	 * This value is added to #n_allocated while the allocation
+	 * is being discarded; it locks out Allocate() callers.
+	 */
+	static constexpr unsigned DISCARDING = 1u << 31;
+
+	/**
+	 * The maximum number of slices in this container.
+	 */
+	const unsigned n_max;
+
+	/**
+	 * The size of each slice in bytes.  This may be larger than
+	 * sizeof(T) if the objects have a variable-size payload
+	 * following them.
+	 */
+	const size_t slice_size;
+
+	/**
+	 * The number of slices that are initialized.  This is used to
+	 * avoid page faulting on the new allocation, so the kernel
+	 * does not need to reserve physical memory pages.
+	 */
+	std::atomic<unsigned> n_initialized;
+
+	/**
+	 * The number of slices currently allocated, plus #DISCARDING
+	 * while the memory is being given back to the kernel.
+	 */
+	std::atomic<unsigned> n_allocated;
+
+	uint8_t *const data;
+
+	/**
+	 * For each slice in the free list: the index of the following
+	 * free slice plus one, or 0 at the end of the list.  This is
+	 * kept outside of the slices, because a thread may still read
+	 * it after a concurrent Allocate() has constructed the object.
+	 */
+	std::atomic<uint32_t> *const links;
+
+	/**
+	 * The head of the free list: the upper 32 bits are a
+	 * generation counter, the lower 32 bits are the index of the
+	 * first free slice plus one (0 if the list is empty).
+	 */
+	std::atomic<uint64_t> available;
+
+	size_t CalcAllocationSize() const {
+		return n_max * slice_size;
+	}
+
+	static constexpr size_t AlignSliceSize(size_t size) {
+		return (size + alignof(T) - 1) / alignof(T) * alignof(T);
+	}
+
+	T *GetSlice(unsigned i) const {
+		return reinterpret_cast<T *>(data + i * slice_size);
+	}
+
+	unsigned GetIndex(const T *value) const {
+		return (reinterpret_cast<const uint8_t *>(value) - data)
+			/ slice_size;
+	}
+
+	static constexpr uint64_t MakeHead(uint64_t old, uint32_t link) {
+		return (((old >> 32) + 1) << 32) | link;
+	}
+
+	/**
+	 * Pop the first slice from the free list.
+	 *
+	 * @return the slice index plus one, or 0 if the list is empty
+	 */
+	uint32_t PopAvailable() {
+		uint64_t old = available.load(std::memory_order_acquire);
+		uint32_t link;
+		do {
+			link = uint32_t(old);
+			if (link == 0)
+				return 0;
+		} while (!available.compare_exchange_weak(old,
+							  MakeHead(old, links[link - 1].load(std::memory_order_relaxed)),
+							  std::memory_order_acquire));
+
+		return link;
+	}
+
+	void PushAvailable(unsigned i) {
+		uint64_t old = available.load(std::memory_order_relaxed);
+		do {
+			links[i].store(uint32_t(old), std::memory_order_relaxed);
+		} while (!available.compare_exchange_weak(old,
+							  MakeHead(old, i + 1),
+							  std::memory_order_release));
+	}
+
+	/**
+	 * Take a slice which has never been used since the last
+	 * HugeDiscard().
+	 *
+	 * @return the slice index plus one, or 0 if all slices have
+	 * been initialized already
+	 */
+	uint32_t InitializeNext() {
+		unsigned n = n_initialized.load(std::memory_order_relaxed);
+		do {
+			if (n >= n_max)
+				return 0;
+		} while (!n_initialized.compare_exchange_weak(n, n + 1,
+							      std::memory_order_relaxed));
+
+		return n + 1;
+	}
+
+	/**
+	 * Called after the last slice has been freed: give memory
+	 * back to the kernel, unless another thread has allocated a
+	 * slice in the meantime.
+	 */
+	void TryDiscard() {
+		unsigned expected = 0;
+		if (!n_allocated.compare_exchange_strong(expected, DISCARDING,
+							 std::memory_order_acquire))
+			return;
+
+		HugeDiscard(data, CalcAllocationSize());
+		n_initialized.store(0, std::memory_order_relaxed);
+		available.store(MakeHead(available.load(std::memory_order_relaxed), 0),
+				std::memory_order_relaxed);
+
+		n_allocated.fetch_sub(DISCARDING, std::memory_order_release);
+	}
+
+public:
+	/**
+	 * @param _slice_size the size of each slice; must be at least
+	 * sizeof(T)
+	 */
+	AtomicSliceBuffer(unsigned _count, size_t _slice_size=sizeof(T))
+		:n_max(_count), slice_size(AlignSliceSize(_slice_size)),
+		 n_initialized(0), n_allocated(0),
+		 data((uint8_t *)HugeAllocate(CalcAllocationSize())),
+		 links(new std::atomic<uint32_t>[_count]),
+		 available(0) {
+		assert(n_max > 0);
+		assert(n_max < DISCARDING);
+		assert(slice_size >= sizeof(T));
+	}
+
+	~AtomicSliceBuffer() {
+		/* all slices must be freed explicitly, and this
+		   assertion checks for leaks */
+		assert(n_allocated.load() == 0);
+
+		delete[] links;
+		HugeFree(data, CalcAllocationSize());
+	}
+
+	AtomicSliceBuffer(const AtomicSliceBuffer &other) = delete;
+	AtomicSliceBuffer &operator=(const AtomicSliceBuffer &other) = delete;
+
+	/**
+	 * @return true if buffer allocation (by the constructor) has failed
+	 */
+	bool IsOOM() {
+		return data == nullptr;
+	}
+
+	unsigned GetCapacity() const {
+		return n_max;
+	}
+
+	bool IsEmpty() const {
+		return n_allocated.load(std::memory_order_relaxed) == 0;
+	}
+
+	template<typename... Args>
+	T *Allocate(Args&&... args) {
+		/* announce the allocation first, which prevents a
+		   concurrent Free() from discarding the memory */
+		while (n_allocated.fetch_add(1, std::memory_order_acquire)
+		       >= DISCARDING)
+			/* another thread is discarding; wait until
+			   it's done */
+			n_allocated.fetch_sub(1, std::memory_order_relaxed);
+
+		uint32_t link = PopAvailable();
+		if (link == 0) {
+			link = InitializeNext();
+			if (link == 0) {
+				/* out of (internal) memory, buffer is
+				   full */
+				n_allocated.fetch_sub(1,
+						      std::memory_order_relaxed);
+				return nullptr;
+			}
+		}
+
+		/* construct the object */
+		return ::new((void *)GetSlice(link - 1))
+			T(std::forward<Args>(args)...);
+	}
+
+	void Free(T *value) {
+		assert(reinterpret_cast<uint8_t *>(value) >= data);
+		assert(GetIndex(value) < n_max);
+		assert(GetSlice(GetIndex(value)) == value);
+		assert(n_allocated.load() > 0);
+
+		/* destruct the object */
+		value->~T();
+
+		/* insert the slice in the "available" list */
+		PushAvailable(GetIndex(value));
+
+		/* give memory back to the kernel when the last slice
+		   was freed */
+		if (n_allocated.fetch_sub(1, std::memory_order_release) == 1)
+			TryDiscard();
+	}
+};
+
+#endif
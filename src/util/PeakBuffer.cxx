@@ -38,6 +38,12 @@ PeakBuffer::IsEmpty() const
 		(peak_buffer == nullptr || peak_buffer->IsEmpty());
 }
 
+bool
+PeakBuffer::IsPeak() const
+{
+	return peak_buffer != nullptr && !peak_buffer->IsEmpty();
+}
+
 WritableBuffer<void>
 PeakBuffer::Read() const
 {
@@ -60,6 +60,13 @@ public:
 	gcc_pure
 	bool IsEmpty() const;
 
+	/**
+	 * Has the normal buffer overflowed, i.e. is there data in the
+	 * peak buffer?
+	 */
+	gcc_pure
+	bool IsPeak() const;
+
 	gcc_pure
 	WritableBuffer<void> Read() const;
 
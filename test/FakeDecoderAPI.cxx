@@ -22,6 +22,7 @@
 #include "decoder/DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "util/Error.hxx"
+#include "util/WritableBuffer.hxx"
 #include "Compiler.h"
 
 #include <unistd.h>
@@ -136,6 +137,22 @@ decoder_data(gcc_unused Decoder &decoder,
 	return DecoderCommand::NONE;
 }
 
+WritableBuffer<void>
+decoder_write_begin(gcc_unused Decoder &decoder,
+		    gcc_unused uint16_t kbit_rate)
+{
+	/* let the plugin fall back to decoder_data() */
+	return nullptr;
+}
+
+DecoderCommand
+decoder_write_commit(gcc_unused Decoder &decoder,
+		     gcc_unused InputStream *is,
+		     gcc_unused size_t length)
+{
+	return DecoderCommand::NONE;
+}
+
 DecoderCommand
 decoder_tag(gcc_unused Decoder &decoder,
 	    gcc_unused InputStream *is,
@@ -0,0 +1,473 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program measures the throughput of MPD's PCM library: sample
+ * format and channel conversion, software volume, mixing, dithering,
+ * export and resampling.
+ *
+ */
+
+#include "config.h"
+#include "AudioFormat.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "pcm/PcmExport.hxx"
+#include "pcm/PcmFormat.hxx"
+#include "pcm/PcmMix.hxx"
+#include "pcm/PcmDither.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/Volume.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of frames passed to each call, roughly what the decoder
+ * and the output threads deal with.
+ */
+static constexpr unsigned BENCH_FRAMES = 4096;
+
+/**
+ * The minimum duration of each measurement.
+ */
+static constexpr double BENCH_SECONDS = 0.1;
+
+static const SampleFormat pcm_formats[] = {
+	SampleFormat::S8,
+	SampleFormat::S16,
+	SampleFormat::S24_P32,
+	SampleFormat::S32,
+	SampleFormat::FLOAT,
+};
+
+static const unsigned channel_counts[] = { 1, 2, 6, 8 };
+
+static const unsigned sample_rates[] = {
+	44100, 48000, 88200, 96000, 176400, 192000,
+};
+
+static const char *samplerate_converter = "";
+
+const char *
+config_get_string(enum ConfigOption option, const char *default_value)
+{
+	if (option == CONF_SAMPLERATE_CONVERTER)
+		return samplerate_converter;
+
+	return default_value;
+}
+
+/**
+ * A buffer with pseudo-random samples in the given format.
+ */
+class BenchInput {
+	std::vector<uint8_t> data;
+
+public:
+	BenchInput(SampleFormat format, size_t n_samples) {
+		const size_t sample_size = sample_format_size(format);
+		data.resize(n_samples * sample_size);
+
+		uint32_t seed = 0x4d5044;
+		for (size_t i = 0; i < n_samples; ++i) {
+			seed = seed * 1103515245 + 12345;
+			uint8_t *p = &data[i * sample_size];
+
+			switch (format) {
+			case SampleFormat::FLOAT:
+				*(float *)p = int32_t(seed) / 2147483648.f;
+				break;
+
+			case SampleFormat::S24_P32:
+				*(int32_t *)p = int32_t(seed) >> 8;
+				break;
+
+			default:
+				memcpy(p, &seed, sample_size);
+				break;
+			}
+		}
+	}
+
+	void *GetData() {
+		return &data.front();
+	}
+
+	operator ConstBuffer<void>() const {
+		return { &data.front(), data.size() };
+	}
+};
+
+/**
+ * Store a result somewhere the compiler cannot see, to prevent it
+ * from optimizing away calls to "pure" functions.
+ */
+static void
+Consume(ConstBuffer<void> result)
+{
+	static const void *volatile sink;
+	sink = result.data;
+}
+
+/**
+ * Call the given function repeatedly for at least #BENCH_SECONDS,
+ * and print the throughput.
+ *
+ * @param n_samples the number of samples processed by each call
+ * @param n_bytes the number of input bytes processed by each call
+ */
+template<typename F>
+static void
+Measure(const char *suite, const char *name,
+	size_t n_samples, size_t n_bytes, F f)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	/* warm up the caches and let the buffers grow */
+	f();
+
+	unsigned long iterations = 0;
+	const auto start = Clock::now();
+	std::chrono::duration<double> elapsed;
+
+	do {
+		for (unsigned i = 0; i < 16; ++i)
+			f();
+
+		iterations += 16;
+		elapsed = Clock::now() - start;
+	} while (elapsed.count() < BENCH_SECONDS);
+
+	const double seconds = elapsed.count();
+	printf("%-10s %-40s %10.3f ns/sample %10.1f MB/s\n",
+	       suite, name,
+	       seconds * 1e9 / (double(iterations) * n_samples),
+	       double(iterations) * n_bytes / seconds / 1e6);
+}
+
+static void
+Skip(const char *suite, const char *name, const Error &error)
+{
+	printf("%-10s %-40s skipped: %s\n", suite, name, error.GetMessage());
+}
+
+static void
+BenchConvert(const char *suite, AudioFormat in, AudioFormat out)
+{
+	struct audio_format_string s1, s2;
+	char name[64];
+	snprintf(name, sizeof(name), "%s -> %s",
+		 audio_format_to_string(in, &s1),
+		 audio_format_to_string(out, &s2));
+
+	Error error;
+	PcmConvert convert;
+	if (!convert.Open(in, out, error)) {
+		Skip(suite, name, error);
+		return;
+	}
+
+	const size_t n_samples = size_t(BENCH_FRAMES) * in.channels;
+	BenchInput input(in.format, n_samples);
+
+	bool failed = false;
+	Measure(suite, name, n_samples, n_samples * in.GetSampleSize(),
+		[&](){
+			if (failed)
+				return;
+
+			const auto result = convert.Convert(input, error);
+			if (result.IsNull())
+				failed = true;
+			Consume(result);
+		});
+
+	if (failed)
+		Skip(suite, name, error);
+
+	convert.Close();
+}
+
+static void
+BenchFormats()
+{
+	for (unsigned channels : channel_counts) {
+		for (SampleFormat in : pcm_formats)
+			for (SampleFormat out : pcm_formats)
+				if (out != in && out != SampleFormat::S8)
+					BenchConvert("convert",
+						     AudioFormat(44100, in,
+								 channels),
+						     AudioFormat(44100, out,
+								 channels));
+
+		BenchConvert("convert",
+			     AudioFormat(352800, SampleFormat::DSD, channels),
+			     AudioFormat(44100, SampleFormat::FLOAT,
+					 channels));
+	}
+}
+
+static void
+BenchChannels()
+{
+	static const struct {
+		unsigned in, out;
+	} pairs[] = {
+		{ 1, 2 }, { 2, 1 }, { 6, 2 }, { 8, 2 },
+	};
+
+	for (SampleFormat format : pcm_formats)
+		for (const auto &i : pairs)
+			BenchConvert("channels",
+				     AudioFormat(44100, format, i.in),
+				     AudioFormat(44100, format, i.out));
+}
+
+static void
+BenchResample()
+{
+	static const SampleFormat formats[] = {
+		SampleFormat::S16, SampleFormat::S24_P32, SampleFormat::FLOAT,
+	};
+
+	for (SampleFormat format : formats)
+		for (unsigned channels : { 1, 2, 6 })
+			for (unsigned in : sample_rates)
+				for (unsigned out : sample_rates)
+					if (in != out)
+						BenchConvert("resample",
+							     AudioFormat(in, format,
+									 channels),
+							     AudioFormat(out, format,
+									 channels));
+}
+
+static void
+BenchVolume()
+{
+	for (SampleFormat format : pcm_formats) {
+		Error error;
+		PcmVolume pv;
+		if (!pv.Open(format, error)) {
+			Skip("volume", sample_format_to_string(format), error);
+			continue;
+		}
+
+		pv.SetVolume(PCM_VOLUME_1 / 2);
+
+		const size_t n_samples = size_t(BENCH_FRAMES) * 2;
+		BenchInput input(format, n_samples);
+		Measure("volume", sample_format_to_string(format),
+			n_samples, n_samples * sample_format_size(format),
+			[&](){
+				Consume(pv.Apply(input));
+			});
+
+		pv.Close();
+	}
+}
+
+static void
+BenchMix()
+{
+	for (SampleFormat format : pcm_formats) {
+		const size_t n_samples = size_t(BENCH_FRAMES) * 2;
+		const size_t size = n_samples * sample_format_size(format);
+		BenchInput a(format, n_samples), b(format, n_samples);
+		PcmDither dither;
+
+		char name[64];
+		snprintf(name, sizeof(name), "%s crossfade",
+			 sample_format_to_string(format));
+		Measure("mix", name, n_samples, size,
+			[&](){
+				pcm_mix(dither, a.GetData(),
+					ConstBuffer<void>(b).data, size,
+					format, 0.5);
+			});
+
+		snprintf(name, sizeof(name), "%s add",
+			 sample_format_to_string(format));
+		Measure("mix", name, n_samples, size,
+			[&](){
+				pcm_mix(dither, a.GetData(),
+					ConstBuffer<void>(b).data, size,
+					format, -1);
+			});
+	}
+}
+
+static void
+BenchDither()
+{
+	static const SampleFormat formats[] = {
+		SampleFormat::S24_P32, SampleFormat::S32,
+	};
+
+	for (SampleFormat format : formats) {
+		const size_t n_samples = size_t(BENCH_FRAMES) * 2;
+		BenchInput input(format, n_samples);
+		PcmBuffer buffer;
+		PcmDither dither;
+
+		char name[64];
+		snprintf(name, sizeof(name), "%s -> 16",
+			 sample_format_to_string(format));
+		Measure("dither", name,
+			n_samples, n_samples * sample_format_size(format),
+			[&](){
+				Consume(pcm_convert_to_16(buffer, dither,
+							  format,
+							  input).ToVoid());
+			});
+	}
+}
+
+static void
+BenchExport()
+{
+	static const struct {
+		const char *name;
+		SampleFormat format;
+		bool dop, shift8, pack24;
+		unsigned reverse_endian;
+	} modes[] = {
+		{ "16 reverse-endian", SampleFormat::S16,
+		  false, false, false, 2 },
+		{ "24 pack", SampleFormat::S24_P32,
+		  false, false, true, 0 },
+		{ "24 pack reverse-endian", SampleFormat::S24_P32,
+		  false, false, true, 3 },
+		{ "24 shift8", SampleFormat::S24_P32,
+		  false, true, false, 0 },
+		{ "32 reverse-endian", SampleFormat::S32,
+		  false, false, false, 4 },
+		{ "dsd dop", SampleFormat::DSD,
+		  true, false, false, 0 },
+	};
+
+	for (const auto &mode : modes) {
+		const size_t n_samples = size_t(BENCH_FRAMES) * 2;
+		BenchInput input(mode.format, n_samples);
+
+		PcmExport e;
+		e.Open(mode.format, 2, mode.dop, mode.shift8, mode.pack24,
+		       mode.reverse_endian > 0);
+
+		Measure("export", mode.name,
+			n_samples, n_samples * sample_format_size(mode.format),
+			[&](){
+				Consume(e.Export(input));
+			});
+	}
+}
+
+static void
+Usage()
+{
+	fprintf(stderr,
+		"Usage: bench_pcm [SUITE [SAMPLERATE_CONVERTER...]]\n"
+		"\n"
+		"SUITE is one of: all, convert, channels, volume, mix,\n"
+		"dither, export, resample.  The resample suite is run\n"
+		"once for each SAMPLERATE_CONVERTER (default: the built-in\n"
+		"one, as selected by an empty \"samplerate_converter\").\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *suite = argc > 1 ? argv[1] : "all";
+	const bool all = strcmp(suite, "all") == 0;
+	bool found = all;
+
+	if (all || strcmp(suite, "convert") == 0) {
+		BenchFormats();
+		found = true;
+	}
+
+	if (all || strcmp(suite, "channels") == 0) {
+		BenchChannels();
+		found = true;
+	}
+
+	if (all || strcmp(suite, "volume") == 0) {
+		BenchVolume();
+		found = true;
+	}
+
+	if (all || strcmp(suite, "mix") == 0) {
+		BenchMix();
+		found = true;
+	}
+
+	if (all || strcmp(suite, "dither") == 0) {
+		BenchDither();
+		found = true;
+	}
+
+	if (all || strcmp(suite, "export") == 0) {
+		BenchExport();
+		found = true;
+	}
+
+	if (all || strcmp(suite, "resample") == 0) {
+		static const char *const default_converters[] = { "" };
+		const char *const *converters = default_converters;
+		int n_converters = 1;
+		if (argc > 2) {
+			converters = argv + 2;
+			n_converters = argc - 2;
+		}
+
+		for (int i = 0; i < n_converters; ++i) {
+			samplerate_converter = converters[i];
+			printf("# samplerate_converter \"%s\"\n",
+			       samplerate_converter);
+
+			Error error;
+			if (!pcm_convert_global_init(error)) {
+				LogError(error);
+				return EXIT_FAILURE;
+			}
+
+			BenchResample();
+		}
+
+		found = true;
+	}
+
+	if (!found) {
+		Usage();
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
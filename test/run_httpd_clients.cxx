@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A load test for the "httpd" output plugin: connects many
+ * simulated listeners to the stream and reports how much data each
+ * of them received.
+ */
+
+#include "config.h"
+#include "system/Resolver.hxx"
+#include "system/fd_util.h"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <vector>
+
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Listener {
+	int fd;
+
+	unsigned long long received;
+
+	bool closed;
+};
+
+static double
+Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+Connect(const struct addrinfo *ai)
+{
+	int fd = socket_cloexec_nonblock(ai->ai_family, ai->ai_socktype,
+					 ai->ai_protocol);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, ai->ai_addr, ai->ai_addrlen) < 0 &&
+	    errno != EINPROGRESS) {
+		close(fd);
+		return -1;
+	}
+
+	/* wait for the connection to be established */
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLOUT;
+	int error = 0;
+	socklen_t error_length = sizeof(error);
+	if (poll(&pfd, 1, 5000) != 1 ||
+	    getsockopt(fd, SOL_SOCKET, SO_ERROR, &error,
+		       &error_length) < 0 ||
+	    error != 0) {
+		close(fd);
+		return -1;
+	}
+
+	static constexpr char request[] =
+		"GET / HTTP/1.1\r\n"
+		"User-Agent: run_httpd_clients\r\n"
+		"\r\n";
+	if (send(fd, request, sizeof(request) - 1, 0) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr,
+			"Usage: run_httpd_clients HOST:PORT N [SECONDS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n = strtoul(argv[2], nullptr, 10);
+	const double duration = argc > 3 ? strtod(argv[3], nullptr) : 10;
+	if (n == 0 || duration <= 0) {
+		fprintf(stderr, "Invalid arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	Error error;
+	struct addrinfo *ai = resolve_host_port(argv[1], 8000, 0,
+						SOCK_STREAM, error);
+	if (ai == nullptr) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Listener> listeners;
+	std::vector<struct pollfd> pfds;
+	for (unsigned i = 0; i < n; ++i) {
+		int fd = Connect(ai);
+		if (fd < 0) {
+			fprintf(stderr, "Failed to connect listener %u: %s\n",
+				i, strerror(errno));
+			break;
+		}
+
+		listeners.push_back({fd, 0, false});
+		pfds.push_back({fd, POLLIN, 0});
+	}
+
+	freeaddrinfo(ai);
+
+	if (listeners.empty())
+		return EXIT_FAILURE;
+
+	const double start = Now();
+	const double end = start + duration;
+	unsigned n_open = listeners.size();
+
+	static char buffer[65536];
+	double now;
+	while (n_open > 0 && (now = Now()) < end) {
+		if (poll(pfds.data(), pfds.size(),
+			 int((end - now) * 1000) + 1) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("poll() failed");
+			return EXIT_FAILURE;
+		}
+
+		for (size_t i = 0; i < pfds.size(); ++i) {
+			if (pfds[i].revents == 0)
+				continue;
+
+			Listener &l = listeners[i];
+			ssize_t nbytes = recv(l.fd, buffer, sizeof(buffer), 0);
+			if (nbytes > 0) {
+				l.received += nbytes;
+			} else if (nbytes == 0 ||
+				   (errno != EAGAIN && errno != EINTR)) {
+				l.closed = true;
+				pfds[i].fd = -1;
+				--n_open;
+			}
+		}
+	}
+
+	const double elapsed = Now() - start;
+
+	unsigned long long total = 0;
+	unsigned long long min = ~0ull, max = 0;
+	unsigned n_closed = 0;
+	for (const auto &l : listeners) {
+		total += l.received;
+		if (l.received < min)
+			min = l.received;
+		if (l.received > max)
+			max = l.received;
+		if (l.closed)
+			++n_closed;
+
+		close(l.fd);
+	}
+
+	printf("listeners: %zu (%u closed by the server)\n",
+	       listeners.size(), n_closed);
+	printf("received: %llu bytes in %.1f seconds (%.1f kB/s)\n",
+	       total, elapsed, total / elapsed / 1024);
+	printf("per listener: min %llu, average %llu, max %llu bytes\n",
+	       min, total / listeners.size(), max);
+	return EXIT_SUCCESS;
+}
@@ -56,10 +56,14 @@ filter_plugin_by_name(gcc_unused const char *name)
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     MultipleOutputs &_outputs,
 			     unsigned _buffer_chunks,
-			     unsigned _buffered_before_play)
+			     size_t _chunk_size,
+			     unsigned _buffered_before_play,
+			     unsigned _prefetch_songs)
 	:listener(_listener), outputs(_outputs),
 	 buffer_chunks(_buffer_chunks),
-	 buffered_before_play(_buffered_before_play) {}
+	 chunk_size(_chunk_size),
+	 buffered_before_play(_buffered_before_play),
+	 prefetch_songs(_prefetch_songs) {}
 PlayerControl::~PlayerControl() {}
 
 static AudioOutput *
@@ -74,7 +78,7 @@ load_audio_output(EventLoop &event_loop, const char *name)
 
 	static struct PlayerControl dummy_player_control(*(PlayerListener *)nullptr,
 							 *(MultipleOutputs *)nullptr,
-							 32, 4);
+							 32, 4096, 4, 0);
 
 	Error error;
 	AudioOutput *ao =
@@ -0,0 +1,214 @@
+/*
+ * Unit tests for the binary format and the journal of the simple
+ * database plugin.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/DatabaseBinary.hxx"
+#include "db/plugins/simple/DatabaseJournal.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/StringOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <string.h>
+#include <stdlib.h>
+
+static Directory *
+BuildTree()
+{
+	const ScopeDatabaseLock protect;
+
+	Directory *root = Directory::NewRoot();
+
+	Directory *a = root->CreateChild("a");
+	a->mtime = 1234567890;
+
+	Directory *b = a->CreateChild("b.flac");
+	b->device = DEVICE_CONTAINER;
+
+	Song *song = Song::NewFile("x.ogg", *a);
+	song->mtime = 42;
+	song->start_time = SongTime::FromMS(1000);
+	song->end_time = SongTime::FromMS(2500);
+
+	TagBuilder tag;
+	tag.SetDuration(SignedSongTime::FromMS(180500));
+	tag.AddItem(TAG_ARTIST, "Artist");
+	tag.AddItem(TAG_TITLE, "Title");
+	tag.AddItem(TAG_ARTIST, "Second Artist");
+	tag.Commit(song->tag);
+	a->AddSong(song);
+
+	b->AddSong(Song::NewFile("track001", *b));
+
+	root->playlists.push_back(PlaylistInfo("p.m3u", 99));
+	return root;
+}
+
+static std::string
+Save(const Directory &root)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	db_save_binary(bos, root);
+	CPPUNIT_ASSERT(bos.Flush());
+	return sos.GetValue();
+}
+
+class DatabaseBinaryTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DatabaseBinaryTest);
+	CPPUNIT_TEST(TestMagic);
+	CPPUNIT_TEST(TestRoundTrip);
+	CPPUNIT_TEST(TestTruncated);
+	CPPUNIT_TEST(TestJournal);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestMagic() {
+		static constexpr char text[] = "info_begin\nformat: 2\n";
+		CPPUNIT_ASSERT(!db_is_binary({text, sizeof(text) - 1}));
+		CPPUNIT_ASSERT(!db_is_binary({text, 0}));
+	}
+
+	void TestRoundTrip() {
+		Directory *root = BuildTree();
+		const std::string data = Save(*root);
+		CPPUNIT_ASSERT(db_is_binary({data.data(), data.size()}));
+
+		Directory *root2 = Directory::NewRoot();
+		Error error;
+		CPPUNIT_ASSERT(db_load_binary({data.data(), data.size()},
+					      *root2, error));
+
+		const ScopeDatabaseLock protect;
+
+		const Directory *a = root2->FindChild("a");
+		CPPUNIT_ASSERT(a != nullptr);
+		CPPUNIT_ASSERT_EQUAL(time_t(1234567890), a->mtime);
+
+		const Directory *b = a->FindChild("b.flac");
+		CPPUNIT_ASSERT(b != nullptr);
+		CPPUNIT_ASSERT_EQUAL(DEVICE_CONTAINER, b->device);
+		CPPUNIT_ASSERT(b->FindSong("track001") != nullptr);
+
+		const Song *song = a->FindSong("x.ogg");
+		CPPUNIT_ASSERT(song != nullptr);
+		CPPUNIT_ASSERT_EQUAL(time_t(42), song->mtime);
+		CPPUNIT_ASSERT_EQUAL(1000u, song->start_time.ToMS());
+		CPPUNIT_ASSERT_EQUAL(2500u, song->end_time.ToMS());
+		CPPUNIT_ASSERT_EQUAL(180500, song->tag.duration.ToMS());
+		CPPUNIT_ASSERT_EQUAL(3u, unsigned(song->tag.num_items));
+		CPPUNIT_ASSERT_EQUAL(TAG_ARTIST, song->tag.items[0]->type);
+		CPPUNIT_ASSERT(strcmp(song->tag.items[0]->value,
+				      "Artist") == 0);
+		CPPUNIT_ASSERT(strcmp(song->tag.items[2]->value,
+				      "Second Artist") == 0);
+
+		CPPUNIT_ASSERT(!root2->playlists.empty());
+		CPPUNIT_ASSERT(root2->playlists.begin()->name == "p.m3u");
+		CPPUNIT_ASSERT_EQUAL(time_t(99),
+				     root2->playlists.begin()->mtime);
+
+		/* saving the loaded tree gives the same bytes */
+		CPPUNIT_ASSERT(Save(*root2) == data);
+
+		delete root;
+		delete root2;
+	}
+
+	void TestTruncated() {
+		Directory *root = BuildTree();
+		const std::string data = Save(*root);
+		delete root;
+
+		/* every truncated file must be rejected cleanly */
+		for (size_t length = 8; length < data.size(); ++length) {
+			Directory *root2 = Directory::NewRoot();
+			Error error;
+			CPPUNIT_ASSERT(!db_load_binary({data.data(), length},
+						       *root2, error));
+			CPPUNIT_ASSERT(error.IsDefined());
+			delete root2;
+		}
+	}
+
+	void TestJournal() {
+		Directory *root = BuildTree();
+		const std::string base = Save(*root);
+
+		DatabaseJournal journal;
+		journal.Reset(*root);
+
+		std::string data;
+		journal_write_header(data, base.size(), 1000);
+		CPPUNIT_ASSERT_EQUAL(0u, journal.Collect(*root, data));
+
+		{
+			const ScopeDatabaseLock protect;
+			Directory *a = root->FindChild("a");
+			a->mtime = 1234567891;
+			a->FindChild("b.flac")->Delete();
+
+			Directory *c = root->CreateChild("c");
+			c->AddSong(Song::NewFile("z.mp3", *c));
+		}
+
+		/* the root, "a" and the new "c" */
+		CPPUNIT_ASSERT_EQUAL(3u, journal.Collect(*root, data));
+		CPPUNIT_ASSERT_EQUAL(0u, journal.Collect(*root, data));
+
+		const ConstBuffer<void> buffer(data.data(), data.size());
+		CPPUNIT_ASSERT(journal_check_header(buffer, base.size(), 1000));
+		CPPUNIT_ASSERT(!journal_check_header(buffer, base.size(), 1001));
+		CPPUNIT_ASSERT(!journal_check_header(buffer, base.size() + 1,
+						     1000));
+
+		/* replaying the journal on the old database gives the
+		   new one */
+		Directory *root2 = Directory::NewRoot();
+		Error error;
+		CPPUNIT_ASSERT(db_load_binary({base.data(), base.size()},
+					      *root2, error));
+
+		bool truncated;
+		CPPUNIT_ASSERT(journal_replay(buffer, *root2, truncated,
+					      error));
+		CPPUNIT_ASSERT(!truncated);
+		CPPUNIT_ASSERT(Save(*root2) == Save(*root));
+		delete root2;
+
+		/* an interrupted append is ignored */
+		root2 = Directory::NewRoot();
+		CPPUNIT_ASSERT(db_load_binary({base.data(), base.size()},
+					      *root2, error));
+		CPPUNIT_ASSERT(journal_replay({data.data(), data.size() - 1},
+					      *root2, truncated, error));
+		CPPUNIT_ASSERT(truncated);
+		delete root2;
+
+		delete root;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DatabaseBinaryTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
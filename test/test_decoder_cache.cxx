@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "decoder/DecoderCache.hxx"
+#include "tag/Tag.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr size_t BLOCK = 256 * 1024;
+
+/**
+ * Record a song with the specified number of bytes; each byte
+ * contains the low bits of its offset.
+ */
+static bool
+Record(DecoderCache &cache, const char *uri, size_t size,
+       AudioFormat af=AudioFormat(44100, SampleFormat::S16, 2))
+{
+	DecoderCacheWriter writer(cache, DecoderCache::MakeKey(uri, 1,
+							       SongTime::zero(),
+							       SongTime::zero()));
+	CPPUNIT_ASSERT(writer.SetFormat(af, af, true,
+					SignedSongTime::Negative()));
+
+	const size_t frame_size = af.GetFrameSize();
+	uint8_t buffer[frame_size * 1000];
+	for (size_t position = 0; position < size;) {
+		const size_t n = std::min(sizeof(buffer), size - position);
+		for (size_t i = 0; i < n; ++i)
+			buffer[i] = uint8_t(position + i);
+
+		if (!writer.Append(buffer, n, 128))
+			return false;
+
+		position += n;
+	}
+
+	writer.Commit();
+	return true;
+}
+
+static const DecoderCacheItem *
+Get(DecoderCache &cache, const char *uri)
+{
+	return cache.Get(DecoderCache::MakeKey(uri, 1, SongTime::zero(),
+					       SongTime::zero()));
+}
+
+static DecoderCacheStats
+GetStats(const DecoderCache &cache)
+{
+	DecoderCacheStats stats;
+	cache.GetStats(stats);
+	return stats;
+}
+
+class DecoderCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DecoderCacheTest);
+	CPPUNIT_TEST(TestRead);
+	CPPUNIT_TEST(TestEvents);
+	CPPUNIT_TEST(TestKey);
+	CPPUNIT_TEST(TestEviction);
+	CPPUNIT_TEST(TestInUse);
+	CPPUNIT_TEST(TestReplaceInUse);
+	CPPUNIT_TEST(TestDiscard);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestRead() {
+		DecoderCache cache(16 * BLOCK);
+
+		/* 6 channels, 16 bit: the block size is not a
+		   multiple of the frame size */
+		const AudioFormat af(48000, SampleFormat::S16, 6);
+		const size_t size = 3 * BLOCK + 1200;
+		CPPUNIT_ASSERT(Record(cache, "a", size, af));
+
+		const DecoderCacheItem *item = Get(cache, "a");
+		CPPUNIT_ASSERT(item != nullptr);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(size), item->GetSize());
+		CPPUNIT_ASSERT(item->audio_format == af);
+		CPPUNIT_ASSERT_EQUAL(uint16_t(128), item->kbit_rate);
+
+		uint64_t position = 0;
+		while (true) {
+			const auto data = item->Read(position);
+			if (data.IsEmpty())
+				break;
+
+			CPPUNIT_ASSERT_EQUAL(size_t(0),
+					     data.size % af.GetFrameSize());
+
+			const uint8_t *p = (const uint8_t *)data.data;
+			for (size_t i = 0; i < data.size; ++i)
+				CPPUNIT_ASSERT_EQUAL(uint8_t(position + i),
+						     p[i]);
+
+			position += data.size;
+		}
+
+		CPPUNIT_ASSERT_EQUAL(uint64_t(size), position);
+
+		cache.Put(*item);
+
+		CPPUNIT_ASSERT(Get(cache, "b") == nullptr);
+
+		const auto stats = GetStats(cache);
+		CPPUNIT_ASSERT_EQUAL(1u, stats.n_items);
+		CPPUNIT_ASSERT_EQUAL(1u, stats.hits);
+		CPPUNIT_ASSERT_EQUAL(1u, stats.misses);
+	}
+
+	void TestEvents() {
+		DecoderCache cache(4 * BLOCK);
+		const AudioFormat af(44100, SampleFormat::S16, 2);
+
+		{
+			DecoderCacheWriter writer(cache, "x");
+			ReplayGainInfo rgi;
+			rgi.Clear();
+			writer.AddReplayGain(&rgi);
+			writer.SetFormat(AudioFormat(44100, SampleFormat::S24_P32, 2),
+					 af, false, SignedSongTime::FromMS(2000));
+
+			static const uint8_t data[400] = {};
+			CPPUNIT_ASSERT(writer.Append(data, sizeof(data), 0));
+
+			Tag tag;
+			writer.AddTag(tag);
+			CPPUNIT_ASSERT(writer.Append(data, sizeof(data), 0));
+			writer.Commit();
+		}
+
+		const DecoderCacheItem *item = cache.Get("x");
+		CPPUNIT_ASSERT(item != nullptr);
+		CPPUNIT_ASSERT(!item->seekable);
+		CPPUNIT_ASSERT(item->in_audio_format ==
+			       AudioFormat(44100, SampleFormat::S24_P32, 2));
+		CPPUNIT_ASSERT_EQUAL(2u, item->duration.ToS());
+		CPPUNIT_ASSERT_EQUAL(size_t(2), item->events.size());
+		CPPUNIT_ASSERT(item->events[0].type ==
+			       DecoderCacheItem::Event::Type::REPLAY_GAIN);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), item->events[0].offset);
+		CPPUNIT_ASSERT(item->events[0].replay_gain != nullptr);
+		CPPUNIT_ASSERT(item->events[1].type ==
+			       DecoderCacheItem::Event::Type::TAG);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(400), item->events[1].offset);
+		cache.Put(*item);
+	}
+
+	void TestKey() {
+		const std::string a =
+			DecoderCache::MakeKey("a.flac", 1, SongTime::zero(),
+					      SongTime::zero());
+		CPPUNIT_ASSERT(a == DecoderCache::MakeKey("a.flac", 1,
+							  SongTime::zero(),
+							  SongTime::zero()));
+		CPPUNIT_ASSERT(a != DecoderCache::MakeKey("a.flac", 2,
+							  SongTime::zero(),
+							  SongTime::zero()));
+		CPPUNIT_ASSERT(a != DecoderCache::MakeKey("a.flac", 1,
+							  SongTime::FromMS(60000),
+							  SongTime::zero()));
+		CPPUNIT_ASSERT(a != DecoderCache::MakeKey("b.flac", 1,
+							  SongTime::zero(),
+							  SongTime::zero()));
+	}
+
+	void TestEviction() {
+		DecoderCache cache(3 * BLOCK);
+
+		CPPUNIT_ASSERT(Record(cache, "a", BLOCK));
+		CPPUNIT_ASSERT(Record(cache, "b", BLOCK));
+
+		/* "a" is now more recently used than "b" */
+		cache.Put(*Get(cache, "a"));
+
+		CPPUNIT_ASSERT(Record(cache, "c", 2 * BLOCK));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(3 * BLOCK),
+				     GetStats(cache).size);
+
+		CPPUNIT_ASSERT(Get(cache, "b") == nullptr);
+
+		const DecoderCacheItem *a = Get(cache, "a");
+		CPPUNIT_ASSERT(a != nullptr);
+		cache.Put(*a);
+
+		/* replacing an item frees the old one */
+		CPPUNIT_ASSERT(Record(cache, "c", BLOCK));
+		CPPUNIT_ASSERT_EQUAL(2u, GetStats(cache).n_items);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(2 * BLOCK),
+				     GetStats(cache).size);
+
+		/* a song which does not fit is not cached */
+		CPPUNIT_ASSERT(!Record(cache, "d", 4 * BLOCK));
+		CPPUNIT_ASSERT(Get(cache, "d") == nullptr);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), GetStats(cache).size);
+
+		/* a song known to be too long is rejected early */
+		CPPUNIT_ASSERT(Record(cache, "a", BLOCK));
+		DecoderCacheWriter writer(cache, "e");
+		const AudioFormat af(44100, SampleFormat::S16, 2);
+		CPPUNIT_ASSERT(!writer.SetFormat(af, af, true,
+						 SignedSongTime::FromMS(10000)));
+		CPPUNIT_ASSERT(writer.SetFormat(af, af, true,
+						SignedSongTime::FromMS(1000)));
+		CPPUNIT_ASSERT_EQUAL(1u, GetStats(cache).n_items);
+	}
+
+	void TestInUse() {
+		DecoderCache cache(2 * BLOCK);
+
+		CPPUNIT_ASSERT(Record(cache, "a", BLOCK));
+		CPPUNIT_ASSERT(Record(cache, "b", BLOCK));
+
+		const DecoderCacheItem *a = Get(cache, "a");
+		const DecoderCacheItem *b = Get(cache, "b");
+
+		/* items being played are not evicted */
+		CPPUNIT_ASSERT(!Record(cache, "c", 100));
+		CPPUNIT_ASSERT_EQUAL(2u, GetStats(cache).n_items);
+
+		cache.Put(*b);
+		CPPUNIT_ASSERT(Record(cache, "c", 100));
+		CPPUNIT_ASSERT(Get(cache, "b") == nullptr);
+
+		cache.Put(*a);
+	}
+
+	void TestReplaceInUse() {
+		DecoderCache cache(3 * BLOCK);
+
+		CPPUNIT_ASSERT(Record(cache, "a", BLOCK));
+		const DecoderCacheItem *old_a = Get(cache, "a");
+
+		/* the old item stays valid until it is released */
+		CPPUNIT_ASSERT(Record(cache, "a", BLOCK));
+		const DecoderCacheItem *new_a = Get(cache, "a");
+		CPPUNIT_ASSERT(new_a != old_a);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(BLOCK), old_a->GetSize());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(2 * BLOCK),
+				     GetStats(cache).size);
+
+		cache.Put(*old_a);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(BLOCK), GetStats(cache).size);
+		cache.Put(*new_a);
+	}
+
+	void TestDiscard() {
+		DecoderCache cache(4 * BLOCK);
+
+		{
+			DecoderCacheWriter writer(cache, "x");
+			const AudioFormat af(44100, SampleFormat::S16, 2);
+			writer.SetFormat(af, af, true,
+					 SignedSongTime::Negative());
+
+			static const uint8_t data[4000] = {};
+			CPPUNIT_ASSERT(writer.Append(data, sizeof(data), 0));
+			CPPUNIT_ASSERT_EQUAL(uint64_t(BLOCK),
+					     GetStats(cache).size);
+		}
+
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), GetStats(cache).size);
+		CPPUNIT_ASSERT(cache.Get("x") == nullptr);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DecoderCacheTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "decoder/DecoderConvertThread.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "AudioFormat.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <random>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *
+config_get_string(gcc_unused enum ConfigOption option,
+		  const char *default_value)
+{
+	return default_value;
+}
+
+static void
+Append(std::vector<uint8_t> &v, ConstBuffer<void> b)
+{
+	const uint8_t *p = (const uint8_t *)b.data;
+	v.insert(v.end(), p, p + b.size);
+}
+
+class DecoderConvertThreadTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DecoderConvertThreadTest);
+	CPPUNIT_TEST(TestSame);
+	CPPUNIT_TEST(TestDiscard);
+	CPPUNIT_TEST_SUITE_END();
+
+	const AudioFormat in_format{44100, SampleFormat::S16, 2};
+	const AudioFormat out_format{48000, SampleFormat::FLOAT, 1};
+
+public:
+	void setUp() {
+		Error error;
+		CPPUNIT_ASSERT(pcm_convert_global_init(error));
+	}
+
+	/**
+	 * The thread must produce the same data as a #PcmConvert
+	 * which is called directly, although the caller reuses its
+	 * buffer while the previous block is still being converted.
+	 */
+	void TestSame() {
+		PcmConvert direct, threaded;
+		Error error;
+		CPPUNIT_ASSERT(direct.Open(in_format, out_format, error));
+		CPPUNIT_ASSERT(threaded.Open(in_format, out_format, error));
+
+		std::vector<uint8_t> expected, actual;
+
+		{
+			DecoderConvertThread thread(threaded);
+			CPPUNIT_ASSERT(thread.Start(error));
+
+			std::mt19937 rng(42);
+			int16_t buffer[4096];
+
+			for (unsigned i = 0; i < 200; ++i) {
+				const size_t n = 2 * (1 + rng() % 2048);
+				for (size_t j = 0; j < n; ++j)
+					buffer[j] = rng();
+
+				const ConstBuffer<void> src(buffer,
+							    n * sizeof(buffer[0]));
+
+				const auto result = direct.Convert(src, error);
+				CPPUNIT_ASSERT(!result.IsNull());
+				Append(expected, result);
+
+				if (thread.IsPending()) {
+					const auto r = thread.Collect(error);
+					CPPUNIT_ASSERT(!r.IsNull());
+					Append(actual, r);
+				}
+
+				thread.Submit(src);
+				CPPUNIT_ASSERT(thread.IsPending());
+
+				/* overwrite the buffer, the thread
+				   must have made a copy */
+				memset(buffer, 0, sizeof(buffer));
+			}
+
+			const auto r = thread.Collect(error);
+			CPPUNIT_ASSERT(!r.IsNull());
+			Append(actual, r);
+			CPPUNIT_ASSERT(!thread.IsPending());
+		}
+
+		direct.Close();
+		threaded.Close();
+
+		CPPUNIT_ASSERT(!expected.empty());
+		CPPUNIT_ASSERT(expected == actual);
+	}
+
+	/**
+	 * Destroying the thread with a pending block must not hang.
+	 */
+	void TestDiscard() {
+		PcmConvert convert;
+		Error error;
+		CPPUNIT_ASSERT(convert.Open(in_format, out_format, error));
+
+		{
+			DecoderConvertThread thread(convert);
+			CPPUNIT_ASSERT(thread.Start(error));
+
+			int16_t buffer[1024] = {0};
+			thread.Submit({buffer, sizeof(buffer)});
+		}
+
+		convert.Close();
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DecoderConvertThreadTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "output/FilterStage.hxx"
+#include "filter/FilterInternal.hxx"
+#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "MusicHistory.hxx"
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+MusicChunk::~MusicChunk() {}
+
+#ifndef NDEBUG
+bool
+MusicChunk::CheckFormat(const AudioFormat other_format) const
+{
+	return length == 0 || audio_format == other_format;
+}
+#endif
+
+/* no replay gain filter is configured in this test */
+
+void
+replay_gain_filter_set_mixer(gcc_unused Filter *_filter,
+			     gcc_unused Mixer *mixer,
+			     gcc_unused unsigned base)
+{
+}
+
+void
+replay_gain_filter_set_info(gcc_unused Filter *filter,
+			    gcc_unused const ReplayGainInfo *info)
+{
+}
+
+void
+replay_gain_filter_set_mode(gcc_unused Filter *filter,
+			    gcc_unused ReplayGainMode mode)
+{
+}
+
+static constexpr Domain stub_filter_domain("stub_filter");
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+
+static constexpr size_t CHUNK_SIZE = 64;
+
+/**
+ * A filter which adds 1 to each byte and counts how often it was
+ * invoked.
+ */
+class StubFilter final : public Filter {
+	uint8_t buffer[CHUNK_SIZE];
+
+public:
+	unsigned n_calls = 0;
+	bool fail = false;
+
+	virtual AudioFormat Open(AudioFormat &af,
+				 gcc_unused Error &error) override {
+		return af;
+	}
+
+	virtual void Close() override {}
+
+	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
+					    Error &error) override {
+		++n_calls;
+
+		if (fail) {
+			error.Set(stub_filter_domain, "Stub failure");
+			return nullptr;
+		}
+
+		CPPUNIT_ASSERT(src.size <= sizeof(buffer));
+
+		const uint8_t *p = (const uint8_t *)src.data;
+		for (size_t i = 0; i < src.size; ++i)
+			buffer[i] = p[i] + 1;
+
+		/* overwritten by the next call, just like the
+		   buffers of real filters */
+		return { buffer, src.size };
+	}
+};
+
+static MusicChunk *
+MakeChunk(MusicBuffer &buffer, uint8_t value, unsigned ms)
+{
+	MusicChunk *chunk = buffer.Allocate();
+	CPPUNIT_ASSERT(chunk != nullptr);
+
+	memset(chunk->data, value, CHUNK_SIZE);
+	chunk->length = CHUNK_SIZE;
+	chunk->time = SongTime::FromMS(ms);
+#ifndef NDEBUG
+	chunk->audio_format = audio_format;
+#endif
+	return chunk;
+}
+
+/**
+ * Does the filtered buffer contain the chunk's value plus one?
+ */
+static bool
+IsFiltered(ConstBuffer<void> data, uint8_t value)
+{
+	if (data.IsNull() || data.size != CHUNK_SIZE)
+		return false;
+
+	const uint8_t *p = (const uint8_t *)data.data;
+	for (size_t i = 0; i < data.size; ++i)
+		if (p[i] != uint8_t(value + 1))
+			return false;
+
+	return true;
+}
+
+class FilterStageTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(FilterStageTest);
+	CPPUNIT_TEST(TestShared);
+	CPPUNIT_TEST(TestFailure);
+	CPPUNIT_TEST(TestForgetAll);
+	CPPUNIT_TEST(TestHistoryReplay);
+	CPPUNIT_TEST(TestRecycled);
+	CPPUNIT_TEST_SUITE_END();
+
+	MusicBuffer buffer;
+	MusicPipe pipe;
+	MusicHistory history;
+
+	StubFilter *filter;
+	OutputFilterStage *stage;
+
+public:
+	FilterStageTest():buffer(4, CHUNK_SIZE) {}
+
+	void setUp() {
+		filter = new StubFilter();
+		stage = new OutputFilterStage(filter, "stub");
+
+		/* two outputs */
+		stage->Share();
+
+		Error error;
+		CPPUNIT_ASSERT(stage->Open(audio_format, error) == audio_format);
+		CPPUNIT_ASSERT(stage->Open(audio_format, error) == audio_format);
+	}
+
+	void tearDown() {
+		stage->ForgetAll();
+		stage->Close();
+		stage->Close();
+		stage->Unref();
+		stage->Unref();
+
+		history.Clear(buffer);
+		pipe.Clear(buffer);
+#ifndef NDEBUG
+		CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+#endif
+	}
+
+	ConstBuffer<void> FilterChunk(const MusicChunk &chunk) {
+		Error error;
+		const auto data = stage->FilterChunk(chunk, error);
+		CPPUNIT_ASSERT(data.IsNull() == error.IsDefined());
+		return data;
+	}
+
+	/**
+	 * Simulate MultipleOutputs::Check(): the chunk has been
+	 * consumed by all outputs and is moved to the history.
+	 */
+	void Consume(MusicChunk *chunk) {
+		stage->Forget(*chunk);
+		history.Push(chunk, buffer);
+	}
+
+	void TestShared() {
+		MusicChunk *a = MakeChunk(buffer, 1, 0);
+		MusicChunk *b = MakeChunk(buffer, 2, 10);
+
+		/* the first output computes */
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*a), 1));
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*b), 2));
+		CPPUNIT_ASSERT_EQUAL(2u, filter->n_calls);
+
+		/* the second output gets the cached copy, even though
+		   the filter's own buffer has been overwritten by
+		   now */
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*a), 1));
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*b), 2));
+		CPPUNIT_ASSERT_EQUAL(2u, filter->n_calls);
+
+		buffer.Return(a);
+		buffer.Return(b);
+	}
+
+	void TestFailure() {
+		MusicChunk *a = MakeChunk(buffer, 1, 0);
+		MusicChunk *b = MakeChunk(buffer, 2, 10);
+
+		filter->fail = true;
+		CPPUNIT_ASSERT(FilterChunk(*a).IsNull());
+		CPPUNIT_ASSERT_EQUAL(1u, filter->n_calls);
+
+		/* the failure is recorded for the other output,
+		   which does not run the filter again */
+		filter->fail = false;
+		CPPUNIT_ASSERT(FilterChunk(*a).IsNull());
+		CPPUNIT_ASSERT_EQUAL(1u, filter->n_calls);
+
+		/* the next chunk is not affected */
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*b), 2));
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*b), 2));
+		CPPUNIT_ASSERT_EQUAL(2u, filter->n_calls);
+
+		buffer.Return(a);
+		buffer.Return(b);
+	}
+
+	void TestForgetAll() {
+		MusicChunk *a = MakeChunk(buffer, 1, 0);
+
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*a), 1));
+		CPPUNIT_ASSERT_EQUAL(1u, filter->n_calls);
+
+		/* the pipe has been cleared; the same chunk pointer
+		   must be filtered again */
+		stage->ForgetAll();
+		memset(a->data, 5, CHUNK_SIZE);
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*a), 5));
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*a), 5));
+		CPPUNIT_ASSERT_EQUAL(2u, filter->n_calls);
+
+		buffer.Return(a);
+	}
+
+	void TestHistoryReplay() {
+		history.SetLimit(4, buffer);
+
+		MusicChunk *a = MakeChunk(buffer, 1, 0);
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*a), 1));
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*a), 1));
+		Consume(a);
+
+		/* seek back: the history puts the same chunk pointer
+		   back into the pipe, and both outputs see it again;
+		   the filters run once more, in order */
+		CPPUNIT_ASSERT(history.Seek(SongTime::FromMS(0), pipe, buffer,
+					    audio_format));
+		MusicChunk *replayed = history.Shift();
+		CPPUNIT_ASSERT(replayed == a);
+
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*replayed), 1));
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*replayed), 1));
+		CPPUNIT_ASSERT_EQUAL(2u, filter->n_calls);
+
+		Consume(replayed);
+	}
+
+	void TestRecycled() {
+		/* a history limit of 0 returns each played chunk to
+		   the buffer right away */
+		MusicChunk *a = MakeChunk(buffer, 1, 0);
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*a), 1));
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*a), 1));
+		Consume(a);
+
+		/* the buffer hands out the same address with new
+		   data; no stale result may be returned for it */
+		MusicChunk *b = MakeChunk(buffer, 7, 10);
+		CPPUNIT_ASSERT(b == a);
+
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*b), 7));
+		CPPUNIT_ASSERT(IsFiltered(FilterChunk(*b), 7));
+		CPPUNIT_ASSERT_EQUAL(2u, filter->n_calls);
+
+		buffer.Return(b);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FilterStageTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
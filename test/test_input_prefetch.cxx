@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "input/Prefetch.hxx"
+#include "input/InputStream.hxx"
+#include "input/InputPlugin.hxx"
+#include "input/Registry.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+/**
+ * The state of the fake input plugin.  It is accessed by the
+ * prefetch thread, with the #InputPrefetch mutex unlocked, so it
+ * has its own mutex.
+ */
+static struct {
+	Mutex mutex;
+	Cond cond;
+
+	/** how often each URI has been opened */
+	std::map<std::string, unsigned> opened;
+
+	/** opening these URIs blocks until they are removed */
+	std::set<std::string> blocked;
+
+	/** the URIs of the streams which have been deleted */
+	std::multiset<std::string> deleted;
+} fake;
+
+class FakeInputStream final : public InputStream {
+public:
+	FakeInputStream(const char *_uri, Mutex &_mutex, Cond &_cond)
+		:InputStream(_uri, _mutex, _cond) {
+		/* seekable, so InputStream::Open() does not wrap it
+		   in a RewindInputStream */
+		seekable = true;
+		SetReady();
+	}
+
+	~FakeInputStream() {
+		const ScopeLock protect(fake.mutex);
+		fake.deleted.insert(GetURI());
+	}
+
+	/* virtual methods from InputStream */
+	bool IsEOF() override {
+		return true;
+	}
+
+	size_t Read(gcc_unused void *ptr, gcc_unused size_t read_size,
+		    gcc_unused Error &error) override {
+		return 0;
+	}
+};
+
+static InputStream *
+fake_input_open(const char *uri, Mutex &mutex, Cond &cond,
+		gcc_unused Error &error)
+{
+	fake.mutex.lock();
+	++fake.opened[uri];
+	fake.cond.broadcast();
+
+	while (fake.blocked.find(uri) != fake.blocked.end())
+		fake.cond.wait(fake.mutex);
+	fake.mutex.unlock();
+
+	return new FakeInputStream(uri, mutex, cond);
+}
+
+static const InputPlugin fake_input_plugin = {
+	"fake",
+	nullptr,
+	nullptr,
+	fake_input_open,
+};
+
+const InputPlugin *const input_plugins[] = {
+	&fake_input_plugin,
+	nullptr
+};
+
+bool input_plugins_enabled[] = { true };
+
+static unsigned
+Opened(const char *uri)
+{
+	const ScopeLock protect(fake.mutex);
+	return fake.opened[uri];
+}
+
+static unsigned
+Deleted(const char *uri)
+{
+	const ScopeLock protect(fake.mutex);
+	return fake.deleted.count(uri);
+}
+
+static void
+Block(const char *uri)
+{
+	const ScopeLock protect(fake.mutex);
+	fake.blocked.insert(uri);
+}
+
+static void
+Unblock(const char *uri)
+{
+	const ScopeLock protect(fake.mutex);
+	fake.blocked.erase(uri);
+	fake.cond.broadcast();
+}
+
+/**
+ * Wait until the prefetch thread has begun opening the specified
+ * URI.  Since the thread opens one URI after another, all URIs
+ * preceding it have been dealt with then.
+ */
+static void
+WaitOpening(const char *uri)
+{
+	const ScopeLock protect(fake.mutex);
+	while (fake.opened[uri] == 0)
+		fake.cond.wait(fake.mutex);
+}
+
+class InputPrefetchTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(InputPrefetchTest);
+	CPPUNIT_TEST(TestTake);
+	CPPUNIT_TEST(TestDedup);
+	CPPUNIT_TEST(TestCancelOpening);
+	CPPUNIT_TEST(TestTakeOpening);
+	CPPUNIT_TEST(TestWindow);
+	CPPUNIT_TEST_SUITE_END();
+
+	Mutex mutex;
+	Cond cond;
+	InputPrefetch *prefetch;
+
+public:
+	void setUp() {
+		fake.opened.clear();
+		fake.blocked.clear();
+		fake.deleted.clear();
+
+		prefetch = new InputPrefetch(mutex, cond);
+	}
+
+	void tearDown() {
+		{
+			const ScopeLock protect(fake.mutex);
+			fake.blocked.clear();
+			fake.cond.broadcast();
+		}
+
+		delete prefetch;
+
+		/* every stream which has been opened has been
+		   deleted */
+		for (const auto &i : fake.opened)
+			CPPUNIT_ASSERT_EQUAL(i.second,
+					     unsigned(fake.deleted.count(i.first)));
+	}
+
+	void Set(std::vector<std::string> &&uris) {
+		const ScopeLock protect(mutex);
+		prefetch->Set(std::move(uris));
+	}
+
+	/**
+	 * Take a stream and delete it.
+	 *
+	 * @return true if the stream had been prefetched
+	 */
+	bool Take(const char *uri) {
+		mutex.lock();
+		InputStream *is = prefetch->Take(uri);
+		mutex.unlock();
+
+		if (is == nullptr)
+			return false;
+
+		CPPUNIT_ASSERT_EQUAL(std::string(uri),
+				     std::string(is->GetURI()));
+		delete is;
+		return true;
+	}
+
+	void TestTake() {
+		Block("gate");
+		Set({"a", "gate"});
+		WaitOpening("gate");
+
+		CPPUNIT_ASSERT(Take("a"));
+		CPPUNIT_ASSERT_EQUAL(1u, Opened("a"));
+
+		/* it can be taken only once */
+		CPPUNIT_ASSERT(!Take("a"));
+	}
+
+	void TestDedup() {
+		Block("gate");
+		Set({"a", "gate"});
+		WaitOpening("gate");
+
+		/* neither the stream which is ready nor the one being
+		   opened is opened again */
+		Block("gate2");
+		Set({"a", "gate", "b", "gate2"});
+		Unblock("gate");
+		WaitOpening("gate2");
+
+		CPPUNIT_ASSERT_EQUAL(1u, Opened("a"));
+		CPPUNIT_ASSERT_EQUAL(1u, Opened("gate"));
+		CPPUNIT_ASSERT_EQUAL(1u, Opened("b"));
+
+		CPPUNIT_ASSERT(Take("a"));
+		CPPUNIT_ASSERT(Take("gate"));
+		CPPUNIT_ASSERT(Take("b"));
+	}
+
+	void TestCancelOpening() {
+		Block("a");
+		Set({"a"});
+		WaitOpening("a");
+
+		/* "a" leaves the window while it is being opened */
+		Block("gate");
+		Set({"gate"});
+		Unblock("a");
+		WaitOpening("gate");
+
+		CPPUNIT_ASSERT_EQUAL(1u, Deleted("a"));
+		CPPUNIT_ASSERT(!Take("a"));
+		CPPUNIT_ASSERT_EQUAL(1u, Opened("a"));
+	}
+
+	void TestTakeOpening() {
+		Block("a");
+		Set({"a", "b", "gate"});
+		WaitOpening("a");
+
+		/* the decoder needs "a" before it is ready; it opens
+		   the stream itself, and the prefetched one is
+		   discarded */
+		CPPUNIT_ASSERT(!Take("a"));
+
+		Block("gate");
+		Unblock("a");
+		WaitOpening("gate");
+
+		CPPUNIT_ASSERT_EQUAL(1u, Deleted("a"));
+		CPPUNIT_ASSERT(!Take("a"));
+
+		/* the others are not affected */
+		CPPUNIT_ASSERT(Take("b"));
+	}
+
+	void TestWindow() {
+		Block("gate");
+		Set({"a", "b", "gate"});
+		WaitOpening("gate");
+
+		/* "a" has been played; the window moves on */
+		Block("gate2");
+		Set({"b", "gate", "c", "gate2"});
+		Unblock("gate");
+		WaitOpening("gate2");
+
+		CPPUNIT_ASSERT_EQUAL(1u, Deleted("a"));
+		CPPUNIT_ASSERT_EQUAL(0u, Deleted("b"));
+		CPPUNIT_ASSERT(!Take("a"));
+		CPPUNIT_ASSERT(Take("b"));
+		CPPUNIT_ASSERT(Take("c"));
+		CPPUNIT_ASSERT_EQUAL(1u, Opened("b"));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(InputPrefetchTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
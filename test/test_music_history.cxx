@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MusicHistory.hxx"
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdlib.h>
+
+MusicChunk::~MusicChunk() {}
+
+#ifndef NDEBUG
+bool
+MusicChunk::CheckFormat(const AudioFormat other_format) const
+{
+	return length == 0 || audio_format == other_format;
+}
+#endif
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+
+/**
+ * Each chunk contains 10 ms of audio.
+ */
+static constexpr size_t CHUNK_SIZE = 441 * 4;
+
+/**
+ * Fill the pipe with chunks; the first one begins at the specified
+ * time.
+ */
+static void
+Fill(MusicPipe &pipe, MusicBuffer &buffer, unsigned n, unsigned start_ms=0)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		MusicChunk *chunk = buffer.Allocate();
+		CPPUNIT_ASSERT(chunk != nullptr);
+
+		chunk->length = CHUNK_SIZE;
+		chunk->time = SongTime::FromMS(start_ms + i * 10);
+#ifndef NDEBUG
+		chunk->audio_format = audio_format;
+#endif
+		pipe.Push(chunk);
+	}
+}
+
+/**
+ * Simulate the player: move chunks from the history or the pipe to
+ * the history, as if they had been played.
+ */
+static void
+Play(MusicHistory &history, MusicPipe &pipe, MusicBuffer &buffer,
+     unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		MusicChunk *chunk = history.Shift();
+		if (chunk == nullptr)
+			chunk = pipe.Shift();
+		CPPUNIT_ASSERT(chunk != nullptr);
+		history.Push(chunk, buffer);
+	}
+}
+
+/**
+ * Play the next chunk, and return its time stamp in milliseconds.
+ */
+static int
+PlayOne(MusicHistory &history, MusicPipe &pipe, MusicBuffer &buffer)
+{
+	MusicChunk *chunk = history.Shift();
+	if (chunk == nullptr)
+		chunk = pipe.Shift();
+	CPPUNIT_ASSERT(chunk != nullptr);
+
+	const int result = chunk->time.count();
+	history.Push(chunk, buffer);
+	return result;
+}
+
+class MusicHistoryTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MusicHistoryTest);
+	CPPUNIT_TEST(TestSeek);
+	CPPUNIT_TEST(TestLimit);
+	CPPUNIT_TEST(TestNotReplayable);
+	CPPUNIT_TEST(TestSongBorder);
+	CPPUNIT_TEST_SUITE_END();
+
+	MusicBuffer buffer;
+	MusicPipe pipe;
+	MusicHistory history;
+
+public:
+	MusicHistoryTest():buffer(64, CHUNK_SIZE) {}
+
+	void tearDown() {
+		history.Clear(buffer);
+		pipe.Clear(buffer);
+#ifndef NDEBUG
+		CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+#endif
+	}
+
+	int PlayOne() {
+		return ::PlayOne(history, pipe, buffer);
+	}
+
+	bool Seek(unsigned ms) {
+		return history.Seek(SongTime::FromMS(ms), pipe, buffer,
+				    audio_format);
+	}
+
+	void TestSeek() {
+		history.SetLimit(32, buffer);
+		Fill(pipe, buffer, 10);
+		Play(history, pipe, buffer, 6);
+
+		/* backwards */
+		CPPUNIT_ASSERT(Seek(25));
+		CPPUNIT_ASSERT_EQUAL(20, PlayOne());
+		CPPUNIT_ASSERT_EQUAL(30, PlayOne());
+
+		/* forward, within the chunks to be played again */
+		CPPUNIT_ASSERT(Seek(50));
+		CPPUNIT_ASSERT_EQUAL(50, PlayOne());
+
+		/* forward, into the pipe */
+		CPPUNIT_ASSERT(Seek(89));
+		CPPUNIT_ASSERT(!history.HasReplay());
+		CPPUNIT_ASSERT_EQUAL(2u, pipe.GetSize());
+		CPPUNIT_ASSERT_EQUAL(80, PlayOne());
+
+		/* the skipped chunks are still available */
+		CPPUNIT_ASSERT(Seek(0));
+		for (int i = 0; i < 10; ++i)
+			CPPUNIT_ASSERT_EQUAL(i * 10, PlayOne());
+
+		CPPUNIT_ASSERT(pipe.IsEmpty());
+		CPPUNIT_ASSERT(!history.HasReplay());
+
+		/* beyond the end */
+		CPPUNIT_ASSERT(!Seek(100));
+	}
+
+	void TestLimit() {
+		history.SetLimit(4, buffer);
+		Fill(pipe, buffer, 10);
+		Play(history, pipe, buffer, 8);
+
+		CPPUNIT_ASSERT(!Seek(30));
+		CPPUNIT_ASSERT(Seek(40));
+		CPPUNIT_ASSERT_EQUAL(40, PlayOne());
+
+		/* disabling the history keeps the chunks which are
+		   yet to be played */
+		history.SetLimit(0, buffer);
+		for (int i = 5; i < 10; ++i)
+			CPPUNIT_ASSERT_EQUAL(i * 10, PlayOne());
+
+		CPPUNIT_ASSERT(!Seek(40));
+	}
+
+	void TestNotReplayable() {
+		history.SetLimit(32, buffer);
+
+		/* silence has no time stamp */
+		MusicChunk *silence = buffer.Allocate();
+		silence->length = CHUNK_SIZE;
+		silence->time = SignedSongTime::Negative();
+		history.Push(silence, buffer);
+
+		Fill(pipe, buffer, 2);
+		Play(history, pipe, buffer, 2);
+
+		CPPUNIT_ASSERT(Seek(0));
+		CPPUNIT_ASSERT_EQUAL(0, PlayOne());
+		CPPUNIT_ASSERT_EQUAL(10, PlayOne());
+		CPPUNIT_ASSERT(!history.HasReplay());
+	}
+
+	void TestSongBorder() {
+		history.SetLimit(32, buffer);
+		Fill(pipe, buffer, 10);
+		Play(history, pipe, buffer, 6);
+
+		/* the decoder begins the next song */
+		history.SetLimit(0, buffer);
+
+		/* the rest of the previous song is still in the
+		   outputs' pipe when the new song begins */
+		history.SetLimit(32, buffer);
+		history.SongBorder(pipe.GetSize());
+		Play(history, pipe, buffer, 4);
+
+		Fill(pipe, buffer, 3);
+		Play(history, pipe, buffer, 3);
+
+		/* only the new song is in the window */
+		CPPUNIT_ASSERT(!Seek(75));
+		CPPUNIT_ASSERT(Seek(15));
+		CPPUNIT_ASSERT_EQUAL(10, PlayOne());
+		CPPUNIT_ASSERT_EQUAL(20, PlayOne());
+		CPPUNIT_ASSERT(!history.HasReplay());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MusicHistoryTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
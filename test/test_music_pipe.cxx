@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <atomic>
+
+#include <string.h>
+#include <sched.h>
+#include <stdlib.h>
+
+MusicChunk::~MusicChunk() {}
+
+#ifndef NDEBUG
+bool
+MusicChunk::CheckFormat(const AudioFormat other_format) const
+{
+	return length == 0 || audio_format == other_format;
+}
+#endif
+
+static constexpr unsigned N_CHUNKS = 200000;
+
+/**
+ * Write the value to the beginning and the end of the payload, to
+ * detect chunks which overlap.
+ */
+static void
+StampChunk(MusicChunk &chunk, unsigned value)
+{
+	memcpy(chunk.data, &value, sizeof(value));
+	memcpy(chunk.data + chunk.capacity - sizeof(value),
+	       &value, sizeof(value));
+	chunk.length = chunk.capacity;
+#ifndef NDEBUG
+	chunk.audio_format = AudioFormat(44100, SampleFormat::S16, 2);
+#endif
+}
+
+static unsigned
+ReadStamp(const MusicChunk &chunk)
+{
+	unsigned value, tail;
+	memcpy(&value, chunk.data, sizeof(value));
+	memcpy(&tail, chunk.data + chunk.capacity - sizeof(tail),
+	       sizeof(tail));
+	return value == tail ? value : ~value;
+}
+
+class MusicPipeTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MusicPipeTest);
+	CPPUNIT_TEST(TestOrder);
+	CPPUNIT_TEST(TestBuffer);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestOrder();
+	void TestBuffer();
+};
+
+struct PipeContext {
+	MusicBuffer buffer;
+	MusicPipe pipe;
+
+	PipeContext():buffer(64, MIN_CHUNK_SIZE) {}
+};
+
+static void
+ProducerThread(void *ctx)
+{
+	PipeContext &c = *(PipeContext *)ctx;
+
+	for (unsigned i = 0; i < N_CHUNKS; ++i) {
+		MusicChunk *chunk;
+		while ((chunk = c.buffer.Allocate()) == nullptr)
+			sched_yield();
+
+		StampChunk(*chunk, i);
+		c.pipe.Push(chunk);
+	}
+}
+
+void
+MusicPipeTest::TestOrder()
+{
+	PipeContext c;
+
+	Thread thread;
+	Error error;
+	CPPUNIT_ASSERT(thread.Start(ProducerThread, &c, error));
+
+	for (unsigned i = 0; i < N_CHUNKS;) {
+		const unsigned size = c.pipe.GetSize();
+		if (size == 0) {
+			sched_yield();
+			continue;
+		}
+
+		/* the producer may only grow the pipe; all chunks
+		   counted by GetSize() must be available */
+		for (unsigned j = 0; j < size; ++j, ++i) {
+			MusicChunk *chunk = c.pipe.Shift();
+			CPPUNIT_ASSERT(chunk != nullptr);
+			CPPUNIT_ASSERT_EQUAL(i, ReadStamp(*chunk));
+			c.buffer.Return(chunk);
+		}
+	}
+
+	thread.Join();
+
+	CPPUNIT_ASSERT(c.pipe.IsEmpty());
+	CPPUNIT_ASSERT(c.pipe.Peek() == nullptr);
+	CPPUNIT_ASSERT(c.pipe.Shift() == nullptr);
+}
+
+struct BufferContext {
+	MusicBuffer buffer;
+
+	/** how many chunks are handed out currently */
+	std::atomic<unsigned> n_allocated;
+
+	/** set when a chunk has been handed out twice */
+	std::atomic<bool> overflow;
+
+	std::atomic<unsigned> next_id;
+
+	BufferContext()
+		:buffer(8, 1000), n_allocated(0), overflow(false), next_id(0) {}
+};
+
+static void
+AllocateThread(void *ctx)
+{
+	BufferContext &c = *(BufferContext *)ctx;
+	const unsigned id = ++c.next_id << 24;
+
+	for (unsigned i = 0; i < N_CHUNKS / 4; ++i) {
+		MusicChunk *chunk = c.buffer.Allocate();
+		if (chunk == nullptr) {
+			sched_yield();
+			continue;
+		}
+
+		if (++c.n_allocated > c.buffer.GetSize())
+			c.overflow = true;
+
+		/* no other thread may own this chunk now */
+		StampChunk(*chunk, id + i);
+		sched_yield();
+		if (ReadStamp(*chunk) != id + i)
+			c.overflow = true;
+
+		--c.n_allocated;
+		c.buffer.Return(chunk);
+	}
+}
+
+void
+MusicPipeTest::TestBuffer()
+{
+	BufferContext c;
+
+	Thread threads[4];
+	Error error;
+	for (auto &t : threads)
+		CPPUNIT_ASSERT(t.Start(AllocateThread, &c, error));
+
+	for (auto &t : threads)
+		t.Join();
+
+	CPPUNIT_ASSERT(!c.overflow.load());
+	CPPUNIT_ASSERT_EQUAL(0u, c.n_allocated.load());
+#ifndef NDEBUG
+	CPPUNIT_ASSERT(c.buffer.IsEmptyUnsafe());
+#endif
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MusicPipeTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
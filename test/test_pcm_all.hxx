@@ -79,6 +79,8 @@ class PcmFormatTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestFormat16to24);
 	CPPUNIT_TEST(TestFormat16to32);
 	CPPUNIT_TEST(TestFormatFloat);
+	CPPUNIT_TEST(TestFormatInPlace);
+	CPPUNIT_TEST(TestFormatFullScale);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -86,6 +88,8 @@ public:
 	void TestFormat16to24();
 	void TestFormat16to32();
 	void TestFormatFloat();
+	void TestFormatInPlace();
+	void TestFormatFullScale();
 };
 
 class PcmMixTest : public CppUnit::TestFixture {
@@ -118,4 +122,17 @@ public:
 	void TestDop();
 };
 
+class PcmSimdTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmSimdTest);
+	CPPUNIT_TEST(TestMix);
+	CPPUNIT_TEST(TestVolumeFloat);
+	CPPUNIT_TEST(TestFormat);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestMix();
+	void TestVolumeFloat();
+	void TestFormat();
+};
+
 #endif
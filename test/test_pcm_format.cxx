@@ -25,6 +25,11 @@
 #include "pcm/PcmUtils.hxx"
 #include "pcm/PcmBuffer.hxx"
 #include "AudioFormat.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <algorithm>
+
+#include <string.h>
 
 void
 PcmFormatTest::TestFormat8to16()
@@ -118,3 +123,112 @@ PcmFormatTest::TestFormatFloat()
 	for (size_t i = 4; i < N; ++i)
 		CPPUNIT_ASSERT_EQUAL(src[i], d[i]);
 }
+
+/**
+ * Convert with pcm_convert_in_place() and compare the result with
+ * the (allocating) conversion function.
+ */
+template<typename S, typename D, size_t N, typename C>
+static void
+CheckInPlace(const TestDataBuffer<S, N> &src,
+	     SampleFormat src_format, SampleFormat dest_format,
+	     C convert, double delta)
+{
+	CPPUNIT_ASSERT(pcm_can_convert_in_place(src_format, dest_format));
+
+	PcmBuffer buffer;
+	const auto expected = convert(buffer, src_format,
+				      ConstBuffer<void>(src, sizeof(S) * N));
+	CPPUNIT_ASSERT_EQUAL(N, expected.size);
+
+	S data[N];
+	std::copy(src.begin(), src.end(), data);
+	pcm_convert_in_place(src_format, dest_format,
+			     {data, sizeof(data)});
+
+	for (size_t i = 0; i < N; ++i) {
+		D d;
+		memcpy(&d, &data[i], sizeof(d));
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(double(expected[i]), double(d),
+					     delta);
+	}
+}
+
+void
+PcmFormatTest::TestFormatInPlace()
+{
+	constexpr size_t N = 509;
+	const auto src24 = TestDataBuffer<int32_t, N>(RandomInt24());
+	const auto src32 = TestDataBuffer<int32_t, N>();
+	const auto src_float = TestDataBuffer<float, N>(RandomFloat());
+
+	CPPUNIT_ASSERT(!pcm_can_convert_in_place(SampleFormat::S16,
+						 SampleFormat::S32));
+	CPPUNIT_ASSERT(!pcm_can_convert_in_place(SampleFormat::S24_P32,
+						 SampleFormat::S16));
+
+	CheckInPlace<int32_t, int32_t>(src24, SampleFormat::S24_P32,
+				       SampleFormat::S32,
+				       pcm_convert_to_32, 0);
+	CheckInPlace<int32_t, int32_t>(src32, SampleFormat::S32,
+				       SampleFormat::S24_P32,
+				       pcm_convert_to_24, 0);
+	CheckInPlace<int32_t, float>(src24, SampleFormat::S24_P32,
+				     SampleFormat::FLOAT,
+				     pcm_convert_to_float, 1e-6);
+	CheckInPlace<int32_t, float>(src32, SampleFormat::S32,
+				     SampleFormat::FLOAT,
+				     pcm_convert_to_float, 1e-6);
+
+	/* the SIMD kernels may round differently */
+	CheckInPlace<float, int32_t>(src_float, SampleFormat::FLOAT,
+				     SampleFormat::S24_P32,
+				     pcm_convert_to_24, 1);
+	CheckInPlace<float, int32_t>(src_float, SampleFormat::FLOAT,
+				     SampleFormat::S32,
+				     pcm_convert_to_32, 128);
+}
+
+template<typename T, size_t N>
+static void
+CheckFullScale(const TestDataBuffer<float, N> &src, ConstBuffer<T> d,
+	       T min, T max)
+{
+	CPPUNIT_ASSERT_EQUAL(N, d.size);
+
+	for (size_t i = 0; i < N; ++i) {
+		if (src[i] >= 1)
+			CPPUNIT_ASSERT_EQUAL(max, d[i]);
+		else if (src[i] <= -1)
+			CPPUNIT_ASSERT_EQUAL(min, d[i]);
+		else if (src[i] > 0)
+			CPPUNIT_ASSERT(d[i] > 0);
+		else
+			CPPUNIT_ASSERT(d[i] < 0);
+	}
+}
+
+void
+PcmFormatTest::TestFormatFullScale()
+{
+	/* not a multiple of the SIMD vector size, so the portable
+	   code converts the last samples */
+	constexpr size_t N = 67;
+	const auto src = TestDataBuffer<float, N>(FullScaleFloat());
+
+	PcmBuffer buffer;
+	PcmDither dither;
+
+	CheckFullScale<int16_t>(src,
+				pcm_convert_to_16(buffer, dither,
+						  SampleFormat::FLOAT, src),
+				-32768, 32767);
+	CheckFullScale<int32_t>(src,
+				pcm_convert_to_24(buffer,
+						  SampleFormat::FLOAT, src),
+				-0x800000, 0x7fffff);
+	CheckFullScale<int32_t>(src,
+				pcm_convert_to_32(buffer,
+						  SampleFormat::FLOAT, src),
+				INT32_MIN, INT32_MAX);
+}
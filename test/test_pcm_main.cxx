@@ -32,6 +32,7 @@ CPPUNIT_TEST_SUITE_REGISTRATION(PcmVolumeTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmFormatTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmMixTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmExportTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmSimdTest);
 
 int
 main(gcc_unused int argc, gcc_unused char **argv)
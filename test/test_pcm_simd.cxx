@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/Simd.hxx"
+#include "pcm/Volume.hxx"
+#include "pcm/PcmMix.hxx"
+#include "pcm/PcmFormat.hxx"
+#include "pcm/PcmDither.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/Traits.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+
+#include <string.h>
+
+/**
+ * Generates float samples slightly outside of [-1, 1] to exercise
+ * clamping.
+ */
+struct RandomLoudFloat : RandomFloat {
+	float operator()() {
+		return RandomFloat::operator()() * 1.25f;
+	}
+};
+
+/**
+ * Run the function with all SIMD levels supported by this CPU, and
+ * compare the results with those of the portable code.
+ *
+ * @param f a function which returns a ConstBuffer with the result
+ */
+template<typename F>
+static void
+CompareSimdLevels(F f)
+{
+	pcm_simd_set_level(SimdLevel::NONE);
+	PcmBuffer reference_buffer;
+	const ConstBuffer<void> reference = f(reference_buffer);
+
+	for (auto level : {SimdLevel::SSE2, SimdLevel::AVX2}) {
+		if (pcm_simd_set_level(level) != level)
+			/* not supported by this CPU */
+			continue;
+
+		PcmBuffer buffer;
+		const ConstBuffer<void> result = f(buffer);
+		CPPUNIT_ASSERT_EQUAL(reference.size, result.size);
+		CPPUNIT_ASSERT_EQUAL(0, memcmp(reference.data, result.data,
+					       result.size));
+	}
+
+	pcm_simd_set_level(pcm_simd_detect());
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>,
+	 typename G=RandomInt<typename Traits::value_type>>
+static void
+TestSimdMix(float portion1, G g=G())
+{
+	typedef typename Traits::value_type value_type;
+
+	constexpr size_t N = 509;
+	const auto src1 = TestDataBuffer<value_type, N>(g);
+	const auto src2 = TestDataBuffer<value_type, N>(g);
+
+	CompareSimdLevels([&](PcmBuffer &buffer){
+			auto dest = buffer.GetT<value_type>(N);
+			memcpy(dest, src1.begin(), sizeof(src1));
+
+			PcmDither dither;
+			CPPUNIT_ASSERT(pcm_mix(dither, dest, src2.begin(),
+					       sizeof(src2), F, portion1));
+			return ConstBuffer<void>(dest, sizeof(src2));
+		});
+}
+
+void
+PcmSimdTest::TestMix()
+{
+	/* a negative portion means: add without volume */
+	TestSimdMix<SampleFormat::S8>(-1);
+	TestSimdMix<SampleFormat::S16>(-1);
+	TestSimdMix<SampleFormat::S24_P32>(-1, RandomInt24());
+	TestSimdMix<SampleFormat::S32>(-1);
+	TestSimdMix<SampleFormat::FLOAT>(-1, RandomLoudFloat());
+	TestSimdMix<SampleFormat::FLOAT>(0.3, RandomLoudFloat());
+}
+
+void
+PcmSimdTest::TestVolumeFloat()
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<float, N>(RandomFloat());
+
+	CompareSimdLevels([&](PcmBuffer &buffer){
+			PcmVolume pv;
+			CPPUNIT_ASSERT(pv.Open(SampleFormat::FLOAT,
+					       IgnoreError()));
+			pv.SetVolume(PCM_VOLUME_1 * 3 / 7);
+			auto result = pv.Apply(src);
+
+			/* copy the result, because it is owned by the
+			   PcmVolume object */
+			void *dest = buffer.Get(result.size);
+			memcpy(dest, result.data, result.size);
+			pv.Close();
+			return ConstBuffer<void>(dest, result.size);
+		});
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>,
+	 typename G=RandomInt<typename Traits::value_type>>
+static void
+TestSimdFormat(G g=G())
+{
+	typedef typename Traits::value_type value_type;
+
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<value_type, N>(g);
+
+	CompareSimdLevels([&](PcmBuffer &buffer){
+			return pcm_convert_to_24(buffer, F, src).ToVoid();
+		});
+
+	CompareSimdLevels([&](PcmBuffer &buffer){
+			return pcm_convert_to_32(buffer, F, src).ToVoid();
+		});
+
+	CompareSimdLevels([&](PcmBuffer &buffer){
+			return pcm_convert_to_float(buffer, F, src).ToVoid();
+		});
+}
+
+void
+PcmSimdTest::TestFormat()
+{
+	TestSimdFormat<SampleFormat::S16>();
+	TestSimdFormat<SampleFormat::S24_P32>(RandomInt24());
+	TestSimdFormat<SampleFormat::S32>();
+	TestSimdFormat<SampleFormat::FLOAT>(RandomLoudFloat());
+	TestSimdFormat<SampleFormat::FLOAT>(FullScaleFloat());
+
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<float, N>(RandomLoudFloat());
+
+	CompareSimdLevels([&](PcmBuffer &buffer){
+			PcmDither dither;
+			return pcm_convert_to_16(buffer, dither,
+						 SampleFormat::FLOAT,
+						 src).ToVoid();
+		});
+}
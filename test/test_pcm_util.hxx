@@ -18,6 +18,7 @@
  */
 
 #include "util/ConstBuffer.hxx"
+#include "util/Macros.hxx"
 
 #include <array>
 #include <random>
@@ -59,6 +60,21 @@ struct RandomFloat {
 	}
 };
 
+/**
+ * Generates float samples at and beyond full scale, repeating.
+ */
+struct FullScaleFloat {
+	unsigned i = 0;
+
+	float operator()() {
+		static constexpr float values[] = {
+			1, -1, 10, -10, 1e20, -1e20, 0.5, -0.5,
+		};
+
+		return values[i++ % ARRAY_SIZE(values)];
+	}
+};
+
 template<typename T, size_t N>
 class TestDataBuffer : std::array<T, N> {
 public:
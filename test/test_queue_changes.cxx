@@ -0,0 +1,335 @@
+/*
+ * Unit tests for the queue and its change log.
+ */
+
+#include "config.h"
+#include "queue/Queue.hxx"
+#include "DetachedSong.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+Tag::Tag(const Tag &) {}
+void Tag::Clear() {}
+
+static std::vector<unsigned>
+GetChanges(const Queue &queue, uint32_t version)
+{
+	std::vector<unsigned> result;
+	queue.VisitChanges(version, [&result](unsigned position){
+			result.push_back(position);
+		});
+	return result;
+}
+
+/**
+ * A snapshot of the queue contents, used as the reference.
+ */
+struct Snapshot {
+	std::vector<std::string> uris;
+	std::vector<uint8_t> priorities;
+
+	explicit Snapshot(const Queue &queue) {
+		for (unsigned i = 0; i < queue.GetLength(); ++i) {
+			uris.push_back(queue.Get(i).GetURI());
+			priorities.push_back(queue.GetPriorityAtPosition(i));
+		}
+	}
+
+	/**
+	 * Does the reported change list cover all positions whose
+	 * song differs from this (older) snapshot?
+	 */
+	bool IsCoveredBy(const Queue &queue,
+			 const std::vector<unsigned> &changes) const {
+		if (!std::is_sorted(changes.begin(), changes.end()) ||
+		    std::adjacent_find(changes.begin(),
+				       changes.end()) != changes.end())
+			return false;
+
+		for (unsigned i = 0; i < queue.GetLength(); ++i) {
+			if (i < uris.size() &&
+			    uris[i] == queue.Get(i).GetURI() &&
+			    priorities[i] == queue.GetPriorityAtPosition(i))
+				continue;
+
+			if (!std::binary_search(changes.begin(), changes.end(),
+						i))
+				return false;
+		}
+
+		return true;
+	}
+};
+
+static std::string
+MakeURI(unsigned i)
+{
+	return "song" + std::to_string(i) + ".ogg";
+}
+
+static void
+Fill(Queue &queue, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		queue.Append(DetachedSong(MakeURI(i)), 0);
+	queue.IncrementVersion();
+}
+
+/**
+ * Move the range [start, end) of a vector so it begins at "to",
+ * like Queue::MoveRange().
+ */
+template<typename T>
+static void
+Move(std::vector<T> &v, unsigned start, unsigned end, unsigned to)
+{
+	std::vector<T> tmp(v.begin() + start, v.begin() + end);
+	v.erase(v.begin() + start, v.begin() + end);
+	v.insert(v.begin() + to, tmp.begin(), tmp.end());
+}
+
+/**
+ * Compare the queue with the reference model.
+ */
+static void
+CheckModel(const Queue &queue, const std::vector<std::string> &uris,
+	   const std::vector<unsigned> &ids)
+{
+	CPPUNIT_ASSERT_EQUAL(uris.size(), size_t(queue.GetLength()));
+
+	std::vector<bool> seen(queue.GetLength(), false);
+
+	for (unsigned i = 0; i < queue.GetLength(); ++i) {
+		CPPUNIT_ASSERT(uris[i] == queue.Get(i).GetURI());
+		CPPUNIT_ASSERT_EQUAL(int(ids[i]), queue.PositionToId(i));
+		CPPUNIT_ASSERT_EQUAL(int(i), queue.IdToPosition(ids[i]));
+
+		const unsigned order = queue.PositionToOrder(i);
+		CPPUNIT_ASSERT_EQUAL(i, queue.OrderToPosition(order));
+		CPPUNIT_ASSERT(!seen[order]);
+		seen[order] = true;
+
+		if (!queue.random)
+			CPPUNIT_ASSERT_EQUAL(i, order);
+	}
+}
+
+class QueueChangesTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(QueueChangesTest);
+	CPPUNIT_TEST(TestSimple);
+	CPPUNIT_TEST(TestRandom);
+	CPPUNIT_TEST(TestOverflow);
+	CPPUNIT_TEST(TestLarge);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSimple() {
+		Queue queue(64);
+		Fill(queue, 32);
+
+		const uint32_t v = queue.version;
+		CPPUNIT_ASSERT(GetChanges(queue, v).empty());
+		CPPUNIT_ASSERT_EQUAL(size_t(32), GetChanges(queue, 0).size());
+
+		queue.SwapPositions(3, 20);
+		queue.IncrementVersion();
+
+		const std::vector<unsigned> expected{3, 20};
+		CPPUNIT_ASSERT(GetChanges(queue, v) == expected);
+
+		/* deleting shifts all following songs */
+		queue.DeletePosition(10);
+		queue.IncrementVersion();
+
+		const auto changes = GetChanges(queue, v);
+		CPPUNIT_ASSERT_EQUAL(size_t(22), changes.size());
+		CPPUNIT_ASSERT_EQUAL(3u, changes.front());
+		for (unsigned i = 10; i < 31; ++i)
+			CPPUNIT_ASSERT_EQUAL(i, changes[i - 9]);
+
+		/* moving a range reports only the affected positions */
+		const uint32_t v2 = queue.version;
+		queue.MoveRange(5, 8, 12);
+		queue.IncrementVersion();
+
+		const auto moved = GetChanges(queue, v2);
+		CPPUNIT_ASSERT_EQUAL(size_t(10), moved.size());
+		CPPUNIT_ASSERT_EQUAL(5u, moved.front());
+		CPPUNIT_ASSERT_EQUAL(14u, moved.back());
+	}
+
+	void TestRandom() {
+		TestRandom(false);
+		TestRandom(true);
+	}
+
+	void TestRandom(bool random) {
+		Queue queue(256);
+		Fill(queue, 100);
+
+		/* the reference model: URIs and ids by position */
+		std::vector<std::string> uris;
+		std::vector<unsigned> ids;
+		for (unsigned i = 0; i < 100; ++i) {
+			uris.push_back(MakeURI(i));
+			ids.push_back(queue.PositionToId(i));
+		}
+
+		unsigned next_uri = 100;
+
+		if (random) {
+			queue.random = true;
+			queue.ShuffleOrder();
+		}
+
+		std::mt19937 rng(42);
+		std::vector<std::pair<uint32_t, Snapshot>> snapshots;
+
+		for (unsigned round = 0; round < 500; ++round) {
+			snapshots.emplace_back(queue.version, Snapshot(queue));
+
+			const unsigned length = queue.GetLength();
+			const unsigned a = rng() % length;
+			const unsigned b = rng() % length;
+
+			switch (rng() % 7) {
+			case 0:
+				queue.SwapPositions(a, b);
+				std::swap(uris[a], uris[b]);
+				std::swap(ids[a], ids[b]);
+				break;
+
+			case 1:
+				queue.MovePostion(a, b);
+				Move(uris, a, a + 1, b);
+				Move(ids, a, a + 1, b);
+				break;
+
+			case 2:
+				if (length > 50) {
+					queue.DeletePosition(a);
+					uris.erase(uris.begin() + a);
+					ids.erase(ids.begin() + a);
+				}
+				break;
+
+			case 3:
+				if (!queue.IsFull()) {
+					uris.push_back(MakeURI(next_uri++));
+					ids.push_back(queue.Append(DetachedSong(uris.back()),
+								   0));
+				}
+				break;
+
+			case 4:
+				queue.SetPriority(a, rng() % 256, -1);
+				break;
+
+			case 5:
+				if (a < b) {
+					const unsigned to =
+						rng() % (length - (b - a) + 1);
+					queue.MoveRange(a, b, to);
+					Move(uris, a, b, to);
+					Move(ids, a, b, to);
+				}
+				break;
+
+			case 6: {
+				/* the songs keep their ids */
+				std::map<std::string, unsigned> uri_to_id;
+				for (unsigned i = 0; i < length; ++i)
+					uri_to_id[uris[i]] = ids[i];
+
+				queue.ShuffleRange(std::min(a, b),
+						   std::max(a, b));
+
+				for (unsigned i = 0; i < length; ++i) {
+					uris[i] = queue.Get(i).GetURI();
+					ids[i] = uri_to_id[uris[i]];
+				}
+				break;
+			}
+			}
+
+			queue.IncrementVersion();
+
+			CheckModel(queue, uris, ids);
+
+			for (unsigned i = 0; i < 5; ++i) {
+				const auto &s =
+					snapshots[rng() % snapshots.size()];
+				CPPUNIT_ASSERT(s.second.IsCoveredBy(queue,
+								    GetChanges(queue, s.first)));
+			}
+		}
+	}
+
+	void TestOverflow() {
+		Queue queue(4096);
+		Fill(queue, 4096);
+
+		const uint32_t v = queue.version;
+
+		/* scattered modifications in separate versions
+		   overflow the log; old versions fall back to
+		   reporting everything */
+		for (unsigned i = 0; i < 2000; ++i) {
+			queue.ModifyAtPosition((i * 7) % 4096);
+			queue.IncrementVersion();
+		}
+
+		CPPUNIT_ASSERT_EQUAL(size_t(4096), GetChanges(queue, v).size());
+
+		const auto recent = GetChanges(queue, queue.version - 10);
+		CPPUNIT_ASSERT_EQUAL(size_t(10), recent.size());
+		for (unsigned i = 1990; i < 2000; ++i)
+			CPPUNIT_ASSERT(std::binary_search(recent.begin(),
+							  recent.end(),
+							  (i * 7) % 4096));
+	}
+
+	void TestLarge() {
+		/* no memory is reserved for the configured maximum */
+		constexpr unsigned N = 200000;
+		Queue queue(1u << 30);
+		Fill(queue, N);
+
+		const int id = queue.PositionToId(2);
+
+		/* moving and deleting at the front of a large queue
+		   must not touch every song; this leaves all even
+		   songs in their original order */
+		for (unsigned i = 0; i < N / 2; ++i) {
+			queue.MovePostion(0, N - 1 - i);
+			queue.DeletePosition(0);
+		}
+
+		CPPUNIT_ASSERT_EQUAL(N / 2, queue.GetLength());
+		for (unsigned i = 0; i < N / 2; i += 997)
+			CPPUNIT_ASSERT(queue.Get(i).GetURI() == MakeURI(i * 2));
+		CPPUNIT_ASSERT_EQUAL(1, queue.IdToPosition(id));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(QueueChangesTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -20,7 +20,7 @@ check_descending_priority(const Queue *queue,
 	uint8_t last_priority = 0xff;
 	for (unsigned order = start_order; order < queue->GetLength(); ++order) {
 		unsigned position = queue->OrderToPosition(order);
-		uint8_t priority = queue->items[position].priority;
+		uint8_t priority = queue->GetPriorityAtPosition(position);
 		assert(priority <= last_priority);
 		(void)last_priority;
 		last_priority = priority;
@@ -136,7 +136,7 @@ QueuePriorityTest::TestPriority()
 
 	unsigned a_order = 3;
 	unsigned a_position = queue.OrderToPosition(a_order);
-	CPPUNIT_ASSERT_EQUAL(10u, unsigned(queue.items[a_position].priority));
+	CPPUNIT_ASSERT_EQUAL(10u, unsigned(queue.GetPriorityAtPosition(a_position)));
 	queue.SetPriority(a_position, 20, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -153,7 +153,7 @@ QueuePriorityTest::TestPriority()
 
 	unsigned b_order = 10;
 	unsigned b_position = queue.OrderToPosition(b_order);
-	CPPUNIT_ASSERT_EQUAL(0u, unsigned(queue.items[b_position].priority));
+	CPPUNIT_ASSERT_EQUAL(0u, unsigned(queue.GetPriorityAtPosition(b_position)));
 	queue.SetPriority(b_position, 70, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -170,7 +170,7 @@ QueuePriorityTest::TestPriority()
 
 	unsigned c_order = 0;
 	unsigned c_position = queue.OrderToPosition(c_order);
-	CPPUNIT_ASSERT_EQUAL(50u, unsigned(queue.items[c_position].priority));
+	CPPUNIT_ASSERT_EQUAL(50u, unsigned(queue.GetPriorityAtPosition(c_position)));
 	queue.SetPriority(c_position, 60, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -183,7 +183,7 @@ QueuePriorityTest::TestPriority()
 
 	a_order = queue.PositionToOrder(a_position);
 	CPPUNIT_ASSERT_EQUAL(5u, a_order);
-	CPPUNIT_ASSERT_EQUAL(20u, unsigned(queue.items[a_position].priority));
+	CPPUNIT_ASSERT_EQUAL(20u, unsigned(queue.GetPriorityAtPosition(a_position)));
 	queue.SetPriority(a_position, 5, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
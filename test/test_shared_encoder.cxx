@@ -0,0 +1,362 @@
+/*
+ * Unit tests for src/encoder/SharedEncoder.cxx
+ */
+
+#include "config.h"
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/EncoderAPI.hxx"
+#include "config/ConfigData.hxx"
+#include "AudioFormat.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned n_init, n_write;
+
+/**
+ * A fake encoder which generates a readable stream: "H" after
+ * opening, a copy of all PCM data, "E" for encoder_pre_tag(), "T"
+ * for encoder_tag().
+ */
+struct FakeEncoder {
+	Encoder encoder;
+
+	std::string output;
+
+	FakeEncoder(const EncoderPlugin &plugin):encoder(plugin) {}
+};
+
+extern const EncoderPlugin fake_encoder_plugin;
+
+static Encoder *
+fake_encoder_init(gcc_unused const config_param &param,
+		  gcc_unused Error &error)
+{
+	++n_init;
+	return &(new FakeEncoder(fake_encoder_plugin))->encoder;
+}
+
+static void
+fake_encoder_finish(Encoder *encoder)
+{
+	delete (FakeEncoder *)encoder;
+}
+
+static bool
+fake_encoder_open(Encoder *encoder, gcc_unused AudioFormat &audio_format,
+		  gcc_unused Error &error)
+{
+	((FakeEncoder *)encoder)->output = "H";
+	return true;
+}
+
+static bool
+fake_encoder_pre_tag(Encoder *encoder, gcc_unused Error &error)
+{
+	((FakeEncoder *)encoder)->output += "E";
+	return true;
+}
+
+static bool
+fake_encoder_tag(Encoder *encoder, gcc_unused const Tag *tag,
+		 gcc_unused Error &error)
+{
+	((FakeEncoder *)encoder)->output += "T";
+	return true;
+}
+
+static bool
+fake_encoder_write(Encoder *encoder, const void *data, size_t length,
+		   gcc_unused Error &error)
+{
+	++n_write;
+	((FakeEncoder *)encoder)->output.append((const char *)data, length);
+	return true;
+}
+
+static size_t
+fake_encoder_read(Encoder *_encoder, void *dest, size_t length)
+{
+	FakeEncoder *encoder = (FakeEncoder *)_encoder;
+	size_t nbytes = std::min(length, encoder->output.length());
+	memcpy(dest, encoder->output.data(), nbytes);
+	encoder->output.erase(0, nbytes);
+	return nbytes;
+}
+
+const EncoderPlugin fake_encoder_plugin = {
+	"fake",
+	fake_encoder_init,
+	fake_encoder_finish,
+	fake_encoder_open,
+	nullptr,
+	nullptr,
+	nullptr,
+	fake_encoder_pre_tag,
+	fake_encoder_tag,
+	fake_encoder_write,
+	fake_encoder_read,
+	nullptr,
+};
+
+static constexpr const char *ignore[] = { "port", nullptr };
+
+static Encoder *
+Init(const char *name, const char *quality, const char *port,
+     const char *mixer_type=nullptr)
+{
+	config_param param;
+	param.AddBlockParam("name", name);
+	param.AddBlockParam("quality", quality);
+	param.AddBlockParam("port", port);
+	if (mixer_type != nullptr)
+		param.AddBlockParam("mixer_type", mixer_type);
+
+	Error error;
+	Encoder *encoder = shared_encoder_init(fake_encoder_plugin, param,
+					       ignore, error);
+	CPPUNIT_ASSERT(encoder != nullptr);
+	return encoder;
+}
+
+static void
+Open(Encoder *encoder)
+{
+	AudioFormat audio_format(44100, SampleFormat::S16, 2);
+	Error error;
+	CPPUNIT_ASSERT(encoder_open(encoder, audio_format, error));
+}
+
+static void
+Write(Encoder *encoder, const char *data)
+{
+	Error error;
+	CPPUNIT_ASSERT(encoder_write(encoder, data, strlen(data), error));
+}
+
+/**
+ * Read until encoder_read() returns 0.
+ */
+static std::string
+Read(Encoder *encoder)
+{
+	std::string result;
+	char buffer[2];
+	size_t nbytes;
+	while ((nbytes = encoder_read(encoder, buffer, sizeof(buffer))) > 0)
+		result.append(buffer, nbytes);
+	return result;
+}
+
+static void
+PreTag(Encoder *encoder)
+{
+	Error error;
+	CPPUNIT_ASSERT(encoder_pre_tag(encoder, error));
+}
+
+static void
+SendTag(Encoder *encoder)
+{
+	Error error;
+	CPPUNIT_ASSERT(encoder_tag(encoder, nullptr, error));
+}
+
+class SharedEncoderTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SharedEncoderTest);
+	CPPUNIT_TEST(TestSolo);
+	CPPUNIT_TEST(TestKey);
+	CPPUNIT_TEST(TestShared);
+	CPPUNIT_TEST(TestTag);
+	CPPUNIT_TEST(TestLeaderClose);
+	CPPUNIT_TEST(TestSoftwareMixer);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {
+		n_init = n_write = 0;
+	}
+
+	void TestSolo() {
+		Encoder *a = Init("a", "5", "8000");
+		CPPUNIT_ASSERT(!shared_encoder_has_peers(a));
+
+		Open(a);
+		CPPUNIT_ASSERT(Read(a) == "H");
+		Write(a, "abc");
+		CPPUNIT_ASSERT(Read(a) == "abc");
+
+		PreTag(a);
+		CPPUNIT_ASSERT(Read(a) == "E");
+		SendTag(a);
+		CPPUNIT_ASSERT(Read(a) == "T");
+		Write(a, "d");
+		CPPUNIT_ASSERT(Read(a) == "d");
+
+		encoder_close(a);
+		encoder_finish(a);
+		CPPUNIT_ASSERT_EQUAL(1u, n_init);
+	}
+
+	void TestKey() {
+		/* "name" and "port" don't matter */
+		Encoder *a = Init("a", "5", "8000");
+		Encoder *b = Init("b", "5", "8001");
+		CPPUNIT_ASSERT_EQUAL(1u, n_init);
+
+		Encoder *c = Init("c", "6", "8002");
+		CPPUNIT_ASSERT_EQUAL(2u, n_init);
+
+		encoder_finish(a);
+		encoder_finish(b);
+		encoder_finish(c);
+
+		/* the real encoder has been freed with the last
+		   instance */
+		Encoder *d = Init("d", "5", "8000");
+		CPPUNIT_ASSERT_EQUAL(3u, n_init);
+		encoder_finish(d);
+	}
+
+	void TestShared() {
+		Encoder *a = Init("a", "5", "8000");
+		Encoder *b = Init("b", "5", "8001");
+
+		Open(a);
+		CPPUNIT_ASSERT(Read(a) == "H");
+		Write(a, "x");
+		CPPUNIT_ASSERT(Read(a) == "x");
+
+		/* a late output receives the header, then the data
+		   which was encoded after it joined */
+		Open(b);
+		CPPUNIT_ASSERT(shared_encoder_has_peers(a));
+		CPPUNIT_ASSERT(shared_encoder_has_peers(b));
+		CPPUNIT_ASSERT(Read(b) == "H");
+
+		Write(a, "yz");
+		Write(b, "yz");
+		CPPUNIT_ASSERT_EQUAL(2u, n_write);
+		CPPUNIT_ASSERT(Read(a) == "yz");
+		CPPUNIT_ASSERT(Read(b) == "yz");
+
+		encoder_close(a);
+		encoder_close(b);
+		encoder_finish(a);
+		encoder_finish(b);
+	}
+
+	void TestTag() {
+		Encoder *a = Init("a", "5", "8000");
+		Encoder *b = Init("b", "5", "8001");
+		Open(a);
+		Open(b);
+		CPPUNIT_ASSERT(Read(a) == "H");
+		CPPUNIT_ASSERT(Read(b) == "H");
+
+		/* the leader receives the tag first */
+		Write(a, "1");
+		PreTag(a);
+		CPPUNIT_ASSERT(Read(a) == "1E");
+		SendTag(a);
+		CPPUNIT_ASSERT(Read(a) == "T");
+		Write(a, "2");
+
+		/* the follower doesn't see the new header before it
+		   has received the tag */
+		Write(b, "1");
+		PreTag(b);
+		CPPUNIT_ASSERT(Read(b) == "1E");
+		SendTag(b);
+		CPPUNIT_ASSERT(Read(b) == "T");
+		Write(b, "2");
+		CPPUNIT_ASSERT(Read(b) == "2");
+		CPPUNIT_ASSERT(Read(a) == "2");
+
+		/* now the follower is first */
+		PreTag(b);
+		CPPUNIT_ASSERT(Read(b) == "E");
+		SendTag(b);
+		CPPUNIT_ASSERT(Read(b) == "T");
+
+		PreTag(a);
+		CPPUNIT_ASSERT(Read(a) == "E");
+		SendTag(a);
+		CPPUNIT_ASSERT(Read(a) == "T");
+
+		Write(a, "3");
+		Write(b, "3");
+		CPPUNIT_ASSERT(Read(a) == "3");
+		CPPUNIT_ASSERT(Read(b) == "3");
+
+		/* the real encoder has seen each tag only once */
+		CPPUNIT_ASSERT_EQUAL(3u, n_write);
+
+		encoder_close(a);
+		encoder_close(b);
+		encoder_finish(a);
+		encoder_finish(b);
+	}
+
+	void TestLeaderClose() {
+		Encoder *a = Init("a", "5", "8000");
+		Encoder *b = Init("b", "5", "8001");
+		Open(a);
+		Open(b);
+		Read(a);
+		Read(b);
+
+		/* the follower becomes the leader */
+		encoder_close(a);
+		CPPUNIT_ASSERT(!shared_encoder_has_peers(b));
+		Write(b, "x");
+		CPPUNIT_ASSERT(Read(b) == "x");
+
+		/* the old leader joins again as a follower */
+		Open(a);
+		CPPUNIT_ASSERT(Read(a) == "H");
+		Write(a, "y");
+		CPPUNIT_ASSERT(Read(a) == "");
+		Write(b, "y");
+		CPPUNIT_ASSERT(Read(a) == "y");
+		CPPUNIT_ASSERT(Read(b) == "y");
+
+		encoder_close(a);
+		encoder_close(b);
+		encoder_finish(a);
+		encoder_finish(b);
+		CPPUNIT_ASSERT_EQUAL(1u, n_init);
+	}
+
+	void TestSoftwareMixer() {
+		/* each output has its own volume, so the PCM data
+		   differs */
+		Encoder *a = Init("a", "5", "8000", "software");
+		Encoder *b = Init("b", "5", "8001", "software");
+		CPPUNIT_ASSERT_EQUAL(2u, n_init);
+		CPPUNIT_ASSERT(&a->plugin == &fake_encoder_plugin);
+		CPPUNIT_ASSERT(!shared_encoder_has_peers(a));
+
+		encoder_finish(a);
+		encoder_finish(b);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedEncoderTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+/*
+ * Unit tests for class SongArena.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/SongArena.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+class SongArenaTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SongArenaTest);
+	CPPUNIT_TEST(TestAdjacent);
+	CPPUNIT_TEST(TestFreeBlocks);
+	CPPUNIT_TEST(TestLarge);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestAdjacent() {
+		SongArena arena;
+
+		char *a = (char *)arena.Allocate(100);
+		char *b = (char *)arena.Allocate(1);
+		CPPUNIT_ASSERT(a != nullptr);
+		CPPUNIT_ASSERT(b > a && b < a + 256);
+		CPPUNIT_ASSERT_EQUAL(uintptr_t(0),
+				     uintptr_t(b) % sizeof(void *));
+		memset(a, 0xff, 100);
+		memset(b, 0xff, 1);
+
+		arena.Free(a);
+		arena.Free(b);
+		CPPUNIT_ASSERT_EQUAL(1u, arena.GetBlockCount());
+	}
+
+	void TestFreeBlocks() {
+		SongArena arena;
+
+		std::vector<void *> objects;
+		for (unsigned i = 0; i < 10000; ++i)
+			objects.push_back(arena.Allocate(100));
+
+		const unsigned n_blocks = arena.GetBlockCount();
+		CPPUNIT_ASSERT(n_blocks > 1);
+		CPPUNIT_ASSERT(n_blocks < 40);
+
+		/* freeing every other object does not release a
+		   block */
+		for (unsigned i = 0; i < objects.size(); i += 2)
+			arena.Free(objects[i]);
+		CPPUNIT_ASSERT_EQUAL(n_blocks, arena.GetBlockCount());
+
+		/* freeing all releases all but the current block */
+		for (unsigned i = 1; i < objects.size(); i += 2)
+			arena.Free(objects[i]);
+		CPPUNIT_ASSERT_EQUAL(1u, arena.GetBlockCount());
+
+		/* the current block is reused */
+		arena.Free(arena.Allocate(100));
+		CPPUNIT_ASSERT_EQUAL(1u, arena.GetBlockCount());
+	}
+
+	void TestLarge() {
+		SongArena arena;
+
+		void *p = arena.Allocate(1024 * 1024);
+		memset(p, 0, 1024 * 1024);
+		CPPUNIT_ASSERT_EQUAL(0u, arena.GetBlockCount());
+		arena.Free(p);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SongArenaTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
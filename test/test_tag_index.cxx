@@ -0,0 +1,235 @@
+/*
+ * Unit tests for the tag index of the simple database plugin.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/TagIndex.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "SongFilter.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Set.hxx"
+#include "lib/icu/Init.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdlib.h>
+
+static void
+CollectUniqueTags(TagSet &set, const Directory &directory,
+		  TagType type, uint32_t group_mask)
+{
+	for (const auto &song : directory.songs)
+		set.InsertUnique(song.tag, type, group_mask);
+
+	for (const auto &child : directory.children)
+		CollectUniqueTags(set, child, type, group_mask);
+}
+
+/**
+ * Compare the aggregate with a #TagSet built by visiting all songs.
+ */
+static bool
+CheckAggregate(TagIndex &index, const Directory &root,
+	       TagType type, uint32_t group_mask)
+{
+	TagSet expected;
+	CollectUniqueTags(expected, root, type, group_mask);
+
+	const auto &map = *index.GetAggregate(root, type, group_mask);
+	if (map.size() != expected.size())
+		return false;
+
+	auto i = expected.begin();
+	for (const auto &j : map) {
+		if (TagLess()(*i, j.first) || TagLess()(j.first, *i))
+			return false;
+		++i;
+	}
+
+	return true;
+}
+
+static Song *
+AddSong(Directory &directory, const char *name,
+	const char *artist, const char *album)
+{
+	Song *song = Song::NewFile(name, directory);
+
+	TagBuilder tag;
+	tag.AddItem(TAG_ARTIST, artist);
+	tag.AddItem(TAG_ALBUM, album);
+	tag.Commit(song->tag);
+
+	directory.AddSong(song);
+	return song;
+}
+
+class TagIndexTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TagIndexTest);
+	CPPUNIT_TEST(TestFind);
+	CPPUNIT_TEST(TestLookup);
+	CPPUNIT_TEST(TestRemove);
+	CPPUNIT_TEST(TestAggregates);
+	CPPUNIT_TEST_SUITE_END();
+
+	Directory *root;
+	Song *a1, *a2, *b1;
+
+	TagIndex index;
+
+public:
+	void setUp() override {
+		const ScopeDatabaseLock protect;
+
+		root = Directory::NewRoot();
+		Directory *d = root->CreateChild("d");
+		a1 = AddSong(*root, "a1.ogg", "Foo", "Alpha");
+		a2 = AddSong(*d, "a2.ogg", "Foo", "Another");
+		b1 = AddSong(*d, "b1.ogg", "Foobar", "Beta");
+
+		index.Rebuild(*root);
+	}
+
+	void tearDown() override {
+		const ScopeDatabaseLock protect;
+
+		index.Clear();
+		delete root;
+	}
+
+	void TestFind() {
+		const ScopeDatabaseLock protect;
+
+		TagIndex::SongSet songs;
+		index.FindExact(TAG_ARTIST, "Foo", songs);
+		CPPUNIT_ASSERT(songs == TagIndex::SongSet({a1, a2}));
+
+		songs.clear();
+		index.FindExact(TAG_ARTIST, "Fo", songs);
+		CPPUNIT_ASSERT(songs.empty());
+
+		index.FindPrefix(TAG_ARTIST, "Fo", songs);
+		CPPUNIT_ASSERT_EQUAL(size_t(3), songs.size());
+
+		songs.clear();
+		index.FindPrefix(TAG_ALBUM, "A", songs);
+		CPPUNIT_ASSERT(songs == TagIndex::SongSet({a1, a2}));
+
+		songs.clear();
+		index.FindFolded(TAG_ARTIST, "bar", songs);
+		CPPUNIT_ASSERT(songs == TagIndex::SongSet({b1}));
+
+		CPPUNIT_ASSERT_EQUAL(size_t(2), index.GetValueCount(TAG_ARTIST));
+		CPPUNIT_ASSERT_EQUAL(size_t(0), index.GetValueCount(TAG_TITLE));
+	}
+
+	void TestLookup() {
+		const ScopeDatabaseLock protect;
+
+		TagIndex::SongSet songs;
+		CPPUNIT_ASSERT(!index.Lookup(SongFilter(LOCATE_TAG_FILE_TYPE,
+							"a1.ogg"),
+					     songs));
+		CPPUNIT_ASSERT(!index.Lookup(SongFilter(TAG_ARTIST, ""),
+					     songs));
+
+		/* the most selective item is used */
+		SongFilter filter;
+		CPPUNIT_ASSERT(filter.Parse("artist", "Foo"));
+		CPPUNIT_ASSERT(filter.Parse("album", "Another"));
+		CPPUNIT_ASSERT(index.Lookup(filter, songs));
+		CPPUNIT_ASSERT(songs == TagIndex::SongSet({a2}));
+
+		songs.clear();
+		CPPUNIT_ASSERT(index.Lookup(SongFilter(LOCATE_TAG_ANY_TYPE,
+						       "beta", true),
+					    songs));
+		CPPUNIT_ASSERT(songs == TagIndex::SongSet({b1}));
+
+		songs.clear();
+		CPPUNIT_ASSERT(index.Lookup(SongFilter(TAG_ALBUM_ARTIST,
+						       "Foobar"),
+					    songs));
+		CPPUNIT_ASSERT(songs == TagIndex::SongSet({b1}));
+	}
+
+	void TestRemove() {
+		const ScopeDatabaseLock protect;
+
+		const Tag old_tag(a1->tag);
+		TagBuilder tag;
+		tag.AddItem(TAG_ARTIST, "Qux");
+		tag.Commit(a1->tag);
+
+		index.Remove(*a1, old_tag);
+		index.Add(*a1);
+
+		TagIndex::SongSet songs;
+		index.FindExact(TAG_ARTIST, "Foo", songs);
+		CPPUNIT_ASSERT(songs == TagIndex::SongSet({a2}));
+
+		songs.clear();
+		index.FindExact(TAG_ARTIST, "Qux", songs);
+		CPPUNIT_ASSERT(songs == TagIndex::SongSet({a1}));
+
+		/* "Alpha" was only used by a1 */
+		CPPUNIT_ASSERT_EQUAL(size_t(2), index.GetValueCount(TAG_ALBUM));
+
+		index.Remove(*b1);
+		CPPUNIT_ASSERT_EQUAL(size_t(2), index.GetValueCount(TAG_ARTIST));
+	}
+
+	void TestAggregates() {
+		const ScopeDatabaseLock protect;
+
+		CPPUNIT_ASSERT_EQUAL(3u, index.GetTotal().n_songs);
+
+		const auto &artists = *index.GetAggregate(*root, TAG_ARTIST, 0);
+		CPPUNIT_ASSERT_EQUAL(size_t(2), artists.size());
+		CPPUNIT_ASSERT_EQUAL(2u, artists.begin()->second.n_songs);
+		CPPUNIT_ASSERT(CheckAggregate(index, *root, TAG_ALBUM,
+					      1u << TAG_ARTIST));
+		CPPUNIT_ASSERT(CheckAggregate(index, *root, TAG_TITLE, 0));
+
+		/* the aggregates follow modifications */
+		Directory &d = *root->FindChild("d");
+		index.Remove(*a2);
+		d.RemoveSong(a2);
+		a2->Free();
+
+		Song *c = AddSong(d, "c.ogg", "Zed", "Alpha");
+		index.Add(*c);
+
+		CPPUNIT_ASSERT_EQUAL(3u, index.GetTotal().n_songs);
+		CPPUNIT_ASSERT(CheckAggregate(index, *root, TAG_ARTIST, 0));
+		CPPUNIT_ASSERT(CheckAggregate(index, *root, TAG_ALBUM,
+					      1u << TAG_ARTIST));
+		CPPUNIT_ASSERT(CheckAggregate(index, *root, TAG_TITLE, 0));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TagIndexTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	/* case folding in SongFilter needs the collator */
+	Error error;
+	if (!IcuInit(error))
+		return EXIT_FAILURE;
+
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	const bool success = runner.run();
+
+	IcuFinish();
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
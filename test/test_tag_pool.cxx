@@ -0,0 +1,170 @@
+/*
+ * Unit tests for the tag pool.
+ */
+
+#include "config.h"
+#include "tag/TagPool.hxx"
+#include "tag/TagItem.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <atomic>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static TagItem *
+GetItem(TagType type, const char *value)
+{
+	return tag_pool_get_item(type, value, strlen(value));
+}
+
+static unsigned
+GetItemCount()
+{
+	TagPoolStats stats;
+	tag_pool_get_stats(stats);
+	return stats.n_items;
+}
+
+class TagPoolTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TagPoolTest);
+	CPPUNIT_TEST(TestIntern);
+	CPPUNIT_TEST(TestRefCount);
+	CPPUNIT_TEST(TestGrow);
+	CPPUNIT_TEST(TestThreads);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestIntern() {
+		TagItem *a = GetItem(TAG_ARTIST, "foo");
+		TagItem *b = tag_pool_get_item(TAG_ARTIST, "foobar", 3);
+		TagItem *c = GetItem(TAG_ALBUM, "foo");
+		TagItem *d = GetItem(TAG_ARTIST, "fo");
+
+		CPPUNIT_ASSERT(a == b);
+		CPPUNIT_ASSERT(a != c);
+		CPPUNIT_ASSERT(a != d);
+		CPPUNIT_ASSERT_EQUAL(TAG_ARTIST, a->type);
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(a->value, "foo"));
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(d->value, "fo"));
+		CPPUNIT_ASSERT_EQUAL(3u, GetItemCount());
+
+		tag_pool_put_item(a);
+		tag_pool_put_item(b);
+		tag_pool_put_item(c);
+		tag_pool_put_item(d);
+		CPPUNIT_ASSERT_EQUAL(0u, GetItemCount());
+	}
+
+	void TestRefCount() {
+		/* far beyond the old 8 bit reference counter; all
+		   references share one item */
+		std::vector<TagItem *> items;
+		TagItem *a = GetItem(TAG_GENRE, "Rock");
+		for (unsigned i = 0; i < 1000; ++i)
+			items.push_back(tag_pool_dup_item(a));
+		for (unsigned i = 0; i < 1000; ++i)
+			items.push_back(GetItem(TAG_GENRE, "Rock"));
+
+		for (auto i : items)
+			CPPUNIT_ASSERT(i == a);
+		CPPUNIT_ASSERT_EQUAL(1u, GetItemCount());
+
+		for (auto i : items)
+			tag_pool_put_item(i);
+		CPPUNIT_ASSERT_EQUAL(1u, GetItemCount());
+
+		tag_pool_put_item(a);
+		CPPUNIT_ASSERT_EQUAL(0u, GetItemCount());
+	}
+
+	void TestGrow() {
+		constexpr unsigned N = 100000;
+
+		std::vector<TagItem *> items;
+		for (unsigned i = 0; i < N; ++i) {
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), "Title %u", i);
+			items.push_back(GetItem(TAG_TITLE, buffer));
+		}
+
+		TagPoolStats stats;
+		tag_pool_get_stats(stats);
+		CPPUNIT_ASSERT_EQUAL(N, stats.n_items);
+		CPPUNIT_ASSERT(stats.n_buckets * 2 >= N);
+		CPPUNIT_ASSERT(stats.n_used_buckets <= stats.n_items);
+		CPPUNIT_ASSERT(stats.max_chain >= 1);
+		CPPUNIT_ASSERT(stats.max_chain < 32);
+
+		for (auto i : items)
+			tag_pool_put_item(i);
+		CPPUNIT_ASSERT_EQUAL(0u, GetItemCount());
+	}
+
+	void TestThreads();
+};
+
+struct ThreadContext {
+	std::atomic<bool> failed;
+
+	ThreadContext():failed(false) {}
+};
+
+static void
+InternThread(void *ctx)
+{
+	ThreadContext &c = *(ThreadContext *)ctx;
+
+	for (unsigned round = 0; round < 20; ++round) {
+		std::vector<TagItem *> items;
+		for (unsigned i = 0; i < 500; ++i) {
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), "Artist %u", i);
+			TagItem *item = GetItem(TAG_ARTIST, buffer);
+			if (strcmp(item->value, buffer) != 0)
+				c.failed = true;
+
+			items.push_back(item);
+			items.push_back(tag_pool_dup_item(item));
+		}
+
+		for (auto i : items)
+			tag_pool_put_item(i);
+	}
+}
+
+void
+TagPoolTest::TestThreads()
+{
+	ThreadContext c;
+
+	Thread threads[4];
+	Error error;
+	for (auto &t : threads)
+		CPPUNIT_ASSERT(t.Start(InternThread, &c, error));
+
+	for (auto &t : threads)
+		t.Join();
+
+	CPPUNIT_ASSERT(!c.failed.load());
+	CPPUNIT_ASSERT_EQUAL(0u, GetItemCount());
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TagPoolTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}